@@ -0,0 +1,38 @@
+// AmbientOcclusion.h - per-vertex ambient occlusion baked by ray casting
+
+#ifndef AMBIENT_OCCLUSION_HDR
+#define AMBIENT_OCCLUSION_HDR
+
+#include <functional>
+#include <vector>
+#include "Mesh.h"
+#include "VecMat.h"
+
+using std::vector;
+
+// the occlusion of a vertex is the fraction of cosine-weighted rays, over the hemisphere about its normal,
+// that hit the mesh within maxDistance: 0 is fully open, 1 fully occluded
+// rays are traced against a bounding volume hierarchy of the mesh triangles; vertices are split among all cores
+
+class OcclusionBaker {
+public:
+	int nRays = 32;                         // rays per vertex (quality vs. time)
+	float maxDistance = .5f;                // ignore hits farther than this (object space); 0 for unbounded
+	bool useCache = true;                   // read/write <objFilename>.ao
+	std::function<void(float)> progress;    // if set, called with fraction done (on the calling thread)
+	float bakeMs = 0;                       // time for last bake (0 if read from cache)
+	void Bake(const vector<vec3> &points, const vector<vec3> &normals, const vector<int3> &triangles,
+			  vector<float> &occlusion);
+		// set occlusion for each point; normals correspond with points
+	bool Bake(Mesh &m);
+		// set m.occlusion, computing normals if m has none
+		// if useCache and <m.objFilename>.ao is current, read it, else bake and write it
+		// return true if read from the cache
+};
+
+bool ReadOcclusion(const char *filename, int nPoints, int nTriangles, int nRays, float maxDistance, vector<float> &occlusion);
+	// read occlusion if the file was baked for the same mesh size and settings
+
+bool WriteOcclusion(const char *filename, int nTriangles, int nRays, float maxDistance, vector<float> &occlusion);
+
+#endif
@@ -0,0 +1,85 @@
+// Arena.h - per-frame bump allocator for transient arrays, with STL allocators and scoped marks
+
+#ifndef ARENA_HDR
+#define ARENA_HDR
+
+#include <cstddef>
+#include <vector>
+
+// an arena hands out memory by advancing an offset through blocks taken from the heap; nothing is freed
+// individually: a scope (ArenaScope) returns everything allocated within it, and Reset, once per frame,
+// returns everything; if a frame spilled into more than one block, Reset merges them into one, so the
+// following frames, needing no more, take nothing from the heap; if for shrinkFrames Resets in a row the
+// arena holds more than twice what those frames used (eg, after a one-off spike), Reset frees it for one
+// block of their high water
+// not thread-safe: frameArena is per thread, and memory from it may be read and written by other
+// threads (eg, within ParallelFor) but only allocated by its own
+
+struct ArenaMark {
+	int block = 0;
+	size_t offset = 0, used = 0;
+};
+
+class Arena {
+public:
+	size_t blockSize = (size_t) 1 << 20;	// least size of a block taken from the heap
+	int shrinkFrames = 300;					// oversized Resets in a row before the arena shrinks
+	// statistics
+	size_t used = 0;						// bytes allocated (with alignment padding) since the last Reset
+	size_t highWater = 0;					// most bytes used at once, over all frames
+	size_t frameHighWater = 0;				// most bytes used at once since the last Reset
+	int heapBlocks = 0;						// blocks taken from the heap, in total
+	void *Allocate(size_t bytes, size_t align = alignof(std::max_align_t));
+	void Free(void *p, size_t bytes);
+		// give back the space only if p is the latest allocation (eg, a vector's last growth)
+	ArenaMark Mark() const;
+	void Reset(ArenaMark mark);
+		// return everything allocated since mark
+	void Reset();
+		// return everything, shrinking as above; call once per frame, with no ArenaScope open
+	size_t Capacity() const;
+		// bytes held in blocks
+	~Arena();
+private:
+	struct Block { char *data; size_t size; };
+	std::vector<Block> blocks;
+	int block = 0;							// current block
+	size_t offset = 0;						// within it
+	size_t recentHighWater = 0;				// most bytes used at once over the current run of oversized Resets
+	int nOversized = 0;						// length of that run
+};
+
+extern thread_local Arena frameArena;
+
+class ArenaScope {
+public:
+	Arena &arena;
+	ArenaMark mark;
+	ArenaScope(Arena &a = frameArena) : arena(a), mark(a.Mark()) { }
+	~ArenaScope() { arena.Reset(mark); }
+	ArenaScope(const ArenaScope &) = delete;
+	ArenaScope &operator=(const ArenaScope &) = delete;
+};
+	// declare before the arena arrays it covers, so they are destroyed first
+
+template <class T> struct ArenaAllocator {
+	typedef T value_type;
+	Arena *arena;
+	ArenaAllocator() : arena(&frameArena) { }
+	ArenaAllocator(Arena &a) : arena(&a) { }
+	template <class U> ArenaAllocator(const ArenaAllocator<U> &a) : arena(a.arena) { }
+	T *allocate(size_t n) { return (T *) arena->Allocate(n*sizeof(T), alignof(T)); }
+	void deallocate(T *p, size_t n) { arena->Free(p, n*sizeof(T)); }
+	template <class U> bool operator==(const ArenaAllocator<U> &a) const { return arena == a.arena; }
+	template <class U> bool operator!=(const ArenaAllocator<U> &a) const { return arena != a.arena; }
+};
+
+template <class T> using ArenaVector = std::vector<T, ArenaAllocator<T>>;
+	// a vector in frameArena (by default); valid until the enclosing ArenaScope ends or the frame's Reset
+
+long long HeapAllocations();
+	// calls to the global operator new, over all threads, since start, if the program links src/HeapCount.cpp
+	// (which replaces the operator to count them), else -1; the difference over a frame is the frame's heap
+	// allocations
+
+#endif
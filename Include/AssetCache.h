@@ -0,0 +1,77 @@
+// AssetCache.h - reference-counted meshes and textures, shared by every object that reads the same file
+
+#ifndef ASSET_CACHE_HDR
+#define ASSET_CACHE_HDR
+
+#include <functional>
+#include <map>
+#include <string>
+#include "Mesh.h"
+
+using std::string;
+
+// an asset is read, buffered and uploaded once per key (canonical path plus load options); Mesh::Read and
+// Meshadow::Read acquire meshes and textures here: a mesh reads the asset's geometry in place until it changes
+// it (OwnGeometry copies it first), and draws with the asset's vertex array and buffers until it re-buffers
+// (Buffer, UpdatePoints), which gives it buffers of its own; textures are shared outright
+// an asset nobody holds stays resident, so a later read is a hit, until the cache exceeds its budget;
+// then idle assets are freed, least recently used first
+
+class AssetCache;
+
+struct Asset {
+	string key;							// canonical path and load options
+	int refs = 0;						// holders; idle (evictable) at 0
+	size_t bytes = 0;					// CPU and GPU memory held
+	int lastUse = 0;					// cache tick of the last acquire or release
+	AssetCache *cache = NULL;			// NULL once the cache is gone: freed on last release
+	virtual ~Asset() { }
+	void Release();
+		// drop a reference
+};
+
+struct MeshAsset : Asset {
+	Mesh *mesh = NULL;					// read and buffered once (a Meshadow if read as one); owns the GPU objects
+										// and, in sharedGeometry, the CPU arrays its instances read
+	MemoryOwner memory{"mesh geometry"};	// the shared arrays (the mesh reports its GPU objects)
+	~MeshAsset();
+};
+
+struct TextureAsset : Asset {
+	GLuint textureName = 0;
+	int width = 0, height = 0, channels = 0;
+	MemoryOwner memory{"texture"};
+	~TextureAsset();
+};
+
+class AssetCache {
+public:
+	size_t budget = (size_t) 256 << 20;	// bytes resident above which idle assets are freed
+	// statistics
+	int hits = 0, misses = 0, evictions = 0;
+	size_t bytesResident = 0;			// held and idle assets
+	size_t bytesIdle = 0;
+	MeshAsset *GetMesh(const string &key, std::function<Mesh *()> load);
+		// acquire the mesh under key, calling load (a new, read Mesh or NULL) on a miss; NULL if load fails
+	TextureAsset *GetTexture(const string &filename, bool mipmap = true);
+		// acquire the texture, loading it on a miss (into texture unit 0, a pooled texture name if one of its
+		// size is free); NULL if it can't be read
+	void Trim(size_t bytes);
+		// free idle assets, least recently used first, until at most bytes are resident
+	void Print() const;
+	~AssetCache();
+private:
+	std::map<string, Asset *> assets;
+	int tick = 0;
+	Asset *Find(const string &key);
+	void Add(Asset *a);
+	void Idle(Asset *a);
+	friend struct Asset;
+};
+
+extern AssetCache assetCache;
+
+string AssetKey(const string &filename, const string &options);
+	// canonical (absolute, resolved) path, if the file exists, then the options
+
+#endif
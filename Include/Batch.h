@@ -0,0 +1,103 @@
+// Batch.h - structure-of-arrays vectors and bulk kernels over arrays of vec3
+
+#ifndef BATCH_HDR
+#define BATCH_HDR
+
+#include <vector>
+#include "Quaternion.h"
+#include "VecMat.h"
+
+using std::vector;
+
+// kernels process four vec3s per step with SSE where available (de-interleaving the 12 floats in registers),
+// with a scalar remainder; arrays larger than a few thousand are split among threads (see Parallel.h)
+// in and out may be the same array; all work directly on vector<vec3> data such as Mesh::points, normals
+
+// Structure of Arrays
+
+class vec3SoA {
+public:
+	vector<float> x, y, z;
+	int size() const { return (int) x.size(); }
+	void resize(int n) { x.resize(n); y.resize(n); z.resize(n); }
+	vec3 operator [] (int i) const { return vec3(x[i], y[i], z[i]); }
+	void Set(int i, vec3 v) { x[i] = v.x; y[i] = v.y; z[i] = v.z; }
+};
+
+void ToSoA(const vec3 *in, int n, vec3SoA &out);
+	// resize out to n and copy
+void ToAoS(const vec3SoA &in, vec3 *out);
+	// copy in.size() vectors to out
+void ToAoS(const float *x, const float *y, const float *z, int n, vec3 *out);
+	// as above, from separate arrays (eg, part of a vec3SoA)
+
+// Transformation
+
+void XformPoints(mat4 m, const vec3 *in, vec3 *out, int n);
+	// out[i] = m*in[i] (w = 1); affine: bottom row of m ignored
+void XformPoints(mat4 m, vector<vec3> &points);
+	// in place
+void XformVectors(mat4 m, const vec3 *in, vec3 *out, int n);
+	// out[i] = upper 3x3 of m times in[i] (w = 0)
+
+// Geometry
+
+void NormalizeVectors(vec3 *v, int n);
+	// unit length; zero vectors are left zero
+void MinMax(const vec3 *p, int n, vec3 &min, vec3 &max);
+	// bounds of p (min = FLT_MAX, max = -FLT_MAX if n is 0)
+void Dot(const vec3 *a, const vec3 *b, float *out, int n);
+	// out[i] = dot(a[i], b[i])
+void Cross(const vec3 *a, const vec3 *b, vec3 *out, int n);
+	// out[i] = cross(a[i], b[i])
+
+// Quaternions and Frames
+
+class quatSoA {
+public:
+	vector<float> x, y, z, w;
+	int size() const { return (int) x.size(); }
+	void resize(int n) { x.resize(n); y.resize(n); z.resize(n); w.resize(n); }
+	Quaternion operator [] (int i) const { return Quaternion(x[i], y[i], z[i], w[i]); }
+	void Set(int i, const Quaternion &q) { x[i] = q.x; y[i] = q.y; z[i] = q.z; w[i] = q.w; }
+};
+
+class FrameSoA {
+public:
+	quatSoA orientation;
+	vec3SoA position;
+	vector<float> scale;
+	int size() const { return (int) scale.size(); }
+	void resize(int n) { orientation.resize(n); position.resize(n); scale.resize(n); }
+	Frame operator [] (int i) const { return Frame(orientation[i], position[i], scale[i]); }
+	void Set(int i, const Frame &f) { orientation.Set(i, f.orientation); position.Set(i, f.position); scale[i] = f.scale; }
+};
+
+void ToSoA(const Quaternion *in, int n, quatSoA &out);
+void ToAoS(const quatSoA &in, Quaternion *out);
+void ToSoA(const Frame *in, int n, FrameSoA &out);
+void ToAoS(const FrameSoA &in, Frame *out);
+
+void Nlerp(const quatSoA &a, const quatSoA &b, const float *t, quatSoA &out);
+	// out[i] = normalized (1-t[i])*a[i]+t[i]*b[i]
+void Slerp(const quatSoA &a, const quatSoA &b, const float *t, quatSoA &out);
+	// as Quaternion::Slerp, within 1e-6 of its formula in exact arithmetic (Quaternion::Slerp, in float,
+	// strays by up to 3e-3 as the ends approach opposite); like it (and Nlerp), takes the arc from a to b
+	// as given: negate b where dot(a, b) < 0 for the shorter arc
+void GetMatrices(const quatSoA &q, mat4 *out);
+	// out[i] = q[i].GetMatrix()
+void Compose(const FrameSoA &a, const FrameSoA &b, FrameSoA &out);
+	// out[i] = a[i]*b[i]
+void Compose(const Frame &a, const FrameSoA &b, FrameSoA &out);
+	// out[i] = a*b[i], eg, parts of an assembly
+void GetMatrices(const FrameSoA &f, mat4 *out);
+	// out[i] = f[i].GetMatrix()
+
+// Triangles
+
+void TriangleNormals(const vec3 *points, const int3 *triangles, vec3 *out, int n, bool unit = true);
+	// out[i] = cross(p2-p1, p3-p2) for triangle i, normalized if unit (else its length is twice the area)
+void TriangleAngles(const vec3 *points, const int3 *triangles, float *out, int n);
+	// out[3*i+k] = interior angle, in radians, at corner k of triangle i (to about 1e-6)
+
+#endif
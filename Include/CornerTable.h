@@ -0,0 +1,68 @@
+// CornerTable.h - index-based triangle connectivity: vertex to triangle adjacency, opposite corners
+
+#ifndef CORNER_TABLE_HDR
+#define CORNER_TABLE_HDR
+
+#include <stddef.h>
+#include <vector>
+#include "VecMat.h"
+
+using std::vector;
+
+// corner c is vertex c%3 of triangle c/3; the edge facing corner c runs from Next(c) to Prev(c)
+// all arrays are flat and indexed by vertex or corner (no pointers), so tables copy and free cheaply
+
+class VertexTriangles {
+public:
+	// compressed (CSR) vertex to triangle adjacency: the triangle corners at vertex v are
+	// corners[offsets[v]] through corners[offsets[v+1]-1], where corner c is vertex c%3 of triangle c/3
+	vector<int> offsets, corners;
+	vector<vec3> triNormals;			// scratch for SetVertexNormals, kept between calls
+	vector<float> angles;
+	void Build(const vector<int3> &triangles, int nVertices);
+	bool Current(int nVertices, int nTriangles) const {
+		return (int) offsets.size() == nVertices+1 && (int) corners.size() == 3*nTriangles; }
+	void Clear() { offsets.resize(0); corners.resize(0); triNormals.resize(0); angles.resize(0); }
+};
+
+class CornerTable {
+public:
+	enum { Boundary = -1, NonManifold = -2 };
+	vector<int> vertices;				// vertex id per corner (the mesh triangles, flattened)
+	vector<int> opposite;				// corner facing the same edge in the neighboring triangle,
+										// else Boundary, or NonManifold if the edge has more than two
+										// triangles (or two with inconsistent winding, or is degenerate)
+	VertexTriangles vertexCorners;		// corners around each vertex
+	int nBoundaryEdges = 0, nNonManifoldEdges = 0;
+	float buildMs = 0;
+	void Build(const vector<int3> &triangles, int nVertices);
+		// linear in the number of corners (for bounded valence); opposites found in parallel
+	bool Current(int nVertices, int nTriangles) const {
+		return vertexCorners.Current(nVertices, nTriangles) && (int) opposite.size() == 3*nTriangles; }
+	void Clear();
+	// corners
+	static int Next(int c) { return c%3 == 2? c-2 : c+1; }
+	static int Prev(int c) { return c%3 == 0? c+2 : c-1; }
+	static int Triangle(int c) { return c/3; }
+	int Vertex(int c) const { return vertices[c]; }
+	int Opposite(int c) const { return opposite[c]; }
+	// vertices
+	int NVertices() const { return (int) vertexCorners.offsets.size()-1; }
+	int NTriangles() const { return (int) vertices.size()/3; }
+	int Valence(int v) const { return vertexCorners.offsets[v+1]-vertexCorners.offsets[v]; }
+	const int *Corners(int v) const { return vertexCorners.corners.data()+vertexCorners.offsets[v]; }
+		// Valence(v) corners
+	void OneRing(int v, vector<int> &neighbors) const;
+		// distinct vertices sharing an edge with v, in no particular order
+	bool IsBoundary(int v) const;
+		// v is on an edge with one triangle
+	bool IsManifold(int v) const;
+		// v's edges have at most two triangles, and v's triangles form a single fan (a disk, or
+		// a half-disk at the boundary)
+	// memory
+	size_t Bytes() const;
+	void Print() const;
+		// counts, boundary and non-manifold edges, bytes per vertex and per triangle, build time
+};
+
+#endif
@@ -0,0 +1,64 @@
+// Deformer.h - ordered stack of procedural deformations (wave, twist, bend, noise) applied to mesh points
+
+#ifndef DEFORMER_HDR
+#define DEFORMER_HDR
+
+#include <vector>
+#include "Batch.h"
+#include "Mesh.h"
+#include "VecMat.h"
+
+using std::vector;
+
+// each frame the stack maps the rest (undeformed) points through its deformers, in order, into the back
+// of a pair of output buffers, which then becomes the front; points are processed four at a time with SSE
+// (polynomial sin and cos), in chunks split among threads (see Parallel.h)
+
+enum DeformerType { WaveDeformer = 0, TwistDeformer, BendDeformer, NoiseDeformer };
+
+struct Deformer {
+	DeformerType type = WaveDeformer;
+	int axis = 0;                           // deformation varies along this axis (0: X, 1: Y, 2: Z)
+	vec3 direction = vec3(0, 1, 0);         // wave and noise displacement
+	float amplitude = 0;                    // wave and noise displacement
+	float frequency = 1;                    // wave and noise, cycles per unit
+	float phase = 0;                        // wave and noise, radians; animate to move the wave
+	float rate = 0;                         // twist, radians per unit along axis; bend, curvature (1/radius)
+	int toward = 1;                         // bend toward this axis
+};
+
+Deformer Wave(int axis, vec3 direction, float amplitude, float frequency, float phase = 0);
+	// p += direction*amplitude*sin(2*pi*frequency*p[axis]+phase)
+Deformer Twist(int axis, float radiansPerUnit);
+	// rotate about axis by radiansPerUnit*p[axis]
+Deformer Bend(int axis, int toward, float curvature);
+	// bend the axis into an arc of radius 1/curvature, centered on the toward axis at 1/curvature
+Deformer Noise(vec3 direction, float amplitude, float frequency, float phase = 0);
+	// p += direction*amplitude*n(p), n a smooth pseudo-noise in [-1, 1] (product of sines along skewed axes)
+
+class DeformerStack {
+public:
+	vector<Deformer> deformers;             // applied in order
+	bool setNormals = false;                // recompute normals after deforming (needs triangles)
+	NormalWeight weight = UniformWeight;
+	vector<vec3> points[2], normals[2];     // output, double-buffered: [front] is the latest
+	int front = 0;
+	float deformMs = 0, normalsMs = 0;      // time for the last Apply
+	void SetRest(const vector<vec3> &points, const vector<int3> *triangles = NULL);
+		// set the undeformed points and, for setNormals, the triangles
+	void Apply();
+		// deform the rest points into the back buffers, then swap front and back; the previous front
+		// is not written, so a renderer may read it while Apply runs
+	void Apply(Mesh &m);
+		// Apply, then exchange the new front with m.points (and m.normals if setNormals): the mesh holds
+		// the latest result and points[front] the previous frame; neither allocates once sizes settle (the
+		// first call copies geometry the mesh shares with an asset, see Mesh::OwnGeometry)
+	int Size() const { return nPoints; }
+private:
+	vec3SoA rest;                           // padded to a multiple of four
+	vector<int3> triangles;
+	VertexTriangles adjacency;
+	int nPoints = 0;
+};
+
+#endif
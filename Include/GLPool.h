@@ -0,0 +1,118 @@
+// GLPool.h - pooled GL buffers, vertex arrays and textures, with live counts and bytes
+
+#ifndef GL_POOL_HDR
+#define GL_POOL_HDR
+
+#include <glad.h>
+#include <map>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+// released objects are kept and handed out again instead of being deleted and regenerated: a buffer
+// by size class (storage is allocated at the class size, four classes per power of two, so at most
+// 25% is unused) and usage, a texture by size and format, any vertex array; storage of a reused
+// buffer is not reallocated; objects not acquired here are deleted on release
+// counts of live (acquired) and pooled objects are kept without querying GL, so a stub context
+// (function pointers that only generate names) suffices to check them
+
+struct GLPoolCounts {
+	int buffers = 0, vertexArrays = 0, textures = 0;	// live
+	size_t bufferBytes = 0, textureBytes = 0;			// storage of live buffers and textures
+	int pooled = 0;										// released, kept for reuse
+	size_t pooledBytes = 0;
+	int generated = 0, reused = 0, deleted = 0;			// totals: GL objects generated, acquisitions from the pool, GL objects deleted
+	int allocations = 0;								// total glBufferData calls
+};
+
+class GLPool {
+public:
+	size_t maxPooledBytes = (size_t) 64 << 20;			// storage kept for reuse; beyond it, released objects are deleted
+	int maxPooled = 256;								// objects kept for reuse
+	GLuint AcquireBuffer(GLenum target, GLsizeiptr size, GLenum usage = GL_STATIC_DRAW);
+		// a buffer, bound to target, with storage of at least size bytes (contents undefined)
+	bool ResizeBuffer(GLuint &buffer, GLenum target, GLsizeiptr size, GLenum usage = GL_STATIC_DRAW);
+		// keep buffer if its storage holds size bytes (and not twice that) with the same usage, else release it
+		// and acquire another;
+		// buffer (0 to acquire) is bound to target; return true if storage was allocated (glBufferData)
+	GLsizeiptr Capacity(GLuint buffer) const;
+		// storage of a buffer acquired here, else 0
+	GLuint AcquireVertexArray();
+		// a reused vertex array has its attributes disabled, their divisors 0, and no element buffer
+	GLuint AcquireTexture(int width, int height, GLenum internalFormat, bool mipmap = false);
+		// a texture name, reused from one of the same size and format if any; the caller specifies storage
+		// (glTexImage2D) and parameters
+	void ReleaseBuffer(GLuint &buffer);
+	void ReleaseVertexArray(GLuint &vertexArray);
+	void ReleaseTexture(GLuint &texture);
+		// return to the pool (or delete) and set to 0
+	void Trim(size_t bytes);
+		// delete pooled objects, largest first (by the bytes of one, whatever its kind), until at most bytes
+		// are pooled (all of them if 0)
+	GLPoolCounts Counts() const;
+	void Print() const;
+private:
+	enum Kind { Buffer = 0, VertexArray, Texture };
+	typedef std::tuple<int, long long, int, int> Class;	// kind, size, usage or format, mipmap
+	struct Object { Class type; size_t bytes; bool live; };
+	std::vector<Object> live[3];						// by name (GL names are small integers), so acquire
+														// and release in steady state allocate nothing
+	std::map<Class, std::vector<GLuint>> pooled;
+	GLPoolCounts counts;
+	GLuint Reuse(Class c, size_t bytes);
+	Object *Find(Kind k, GLuint id);
+	void Track(Kind k, GLuint id, Class c, size_t bytes);
+	void Release(Kind k, GLuint &id);
+	void Delete(int kind, GLuint id);
+};
+
+extern GLPool &glPool;
+	// never destroyed, so objects may be released during static destruction
+
+// RAII handles, released to glPool on destruction; movable, not copyable
+
+class GLBuffer {
+public:
+	GLuint id = 0;
+	GLBuffer() { }
+	GLBuffer(GLBuffer &&b) : id(b.id) { b.id = 0; }
+	GLBuffer &operator=(GLBuffer &&b) { std::swap(id, b.id); return *this; }
+	GLBuffer(const GLBuffer &) = delete;
+	GLBuffer &operator=(const GLBuffer &) = delete;
+	~GLBuffer() { glPool.ReleaseBuffer(id); }
+	bool Reserve(GLenum target, GLsizeiptr size, GLenum usage = GL_STATIC_DRAW) { return glPool.ResizeBuffer(id, target, size, usage); }
+		// as GLPool::ResizeBuffer
+	GLsizeiptr Capacity() const { return glPool.Capacity(id); }
+	operator GLuint() const { return id; }
+};
+
+class GLVertexArray {
+public:
+	GLuint id = 0;
+	GLVertexArray() { }
+	GLVertexArray(GLVertexArray &&v) : id(v.id) { v.id = 0; }
+	GLVertexArray &operator=(GLVertexArray &&v) { std::swap(id, v.id); return *this; }
+	GLVertexArray(const GLVertexArray &) = delete;
+	GLVertexArray &operator=(const GLVertexArray &) = delete;
+	~GLVertexArray() { glPool.ReleaseVertexArray(id); }
+	void Acquire() { if (!id) id = glPool.AcquireVertexArray(); }
+	operator GLuint() const { return id; }
+};
+
+class GLTexture {
+public:
+	GLuint id = 0;
+	GLTexture() { }
+	GLTexture(GLTexture &&t) : id(t.id) { t.id = 0; }
+	GLTexture &operator=(GLTexture &&t) { std::swap(id, t.id); return *this; }
+	GLTexture(const GLTexture &) = delete;
+	GLTexture &operator=(const GLTexture &) = delete;
+	~GLTexture() { glPool.ReleaseTexture(id); }
+	void Acquire(int width, int height, GLenum internalFormat, bool mipmap = false) {
+		glPool.ReleaseTexture(id);
+		id = glPool.AcquireTexture(width, height, internalFormat, mipmap);
+	}
+	operator GLuint() const { return id; }
+};
+
+#endif
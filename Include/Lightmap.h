@@ -0,0 +1,130 @@
+// Lightmap.h - baked and cached shadows for static receivers
+
+#ifndef LIGHTMAP_HDR
+#define LIGHTMAP_HDR
+
+#include <glad.h>
+#include <functional>
+#include <vector>
+#include "GLPool.h"
+#include "MemoryLedger.h"
+#include "Mesh.h"
+#include "Occluder.h"
+#include "VecMat.h"
+
+using std::vector;
+
+// Shadow Change Tracking
+
+bool ShadowFootprint(vec3 boundsMin, vec3 boundsMax, vec3 light, float lightRadius,
+					 vec3 planeOrigin, vec3 planeN, vec3 planeU, vec3 planeV, vec2 &rectMin, vec2 &rectMax);
+	// project world-space box from the corners of the area light's bounding box onto a plane
+	// set rectangle (in planeU, planeV coordinates) bounding the shadow footprint
+	// return false if the footprint is unbounded (box not strictly between light and plane)
+	// planeN may face either way: heights are measured on the light's side of the plane
+
+class ShadowReceiver {
+public:
+	virtual void Invalidate() = 0;
+		// all cached shadow samples are stale
+	virtual void Invalidate(vec3 boundsMin, vec3 boundsMax, vec3 light, float lightRadius) = 0;
+		// samples within the shadow footprint of the world-space box are stale
+	virtual ~ShadowReceiver() { }
+};
+
+class ShadowTracker {
+public:
+	vector<ShadowReceiver *> receivers;
+	vec3 light;
+	float lightRadius = -1;
+	Mesh *occluder = NULL;
+	mat4 occluderTransform;
+	vec3 occluderMin, occluderMax;      // world bounds for occluderTransform
+	bool SetLight(vec3 light, float radius);
+		// if light moved or resized, invalidate all receivers and return true
+	bool SetOccluder(Mesh *occluder);
+		// if the occluder transform changed, invalidate the footprints of its old and new bounds
+		// on every receiver and return true
+};
+
+// Lightmap
+
+// a Lightmap stores, per texel of a receiver's uv space, the fraction of an area light visible past
+// the occluder; texels are grouped into tiles and only dirty tiles are re-baked
+// runtime shading samples the map (mix(.5, 1, visibility)) rather than ray-testing the occluder
+
+class Lightmap : public ShadowReceiver {
+public:
+	static const int TileSize = 8;
+	Mesh *receiver = NULL;
+	int res = 0, nTiles = 0;            // texels per side, tiles per side
+	GLuint textureName = 0;
+	vector<unsigned char> visibility;   // res*res, 255 is fully lit
+	// texel geometry, set once (receiver presumed static)
+	vector<vec3> texelPoints;           // world space
+	vector<vec3> texelNormals;          // world space
+	vector<vec2> texelPlanar;           // texel projected to receiver plane axes (if planar)
+	vector<char> texelValid;            // texel center inside some receiver triangle
+	bool planar = false;
+	vec3 planeOrigin, planeN, planeU, planeV;
+	// dirty tiles
+	vector<char> dirty;                 // nTiles*nTiles
+	int nDirty = 0;
+	bool changed = false;               // visibility modified since last upload
+	MemoryOwner memory{"lightmap"};
+	void Init(Mesh *receiver, int res);
+	void Invalidate();
+		// mark all tiles dirty
+	void Invalidate(vec3 boundsMin, vec3 boundsMax, vec3 light, float lightRadius);
+		// mark tiles within the shadow footprint (all tiles if the receiver is not planar)
+	void Upload();
+		// copy visibility to textureName if changed
+	~Lightmap() { glPool.ReleaseTexture(textureName); }
+};
+
+class LightmapBaker {
+public:
+	int nSamples = 16;                  // light samples per texel (quality)
+	float budgetMs = 4;                 // bake time per call to Update
+	vector<Lightmap *> maps;
+	ShadowTracker tracker;
+	Lightmap *Add(Mesh *receiver, int res = 128);
+	Lightmap *Find(Mesh *receiver);
+	void SetLight(vec3 light, float radius);
+		// if light moved or resized, invalidate all maps
+	void SetOccluder(Mesh *occluder);
+		// if the occluder transform changed, invalidate footprints of its old and new bounds
+	int Update();
+		// bake dirty tiles until budgetMs expires, upload changed maps; return # texels baked
+	bool Done();
+		// no dirty tiles remain
+	~LightmapBaker();
+private:
+	Occluder occluder;                  // world-space occluder triangles
+	vector<vec3> lightOffsets;
+	void BakeTile(Lightmap *m, int tile);
+};
+
+// Shadow Grid
+
+// a ShadowGrid caches one shadow value per point of a res*res grid spanning a planar quad
+// Update re-traces only samples invalidated since the previous Update
+
+class ShadowGrid : public ShadowReceiver {
+public:
+	int res = 0;
+	vec3 planeOrigin, planeN, planeU, planeV;
+	vector<vec3> points;                // world space, res*res
+	vector<vec2> planar;                // points projected to plane axes
+	vector<float> values;               // cached result of trace
+	vector<char> stale;
+	int nReused = 0, nRecomputed = 0;   // for the last Update
+	void Init(vec3 p1, vec3 p2, vec3 p3, vec3 p4, int res);
+		// grid points are bilinear in s (p1 to p2, p4 to p3) and t (p1p2 to p4p3)
+	void Invalidate();
+	void Invalidate(vec3 boundsMin, vec3 boundsMax, vec3 light, float lightRadius);
+	void Update(std::function<float(vec3 p)> trace);
+		// set values for stale points to trace(point)
+};
+
+#endif
@@ -0,0 +1,102 @@
+// MemoryLedger.h - bytes held per owner and category, CPU and GPU, with high-water marks and JSON reports
+
+#ifndef MEMORY_LEDGER_HDR
+#define MEMORY_LEDGER_HDR
+
+#include <string>
+#include <vector>
+
+using std::string;
+using std::vector;
+
+// an owner (a mesh, texture, lightmap, ...) reports the bytes it holds per category when they change
+// (after reading, buffering, growing a buffer); the ledger keeps running totals and high-water marks
+// a report is an array store and a few additions, so the ledger stays on in release builds; owners report
+// from the thread that issues GL calls
+// CPU bytes are vector capacities as of the owner's last report; GPU bytes are buffer storage (as sized
+// by glPool) and texture storage (with mipmaps); an owner reports only what it alone holds: a mesh
+// drawing with a shared asset's buffers reports none, the asset's mesh reports them; geometry shared with
+// an asset is reported by the asset
+
+enum MemoryCategory {
+	// CPU
+	MemPoints = 0, MemNormals, MemUvs, MemTriangles, MemQuads, MemCpuOther,
+	// GPU
+	MemVertexBuffer, MemElementBuffer, MemStorageBuffer, MemTexture,
+	MemCategories
+};
+
+const char *MemoryCategoryName(int category);
+
+inline bool GpuCategory(int category) { return category >= MemVertexBuffer; }
+
+struct MemoryAccount {
+	int serial = 0;							// unique over the session (slots are reused, serials are not)
+	string name;
+	size_t bytes[MemCategories] = { };
+	size_t peak = 0;						// most bytes held at once
+	size_t Cpu() const;
+	size_t Gpu() const;
+};
+
+struct MemorySnapshot {
+	vector<MemoryAccount> owners;			// open owners, by serial
+	size_t totals[MemCategories] = { }, highWater[MemCategories] = { };
+	size_t cpu = 0, gpu = 0, cpuHighWater = 0, gpuHighWater = 0;
+	// GL objects held by glPool, pooled ones included, and the frame arena (see GLPool.h, Arena.h)
+	size_t poolBufferBytes = 0, poolTextureBytes = 0, poolIdleBytes = 0;
+	size_t arenaCapacity = 0, arenaHighWater = 0;
+	long long heapAllocations = 0;		// -1 if not counted (see HeapAllocations in Arena.h)
+};
+
+class MemoryLedger {
+public:
+	int Open(const string &name);
+		// a new owner, holding nothing; return its slot
+	void Rename(int owner, const string &name);
+	void Set(int owner, MemoryCategory category, size_t bytes);
+		// owner now holds bytes of category
+	void Close(int owner);
+		// owner holds nothing and is gone; its slot may be reused
+	size_t Total(MemoryCategory category) const { return totals[category]; }
+	size_t HighWater(MemoryCategory category) const { return highWater[category]; }
+	size_t Cpu() const { return cpu; }
+	size_t Gpu() const { return gpu; }
+	MemorySnapshot Snapshot() const;
+private:
+	vector<MemoryAccount> accounts;			// by slot
+	vector<char> open;
+	vector<int> freeSlots;
+	int serials = 0;
+	size_t totals[MemCategories] = { }, highWater[MemCategories] = { };
+	size_t cpu = 0, gpu = 0, cpuHighWater = 0, gpuHighWater = 0;
+};
+
+extern MemoryLedger &memoryLedger;
+	// never destroyed, so owners may close during static destruction
+
+string Json(const MemorySnapshot &s);
+	// totals, high-water marks, pool and arena figures, and each owner's bytes by category
+string JsonDiff(const MemorySnapshot &before, const MemorySnapshot &after);
+	// changes in totals, and owners added, removed or changed (matched by serial), with per-category deltas
+bool WriteJson(const char *filename, const string &json);
+
+// an owner's entry, opened on its first report and closed on destruction; a copy starts with no entry
+
+class MemoryOwner {
+public:
+	MemoryOwner(const char *kind = "object") : name(kind) { }
+	MemoryOwner(const MemoryOwner &o) : name(o.name) { }
+	MemoryOwner &operator=(const MemoryOwner &) { return *this; }
+	~MemoryOwner() { if (slot >= 0) memoryLedger.Close(slot); }
+	void Name(const string &n);
+	void Set(MemoryCategory category, size_t bytes) {
+		if (slot < 0) slot = memoryLedger.Open(name);
+		memoryLedger.Set(slot, category, bytes);
+	}
+private:
+	string name;
+	int slot = -1;
+};
+
+#endif
@@ -16,15 +16,30 @@ using std::vector;
 GLuint GetMeshadowShader();
 GLuint UseMeshadowShader();
 
-struct ShaderStorage { GLuint binding, buffer; };
+struct ShaderStorage {
+	GLuint binding = 0, buffer = 0;
+	GLintptr offset = 0;				// range of buffer bound to binding
+	GLsizeiptr size = 0;
+};
 
 class Meshadow : public Mesh {
 public:
 	Meshadow() { };
-	~Meshadow() { };
+	~Meshadow();
+	GLuint storage = 0;				 // one buffer holding the ranges below
 	ShaderStorage pos, nrm, uv, eid; // points, normals, uvs, element ids
+	GLuint occlusionBuffer = 0;		 // vertex attribute (not shader storage), if occlusion set
 	void Buffer(int bindingOffset = 0);
-		// if non-null, nrms and uvs assumed same size as pts
+		// write points, normals, uvs (or packed vertices) and triangles straight from the mesh arrays into
+		// one mapped buffer, as tightly packed std430 arrays (float points[3*n], uint triangles[3*t]) at
+		// offsets aligned for glBindBufferRange; the same ranges are the vertex attributes and element array
+		// normals and uvs are used only if the same size as points
+	void BufferOcclusion();
+		// (re)load occlusionBuffer from occlusion, e.g. after baking
+	void AccountMemory();
+		// as Mesh, with storage and occlusionBuffer
+	void BindVertices(int shader);
+		// bind vao, set point, normal and uv attributes, and the uniforms that decode them if packed (see Quantize.h)
 	void Display(CameraAB camera, bool lines = false);
 	bool Read(string objFile, mat4 *m, bool normalize = true, int bindingOffset = 0);
 	bool Read(string objFile, string texFile, int texUnit, mat4 *m = NULL, bool normalize = true, int bindingOffset = 0);
@@ -0,0 +1,52 @@
+// Meshlet.h - triangle clusters with bounding spheres and normal cones, culled per frame on the CPU
+
+#ifndef MESHLET_HDR
+#define MESHLET_HDR
+
+#include <glad.h>
+#include <vector>
+#include "CornerTable.h"
+#include "VecMat.h"
+
+using std::vector;
+
+// a meshlet is a run of triangles that share few vertices (at most maxVertices, as for a mesh shader);
+// BuildMeshlets reorders the triangles so each meshlet is contiguous, then a culling pass tests every
+// meshlet's bounding sphere against the view frustum and its normal cone against the eye, and merges
+// the survivors into ranges for a single glMultiDrawElements
+
+struct Meshlet {
+	int first = 0, count = 0;				// triangles [first, first+count)
+	int nVertices = 0;						// distinct vertices
+	vec3 center;							// bounding sphere, object space
+	float radius = 0;
+	vec3 coneAxis;							// average triangle normal
+	float coneCutoff = 2;					// sine of the largest angle between axis and a triangle normal;
+											// 2 if some normal is 90 degrees or more from the axis (never culled)
+};
+
+struct MeshletCull {
+	bool frustum = true;					// cull meshlets outside the view frustum
+	bool backface = true;					// cull meshlets facing away (only if back faces are hidden, eg, closed meshes)
+	int indexBytes = 4;						// size of an element buffer index
+	// per frame output and counts of CullMeshlets; arrays are kept between calls
+	vector<GLsizei> counts;					// elements per draw range
+	vector<const void *> offsets;			// byte offset of each range in the element buffer
+	vector<char> visible;					// per meshlet: 1 drawn, 0 outside the frustum, 2 back facing
+	int nMeshlets = 0, nFrustumCulled = 0, nBackfaceCulled = 0;
+	int nTriangles = 0, nTrianglesCulled = 0;
+	float cullMs = 0;
+	void Print() const;
+};
+
+void BuildMeshlets(vector<vec3> &points, vector<int3> &triangles, vector<Meshlet> &meshlets,
+				   int maxVertices = 64, int maxTriangles = 124, vector<int> *order = NULL);
+	// reorder triangles into meshlets, each grown greedily from a seed triangle by the candidate adding
+	// the fewest new vertices (ties to the nearest); order, if non-null, is set to the original index of
+	// each reordered triangle; bounds are computed in parallel
+
+void CullMeshlets(vector<Meshlet> &meshlets, mat4 modelview, mat4 persp, MeshletCull &cull);
+	// modelview maps object to eye space; set cull.counts and cull.offsets to the visible triangle ranges
+	// (adjacent visible meshlets merged); meshlets are tested in parallel
+
+#endif
@@ -15,6 +15,8 @@ bool Control();
 std::string GetDirectory();
 time_t FileModified(const char *name);
 bool FileExists(const char *name);
+size_t PeakMemory();
+	// peak resident (working set) bytes of the process so far
 
 // Sphere
 int LineSphere(vec3 ln1, vec3 ln2, vec3 center, float radius, vec3 &p1, vec3 &p2);
@@ -0,0 +1,49 @@
+// Occluder.h - occluder triangles transformed once per frame for shadow ray tests
+
+#ifndef OCCLUDER_HDR
+#define OCCLUDER_HDR
+
+#include <glad.h>
+#include <vector>
+#include "GLPool.h"
+#include "MemoryLedger.h"
+#include "Meshadow.h"
+#include "VecMat.h"
+
+using std::vector;
+
+// a prepared triangle is four vec4s (std430 layout, as read by the shadow shaders):
+//     p      first vertex (w = 1)
+//     e1, e2 edges p2-p1, p3-p1 (w = 0), used by the Moller-Trumbore intersection
+//     plane  unit normal and offset, used to reject segments entirely on one side
+// a segment d is taken as parallel to a triangle if |det| = |d.(e1 x e2)| <= ParallelEpsilon*|d||e1||e2|, the
+// same in Intersect and the shadow shaders, so the test doesn't depend on the scale of the geometry
+
+struct OccluderTriangle { vec4 p, e1, e2, plane; };
+
+const float ParallelEpsilon = 1e-6f;
+
+class Occluder {
+public:
+	int nTriangles = 0;
+	vector<vec3> points;                    // transformed vertices
+	vector<OccluderTriangle> triangles;     // CPU prepared triangles
+	GLBuffer buffer;                        // shader storage for prepared triangles
+	float prepareMs = 0;                    // time spent in last Prepare or PrepareOnGPU
+	MemoryOwner memory{"occluder"};
+	void Prepare(Mesh &m, mat4 transform);
+		// transform m.points (see Batch.h) and build triangles on CPU
+	void Upload(GLuint binding);
+		// copy prepared triangles to buffer, bind buffer to binding
+	void PrepareOnGPU(Meshadow &m, mat4 transform, GLuint binding);
+		// build triangles in buffer with a compute shader reading m's point and element storage, packed or not
+	float CompareGPU(Meshadow &m, mat4 transform, GLuint binding);
+		// prepare m on CPU and on GPU, return the largest difference between their triangle components
+		// (if m is packed, expect up to about m.packer.maxPositionError, scaled by transform)
+	bool Intersect(vec3 a, vec3 b);
+		// does segment ab intersect any prepared (CPU) triangle?
+private:
+	void Reserve(GLuint binding);
+};
+
+#endif
@@ -0,0 +1,33 @@
+// Parallel.h - chunked multithreaded loops
+
+#ifndef PARALLEL_HDR
+#define PARALLEL_HDR
+
+#include <type_traits>
+
+int NumThreads();
+	// number of hardware threads (at least 1)
+
+class ChunkFunction {
+	// reference to a callable f(int begin, int end), held only for the call it is passed to; unlike
+	// std::function, never copies f to the heap
+public:
+	template <class F, class = typename std::enable_if<!std::is_same<typename std::decay<F>::type, ChunkFunction>::value>::type>
+	ChunkFunction(F &&f) : object((void *) &f), call([](void *o, int begin, int end) {
+		(*(typename std::remove_reference<F>::type *) o)(begin, end); }) { }
+	void operator()(int begin, int end) const { call(object, begin, end); }
+private:
+	void *object;
+	void (*call)(void *, int, int);
+};
+
+void ParallelFor(int n, ChunkFunction f, int minChunk = 256);
+	// split [0, n) into contiguous chunks of at least minChunk and call f(begin, end) on each
+	// if minChunk is a multiple of 16, so is every chunk's begin
+	// chunks are handed out to the calling thread and NumThreads()-1 workers, started by the first call and
+	// kept; runs on the calling thread if n < 2*minChunk, or if called within another ParallelFor
+
+double TimeMs();
+	// monotonic wall-clock time, in milliseconds (unlike clock(), not summed over threads)
+
+#endif
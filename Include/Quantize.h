@@ -0,0 +1,62 @@
+// Quantize.h - packed vertex format: 16-bit positions, octahedral normals, half-float uvs, 16-bit indices
+
+#ifndef QUANTIZE_HDR
+#define QUANTIZE_HDR
+
+#include <glad.h>
+#include <stdint.h>
+#include <vector>
+#include "VecMat.h"
+
+using std::vector;
+
+// a packed vertex is 16 bytes, against 32 for float points, normals and uvs (48 in Meshadow's vec4s):
+// positions are unsigned 16-bit fractions of the mesh bounding box, decoded by the vertex attribute
+// (normalized) then mapped to object space by the Dequantize matrix, which shaders apply ahead of the
+// mesh transform; normals are folded onto an octahedron and stored as two signed 16-bit values, decoded
+// in the shader (OctDecode); uvs are half floats; occlusion rides in the fourth position component
+
+struct PackedVertex {
+	uint16_t position[3];					// unorm16, within the bounding box
+	uint16_t occlusion;						// unorm16
+	int16_t normal[2];						// snorm16, octahedral
+	uint16_t uv[2];							// half float
+};
+
+class VertexPacker {
+public:
+	vec3 min, extent;						// position = min+extent*unorm
+	float maxPositionError = 0;				// round trip errors of the last Pack: object space distance,
+	float maxNormalDegrees = 0;				// angle between normals,
+	float maxUvError = 0;					// and uv distance
+	float packMs = 0;
+	void Pack(const vec3 *points, const vec3 *normals, const vec2 *uvs, const float *occlusion, int n, PackedVertex *out);
+		// normals, uvs and occlusion may be null; vertices are packed (and checked) in parallel
+	mat4 Dequantize() const;
+		// normalized position to object space
+	void Print(int nVertices, int nTriangles, bool normals, bool uvs, bool occlusion, bool shortIndices) const;
+		// bytes per vertex and per triangle, packed against float, and round trip errors
+};
+
+bool ShortIndices(int nVertices);
+	// indices of nVertices fit 16 bits
+
+void ToShortIndices(const int3 *triangles, int n, uint16_t *out);
+	// 3n indices
+
+void EnablePackedVertex(bool normals, bool uvs, bool occlusion, int offset = 0);
+	// set attributes 0 (point), 1 (normal), 2 (uv), and 8 (occlusion) to PackedVertex in the bound
+	// GL_ARRAY_BUFFER, starting at byte offset
+
+// Encoding
+
+uint16_t FloatToHalf(float f);
+	// round to nearest even; overflow to infinity
+float HalfToFloat(uint16_t h);
+
+void OctEncode(vec3 n, int16_t e[2]);
+	// n unit length
+vec3 OctDecode(const int16_t e[2]);
+	// as the shaders (snorm16 decode, then unfold), normalized
+
+#endif
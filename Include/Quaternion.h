@@ -4,32 +4,70 @@
 #ifndef QUATERNION_HDR
 #define QUATERNION_HDR
 
+#include <float.h>
 #include "VecMat.h"
 
 class Quaternion {
 public:
 	float x = 0, y = 0, z = 0, w = 0;
-	Quaternion() { };
-	Quaternion(vec3 axis, float radAng);
-	Quaternion(float x, float y, float z, float w) : x(x), y(y), z(z), w(w) { };
+	constexpr Quaternion() { };
+	VECMAT_CONSTEXPR Quaternion(vec3 axis, float radAng) {
+		float c = Cos(radAng/2), s = Sin(radAng/2);
+		vec3 a = normalize(axis);
+		x = s*a.x; y = s*a.y; z = s*a.z; w = c;
+	}
+	constexpr Quaternion(float x, float y, float z, float w) : x(x), y(y), z(z), w(w) { };
 	Quaternion(mat3 &rot); // presumes rot is pure rotation matrix (no scale)
 	Quaternion(mat4 m);
-	Quaternion(const Quaternion &a) { x = a.x; y = a.y; z = a.z; w = a.w; }
-	Quaternion& operator = (const Quaternion &a) { x = a.x; y = a.y; z = a.z; w = a.w; return *this; }
-	Quaternion operator + (const Quaternion &q) const { return Quaternion(x+q.x, y+q.y, z+q.z, w+q.w); }
-	Quaternion operator * (float s) const { return Quaternion(s*x, s*y, s*z, s*w); }
-	Quaternion operator * (const Quaternion &q) const {
+	constexpr Quaternion(const Quaternion &a) : x(a.x), y(a.y), z(a.z), w(a.w) { }
+	constexpr Quaternion& operator = (const Quaternion &a) { x = a.x; y = a.y; z = a.z; w = a.w; return *this; }
+	constexpr Quaternion operator + (const Quaternion &q) const { return Quaternion(x+q.x, y+q.y, z+q.z, w+q.w); }
+	constexpr Quaternion operator * (float s) const { return Quaternion(s*x, s*y, s*z, s*w); }
+	constexpr Quaternion operator * (const Quaternion &q) const {
 		float xx =  x*q.w+y*q.z-z*q.y+w*q.x;
 		float yy = -x*q.z+y*q.w+z*q.x+w*q.y;
 		float zz =  x*q.y-y*q.x+z*q.w+w*q.z;
 		float ww = -x*q.x-y*q.y-z*q.z+w*q.w;
 		return Quaternion(xx, yy, zz, ww);
 	}
-	float Norm() { return x*x+y*y+z*z+w*w; }
-	mat3 Get3x3();
-	mat4 GetMatrix();
+	constexpr float Norm() const { return x*x+y*y+z*z+w*w; }
+	constexpr mat3 Get3x3() const {
+		float norm = Norm();
+		if (norm < FLT_EPSILON && norm > -FLT_EPSILON)
+			return mat3(vec3(1, 0, 0), vec3(0, 1, 0), vec3(0, 0, 1));
+		float s = 2/norm;
+		float xs = x*s,  ys = y*s,  zs = z*s;
+		float wx = w*xs, wy = w*ys, wz = w*zs;
+		float xx = x*xs, xy = x*ys, xz = x*zs;
+		float yy = y*ys, yz = y*zs, zz = z*zs;
+		return mat3(
+			vec3(1 - (yy + zz), xy + wz,       xz - wy),
+			vec3(xy - wz,       1 - (xx + zz), yz + wx),
+			vec3(xz + wy,       yz - wx,       1 - (xx + yy)));
+	}
+	constexpr mat4 GetMatrix() const { return mat4(Get3x3()); }
 	void SetMatrix(mat4 &m, float scale = 1);
 	void Slerp(Quaternion &qu0, Quaternion &qu1, float t);
 };
 
+// rigid placement with uniform scale: matrix is Translate(position)*rotation*Scale(scale)
+// (see Batch.h for arrays of frames)
+
+class Frame {
+public:
+	constexpr Frame() { };
+	constexpr Frame(Quaternion q, vec3 p, float s) : orientation(q), position(p), scale(s) { };
+	Quaternion orientation;
+	vec3 position;
+	float scale = 1;
+	constexpr Frame operator * (const Frame &f) const {
+		// f placed in this frame: (a*b).GetMatrix() == a.GetMatrix()*b.GetMatrix()
+		return Frame(f.orientation*orientation, position+scale*(orientation.Get3x3()*f.position), scale*f.scale);
+	}
+	constexpr mat4 GetMatrix() const {
+		mat3 r = orientation.Get3x3();
+		return mat4(vec4(scale*r[0], position.x), vec4(scale*r[1], position.y), vec4(scale*r[2], position.z), vec4(0, 0, 0, 1));
+	}
+};
+
 #endif
@@ -0,0 +1,50 @@
+// SceneGraph.h - flat transform hierarchy, updated in one pass over dirty subtrees
+
+#ifndef SCENE_GRAPH_HDR
+#define SCENE_GRAPH_HDR
+
+#include <vector>
+#include "VecMat.h"
+
+using std::vector;
+
+class Mesh;
+
+// nodes are stored parent before child (parents[i] < i), so one pass in index order sees every parent
+// before its children: a node is recomputed if its local transform was set or its parent was recomputed
+// local and world transforms are separate arrays (affine, see mat3x4); nodes may refer to a Mesh,
+// whose transform Update sets to the node's world transform
+
+class SceneGraph {
+public:
+	vector<int> parents;                    // -1 for a root
+	vector<mat3x4> local;                   // relative to parent
+	vector<mat3x4> world;                   // parent world * local, current after Update
+	vector<Mesh *> meshes;                  // optional, per node
+	bool parallel = false;                  // Update level by level, threaded within a level
+	int nUpdated = 0;                       // nodes recomputed by the last Update
+	float updateMs = 0;
+	int Size() const { return (int) parents.size(); }
+	int Add(int parent = -1, const mat3x4 &local = mat3x4(), Mesh *mesh = NULL);
+		// return node id; parent must already exist
+	int Add(Mesh *m, int parent = -1);
+		// add m and (recursively) m->children; locals are set from current mesh transforms
+	void SetLocal(int node, const mat3x4 &m);
+		// mark node (and so its subtree) dirty
+	void Capture();
+		// reset locals from current mesh transforms (after meshes were moved outside the graph)
+	void Update();
+		// recompute dirty nodes and their descendants, set their mesh transforms
+	void Clear();
+private:
+	vector<char> dirty;                     // local set since the last Update
+	vector<unsigned int> stamps;            // Update count when the node was last recomputed
+	unsigned int stamp = 0;
+	int firstDirty = 0;                     // nodes before this are clean
+	vector<int> depth, levelOrder, levelStart;
+	bool levelsCurrent = false;
+	void SetLevels();
+	bool UpdateNode(int i);
+};
+
+#endif
@@ -0,0 +1,54 @@
+// ShadowVolume.h - stencil shadows from silhouette edges of an occluder
+
+#ifndef SHADOW_VOLUME_HDR
+#define SHADOW_VOLUME_HDR
+
+#include <glad.h>
+#include <vector>
+#include "GLPool.h"
+#include "MemoryLedger.h"
+#include "Mesh.h"
+#include "VecMat.h"
+
+using std::vector;
+
+// a shadow volume bounds the space an occluder hides from a point light: the light-facing triangles
+// (front cap), the same triangles pushed away from the light (back cap), and quads extruded from
+// the silhouette edges, those between a light-facing and a back-facing triangle
+// the CPU stage (Init, Update) makes no GL calls; Upload and Render draw the volume into the stencil
+// buffer (depth-fail counting) and darken pixels inside it
+
+struct VolumeEdge {
+	int v1, v2;                             // point ids, in the winding order of t1
+	int t1, t2;                             // adjacent triangles, t2 = -1 if a boundary edge
+};
+
+class ShadowVolume {
+public:
+	float extrude = 50;                     // distance silhouettes are pushed from the light
+	// set once by Init
+	vector<VolumeEdge> edges;
+	// set by Update
+	vector<vec3> points;                    // world space occluder vertices
+	vector<char> facing;                    // per triangle, 1 if facing the light
+	vector<vec3> vertices;                  // volume triangles, three vertices each
+	int nSilhouette = 0, nCapTriangles = 0;
+	float updateMs = 0;
+	void Init(Mesh &occluder);
+		// build edge adjacency; points with identical positions are welded so that
+		// meshes with per-face normals or uvs still close up
+	void Update(Mesh &occluder, mat4 transform, vec3 light);
+		// transform occluder (SIMD), classify triangles (SIMD, threaded), extract silhouettes and
+		// emit volume triangles (threaded)
+	void Upload();
+	void Render(mat4 fullview, float shade = .4f);
+		// with the scene depth buffer in place, count volume crossings into the stencil buffer and
+		// blend black (opacity shade) over pixels in shadow; presumes a stencil buffer
+private:
+	GLVertexArray vao;
+	GLBuffer vbo;
+	int nUploaded = 0;
+	MemoryOwner memory{"shadow volume"};
+};
+
+#endif
@@ -0,0 +1,44 @@
+// Simplify.h - quadric error mesh simplification into level-of-detail chains
+
+#ifndef SIMPLIFY_HDR
+#define SIMPLIFY_HDR
+
+#include <vector>
+#include "Mesh.h"
+#include "VecMat.h"
+
+using std::vector;
+
+// edges are collapsed one vertex into the other (half-edge collapse), cheapest first, where the cost of
+// moving a vertex is its distance to the planes of its original triangles (Garland-Heckbert quadrics) plus
+// a penalty for differing normals and uvs; since no vertex is moved or created, every level indexes the
+// original points, and all levels share one vertex buffer (see Mesh::lods)
+// boundary vertices only collapse along the boundary, into boundary vertices, and boundary edges add
+// perpendicular planes to the quadrics, so open edges and uv seams (duplicated points) keep their shape
+// a single greedy pass records each level as the triangle count falls below its target, so levels nest
+
+class LodBuilder {
+public:
+	int maxLevels = 6;                      // including level 0 (the full mesh)
+	float ratio = .5f;                      // triangles in a level relative to the previous
+	int minTriangles = 32;                  // stop when a level would have fewer
+	float normalWeight = 1, uvWeight = 1;   // attribute penalties, relative to the quadric error
+	float boundaryWeight = 10;              // strength of the boundary planes
+	bool useCache = true;                   // read/write <objFilename>.lod
+	float buildMs = 0;                      // time for the last build (0 if read from the cache)
+	void Build(const vector<vec3> &points, const vector<vec3> *normals, const vector<vec2> *uvs,
+			   const vector<int3> &triangles, vector<int3> &lodTriangles, vector<LodLevel> &lods);
+		// levels 1 on, concatenated in lodTriangles; lods[0] is triangles itself
+		// normals and uvs, if non-null and the size of points, contribute to the cost
+	bool Build(Mesh &m);
+		// set m.lodTriangles, m.lods, m.lodCenter, m.lodRadius (and re-buffer m if it has a vertex array)
+		// if useCache and <m.objFilename>.lod is current, read it, else build and write it
+		// return true if read from the cache
+};
+
+bool ReadLods(const char *filename, int nPoints, int nTriangles, float ratio, vector<int3> &lodTriangles, vector<LodLevel> &lods);
+	// read a chain built for the same mesh size and ratio
+
+bool WriteLods(const char *filename, int nPoints, int nTriangles, float ratio, vector<int3> &lodTriangles, vector<LodLevel> &lods);
+
+#endif
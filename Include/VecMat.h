@@ -1,4 +1,4 @@
-// VecMat.h: 2D, 3D, 4D vector classes, 3x3 and 4x4 matrix classes
+// VecMat.h: 2D, 3D, 4D vector classes, 3x3, 4x4, and 3x4 affine matrix classes
 // (c) 2019-2022 Jules Bloomenthal
 
 #ifndef VEC_MAT_HDR
@@ -7,36 +7,114 @@
 #include <math.h>
 #include <iostream>
 
+// mat4 products, Transpose and Invert use SIMD if available, chosen at compile time: SSE2 (all x86-64,
+// also used in AVX builds, where 256-bit products measured no faster), or NEON (ARM; Invert stays scalar)
+// define VECMAT_SCALAR to use the scalar code; products and Transpose match it exactly (no fused multiply-add),
+// Invert to within a few ulps (different but equivalent cofactor arithmetic); tests/VecMatTest.cpp checks this
+// the NEON code has not yet been compiled or tested: ARM builds use it only if VECMAT_NEON is defined
+
+#if !defined(VECMAT_SCALAR)
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define VECMAT_SSE
+#include <xmmintrin.h>
+#elif defined(VECMAT_NEON) && (defined(__ARM_NEON) || defined(__ARM_NEON__))
+#include <arm_neon.h>
+#else
+#undef VECMAT_NEON
+#endif
+#else
+#undef VECMAT_NEON
+#endif
+
+// vectors, matrices, Quaternion, and the transform builders are constexpr (C++17), so constant tables and
+// fixed transforms fold at compile time; functions with SIMD or <math.h> code branch on constant evaluation
+// to a scalar path (products, Transpose), or to series and Newton iteration in double (Sin, Cos, Tan, Sqrt,
+// within an ulp of <math.h>); run-time code is unchanged; Invert is run-time only
+// without __builtin_is_constant_evaluated (gcc 9, clang 9, msvc 19.25), only the SIMD-free functions are constexpr
+
+#if defined(__has_builtin)
+#if __has_builtin(__builtin_is_constant_evaluated)
+#define VECMAT_CONSTANT_EVALUATED() __builtin_is_constant_evaluated()
+#endif
+#endif
+#if !defined(VECMAT_CONSTANT_EVALUATED) && ((defined(__GNUC__) && __GNUC__ >= 9) || (defined(_MSC_VER) && _MSC_VER >= 1925))
+#define VECMAT_CONSTANT_EVALUATED() __builtin_is_constant_evaluated()
+#endif
+#if defined(VECMAT_CONSTANT_EVALUATED)
+#define VECMAT_CONSTEXPR constexpr
+#else
+#define VECMAT_CONSTANT_EVALUATED() false
+#define VECMAT_CONSTEXPR
+#endif
+
+// math
+
+inline VECMAT_CONSTEXPR float Sqrt(float x) {
+	if (VECMAT_CONSTANT_EVALUATED()) {
+		// Newton iteration; negative x is not a constant expression
+		if (x == 0)
+			return 0;
+		double d = x, r = d > 1? d : 1;
+		for (int i = 0; i < 100 && r*r != d; i++)
+			r = .5*(r+d/r);
+		return (float) r;
+	}
+	return sqrt(x);
+}
+
+inline constexpr double SinSeries(double a) {
+	// reduce to [-pi, pi], then Taylor series
+	const double twoPi = 6.283185307179586;
+	double k = (double) (long long) (a/twoPi+(a < 0? -.5 : .5)), x = a-k*twoPi, term = x, sum = x;
+	for (int n = 1; n < 16; n++) {
+		term *= -x*x/((2*n)*(2*n+1));
+		sum += term;
+	}
+	return sum;
+}
+
+inline VECMAT_CONSTEXPR float Sin(float radians) {
+	return VECMAT_CONSTANT_EVALUATED()? (float) SinSeries(radians) : sin(radians);
+}
+
+inline VECMAT_CONSTEXPR float Cos(float radians) {
+	return VECMAT_CONSTANT_EVALUATED()? (float) SinSeries(radians+1.5707963267948966) : cos(radians);
+}
+
+inline VECMAT_CONSTEXPR float Tan(float radians) {
+	return VECMAT_CONSTANT_EVALUATED()? (float) (SinSeries(radians)/SinSeries(radians+1.5707963267948966)) : tan(radians);
+}
+
 // integer pair and triplet
 
 struct int2 {
 	int i1, i2;
-	int2() { i1 = i2 = 0; }
-	int2(int i1, int i2) : i1(i1), i2(i2) { }
+	constexpr int2() : i1(0), i2(0) { }
+	constexpr int2(int i1, int i2) : i1(i1), i2(i2) { }
 	int &operator [] (int i) { return *(&i1+i); }
 	const int operator [] (int i) const { return *(&i1+i); }
 	bool operator == (const int2 &rhs) { return this->i1 == rhs.i1 && this->i2 == rhs.i2; }
-	int2 operator + (const int2 &v) const { return int2(i1+v.i1, i2+v.i2); }
-	int2 operator - (const int2 &v) const { return int2(i1-v.i1, i2-v.i2); }
+	constexpr int2 operator + (const int2 &v) const { return int2(i1+v.i1, i2+v.i2); }
+	constexpr int2 operator - (const int2 &v) const { return int2(i1-v.i1, i2-v.i2); }
 };
 
 struct int3 {
 	int i1, i2, i3;
-	int3() { i1 = i2 = i3 = 0; }
-	int3(int *i) : i1(i[0]), i2(i[1]), i3(i[2]) { }
-	int3(int i1, int i2, int i3) : i1(i1), i2(i2), i3(i3) { }
+	constexpr int3() : i1(0), i2(0), i3(0) { }
+	constexpr int3(const int *i) : i1(i[0]), i2(i[1]), i3(i[2]) { }
+	constexpr int3(int i1, int i2, int i3) : i1(i1), i2(i2), i3(i3) { }
 	int &operator [] (int i) { return *(&i1+i); }
 	const int operator [] (int i) const { return *(&i1+i); }
 	bool operator == (const int3 &rhs) { return this->i1 == rhs.i1 && this->i2 == rhs.i2 && this->i3 == rhs.i3; }
-	int3 operator + (const int3 &v) const { return int3(i1+v.i1, i2+v.i2, i3+v.i3); }
-	int3 operator - (const int3 &v) const { return int3(i1-v.i1, i2-v.i2, i3-v.i3); }
+	constexpr int3 operator + (const int3 &v) const { return int3(i1+v.i1, i2+v.i2, i3+v.i3); }
+	constexpr int3 operator - (const int3 &v) const { return int3(i1-v.i1, i2-v.i2, i3-v.i3); }
 };
 
 struct int4 {
 	int i1, i2, i3, i4;
-	int4() { i1 = i2 = i3 = i4 = 0; }
-	int4(int *i) : i1(i[0]), i2(i[1]), i3(i[2]), i4(i[3]) { }
-	int4(int i1, int i2, int i3, int i4) : i1(i1), i2(i2), i3(i3), i4(i4) { }
+	constexpr int4() : i1(0), i2(0), i3(0), i4(0) { }
+	constexpr int4(const int *i) : i1(i[0]), i2(i[1]), i3(i[2]), i4(i[3]) { }
+	constexpr int4(int i1, int i2, int i3, int i4) : i1(i1), i2(i2), i3(i3), i4(i4) { }
 	int &operator [] (int i) { return *(&i1+i); }
 	const int operator [] (int i) const { return *(&i1+i); }
 	bool operator == (const int4& rhs) { return this->i1 == rhs.i1 && this->i2 == rhs.i2 && this->i3 == rhs.i3 && this->i4 == rhs.i4; }
@@ -66,38 +144,39 @@ class vec2 {
 public:
 	float x, y;
 	// constructors
-	vec2(float s = 0) : x(s), y(s) { }
-	vec2(float x, float y) : x(x), y(y) { }
-	vec2(double x, double y) : x((float) x), y((float) y) { }
-	vec2(float *p) : x(p[0]), y(p[1]) { }
-	vec2(const vec2 &v) : x(v.x), y(v.y) { }
-	vec2(const float *p) : x(p[0]), y(p[1]) { }
-	vec2(int xa, int ya) { x = (float) xa; y = (float) ya; }
+	constexpr vec2(float s = 0) : x(s), y(s) { }
+	constexpr vec2(float x, float y) : x(x), y(y) { }
+	constexpr vec2(double x, double y) : x((float) x), y((float) y) { }
+	constexpr vec2(float *p) : x(p[0]), y(p[1]) { }
+	constexpr vec2(const vec2 &v) : x(v.x), y(v.y) { }
+	constexpr vec2(const float *p) : x(p[0]), y(p[1]) { }
+	constexpr vec2(int xa, int ya) : x((float) xa), y((float) ya) { }
+	vec2 &operator = (const vec2 &v) = default;
 	// access
-	float &operator [] (int i) { return *(&x+i); }
-	const float operator [] (int i) const { return *(&x+i); }
+	VECMAT_CONSTEXPR float &operator [] (int i) { return VECMAT_CONSTANT_EVALUATED()? (i? y : x) : *(&x+i); }
+	VECMAT_CONSTEXPR const float operator [] (int i) const { return VECMAT_CONSTANT_EVALUATED()? (i? y : x) : *(&x+i); }
 	operator const float* () const { return static_cast<const float*>(&x); }
 	operator float* () { return static_cast<float*>(&x); }
 	// operations
-	vec2 operator - () const { return vec2(-x, -y); }
-	vec2 operator + (const vec2 &v) const { return vec2(x+v.x, y+v.y); }
-	vec2 operator - (const vec2 &v) const { return vec2(x-v.x, y-v.y); }
-	vec2 operator * (float s) const { return vec2(s*x, s*y); }
-	vec2 operator * (const vec2 &v) const { return vec2(x*v.x, y*v.y); }
-	friend vec2 operator * (float s, const vec2 &v) { return v*s; }
-	vec2 operator / (float s) const { float r = 1.f/s; return *this*r; }
+	constexpr vec2 operator - () const { return vec2(-x, -y); }
+	constexpr vec2 operator + (const vec2 &v) const { return vec2(x+v.x, y+v.y); }
+	constexpr vec2 operator - (const vec2 &v) const { return vec2(x-v.x, y-v.y); }
+	constexpr vec2 operator * (float s) const { return vec2(s*x, s*y); }
+	constexpr vec2 operator * (const vec2 &v) const { return vec2(x*v.x, y*v.y); }
+	friend constexpr vec2 operator * (float s, const vec2 &v) { return v*s; }
+	constexpr vec2 operator / (float s) const { float r = 1.f/s; return *this*r; }
 	// reflexive
-	vec2 &operator += (const vec2 &v) { x += v.x; y += v.y; return *this; }
-	vec2 &operator -= (const vec2 &v) { x -= v.x; y -= v.y; return *this; }
-	vec2 &operator *= (float s) { x *= s; y *= s; return *this; }
-	vec2 &operator *= (const vec2 &v) { x *= v.x; y *= v.y; return *this; }
-	vec2 &operator /= (float s) { float r = 1.f/s; *this *= r; return *this; }
+	constexpr vec2 &operator += (const vec2 &v) { x += v.x; y += v.y; return *this; }
+	constexpr vec2 &operator -= (const vec2 &v) { x -= v.x; y -= v.y; return *this; }
+	constexpr vec2 &operator *= (float s) { x *= s; y *= s; return *this; }
+	constexpr vec2 &operator *= (const vec2 &v) { x *= v.x; y *= v.y; return *this; }
+	constexpr vec2 &operator /= (float s) { float r = 1.f/s; *this *= r; return *this; }
 };
 
-inline float dot(const vec2 &a, const vec2 &b) { return a.x*b.x+a.y*b.y; }
-inline float cross(const vec2 &v1, const vec2 &v2) { return v1.x*v2.y-v1.y*v2.x; }
-inline float length(const vec2 &v) { return sqrt(dot(v,v)); }
-inline vec2 normalize(const vec2 &v) { return v/length(v); }
+inline constexpr float dot(const vec2 &a, const vec2 &b) { return a.x*b.x+a.y*b.y; }
+inline constexpr float cross(const vec2 &v1, const vec2 &v2) { return v1.x*v2.y-v1.y*v2.x; }
+inline VECMAT_CONSTEXPR float length(const vec2 &v) { return Sqrt(dot(v,v)); }
+inline VECMAT_CONSTEXPR vec2 normalize(const vec2 &v) { return v/length(v); }
 
 //  3D vector
 
@@ -105,34 +184,35 @@ class vec3 {
 public:
 	float  x, y, z;
 	// constructors
-	vec3(float s = 0) : x(s), y(s), z(s) { }
-	vec3(float x, float y, float z = 0) : x(x), y(y), z(z) { }
-	vec3(const vec3 &v) { x = v.x; y = v.y; z = v.z; }
-	vec3(const vec2 &v, float f = 0) { x = v.x; y = v.y; z = f; }
-	vec3(const float *p) : x(p[0]), y(p[1]), z(p[2]) { }
+	constexpr vec3(float s = 0) : x(s), y(s), z(s) { }
+	constexpr vec3(float x, float y, float z = 0) : x(x), y(y), z(z) { }
+	constexpr vec3(const vec3 &v) : x(v.x), y(v.y), z(v.z) { }
+	constexpr vec3(const vec2 &v, float f = 0) : x(v.x), y(v.y), z(f) { }
+	constexpr vec3(const float *p) : x(p[0]), y(p[1]), z(p[2]) { }
+	vec3 &operator = (const vec3 &v) = default;
    // access
-	float &operator [] (int i) { return *(&x+i); } // causes ambiguity
-	const float operator [] (int i) const { return *(&x+i); }
+	VECMAT_CONSTEXPR float &operator [] (int i) { return VECMAT_CONSTANT_EVALUATED()? (i == 0? x : i == 1? y : z) : *(&x+i); } // causes ambiguity
+	VECMAT_CONSTEXPR const float operator [] (int i) const { return VECMAT_CONSTANT_EVALUATED()? (i == 0? x : i == 1? y : z) : *(&x+i); }
 	// arithmetic
-	vec3 operator - () const { return vec3(-x, -y, -z); }
-	vec3 operator + (const vec3 &v) const { return vec3(x+v.x, y+v.y, z+v.z); }
-	vec3 operator - (const vec3 &v) const { return vec3(x-v.x, y-v.y, z-v.z); }
-	vec3 operator * (float s) const { return vec3(s*x, s*y, s*z); }
-	vec3 operator * (const vec3 &v) const { return vec3(x*v.x, y*v.y, z*v.z); }
-	friend vec3 operator * (float s, const vec3 &v) { return v*s; }
-	vec3 operator / (float s) const { float r = 1.f/s; return *this * r; }
+	constexpr vec3 operator - () const { return vec3(-x, -y, -z); }
+	constexpr vec3 operator + (const vec3 &v) const { return vec3(x+v.x, y+v.y, z+v.z); }
+	constexpr vec3 operator - (const vec3 &v) const { return vec3(x-v.x, y-v.y, z-v.z); }
+	constexpr vec3 operator * (float s) const { return vec3(s*x, s*y, s*z); }
+	constexpr vec3 operator * (const vec3 &v) const { return vec3(x*v.x, y*v.y, z*v.z); }
+	friend constexpr vec3 operator * (float s, const vec3 &v) { return v*s; }
+	constexpr vec3 operator / (float s) const { float r = 1.f/s; return *this * r; }
 	// reflexive
-	vec3 &operator += (const vec3 &v) { x += v.x; y += v.y; z += v.z; return *this; }
-	vec3 &operator -= (const vec3 &v) { x -= v.x; y -= v.y; z -= v.z; return *this; }
-	vec3 &operator *= (float s) { x *= s; y *= s; z *= s; return *this; }
-	vec3 &operator *= (const vec3 &v) { x *= v.x; y *= v.y; z *= v.z; return *this; }
-	vec3 &operator /= (float s) { float r = 1.f/s; *this *= r; return *this; }
+	constexpr vec3 &operator += (const vec3 &v) { x += v.x; y += v.y; z += v.z; return *this; }
+	constexpr vec3 &operator -= (const vec3 &v) { x -= v.x; y -= v.y; z -= v.z; return *this; }
+	constexpr vec3 &operator *= (float s) { x *= s; y *= s; z *= s; return *this; }
+	constexpr vec3 &operator *= (const vec3 &v) { x *= v.x; y *= v.y; z *= v.z; return *this; }
+	constexpr vec3 &operator /= (float s) { float r = 1.f/s; *this *= r; return *this; }
 };
 
-inline float dot(const vec3 &a, const vec3 &b) { return a.x*b.x+a.y*b.y+a.z*b.z; }
-inline float length(const vec3 &v) { return sqrt(dot(v,v)); }
-inline vec3 normalize(const vec3 &v) { return v/length(v); }
-inline vec3 cross(const vec3 &a, const vec3 &b) { return vec3(a.y*b.z-a.z*b.y, a.z*b.x-a.x*b.z, a.x*b.y-a.y*b.x); }
+inline constexpr float dot(const vec3 &a, const vec3 &b) { return a.x*b.x+a.y*b.y+a.z*b.z; }
+inline VECMAT_CONSTEXPR float length(const vec3 &v) { return Sqrt(dot(v,v)); }
+inline VECMAT_CONSTEXPR vec3 normalize(const vec3 &v) { return v/length(v); }
+inline constexpr vec3 cross(const vec3 &a, const vec3 &b) { return vec3(a.y*b.z-a.z*b.y, a.z*b.x-a.x*b.z, a.x*b.y-a.y*b.x); }
 	// right-handed cross-product
 
 // 4D vector
@@ -141,36 +221,37 @@ class vec4 {
 public:
 	float x, y, z, w;
 	// constructors
-	vec4(float s = 0) : x(s), y(s), z(s), w(s) { }
-	vec4(float x, float y, float z, float w) : x(x), y(y), z(z), w(w) { }
-	vec4(const vec4 &v) { x = v.x; y = v.y;  z = v.z;  w = v.w; }
-	vec4(float *p) : x(p[0]), y(p[1]), z(p[2]), w(p[3]) { }
-	vec4(const vec2 &v, float z, float w) : x(v.x), y(v.y), z(z), w(w) { }
-	vec4(const vec3 &v, float w = 1) : x(v.x), y(v.y), z(v.z), w(w) { }
+	constexpr vec4(float s = 0) : x(s), y(s), z(s), w(s) { }
+	constexpr vec4(float x, float y, float z, float w) : x(x), y(y), z(z), w(w) { }
+	constexpr vec4(const vec4 &v) : x(v.x), y(v.y), z(v.z), w(v.w) { }
+	constexpr vec4(float *p) : x(p[0]), y(p[1]), z(p[2]), w(p[3]) { }
+	constexpr vec4(const vec2 &v, float z, float w) : x(v.x), y(v.y), z(z), w(w) { }
+	constexpr vec4(const vec3 &v, float w = 1) : x(v.x), y(v.y), z(v.z), w(w) { }
+	vec4 &operator = (const vec4 &v) = default;
 	// access
-	float &operator [] (int i) { return *(&x+i); }
-	const float operator [] (int i) const { return *(&x+i); }
+	VECMAT_CONSTEXPR float &operator [] (int i) { return VECMAT_CONSTANT_EVALUATED()? (i == 0? x : i == 1? y : i == 2? z : w) : *(&x+i); }
+	VECMAT_CONSTEXPR const float operator [] (int i) const { return VECMAT_CONSTANT_EVALUATED()? (i == 0? x : i == 1? y : i == 2? z : w) : *(&x+i); }
 	operator const float* () const { return static_cast<const float*>(&x); }
 	operator float* () { return static_cast<float*>(&x); }
 	// arithmetic
-	vec4 operator - () const { return vec4(-x, -y, -z, -w); }
-	vec4 operator + (const vec4 &v) const { return vec4(x+v.x, y+v.y, z+v.z, w+v.w); }
-	vec4 operator - (const vec4 &v) const { return vec4(x-v.x, y-v.y, z-v.z, w-v.w); }
-	vec4 operator * (float s) const { return vec4(s*x, s*y, s*z, s*w); }
-	vec4 operator * (const vec4 &v) const { return vec4(x*v.x, y*v.y, z*v.z, w*v.z); }
-	friend vec4 operator * (float s, const vec4& v) { return v*s; }
-	vec4 operator / (float s) const { float r = 1.f/s; return *this*r; }
+	constexpr vec4 operator - () const { return vec4(-x, -y, -z, -w); }
+	constexpr vec4 operator + (const vec4 &v) const { return vec4(x+v.x, y+v.y, z+v.z, w+v.w); }
+	constexpr vec4 operator - (const vec4 &v) const { return vec4(x-v.x, y-v.y, z-v.z, w-v.w); }
+	constexpr vec4 operator * (float s) const { return vec4(s*x, s*y, s*z, s*w); }
+	constexpr vec4 operator * (const vec4 &v) const { return vec4(x*v.x, y*v.y, z*v.z, w*v.z); }
+	friend constexpr vec4 operator * (float s, const vec4& v) { return v*s; }
+	constexpr vec4 operator / (float s) const { float r = 1.f/s; return *this*r; }
 	// reflexive
-	vec4 &operator += (const vec4 &v) { x += v.x;  y += v.y;  z += v.z;  w += v.w; return *this; }
-	vec4 &operator -= (const vec4 &v) { x -= v.x;  y -= v.y;  z -= v.z;  w -= v.w; return *this; }
-	vec4 &operator *= (float s) { x *= s;  y *= s;  z *= s;  w *= s; return *this; }
-	vec4 &operator *= (const vec4 &v) { x *= v.x, y *= v.y, z *= v.z, w *= v.w; return *this; }
-	vec4 &operator /= (float s) { float r = 1.f/s; *this *= r; return *this; }
+	constexpr vec4 &operator += (const vec4 &v) { x += v.x;  y += v.y;  z += v.z;  w += v.w; return *this; }
+	constexpr vec4 &operator -= (const vec4 &v) { x -= v.x;  y -= v.y;  z -= v.z;  w -= v.w; return *this; }
+	constexpr vec4 &operator *= (float s) { x *= s;  y *= s;  z *= s;  w *= s; return *this; }
+	constexpr vec4 &operator *= (const vec4 &v) { x *= v.x, y *= v.y, z *= v.z, w *= v.w; return *this; }
+	constexpr vec4 &operator /= (float s) { float r = 1.f/s; *this *= r; return *this; }
 };
 
-inline float dot(const vec4 &a, const vec4 &b) { return a.x*b.x+a.y*b.y+a.z*b.z+a.w*b.w; }
-inline float length(const vec4 &v) { return sqrt(dot(v, v)); }
-inline vec4 normalize(const vec4 &v) { return v/length(v); }
+inline constexpr float dot(const vec4 &a, const vec4 &b) { return a.x*b.x+a.y*b.y+a.z*b.z+a.w*b.w; }
+inline VECMAT_CONSTEXPR float length(const vec4 &v) { return Sqrt(dot(v, v)); }
+inline VECMAT_CONSTEXPR vec4 normalize(const vec4 &v) { return v/length(v); }
 
 // 3x3 matrix representation (used by some quaternion related operations)
 
@@ -178,17 +259,18 @@ class mat3 {
 public:
 	vec3 row[3];
 	//  constructors
-	mat3(float diag = 1) { row[0].x = row[1].y = row[2].z = diag; }
-	mat3(const vec3 &r0, const vec3 &r1, const vec3 &r2) { row[0] = r0; row[1] = r1; row[2] = r2; }
-	mat3(const mat3 &m) { for (int i = 0; i < 3; i++) row[i] = m.row[i]; }
+	constexpr mat3(float diag = 1) : row{vec3(diag, 0, 0), vec3(0, diag, 0), vec3(0, 0, diag)} { }
+	constexpr mat3(const vec3 &r0, const vec3 &r1, const vec3 &r2) : row{r0, r1, r2} { }
+	constexpr mat3(const mat3 &m) : row{m.row[0], m.row[1], m.row[2]} { }
+	mat3 &operator = (const mat3 &m) = default;
 	// access
-	vec3 &operator [] (int i) { return row[i]; }
-	const vec3 &operator [] (int i) const { return row[i]; }
+	constexpr vec3 &operator [] (int i) { return row[i]; }
+	constexpr const vec3 &operator [] (int i) const { return row[i]; }
 	operator const float *() const { return static_cast<const float*>(&row[0].x); }
 	// methods
-	mat3 operator * (float s) const { return mat3(s*row[0], s*row[1], s*row[2]); }
-	friend mat3 operator * (float s, const mat3 &m) { return m*s; }
-	mat3 operator * (const mat3 &m) const {
+	constexpr mat3 operator * (float s) const { return mat3(s*row[0], s*row[1], s*row[2]); }
+	friend constexpr mat3 operator * (float s, const mat3 &m) { return m*s; }
+	VECMAT_CONSTEXPR mat3 operator * (const mat3 &m) const {
 		mat3 a(0);
 		for (int i = 0; i < 3; i++)
 			for (int j = 0; j < 3; j++)
@@ -196,7 +278,7 @@ public:
 					a[i][j] += row[i][k]*m[k][j];
 		return a;
 	}
-	vec3 operator * (const vec3 &v) const { return vec3(dot(row[0], v), dot(row[1], v), dot(row[2], v)); }
+	constexpr vec3 operator * (const vec3 &v) const { return vec3(dot(row[0], v), dot(row[1], v), dot(row[2], v)); }
 };
 
 // 4x4 matrix
@@ -222,111 +304,131 @@ class mat4 {
 public:
 	vec4 row[4];
 	//  constructors
-	mat4(float diag = 1) { row[0].x = row[1].y = row[2].z = row[3].w = diag; }
-	mat4(const vec4 &r0, const vec4 &r1, const vec4 &r2, const vec4 &r3) { row[0] = r0; row[1] = r1; row[2] = r2; row[3] = r3; }
-	mat4(const mat4 &m) { for (int i = 0; i < 4; i++) row[i] = m.row[i]; }
-	mat4(const mat3 &m) {
-		for (int i = 0; i < 3; i++)
-			for (int j = 0; j < 3; j++)
-				row[i][j] = m[i][j];
-		row[3][3] = 1;
-	}
+	constexpr mat4(float diag = 1) : row{vec4(diag, 0, 0, 0), vec4(0, diag, 0, 0), vec4(0, 0, diag, 0), vec4(0, 0, 0, diag)} { }
+	constexpr mat4(const vec4 &r0, const vec4 &r1, const vec4 &r2, const vec4 &r3) : row{r0, r1, r2, r3} { }
+	constexpr mat4(const mat4 &m) : row{m.row[0], m.row[1], m.row[2], m.row[3]} { }
+	constexpr mat4(const mat3 &m) : row{vec4(m[0], 0), vec4(m[1], 0), vec4(m[2], 0), vec4(0, 0, 0, 1)} { }
+	mat4 &operator = (const mat4 &m) = default;
 	// access
-	vec4 &operator [] (int i) { return row[i]; }
-	const vec4 &operator [] (int i) const { return row[i]; }
+	constexpr vec4 &operator [] (int i) { return row[i]; }
+	constexpr const vec4 &operator [] (int i) const { return row[i]; }
 	operator const float *() const { return static_cast<const float*>(&row[0].x); }
 	// methods
-	mat4 operator * (float s) const { return mat4(s*row[0], s*row[1], s*row[2], s*row[3]); }
-	friend mat4 operator * (float s, const mat4 &m) { return m*s; }
-	mat4 operator * (const mat4 &m) const {
+	constexpr mat4 operator * (float s) const { return mat4(s*row[0], s*row[1], s*row[2], s*row[3]); }
+	friend constexpr mat4 operator * (float s, const mat4 &m) { return m*s; }
+	VECMAT_CONSTEXPR mat4 operator * (const mat4 &m) const {
+		// row i of product is sum over k of row[i][k]*m[k], summed in order k = 0..3 starting from zero
 		mat4 a(0);
+		if (!VECMAT_CONSTANT_EVALUATED()) {
+#if defined(VECMAT_SSE)
+			__m128 m0 = _mm_loadu_ps(m[0]), m1 = _mm_loadu_ps(m[1]), m2 = _mm_loadu_ps(m[2]), m3 = _mm_loadu_ps(m[3]);
+			for (int i = 0; i < 4; i++) {
+				const vec4 &r = row[i];
+				__m128 s = _mm_add_ps(_mm_setzero_ps(), _mm_mul_ps(_mm_set1_ps(r.x), m0));
+				s = _mm_add_ps(s, _mm_mul_ps(_mm_set1_ps(r.y), m1));
+				s = _mm_add_ps(s, _mm_mul_ps(_mm_set1_ps(r.z), m2));
+				s = _mm_add_ps(s, _mm_mul_ps(_mm_set1_ps(r.w), m3));
+				_mm_storeu_ps(a[i], s);
+			}
+			return a;
+#elif defined(VECMAT_NEON)
+			float32x4_t m0 = vld1q_f32(m[0]), m1 = vld1q_f32(m[1]), m2 = vld1q_f32(m[2]), m3 = vld1q_f32(m[3]);
+			for (int i = 0; i < 4; i++) {
+				const vec4 &r = row[i];
+				float32x4_t s = vaddq_f32(vdupq_n_f32(0), vmulq_n_f32(m0, r.x));
+				s = vaddq_f32(s, vmulq_n_f32(m1, r.y));
+				s = vaddq_f32(s, vmulq_n_f32(m2, r.z));
+				s = vaddq_f32(s, vmulq_n_f32(m3, r.w));
+				vst1q_f32(a[i], s);
+			}
+			return a;
+#endif
+		}
 		for (int i = 0; i < 4; i++)
 			for (int j = 0; j < 4; j++)
 				for (int k = 0; k < 4; k++)
 					a[i][j] += row[i][k]*m[k][j];
 		return a;
 	}
-	vec4 operator * (const vec4 &v) const { return vec4(dot(row[0], v), dot(row[1], v), dot(row[2], v), dot(row[3], v)); }
+	VECMAT_CONSTEXPR vec4 operator * (const vec4 &v) const {
+		if (!VECMAT_CONSTANT_EVALUATED()) {
+#if defined(VECMAT_SSE)
+			// products of rows with v, transposed so that lane i sums row i in dot's order
+			__m128 x = _mm_loadu_ps(v);
+			__m128 p0 = _mm_mul_ps(_mm_loadu_ps(row[0]), x), p1 = _mm_mul_ps(_mm_loadu_ps(row[1]), x);
+			__m128 p2 = _mm_mul_ps(_mm_loadu_ps(row[2]), x), p3 = _mm_mul_ps(_mm_loadu_ps(row[3]), x);
+			_MM_TRANSPOSE4_PS(p0, p1, p2, p3);
+			vec4 r;
+			_mm_storeu_ps(r, _mm_add_ps(_mm_add_ps(_mm_add_ps(p0, p1), p2), p3));
+			return r;
+#elif defined(VECMAT_NEON)
+			float32x4_t x = vld1q_f32(v);
+			float32x4_t p0 = vmulq_f32(vld1q_f32(row[0]), x), p1 = vmulq_f32(vld1q_f32(row[1]), x);
+			float32x4_t p2 = vmulq_f32(vld1q_f32(row[2]), x), p3 = vmulq_f32(vld1q_f32(row[3]), x);
+			float32x4x2_t t01 = vtrnq_f32(p0, p1), t23 = vtrnq_f32(p2, p3);
+			float32x4_t c0 = vcombine_f32(vget_low_f32(t01.val[0]), vget_low_f32(t23.val[0]));
+			float32x4_t c1 = vcombine_f32(vget_low_f32(t01.val[1]), vget_low_f32(t23.val[1]));
+			float32x4_t c2 = vcombine_f32(vget_high_f32(t01.val[0]), vget_high_f32(t23.val[0]));
+			float32x4_t c3 = vcombine_f32(vget_high_f32(t01.val[1]), vget_high_f32(t23.val[1]));
+			vec4 r;
+			vst1q_f32(r, vaddq_f32(vaddq_f32(vaddq_f32(c0, c1), c2), c3));
+			return r;
+#endif
+		}
+		return vec4(dot(row[0], v), dot(row[1], v), dot(row[2], v), dot(row[3], v));
+	}
 };
 
-inline mat4 Scale(float x, float y, float z) {
-	mat4 c;
-	c[0][0] = x;
-	c[1][1] = y;
-	c[2][2] = z;
-	return c;
+inline constexpr mat4 Scale(float x, float y, float z) {
+	return mat4(vec4(x, 0, 0, 0), vec4(0, y, 0, 0), vec4(0, 0, z, 0), vec4(0, 0, 0, 1));
 }
 
-inline mat4 Scale(vec3 s) { return Scale(s.x, s.y, s.z); }
+inline constexpr mat4 Scale(vec3 s) { return Scale(s.x, s.y, s.z); }
 
-inline mat4 Translate(float x, float y, float z) {
-	mat4 c;
-	c[0][3] = x;
-	c[1][3] = y;
-	c[2][3] = z;
-	return c;
+inline constexpr mat4 Translate(float x, float y, float z) {
+	return mat4(vec4(1, 0, 0, x), vec4(0, 1, 0, y), vec4(0, 0, 1, z), vec4(0, 0, 0, 1));
 }
 
-inline mat4 Translate(vec3 t) { return Translate(t.x, t.y, t.z); }
+inline constexpr mat4 Translate(vec3 t) { return Translate(t.x, t.y, t.z); }
 
-static float DegreesToRadians = 3.14159265358f/180.f;
+constexpr float DegreesToRadians = 3.14159265358f/180.f;
 
-inline mat4 RotateX(float theta) {
-	float angle = DegreesToRadians*theta;
-	mat4 c;
-	c[2][2] = c[1][1] = cos(angle);
-	c[2][1] = sin(angle);
-	c[1][2] = -c[2][1];
-	return c;
+inline VECMAT_CONSTEXPR mat4 RotateX(float theta) {
+	float angle = DegreesToRadians*theta, c = Cos(angle), s = Sin(angle);
+	return mat4(vec4(1, 0, 0, 0), vec4(0, c, -s, 0), vec4(0, s, c, 0), vec4(0, 0, 0, 1));
 }
 
-inline mat4 RotateY(float theta) {
-	float angle = DegreesToRadians*theta;
-	mat4 c;
-	c[2][2] = c[0][0] = cos(angle);
-	c[0][2] = sin(angle);
-	c[2][0] = -c[0][2];
-	return c;
+inline VECMAT_CONSTEXPR mat4 RotateY(float theta) {
+	float angle = DegreesToRadians*theta, c = Cos(angle), s = Sin(angle);
+	return mat4(vec4(c, 0, s, 0), vec4(0, 1, 0, 0), vec4(-s, 0, c, 0), vec4(0, 0, 0, 1));
 }
 
-inline mat4 RotateZ(float theta) {
-	float angle = DegreesToRadians*theta;
-	mat4 c;
-	c[0][0] = c[1][1] = cos(angle);
-	c[1][0] = sin(angle);
-	c[0][1] = -c[1][0];
-	return c;
+inline VECMAT_CONSTEXPR mat4 RotateZ(float theta) {
+	float angle = DegreesToRadians*theta, c = Cos(angle), s = Sin(angle);
+	return mat4(vec4(c, -s, 0, 0), vec4(s, c, 0, 0), vec4(0, 0, 1, 0), vec4(0, 0, 0, 1));
 }
 
-inline mat4 Orthographic(float left, float right, float bottom, float top, float zNear = -1, float zFar = 1) {
-	mat4 c;
-	c[0][0] = 2.f/(right-left);
-	c[1][1] = 2.f/(top-bottom);
-	c[2][2] = 2.f/(zNear-zFar);
-	c[3][3] = 1.f;
-	c[0][3] = -(right+left)/(right-left);
-	c[1][3] = -(top+bottom)/(top-bottom);
-	c[2][3] = -(zFar+zNear)/(zFar-zNear);
-	return c;
+inline constexpr mat4 Orthographic(float left, float right, float bottom, float top, float zNear = -1, float zFar = 1) {
+	return mat4(vec4(2.f/(right-left), 0, 0, -(right+left)/(right-left)),
+				vec4(0, 2.f/(top-bottom), 0, -(top+bottom)/(top-bottom)),
+				vec4(0, 0, 2.f/(zNear-zFar), -(zFar+zNear)/(zFar-zNear)),
+				vec4(0, 0, 0, 1));
 }
 
-inline mat4 Perspective(float verticalFOV, float aspectRatio, float zNear, float zFar) {
+inline VECMAT_CONSTEXPR mat4 Perspective(float verticalFOV, float aspectRatio, float zNear, float zFar) {
 	// convert view frustum to +/-1 perspective/clip space
 	// zNear and zFar are positive distances (despite camera facing -z axis)
 	// view frustum defined by verticalFOV (top, bottom), aspectRatio (left, right) and near, far
 	// -1/+1 in perspective z defaults to full depth buffer
-	float t = tan(verticalFOV*DegreesToRadians/2.f);
+	float t = Tan(verticalFOV*DegreesToRadians/2.f);
 	float fnDif = zFar-zNear;
-	mat4 m(0);
-	m[0][0] = 1.f/(aspectRatio*t);
-	m[1][1] = 1.f/t;
-	m[2][2] = -(zFar+zNear)/fnDif;
-	m[2][3] = -2.f*zFar*zNear/fnDif;
-	m[3][2] = -1.f;
-	return m;
+	return mat4(vec4(1.f/(aspectRatio*t), 0, 0, 0),
+				vec4(0, 1.f/t, 0, 0),
+				vec4(0, 0, -(zFar+zNear)/fnDif, -2.f*zFar*zNear/fnDif),
+				vec4(0, 0, -1.f, 0));
 }
 
-inline mat4 LookTowards(vec3 eye, vec3 lookV, vec3 up) {
+inline VECMAT_CONSTEXPR mat4 LookTowards(vec3 eye, vec3 lookV, vec3 up) {
 	// camera view matrix transforms standard coordinate system (origin at (0,0,0), x-axis to right) to arbitrary
 	// scene coordinate system (ie, (0,0,0) transforms to origin of new system, (1,0,0) transforms to new x-axis) 
 	// LookAt is inverse: it must transform arbitrary x-axis to (1,0,0) and arbitrary origin to (0,0,0)
@@ -341,9 +443,21 @@ inline mat4 LookTowards(vec3 eye, vec3 lookV, vec3 up) {
 	return m;
 }
 
-inline mat4 LookAt(vec3 eye, vec3 lookat, vec3 up) { return LookTowards(eye, lookat-eye, up); }
-
-inline mat4 Transpose(mat4 m) {
+inline VECMAT_CONSTEXPR mat4 LookAt(vec3 eye, vec3 lookat, vec3 up) { return LookTowards(eye, lookat-eye, up); }
+
+inline VECMAT_CONSTEXPR mat4 Transpose(mat4 m) {
+	if (!VECMAT_CONSTANT_EVALUATED()) {
+#if defined(VECMAT_SSE)
+		__m128 r0 = _mm_loadu_ps(m[0]), r1 = _mm_loadu_ps(m[1]), r2 = _mm_loadu_ps(m[2]), r3 = _mm_loadu_ps(m[3]);
+		_MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+		_mm_storeu_ps(m[0], r0); _mm_storeu_ps(m[1], r1); _mm_storeu_ps(m[2], r2); _mm_storeu_ps(m[3], r3);
+		return m;
+#elif defined(VECMAT_NEON)
+		float32x4x4_t c = vld4q_f32(m[0]);		// de-interleave: c.val[j] is column j
+		vst1q_f32(m[0], c.val[0]); vst1q_f32(m[1], c.val[1]); vst1q_f32(m[2], c.val[2]); vst1q_f32(m[3], c.val[3]);
+		return m;
+#endif
+	}
 	return mat4(vec4(m[0][0], m[1][0], m[2][0], m[3][0]),
 				vec4(m[0][1], m[1][1], m[2][1], m[3][1]),
 				vec4(m[0][2], m[1][2], m[2][2], m[3][2]),
@@ -393,12 +507,185 @@ inline bool InverseMatrix4x4(const float *m, float *out) {
 	return h.invert(out);
 }
 
+#if defined(VECMAT_SSE)
+
+// 2x2 block inverse (Eric Zhang, "Fast 4x4 Matrix Inverse with SSE SIMD, Explained")
+// a 2x2 matrix is held in one register as (m00, m01, m10, m11)
+
+#define VECMAT_SWIZZLE(v, x, y, z, w) _mm_shuffle_ps(v, v, _MM_SHUFFLE(w, z, y, x))
+#define VECMAT_SHUFFLE(a, b, x, y, z, w) _mm_shuffle_ps(a, b, _MM_SHUFFLE(w, z, y, x))
+
+inline __m128 Mat2Mul(__m128 a, __m128 b) {
+	// a*b
+	return _mm_add_ps(_mm_mul_ps(a, VECMAT_SWIZZLE(b, 0, 3, 0, 3)), _mm_mul_ps(VECMAT_SWIZZLE(a, 1, 0, 3, 2), VECMAT_SWIZZLE(b, 2, 1, 2, 1)));
+}
+
+inline __m128 Mat2AdjMul(__m128 a, __m128 b) {
+	// adjugate(a)*b
+	return _mm_sub_ps(_mm_mul_ps(VECMAT_SWIZZLE(a, 3, 3, 0, 0), b), _mm_mul_ps(VECMAT_SWIZZLE(a, 1, 1, 2, 2), VECMAT_SWIZZLE(b, 2, 3, 0, 1)));
+}
+
+inline __m128 Mat2MulAdj(__m128 a, __m128 b) {
+	// a*adjugate(b)
+	return _mm_sub_ps(_mm_mul_ps(a, VECMAT_SWIZZLE(b, 3, 0, 3, 0)), _mm_mul_ps(VECMAT_SWIZZLE(a, 1, 0, 3, 2), VECMAT_SWIZZLE(b, 2, 1, 2, 1)));
+}
+
+inline mat4 Invert(mat4 m) {
+	// identity if m singular
+	__m128 r0 = _mm_loadu_ps(m[0]), r1 = _mm_loadu_ps(m[1]), r2 = _mm_loadu_ps(m[2]), r3 = _mm_loadu_ps(m[3]);
+	// m = | A B |
+	//     | C D |
+	__m128 A = _mm_movelh_ps(r0, r1), B = _mm_movehl_ps(r1, r0), C = _mm_movelh_ps(r2, r3), D = _mm_movehl_ps(r3, r2);
+	// (|A|, |B|, |C|, |D|)
+	__m128 detSub = _mm_sub_ps(_mm_mul_ps(VECMAT_SHUFFLE(r0, r2, 0, 2, 0, 2), VECMAT_SHUFFLE(r1, r3, 1, 3, 1, 3)),
+							   _mm_mul_ps(VECMAT_SHUFFLE(r0, r2, 1, 3, 1, 3), VECMAT_SHUFFLE(r1, r3, 0, 2, 0, 2)));
+	__m128 detA = VECMAT_SWIZZLE(detSub, 0, 0, 0, 0), detB = VECMAT_SWIZZLE(detSub, 1, 1, 1, 1);
+	__m128 detC = VECMAT_SWIZZLE(detSub, 2, 2, 2, 2), detD = VECMAT_SWIZZLE(detSub, 3, 3, 3, 3);
+	__m128 D_C = Mat2AdjMul(D, C), A_B = Mat2AdjMul(A, B);
+	// adjugates of the inverse's blocks X, Y, Z, W
+	__m128 X_ = _mm_sub_ps(_mm_mul_ps(detD, A), Mat2Mul(B, D_C));
+	__m128 W_ = _mm_sub_ps(_mm_mul_ps(detA, D), Mat2Mul(C, A_B));
+	__m128 Y_ = _mm_sub_ps(_mm_mul_ps(detB, C), Mat2MulAdj(D, A_B));
+	__m128 Z_ = _mm_sub_ps(_mm_mul_ps(detC, B), Mat2MulAdj(A, D_C));
+	// |m| = |A||D|+|B||C|-trace(A_B*D_C)
+	__m128 tr = _mm_mul_ps(A_B, VECMAT_SWIZZLE(D_C, 0, 2, 1, 3));
+	tr = _mm_add_ps(tr, VECMAT_SWIZZLE(tr, 1, 0, 3, 2));
+	tr = _mm_add_ps(tr, VECMAT_SWIZZLE(tr, 2, 3, 0, 1));
+	__m128 detM = _mm_sub_ps(_mm_add_ps(_mm_mul_ps(detA, detD), _mm_mul_ps(detB, detC)), tr);
+	if (_mm_cvtss_f32(detM) == 0)
+		return mat4();
+	__m128 rDetM = _mm_div_ps(_mm_setr_ps(1, -1, -1, 1), detM);
+	X_ = _mm_mul_ps(X_, rDetM);
+	Y_ = _mm_mul_ps(Y_, rDetM);
+	Z_ = _mm_mul_ps(Z_, rDetM);
+	W_ = _mm_mul_ps(W_, rDetM);
+	// adjugate shuffles combined with the store layout
+	mat4 inv;
+	_mm_storeu_ps(inv[0], VECMAT_SHUFFLE(X_, Y_, 3, 1, 3, 1));
+	_mm_storeu_ps(inv[1], VECMAT_SHUFFLE(X_, Y_, 2, 0, 2, 0));
+	_mm_storeu_ps(inv[2], VECMAT_SHUFFLE(Z_, W_, 3, 1, 3, 1));
+	_mm_storeu_ps(inv[3], VECMAT_SHUFFLE(Z_, W_, 2, 0, 2, 0));
+	return inv;
+}
+
+#undef VECMAT_SWIZZLE
+#undef VECMAT_SHUFFLE
+
+#else
+
 inline mat4 Invert(mat4 m) {
 	mat4 inv;
 	InverseMatrix4x4(&m[0][0], &inv[0][0]);
 	return inv;
 }
 
+#endif
+
+// 3x4 affine matrix
+
+// the top three rows of a mat4 whose bottom row is (0, 0, 0, 1): object, camera, and hierarchy transforms
+// composes in 36 multiplies (mat4: 64), transforms points and vectors in 9, and inverts from 3x3 cofactors
+// converts implicitly to mat4 (for SetUniform, projection, etc.); from mat4 explicitly, dropping the bottom row
+//     mat3x4 a(Translate(p)*RotateY(30));
+//     mat3x4 ab = a*b, ai = Invert(a);
+//     vec3 q = ab.Point(p), v = ab.Vector(d), n = NormalMatrix(ab)*normal;
+
+class mat3x4 {
+public:
+	vec4 row[3];
+	// constructors
+	constexpr mat3x4(float diag = 1) : row{vec4(diag, 0, 0, 0), vec4(0, diag, 0, 0), vec4(0, 0, diag, 0)} { }
+	constexpr mat3x4(const vec4 &r0, const vec4 &r1, const vec4 &r2) : row{r0, r1, r2} { }
+	constexpr mat3x4(const mat3 &m, vec3 t = vec3(0, 0, 0)) : row{vec4(m[0], t.x), vec4(m[1], t.y), vec4(m[2], t.z)} { }
+	constexpr explicit mat3x4(const mat4 &m) : row{m[0], m[1], m[2]} { }
+	constexpr operator mat4() const { return mat4(row[0], row[1], row[2], vec4(0, 0, 0, 1)); }
+	// access
+	constexpr vec4 &operator [] (int i) { return row[i]; }
+	constexpr const vec4 &operator [] (int i) const { return row[i]; }
+	// methods
+	VECMAT_CONSTEXPR mat3x4 operator * (const mat3x4 &m) const {
+		// as mat4 product with implicit bottom rows, summed in the same order (results match exactly)
+		mat3x4 a(0);
+		if (!VECMAT_CONSTANT_EVALUATED()) {
+#if defined(VECMAT_SSE)
+			__m128 m0 = _mm_loadu_ps(m[0]), m1 = _mm_loadu_ps(m[1]), m2 = _mm_loadu_ps(m[2]);
+			for (int i = 0; i < 3; i++) {
+				const vec4 &r = row[i];
+				__m128 s = _mm_add_ps(_mm_setzero_ps(), _mm_mul_ps(_mm_set1_ps(r.x), m0));
+				s = _mm_add_ps(s, _mm_mul_ps(_mm_set1_ps(r.y), m1));
+				s = _mm_add_ps(s, _mm_mul_ps(_mm_set1_ps(r.z), m2));
+				s = _mm_add_ps(s, _mm_setr_ps(0, 0, 0, r.w));
+				_mm_storeu_ps(a[i], s);
+			}
+			return a;
+#elif defined(VECMAT_NEON)
+			float32x4_t m0 = vld1q_f32(m[0]), m1 = vld1q_f32(m[1]), m2 = vld1q_f32(m[2]);
+			for (int i = 0; i < 3; i++) {
+				const vec4 &r = row[i];
+				float32x4_t s = vaddq_f32(vdupq_n_f32(0), vmulq_n_f32(m0, r.x));
+				s = vaddq_f32(s, vmulq_n_f32(m1, r.y));
+				s = vaddq_f32(s, vmulq_n_f32(m2, r.z));
+				s = vaddq_f32(s, vsetq_lane_f32(r.w, vdupq_n_f32(0), 3));
+				vst1q_f32(a[i], s);
+			}
+			return a;
+#endif
+		}
+		for (int i = 0; i < 3; i++) {
+			const vec4 &r = row[i];
+			for (int j = 0; j < 4; j++)
+				a[i][j] = 0.f+r.x*m[0][j]+r.y*m[1][j]+r.z*m[2][j];	// from zero, as mat4: a -0 sum is +0
+			a[i][3] += r.w;
+		}
+		return a;
+	}
+	VECMAT_CONSTEXPR mat4 operator * (const mat4 &m) const { return mat4(*this)*m; }
+	constexpr vec4 operator * (const vec4 &v) const { return vec4(dot(row[0], v), dot(row[1], v), dot(row[2], v), v.w); }
+	constexpr vec3 Point(const vec3 &p) const {
+		return vec3(row[0].x*p.x+row[0].y*p.y+row[0].z*p.z+row[0].w,
+					row[1].x*p.x+row[1].y*p.y+row[1].z*p.z+row[1].w,
+					row[2].x*p.x+row[2].y*p.y+row[2].z*p.z+row[2].w);
+	}
+	constexpr vec3 Vector(const vec3 &v) const {
+		return vec3(row[0].x*v.x+row[0].y*v.y+row[0].z*v.z,
+					row[1].x*v.x+row[1].y*v.y+row[1].z*v.z,
+					row[2].x*v.x+row[2].y*v.y+row[2].z*v.z);
+	}
+	constexpr vec3 Translation() const { return vec3(row[0].w, row[1].w, row[2].w); }
+};
+
+inline constexpr mat3x4 Invert(const mat3x4 &m) {
+	// general affine inverse: 3x3 inverse (transposed cofactors over determinant), translation -inverse*t
+	vec3 a0(m[0].x, m[0].y, m[0].z), a1(m[1].x, m[1].y, m[1].z), a2(m[2].x, m[2].y, m[2].z), t = m.Translation();
+	vec3 c0 = cross(a1, a2), c1 = cross(a2, a0), c2 = cross(a0, a1);
+	float det = dot(a0, c0);
+	if (det == 0)
+		return mat3x4();
+	float s = 1/det;
+	vec3 r0 = s*vec3(c0.x, c1.x, c2.x), r1 = s*vec3(c0.y, c1.y, c2.y), r2 = s*vec3(c0.z, c1.z, c2.z);
+	return mat3x4(vec4(r0, -dot(r0, t)), vec4(r1, -dot(r1, t)), vec4(r2, -dot(r2, t)));
+}
+
+inline VECMAT_CONSTEXPR mat3x4 InvertTRS(const mat3x4 &m) {
+	// inverse of translate*rotate*scale (rotation with per-axis scale, no shear): for 3x3 R*S,
+	// the inverse is S^-2 (R*S)^T, ie, row i is column i over its squared length
+	vec3 t = m.Translation(), r[3];
+	for (int i = 0; i < 3; i++) {
+		vec3 c(m[0][i], m[1][i], m[2][i]);
+		float l2 = dot(c, c);
+		r[i] = l2 > 0? (1/l2)*c : vec3(0, 0, 0);
+	}
+	return mat3x4(vec4(r[0], -dot(r[0], t)), vec4(r[1], -dot(r[1], t)), vec4(r[2], -dot(r[2], t)));
+}
+
+inline constexpr mat3 NormalMatrix(const mat3x4 &m) {
+	// inverse transpose of the 3x3: transforms normals; cofactors over determinant
+	vec3 a0(m[0].x, m[0].y, m[0].z), a1(m[1].x, m[1].y, m[1].z), a2(m[2].x, m[2].y, m[2].z);
+	vec3 c0 = cross(a1, a2), c1 = cross(a2, a0), c2 = cross(a0, a1);
+	float det = dot(a0, c0);
+	return det == 0? mat3() : (1/det)*mat3(c0, c1, c2);
+}
+
 #endif // VEC_MAT_HDR
 
 /* void Adjoint3x3(double in[][3], double out[][3]) {
@@ -0,0 +1,296 @@
+// AmbientOcclusion.cpp - per-vertex ambient occlusion baked by ray casting
+
+#include "AmbientOcclusion.h"
+#include "Misc.h"
+#include "Parallel.h"
+#include <algorithm>
+#include <float.h>
+#include <string.h>
+
+namespace {
+
+// Bounding Volume Hierarchy
+
+struct BVHNode {
+	vec3 min, max;
+	int start = 0, count = 0;   // leaf: triangles [start, start+count); interior (count 0): children index+1, start
+};
+
+class BVH {
+public:
+	vector<BVHNode> nodes;
+	vector<vec3> p, e1, e2;     // triangles in leaf order: first vertex, two edges
+	void Build(const vector<vec3> &points, const vector<int3> &triangles);
+	bool Occluded(vec3 o, vec3 d, float tMax) const;
+		// does ray o+t*d, 0 < t < tMax, hit any triangle?
+private:
+	static const int LeafSize = 4;
+	vector<int> order;
+	vector<vec3> centers, mins, maxs;
+	int Build(int start, int count);
+};
+
+void BVH::Build(const vector<vec3> &points, const vector<int3> &triangles) {
+	int nTriangles = (int) triangles.size();
+	order.resize(nTriangles);
+	centers.resize(nTriangles);
+	mins.resize(nTriangles);
+	maxs.resize(nTriangles);
+	ParallelFor(nTriangles, [&](int begin, int end) {
+		for (int i = begin; i < end; i++) {
+			const int3 &t = triangles[i];
+			const vec3 &a = points[t.i1], &b = points[t.i2], &c = points[t.i3];
+			mins[i] = vec3(std::min(a.x, std::min(b.x, c.x)), std::min(a.y, std::min(b.y, c.y)), std::min(a.z, std::min(b.z, c.z)));
+			maxs[i] = vec3(std::max(a.x, std::max(b.x, c.x)), std::max(a.y, std::max(b.y, c.y)), std::max(a.z, std::max(b.z, c.z)));
+			centers[i] = .5f*(mins[i]+maxs[i]);
+			order[i] = i;
+		}
+	});
+	nodes.resize(0);
+	nodes.reserve(2*nTriangles/LeafSize+1);
+	if (nTriangles)
+		Build(0, nTriangles);
+	// store triangles in leaf order for locality
+	p.resize(nTriangles);
+	e1.resize(nTriangles);
+	e2.resize(nTriangles);
+	for (int i = 0; i < nTriangles; i++) {
+		const int3 &t = triangles[order[i]];
+		p[i] = points[t.i1];
+		e1[i] = points[t.i2]-p[i];
+		e2[i] = points[t.i3]-p[i];
+	}
+	order.clear(); centers.clear(); mins.clear(); maxs.clear();
+}
+
+int BVH::Build(int start, int count) {
+	int index = (int) nodes.size();
+	nodes.push_back(BVHNode());
+	vec3 bmin(FLT_MAX, FLT_MAX, FLT_MAX), bmax(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+	vec3 cmin = bmin, cmax = bmax;
+	for (int i = start; i < start+count; i++) {
+		int t = order[i];
+		for (int k = 0; k < 3; k++) {
+			bmin[k] = std::min(bmin[k], mins[t][k]);
+			bmax[k] = std::max(bmax[k], maxs[t][k]);
+			cmin[k] = std::min(cmin[k], centers[t][k]);
+			cmax[k] = std::max(cmax[k], centers[t][k]);
+		}
+	}
+	nodes[index].min = bmin;
+	nodes[index].max = bmax;
+	if (count <= LeafSize) {
+		nodes[index].start = start;
+		nodes[index].count = count;
+		return index;
+	}
+	// median split along the longest axis of the triangle centers
+	vec3 extent = cmax-cmin;
+	int axis = extent.x > extent.y? (extent.x > extent.z? 0 : 2) : (extent.y > extent.z? 1 : 2);
+	int half = count/2;
+	std::nth_element(order.begin()+start, order.begin()+start+half, order.begin()+start+count,
+		[&](int a, int b) { return centers[a][axis] < centers[b][axis]; });
+	Build(start, half);
+	int right = Build(start+half, count-half);
+	nodes[index].start = right;
+	return index;
+}
+
+bool HitBox(const BVHNode &n, vec3 o, vec3 inv, float tMax) {
+	float tNear = 0, tFar = tMax;
+	for (int k = 0; k < 3; k++) {
+		float t1 = (n.min[k]-o[k])*inv[k], t2 = (n.max[k]-o[k])*inv[k];
+		if (t1 > t2) std::swap(t1, t2);
+		// comparisons ignore the NaN from 0*inf (ray within a slab plane)
+		tNear = t1 > tNear? t1 : tNear;
+		tFar = t2 < tFar? t2 : tFar;
+	}
+	return tNear <= tFar;
+}
+
+bool BVH::Occluded(vec3 o, vec3 d, float tMax) const {
+	if (nodes.empty())
+		return false;
+	vec3 inv(1/d.x, 1/d.y, 1/d.z);
+	int stack[64], nStack = 0, i = 0;
+	for (;;) {
+		const BVHNode &n = nodes[i];
+		if (HitBox(n, o, inv, tMax)) {
+			if (!n.count) {
+				stack[nStack++] = n.start;
+				i = i+1;
+				continue;
+			}
+			for (int t = n.start; t < n.start+n.count; t++) {
+				// Moller-Trumbore
+				vec3 h = cross(d, e2[t]);
+				float det = dot(e1[t], h);
+				if (det > -FLT_EPSILON && det < FLT_EPSILON)
+					continue;
+				float f = 1/det;
+				vec3 s = o-p[t];
+				float u = f*dot(s, h);
+				if (u < 0 || u > 1)
+					continue;
+				vec3 q = cross(s, e1[t]);
+				float v = f*dot(d, q);
+				if (v < 0 || u+v > 1)
+					continue;
+				float a = f*dot(e2[t], q);
+				if (a > 0 && a < tMax)
+					return true;
+			}
+		}
+		if (!nStack)
+			return false;
+		i = stack[--nStack];
+	}
+}
+
+// Sampling
+
+unsigned int Hash(unsigned int x) {
+	x ^= x >> 16; x *= 0x7feb352d;
+	x ^= x >> 15; x *= 0x846ca68b;
+	return x ^ (x >> 16);
+}
+
+float RadicalInverse(unsigned int i) {
+	i = (i << 16) | (i >> 16);
+	i = ((i & 0x55555555) << 1) | ((i & 0xAAAAAAAA) >> 1);
+	i = ((i & 0x33333333) << 2) | ((i & 0xCCCCCCCC) >> 2);
+	i = ((i & 0x0F0F0F0F) << 4) | ((i & 0xF0F0F0F0) >> 4);
+	i = ((i & 0x00FF00FF) << 8) | ((i & 0xFF00FF00) >> 8);
+	return (float) i*2.3283064365386963e-10f;
+}
+
+void Basis(vec3 n, vec3 &u, vec3 &v) {
+	// orthonormal u, v perpendicular to unit n (Duff et al. 2017)
+	float s = n.z >= 0? 1.f : -1.f, a = -1/(s+n.z), b = n.x*n.y*a;
+	u = vec3(1+s*n.x*n.x*a, s*b, -s*n.x);
+	v = vec3(b, s+n.y*n.y*a, -n.y);
+}
+
+} // end namespace
+
+// Bake
+
+void OcclusionBaker::Bake(const vector<vec3> &points, const vector<vec3> &normals, const vector<int3> &triangles,
+						  vector<float> &occlusion) {
+	double start = TimeMs();
+	int nPoints = (int) points.size();
+	occlusion.assign(nPoints, 0);
+	BVH bvh;
+	bvh.Build(points, triangles);
+	// offset ray origins off the surface in proportion to mesh size
+	float bias = bvh.nodes.size()? 1e-4f*length(bvh.nodes[0].max-bvh.nodes[0].min) : 0;
+	float tMax = maxDistance > 0? maxDistance : FLT_MAX;
+	int n = nRays > 0? nRays : 1;
+	// sample directions: Hammersley points, rotated per vertex (Cranley-Patterson) to decorrelate neighbors
+	vector<vec2> samples(n);
+	for (int i = 0; i < n; i++)
+		samples[i] = vec2((i+.5f)/n, RadicalInverse(i));
+	auto bake = [&](int begin, int end) {
+		for (int i = begin; i < end; i++) {
+			vec3 nrm = normals[i];
+			float len = length(nrm);
+			if (len < FLT_MIN)
+				continue;
+			nrm = nrm/len;
+			vec3 u, v, o = points[i]+bias*nrm;
+			Basis(nrm, u, v);
+			unsigned int h = Hash(i);
+			float r1 = (h & 0xffff)/65536.f, r2 = (h >> 16)/65536.f;
+			int nHits = 0;
+			for (int s = 0; s < n; s++) {
+				float s1 = samples[s].x+r1, s2 = samples[s].y+r2;
+				s1 -= (int) s1;
+				s2 -= (int) s2;
+				// cosine-weighted direction about nrm
+				float r = sqrt(s1), phi = 2*3.1415926f*s2;
+				vec3 d = r*cos(phi)*u+r*sin(phi)*v+sqrt(std::max(0.f, 1-s1))*nrm;
+				if (bvh.Occluded(o, d, tMax))
+					nHits++;
+			}
+			occlusion[i] = (float) nHits/n;
+		}
+	};
+	// batches so progress can be reported from the calling thread
+	int nBatches = progress? 20 : 1, batch = (nPoints+nBatches-1)/nBatches;
+	for (int b = 0; b < nBatches && b*batch < nPoints; b++) {
+		int begin = b*batch, end = std::min(nPoints, begin+batch);
+		ParallelFor(end-begin, [&](int b0, int b1) { bake(begin+b0, begin+b1); }, 64);
+		if (progress)
+			progress((float) end/nPoints);
+	}
+	bakeMs = (float) (TimeMs()-start);
+}
+
+bool OcclusionBaker::Bake(Mesh &m) {
+	string cacheFile = m.objFilename+".ao";
+	const vector<vec3> &points = m.Points(), &meshNormals = m.Normals();
+	const vector<int3> &triangles = m.Triangles();
+	int nPoints = (int) points.size(), nTriangles = (int) triangles.size();
+	if (useCache && m.objFilename.size()) {
+		FILE *in = fopen(cacheFile.c_str(), "rb");
+		bool current = in != NULL && FileModified(cacheFile.c_str()) >= FileModified(m.objFilename.c_str());
+		if (in)
+			fclose(in);
+		if (current && ReadOcclusion(cacheFile.c_str(), nPoints, nTriangles, nRays, maxDistance, m.occlusion)) {
+			bakeMs = 0;
+			return true;
+		}
+	}
+	vector<vec3> normals;
+	if (meshNormals.size() != points.size())
+		SetVertexNormals(points, triangles, normals);
+	Bake(points, meshNormals.size() == points.size()? meshNormals : normals, triangles, m.occlusion);
+	if (useCache && m.objFilename.size() && !WriteOcclusion(cacheFile.c_str(), nTriangles, nRays, maxDistance, m.occlusion))
+		printf("OcclusionBaker: can't write %s\n", cacheFile.c_str());
+	return false;
+}
+
+// Cache File
+
+namespace {
+
+const char occlusionTag[4] = { 'A', 'O', '0', '1' };
+
+struct OcclusionHeader {
+	char tag[4];
+	int nPoints, nTriangles, nRays;
+	float maxDistance;
+};
+
+} // end namespace
+
+bool ReadOcclusion(const char *filename, int nPoints, int nTriangles, int nRays, float maxDistance, vector<float> &occlusion) {
+	FILE *in = fopen(filename, "rb");
+	if (!in)
+		return false;
+	OcclusionHeader h;
+	bool ok = fread(&h, sizeof(h), 1, in) == 1 && !strncmp(h.tag, occlusionTag, 4) &&
+			  h.nPoints == nPoints && h.nTriangles == nTriangles && h.nRays == nRays && h.maxDistance == maxDistance;
+	if (ok) {
+		occlusion.resize(nPoints);
+		ok = (int) fread(occlusion.data(), sizeof(float), nPoints, in) == nPoints;
+	}
+	fclose(in);
+	return ok;
+}
+
+bool WriteOcclusion(const char *filename, int nTriangles, int nRays, float maxDistance, vector<float> &occlusion) {
+	FILE *out = fopen(filename, "wb");
+	if (!out)
+		return false;
+	OcclusionHeader h;
+	memcpy(h.tag, occlusionTag, 4);
+	h.nPoints = (int) occlusion.size();
+	h.nTriangles = nTriangles;
+	h.nRays = nRays;
+	h.maxDistance = maxDistance;
+	bool ok = fwrite(&h, sizeof(h), 1, out) == 1 &&
+			  fwrite(occlusion.data(), sizeof(float), occlusion.size(), out) == occlusion.size();
+	fclose(out);
+	return ok;
+}
@@ -0,0 +1,102 @@
+// Arena.cpp - per-frame bump allocator for transient arrays, with STL allocators and scoped marks
+
+#include "Arena.h"
+#include <stdint.h>
+#include <stdlib.h>
+
+thread_local Arena frameArena;
+
+// Allocate
+
+void *Arena::Allocate(size_t bytes, size_t align) {
+	for (;;) {
+		if (block < (int) blocks.size()) {
+			Block &b = blocks[block];
+			size_t pad = (align-(uintptr_t) (b.data+offset)%align)%align;
+			if (offset+pad+bytes <= b.size) {
+				void *p = b.data+offset+pad;
+				offset += pad+bytes;
+				used += pad+bytes;
+				frameHighWater = used > frameHighWater? used : frameHighWater;
+				highWater = used > highWater? used : highWater;
+				return p;
+			}
+			// the rest of this block is skipped until the mark before it is reset
+			block++;
+			offset = 0;
+			continue;
+		}
+		size_t size = bytes+align > blockSize? bytes+align : blockSize;
+		blocks.push_back({ new char[size], size });
+		heapBlocks++;
+		block = (int) blocks.size()-1;
+		offset = 0;
+	}
+}
+
+void Arena::Free(void *p, size_t bytes) {
+	if (block < (int) blocks.size() && (char *) p+bytes == blocks[block].data+offset) {
+		offset -= bytes;
+		used -= bytes;
+	}
+}
+
+// Reset
+
+ArenaMark Arena::Mark() const {
+	ArenaMark m;
+	m.block = block;
+	m.offset = offset;
+	m.used = used;
+	return m;
+}
+
+void Arena::Reset(ArenaMark mark) {
+	block = mark.block;
+	offset = mark.offset;
+	used = mark.used;
+}
+
+void Arena::Reset() {
+	size_t capacity = Capacity();
+	recentHighWater = frameHighWater > recentHighWater? frameHighWater : recentHighWater;
+	size_t need = recentHighWater > blockSize? recentHighWater : blockSize;
+	if (blocks.size() > 1 || (capacity > 2*need && ++nOversized >= shrinkFrames)) {
+		// merge, so a frame as large as the last fits one block; or shrink to the recent frames' need
+		size_t size = blocks.size() > 1? capacity : need;
+		for (Block &b : blocks)
+			delete [] b.data;
+		blocks.assign(1, { new char[size], size });
+		heapBlocks++;
+		nOversized = 0;
+		recentHighWater = 0;
+	}
+	else if (capacity <= 2*need) {
+		nOversized = 0;
+		recentHighWater = 0;
+	}
+	block = 0;
+	offset = 0;
+	used = 0;
+	frameHighWater = 0;
+}
+
+size_t Arena::Capacity() const {
+	size_t size = 0;
+	for (const Block &b : blocks)
+		size += b.size;
+	return size;
+}
+
+Arena::~Arena() {
+	for (Block &b : blocks)
+		delete [] b.data;
+}
+
+// Heap instrumentation
+
+long long (*heapAllocationCounter)() = NULL;	// set by HeapCount.cpp, if linked
+
+long long HeapAllocations() {
+	return heapAllocationCounter? heapAllocationCounter() : -1;
+}
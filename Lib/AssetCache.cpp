@@ -0,0 +1,160 @@
+// AssetCache.cpp - reference-counted meshes and textures, shared by every object that reads the same file
+
+#include "AssetCache.h"
+#include "GLPool.h"
+#include "Misc.h"
+#include "STB_Image.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+AssetCache assetCache;
+
+// Keys
+
+string AssetKey(const string &filename, const string &options) {
+	char path[4096];
+#ifdef _WIN32
+	bool resolved = _fullpath(path, filename.c_str(), sizeof(path)) != NULL;
+#else
+	bool resolved = realpath(filename.c_str(), path) != NULL;
+#endif
+	return (resolved? string(path) : filename)+"|"+options;
+}
+
+// Assets
+
+void Asset::Release() {
+	if (--refs > 0)
+		return;
+	if (cache)
+		cache->Idle(this);
+	else
+		delete this;
+}
+
+MeshAsset::~MeshAsset() {
+	delete mesh;
+}
+
+TextureAsset::~TextureAsset() {
+	glPool.ReleaseTexture(textureName);
+}
+
+// Cache
+
+Asset *AssetCache::Find(const string &key) {
+	auto i = assets.find(key);
+	if (i == assets.end())
+		return NULL;
+	Asset *a = i->second;
+	if (a->refs++ == 0)
+		bytesIdle -= a->bytes;
+	a->lastUse = ++tick;
+	hits++;
+	return a;
+}
+
+void AssetCache::Add(Asset *a) {
+	a->cache = this;
+	a->refs = 1;
+	a->lastUse = ++tick;
+	assets[a->key] = a;
+	bytesResident += a->bytes;
+	Trim(budget);
+}
+
+void AssetCache::Idle(Asset *a) {
+	a->lastUse = ++tick;
+	bytesIdle += a->bytes;
+	Trim(budget);
+}
+
+MeshAsset *AssetCache::GetMesh(const string &key, std::function<Mesh *()> load) {
+	if (Asset *a = Find(key))
+		return (MeshAsset *) a;
+	misses++;
+	MeshCounters start = meshCounters;
+	Mesh *m = load();
+	if (!m)
+		return NULL;
+	// buffered: its arrays become the geometry every holder reads, counted once, here
+	m->ShareGeometry();
+	const MeshGeometry &g = *m->sharedGeometry;
+	MeshAsset *a = new MeshAsset();
+	a->key = key;
+	a->mesh = m;
+	a->bytes = meshCounters.bytesUploaded-start.bytesUploaded+g.Bytes();
+	a->memory.Name(m->objFilename);
+	a->memory.Set(MemPoints, g.points.capacity()*sizeof(vec3));
+	a->memory.Set(MemNormals, g.normals.capacity()*sizeof(vec3));
+	a->memory.Set(MemUvs, g.uvs.capacity()*sizeof(vec2));
+	a->memory.Set(MemTriangles, g.triangles.capacity()*sizeof(int3));
+	a->memory.Set(MemQuads, g.quads.capacity()*sizeof(int4));
+	Add(a);
+	return a;
+}
+
+TextureAsset *AssetCache::GetTexture(const string &filename, bool mipmap) {
+	string key = AssetKey(filename, mipmap? "mipmap" : "");
+	if (Asset *a = Find(key))
+		return (TextureAsset *) a;
+	misses++;
+	int width, height, channels;
+	stbi_set_flip_vertically_on_load(true);
+	unsigned char *data = stbi_load(filename.c_str(), &width, &height, &channels, 0);
+	if (!data) {
+		printf("GetTexture: can't open %s (%s)\n", filename.c_str(), stbi_failure_reason());
+		return NULL;
+	}
+	TextureAsset *a = new TextureAsset();
+	a->key = key;
+	a->width = width;
+	a->height = height;
+	a->channels = channels;
+	a->textureName = glPool.AcquireTexture(width, height, channels == 4? GL_RGBA : GL_RGB, mipmap);
+	LoadTexture(data, width, height, channels, 0, a->textureName, false, mipmap);
+	stbi_image_free(data);
+	a->bytes = (size_t) a->width*a->height*a->channels*(mipmap? 4 : 3)/3;
+	a->memory.Name(filename);
+	a->memory.Set(MemTexture, a->bytes);
+	Add(a);
+	return a;
+}
+
+void AssetCache::Trim(size_t bytes) {
+	while (bytesResident > bytes && bytesIdle > 0) {
+		// least recently used idle asset
+		auto lru = assets.end();
+		for (auto i = assets.begin(); i != assets.end(); i++)
+			if (i->second->refs == 0 && (lru == assets.end() || i->second->lastUse < lru->second->lastUse))
+				lru = i;
+		Asset *a = lru->second;
+		bytesResident -= a->bytes;
+		bytesIdle -= a->bytes;
+		evictions++;
+		assets.erase(lru);
+		delete a;
+	}
+}
+
+void AssetCache::Print() const {
+	int nMeshes = 0, nTextures = 0, nIdle = 0;
+	for (auto &i : assets) {
+		if (dynamic_cast<MeshAsset *>(i.second)) nMeshes++; else nTextures++;
+		nIdle += i.second->refs == 0;
+	}
+	printf("AssetCache: %i meshes, %i textures (%i idle), %.2f MB resident (%.2f MB idle, budget %.0f MB)\n",
+		   nMeshes, nTextures, nIdle, bytesResident/(1024.f*1024.f), bytesIdle/(1024.f*1024.f), budget/(1024.f*1024.f));
+	printf("  %i hits, %i misses, %i evictions\n", hits, misses, evictions);
+}
+
+AssetCache::~AssetCache() {
+	// free idle assets; held ones are freed by their last release
+	for (auto &i : assets) {
+		if (i.second->refs == 0)
+			delete i.second;
+		else
+			i.second->cache = NULL;
+	}
+}
@@ -0,0 +1,610 @@
+// Batch.cpp - structure-of-arrays vectors and bulk kernels over arrays of vec3
+
+#include "Arena.h"
+#include "Batch.h"
+#include "Parallel.h"
+#include <float.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define BATCH_SSE
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+const int MinChunk = 16384;             // vec3s per thread task; smaller arrays run on the calling thread
+
+#ifdef BATCH_SSE
+
+// four vec3s as three registers of x, y, z
+
+struct vec3x4 { __m128 x, y, z; };
+
+inline vec3x4 Load(const vec3 *p) {
+	// 12 floats: a = x0 y0 z0 x1, b = y1 z1 x2 y2, c = z2 x3 y3 z3
+	const float *f = &p->x;
+	__m128 a = _mm_loadu_ps(f), b = _mm_loadu_ps(f+4), c = _mm_loadu_ps(f+8);
+	vec3x4 v;
+	v.x = _mm_shuffle_ps(_mm_shuffle_ps(a, a, _MM_SHUFFLE(3, 0, 3, 0)), _mm_shuffle_ps(b, c, _MM_SHUFFLE(1, 1, 2, 2)), _MM_SHUFFLE(2, 0, 1, 0));
+	v.y = _mm_shuffle_ps(_mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 0, 1, 1)), _mm_shuffle_ps(b, c, _MM_SHUFFLE(2, 2, 3, 3)), _MM_SHUFFLE(2, 0, 2, 0));
+	v.z = _mm_shuffle_ps(_mm_shuffle_ps(a, b, _MM_SHUFFLE(1, 1, 2, 2)), _mm_shuffle_ps(c, c, _MM_SHUFFLE(3, 3, 0, 0)), _MM_SHUFFLE(2, 0, 2, 0));
+	return v;
+}
+
+inline void Store(vec3 *p, vec3x4 v) {
+	float *f = &p->x;
+	__m128 X = v.x, Y = v.y, Z = v.z;
+	_mm_storeu_ps(f,   _mm_shuffle_ps(_mm_shuffle_ps(X, Y, _MM_SHUFFLE(0, 0, 0, 0)), _mm_shuffle_ps(Z, X, _MM_SHUFFLE(1, 1, 0, 0)), _MM_SHUFFLE(2, 0, 2, 0)));
+	_mm_storeu_ps(f+4, _mm_shuffle_ps(_mm_shuffle_ps(Y, Z, _MM_SHUFFLE(1, 1, 1, 1)), _mm_shuffle_ps(X, Y, _MM_SHUFFLE(2, 2, 2, 2)), _MM_SHUFFLE(2, 0, 2, 0)));
+	_mm_storeu_ps(f+8, _mm_shuffle_ps(_mm_shuffle_ps(Z, X, _MM_SHUFFLE(3, 3, 2, 2)), _mm_shuffle_ps(Y, Z, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(2, 0, 2, 0)));
+}
+
+inline __m128 Dot(vec3x4 a, vec3x4 b) {
+	return _mm_add_ps(_mm_add_ps(_mm_mul_ps(a.x, b.x), _mm_mul_ps(a.y, b.y)), _mm_mul_ps(a.z, b.z));
+}
+
+#endif
+
+} // end namespace
+
+// Structure of Arrays
+
+void ToSoA(const vec3 *in, int n, vec3SoA &out) {
+	out.resize(n);
+	float *x = out.x.data(), *y = out.y.data(), *z = out.z.data();
+	ParallelFor(n, [&](int begin, int end) {
+		int i = begin;
+#ifdef BATCH_SSE
+		for (; i+4 <= end; i += 4) {
+			vec3x4 v = Load(in+i);
+			_mm_storeu_ps(x+i, v.x);
+			_mm_storeu_ps(y+i, v.y);
+			_mm_storeu_ps(z+i, v.z);
+		}
+#endif
+		for (; i < end; i++) {
+			x[i] = in[i].x; y[i] = in[i].y; z[i] = in[i].z;
+		}
+	}, MinChunk);
+}
+
+void ToAoS(const float *x, const float *y, const float *z, int n, vec3 *out) {
+	ParallelFor(n, [&](int begin, int end) {
+		int i = begin;
+#ifdef BATCH_SSE
+		for (; i+4 <= end; i += 4)
+			Store(out+i, { _mm_loadu_ps(x+i), _mm_loadu_ps(y+i), _mm_loadu_ps(z+i) });
+#endif
+		for (; i < end; i++)
+			out[i] = vec3(x[i], y[i], z[i]);
+	}, MinChunk);
+}
+
+void ToAoS(const vec3SoA &in, vec3 *out) { ToAoS(in.x.data(), in.y.data(), in.z.data(), in.size(), out); }
+
+// Transformation
+
+namespace {
+
+void Xform(mat4 m, const vec3 *in, vec3 *out, int n, float w) {
+	// w = 1 for points, 0 for vectors
+	ParallelFor(n, [&](int begin, int end) {
+		int i = begin;
+#ifdef BATCH_SSE
+		__m128 m00 = _mm_set1_ps(m[0][0]), m01 = _mm_set1_ps(m[0][1]), m02 = _mm_set1_ps(m[0][2]), m03 = _mm_set1_ps(w*m[0][3]);
+		__m128 m10 = _mm_set1_ps(m[1][0]), m11 = _mm_set1_ps(m[1][1]), m12 = _mm_set1_ps(m[1][2]), m13 = _mm_set1_ps(w*m[1][3]);
+		__m128 m20 = _mm_set1_ps(m[2][0]), m21 = _mm_set1_ps(m[2][1]), m22 = _mm_set1_ps(m[2][2]), m23 = _mm_set1_ps(w*m[2][3]);
+		for (; i+4 <= end; i += 4) {
+			vec3x4 p = Load(in+i), r;
+			r.x = _mm_add_ps(_mm_add_ps(_mm_mul_ps(m00, p.x), _mm_mul_ps(m01, p.y)), _mm_add_ps(_mm_mul_ps(m02, p.z), m03));
+			r.y = _mm_add_ps(_mm_add_ps(_mm_mul_ps(m10, p.x), _mm_mul_ps(m11, p.y)), _mm_add_ps(_mm_mul_ps(m12, p.z), m13));
+			r.z = _mm_add_ps(_mm_add_ps(_mm_mul_ps(m20, p.x), _mm_mul_ps(m21, p.y)), _mm_add_ps(_mm_mul_ps(m22, p.z), m23));
+			Store(out+i, r);
+		}
+#endif
+		for (; i < end; i++) {
+			vec3 p = in[i];
+			out[i] = vec3((m[0][0]*p.x+m[0][1]*p.y)+(m[0][2]*p.z+w*m[0][3]),
+						  (m[1][0]*p.x+m[1][1]*p.y)+(m[1][2]*p.z+w*m[1][3]),
+						  (m[2][0]*p.x+m[2][1]*p.y)+(m[2][2]*p.z+w*m[2][3]));
+		}
+	}, MinChunk);
+}
+
+} // end namespace
+
+void XformPoints(mat4 m, const vec3 *in, vec3 *out, int n) { Xform(m, in, out, n, 1); }
+
+void XformPoints(mat4 m, vector<vec3> &points) { Xform(m, points.data(), points.data(), (int) points.size(), 1); }
+
+void XformVectors(mat4 m, const vec3 *in, vec3 *out, int n) { Xform(m, in, out, n, 0); }
+
+// Geometry
+
+void NormalizeVectors(vec3 *v, int n) {
+	ParallelFor(n, [&](int begin, int end) {
+		int i = begin;
+#ifdef BATCH_SSE
+		__m128 zero = _mm_setzero_ps(), one = _mm_set1_ps(1);
+		for (; i+4 <= end; i += 4) {
+			vec3x4 p = Load(v+i);
+			__m128 len = _mm_sqrt_ps(Dot(p, p));
+			// as vec3 normalize (multiply by reciprocal), but zero where len is zero
+			__m128 r = _mm_and_ps(_mm_cmpgt_ps(len, zero), _mm_div_ps(one, len));
+			p.x = _mm_mul_ps(p.x, r);
+			p.y = _mm_mul_ps(p.y, r);
+			p.z = _mm_mul_ps(p.z, r);
+			Store(v+i, p);
+		}
+#endif
+		for (; i < end; i++) {
+			float len = length(v[i]);
+			v[i] = len > 0? v[i]/len : vec3(0, 0, 0);
+		}
+	}, MinChunk);
+}
+
+void MinMax(const vec3 *p, int n, vec3 &min, vec3 &max) {
+	min = vec3(FLT_MAX, FLT_MAX, FLT_MAX);
+	max = vec3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+	int nChunks = (n+MinChunk-1)/MinChunk;
+	ArenaScope scope;
+	ArenaVector<vec3> mins(nChunks, min), maxs(nChunks, max);
+	ParallelFor(nChunks, [&](int c0, int c1) {
+		for (int c = c0; c < c1; c++) {
+			int i = c*MinChunk, end = i+MinChunk < n? i+MinChunk : n;
+			vec3 &lo = mins[c], &hi = maxs[c];
+#ifdef BATCH_SSE
+			__m128 xlo = _mm_set1_ps(FLT_MAX), ylo = xlo, zlo = xlo, xhi = _mm_set1_ps(-FLT_MAX), yhi = xhi, zhi = xhi;
+			for (; i+4 <= end; i += 4) {
+				vec3x4 v = Load(p+i);
+				xlo = _mm_min_ps(xlo, v.x); ylo = _mm_min_ps(ylo, v.y); zlo = _mm_min_ps(zlo, v.z);
+				xhi = _mm_max_ps(xhi, v.x); yhi = _mm_max_ps(yhi, v.y); zhi = _mm_max_ps(zhi, v.z);
+			}
+			float f[4];
+			__m128 lanes[] = { xlo, ylo, zlo, xhi, yhi, zhi };
+			for (int k = 0; k < 6; k++) {
+				_mm_storeu_ps(f, lanes[k]);
+				for (int j = 0; j < 4; j++)
+					if (k < 3) { if (f[j] < lo[k]) lo[k] = f[j]; }
+					else { if (f[j] > hi[k-3]) hi[k-3] = f[j]; }
+			}
+#endif
+			for (; i < end; i++)
+				for (int k = 0; k < 3; k++) {
+					if (p[i][k] < lo[k]) lo[k] = p[i][k];
+					if (p[i][k] > hi[k]) hi[k] = p[i][k];
+				}
+		}
+	}, 1);
+	for (int c = 0; c < nChunks; c++)
+		for (int k = 0; k < 3; k++) {
+			if (mins[c][k] < min[k]) min[k] = mins[c][k];
+			if (maxs[c][k] > max[k]) max[k] = maxs[c][k];
+		}
+}
+
+void Dot(const vec3 *a, const vec3 *b, float *out, int n) {
+	ParallelFor(n, [&](int begin, int end) {
+		int i = begin;
+#ifdef BATCH_SSE
+		for (; i+4 <= end; i += 4)
+			_mm_storeu_ps(out+i, Dot(Load(a+i), Load(b+i)));
+#endif
+		for (; i < end; i++)
+			out[i] = dot(a[i], b[i]);
+	}, MinChunk);
+}
+
+void Cross(const vec3 *a, const vec3 *b, vec3 *out, int n) {
+	ParallelFor(n, [&](int begin, int end) {
+		int i = begin;
+#ifdef BATCH_SSE
+		for (; i+4 <= end; i += 4) {
+			vec3x4 u = Load(a+i), v = Load(b+i), c;
+			c.x = _mm_sub_ps(_mm_mul_ps(u.y, v.z), _mm_mul_ps(u.z, v.y));
+			c.y = _mm_sub_ps(_mm_mul_ps(u.z, v.x), _mm_mul_ps(u.x, v.z));
+			c.z = _mm_sub_ps(_mm_mul_ps(u.x, v.y), _mm_mul_ps(u.y, v.x));
+			Store(out+i, c);
+		}
+#endif
+		for (; i < end; i++)
+			out[i] = cross(a[i], b[i]);
+	}, MinChunk);
+}
+
+// Quaternions and Frames
+
+void ToSoA(const Quaternion *in, int n, quatSoA &out) {
+	out.resize(n);
+	for (int i = 0; i < n; i++)
+		out.Set(i, in[i]);
+}
+
+void ToAoS(const quatSoA &in, Quaternion *out) {
+	for (int i = 0, n = in.size(); i < n; i++)
+		out[i] = in[i];
+}
+
+void ToSoA(const Frame *in, int n, FrameSoA &out) {
+	out.resize(n);
+	for (int i = 0; i < n; i++)
+		out.Set(i, in[i]);
+}
+
+void ToAoS(const FrameSoA &in, Frame *out) {
+	for (int i = 0, n = in.size(); i < n; i++)
+		out[i] = in[i];
+}
+
+namespace {
+
+#ifdef BATCH_SSE
+
+// four quaternions as four registers of x, y, z, w, and their rotation matrices
+
+struct quat4 { __m128 x, y, z, w; };
+
+struct mat3x4x4 { __m128 m[3][3]; };
+
+inline quat4 Load(const quatSoA &q, int i) {
+	return { _mm_loadu_ps(q.x.data()+i), _mm_loadu_ps(q.y.data()+i), _mm_loadu_ps(q.z.data()+i), _mm_loadu_ps(q.w.data()+i) };
+}
+
+inline quat4 Broadcast(const Quaternion &q) {
+	return { _mm_set1_ps(q.x), _mm_set1_ps(q.y), _mm_set1_ps(q.z), _mm_set1_ps(q.w) };
+}
+
+inline void Store(quatSoA &q, int i, quat4 v) {
+	_mm_storeu_ps(q.x.data()+i, v.x);
+	_mm_storeu_ps(q.y.data()+i, v.y);
+	_mm_storeu_ps(q.z.data()+i, v.z);
+	_mm_storeu_ps(q.w.data()+i, v.w);
+}
+
+inline __m128 Select(__m128 mask, __m128 a, __m128 b) {
+	return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+}
+
+inline __m128 Dot(quat4 a, quat4 b) {
+	return _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(a.x, b.x), _mm_mul_ps(a.y, b.y)), _mm_mul_ps(a.z, b.z)), _mm_mul_ps(a.w, b.w));
+}
+
+inline quat4 Mul(quat4 p, quat4 q) {
+	// as Quaternion::operator*, same order of operations
+	quat4 r;
+	r.x = _mm_add_ps(_mm_sub_ps(_mm_add_ps(_mm_mul_ps(p.x, q.w), _mm_mul_ps(p.y, q.z)), _mm_mul_ps(p.z, q.y)), _mm_mul_ps(p.w, q.x));
+	r.y = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_sub_ps(_mm_setzero_ps(), _mm_mul_ps(p.x, q.z)), _mm_mul_ps(p.y, q.w)), _mm_mul_ps(p.z, q.x)), _mm_mul_ps(p.w, q.y));
+	r.z = _mm_add_ps(_mm_add_ps(_mm_sub_ps(_mm_mul_ps(p.x, q.y), _mm_mul_ps(p.y, q.x)), _mm_mul_ps(p.z, q.w)), _mm_mul_ps(p.w, q.z));
+	r.w = _mm_add_ps(_mm_sub_ps(_mm_sub_ps(_mm_sub_ps(_mm_setzero_ps(), _mm_mul_ps(p.x, q.x)), _mm_mul_ps(p.y, q.y)), _mm_mul_ps(p.z, q.z)), _mm_mul_ps(p.w, q.w));
+	return r;
+}
+
+inline mat3x4x4 Rotations(quat4 q) {
+	// as Quaternion::Get3x3: identity if norm is (near) zero
+	__m128 norm = Dot(q, q), two = _mm_set1_ps(2), one = _mm_set1_ps(1);
+	__m128 valid = _mm_cmpge_ps(_mm_andnot_ps(_mm_set1_ps(-0.f), norm), _mm_set1_ps(FLT_EPSILON));
+	__m128 s = _mm_div_ps(two, norm);
+	__m128 xs = _mm_mul_ps(q.x, s), ys = _mm_mul_ps(q.y, s), zs = _mm_mul_ps(q.z, s);
+	__m128 wx = _mm_mul_ps(q.w, xs), wy = _mm_mul_ps(q.w, ys), wz = _mm_mul_ps(q.w, zs);
+	__m128 xx = _mm_mul_ps(q.x, xs), xy = _mm_mul_ps(q.x, ys), xz = _mm_mul_ps(q.x, zs);
+	__m128 yy = _mm_mul_ps(q.y, ys), yz = _mm_mul_ps(q.y, zs), zz = _mm_mul_ps(q.z, zs);
+	mat3x4x4 r;
+	r.m[0][0] = Select(valid, _mm_sub_ps(one, _mm_add_ps(yy, zz)), one);
+	r.m[0][1] = _mm_and_ps(valid, _mm_add_ps(xy, wz));
+	r.m[0][2] = _mm_and_ps(valid, _mm_sub_ps(xz, wy));
+	r.m[1][0] = _mm_and_ps(valid, _mm_sub_ps(xy, wz));
+	r.m[1][1] = Select(valid, _mm_sub_ps(one, _mm_add_ps(xx, zz)), one);
+	r.m[1][2] = _mm_and_ps(valid, _mm_add_ps(yz, wx));
+	r.m[2][0] = _mm_and_ps(valid, _mm_add_ps(xz, wy));
+	r.m[2][1] = _mm_and_ps(valid, _mm_sub_ps(yz, wx));
+	r.m[2][2] = Select(valid, _mm_sub_ps(one, _mm_add_ps(xx, yy)), one);
+	return r;
+}
+
+void StoreMatrices(const mat3x4x4 &r, __m128 scale, const __m128 *position, mat4 *out) {
+	// out[k] = (scale*r | position) for lanes k = 0..3, position may be NULL
+	__m128 lastRow = _mm_setr_ps(0, 0, 0, 1);
+	for (int i = 0; i < 3; i++) {
+		// transpose lanes into row i of the four matrices
+		__m128 c0 = _mm_mul_ps(scale, r.m[i][0]), c1 = _mm_mul_ps(scale, r.m[i][1]), c2 = _mm_mul_ps(scale, r.m[i][2]);
+		__m128 c3 = position? position[i] : _mm_setzero_ps();
+		_MM_TRANSPOSE4_PS(c0, c1, c2, c3);
+		_mm_storeu_ps(out[0][i], c0);
+		_mm_storeu_ps(out[1][i], c1);
+		_mm_storeu_ps(out[2][i], c2);
+		_mm_storeu_ps(out[3][i], c3);
+	}
+	for (int k = 0; k < 4; k++)
+		_mm_storeu_ps(out[k][3], lastRow);
+}
+
+// acos and sin for Slerp
+
+const float PiHi = 3.14159274f, PiLo = -8.74227801e-8f;	// float pi and the remainder, pi = PiHi+PiLo
+
+inline __m128 Acos(__m128 a, __m128 oneMinusA) {
+	// Abramowitz and Stegun 4.4.46 (error 2e-8): acos(a) = sqrt(1-a)*p(a), 0 <= a <= 1, for 1-a given
+	// more exactly than a
+	const float c[] = { -0.0012624911f, 0.0066700901f, -0.0170881256f, 0.0308918810f,
+						-0.0501743046f, 0.0889789874f, -0.2145988016f, 1.5707963050f };
+	__m128 p = _mm_set1_ps(c[0]);
+	for (int i = 1; i < 8; i++)
+		p = _mm_add_ps(_mm_mul_ps(p, a), _mm_set1_ps(c[i]));
+	return _mm_mul_ps(_mm_sqrt_ps(_mm_max_ps(oneMinusA, _mm_setzero_ps())), p);
+}
+
+inline __m128 Acos(__m128 x) {
+	// acos(-x) = pi-acos(x)
+	__m128 a = _mm_andnot_ps(_mm_set1_ps(-0.f), x), r = Acos(a, _mm_sub_ps(_mm_set1_ps(1), a));
+	return Select(_mm_cmplt_ps(x, _mm_setzero_ps()), _mm_sub_ps(_mm_set1_ps(3.14159265f), r), r);
+}
+
+inline __m128 Sin(__m128 x) {
+	// reduce to [-pi, pi], fold to [-pi/2, pi/2], Taylor series to x^11 (error 6e-8)
+	// pi in two parts: near pi, sin(x) is small and pi-x must keep the bits float pi lacks
+	__m128 k = _mm_cvtepi32_ps(_mm_cvtps_epi32(_mm_mul_ps(x, _mm_set1_ps(.5f/PiHi))));
+	x = _mm_sub_ps(_mm_sub_ps(x, _mm_mul_ps(k, _mm_set1_ps(2*PiHi))), _mm_mul_ps(k, _mm_set1_ps(2*PiLo)));
+	__m128 halfPi = _mm_set1_ps(PiHi/2), piHi = _mm_set1_ps(PiHi), piLo = _mm_set1_ps(PiLo);
+	x = Select(_mm_cmpgt_ps(x, halfPi), _mm_add_ps(_mm_sub_ps(piHi, x), piLo), x);
+	x = Select(_mm_cmplt_ps(x, _mm_sub_ps(_mm_setzero_ps(), halfPi)), _mm_sub_ps(_mm_sub_ps(_mm_setzero_ps(), _mm_add_ps(piHi, x)), piLo), x);
+	__m128 x2 = _mm_mul_ps(x, x), p = _mm_set1_ps(-1/39916800.f);
+	const float c[] = { 1/362880.f, -1/5040.f, 1/120.f, -1/6.f, 1 };
+	for (int i = 0; i < 5; i++)
+		p = _mm_add_ps(_mm_mul_ps(p, x2), _mm_set1_ps(c[i]));
+	return _mm_mul_ps(p, x);
+}
+
+inline __m128 OneMinusAbsDot(quat4 a, quat4 b) {
+	// 1-|dot(a, b)|, in double: products of floats are exact, and the difference keeps its low bits
+	__m128d lo = _mm_setzero_pd(), hi = _mm_setzero_pd();
+	__m128 pa[] = { a.x, a.y, a.z, a.w }, pb[] = { b.x, b.y, b.z, b.w };
+	for (int k = 0; k < 4; k++) {
+		lo = _mm_add_pd(lo, _mm_mul_pd(_mm_cvtps_pd(pa[k]), _mm_cvtps_pd(pb[k])));
+		hi = _mm_add_pd(hi, _mm_mul_pd(_mm_cvtps_pd(_mm_movehl_ps(pa[k], pa[k])), _mm_cvtps_pd(_mm_movehl_ps(pb[k], pb[k]))));
+	}
+	__m128d one = _mm_set1_pd(1), sign = _mm_set1_pd(-0.);
+	lo = _mm_sub_pd(one, _mm_andnot_pd(sign, lo));
+	hi = _mm_sub_pd(one, _mm_andnot_pd(sign, hi));
+	return _mm_movelh_ps(_mm_cvtpd_ps(lo), _mm_cvtpd_ps(hi));
+}
+
+#endif
+
+} // end namespace
+
+void Nlerp(const quatSoA &a, const quatSoA &b, const float *t, quatSoA &out) {
+	int n = a.size();
+	out.resize(n);
+	ParallelFor(n, [&](int begin, int end) {
+		int i = begin;
+#ifdef BATCH_SSE
+		__m128 one = _mm_set1_ps(1), zero = _mm_setzero_ps();
+		for (; i+4 <= end; i += 4) {
+			quat4 q0 = Load(a, i), q1 = Load(b, i), r;
+			__m128 t1 = _mm_loadu_ps(t+i), t0 = _mm_sub_ps(one, t1);
+			r.x = _mm_add_ps(_mm_mul_ps(t0, q0.x), _mm_mul_ps(t1, q1.x));
+			r.y = _mm_add_ps(_mm_mul_ps(t0, q0.y), _mm_mul_ps(t1, q1.y));
+			r.z = _mm_add_ps(_mm_mul_ps(t0, q0.z), _mm_mul_ps(t1, q1.z));
+			r.w = _mm_add_ps(_mm_mul_ps(t0, q0.w), _mm_mul_ps(t1, q1.w));
+			__m128 len = _mm_sqrt_ps(Dot(r, r));
+			__m128 s = _mm_and_ps(_mm_cmpgt_ps(len, zero), _mm_div_ps(one, len));
+			r.x = _mm_mul_ps(r.x, s); r.y = _mm_mul_ps(r.y, s); r.z = _mm_mul_ps(r.z, s); r.w = _mm_mul_ps(r.w, s);
+			Store(out, i, r);
+		}
+#endif
+		for (; i < end; i++) {
+			Quaternion r = a[i]*(1-t[i])+b[i]*t[i];
+			float len = sqrt(r.Norm());
+			out.Set(i, len > 0? r*(1/len) : Quaternion(0, 0, 0, 0));
+		}
+	}, MinChunk);
+}
+
+void Slerp(const quatSoA &a, const quatSoA &b, const float *t, quatSoA &out) {
+	int n = a.size();
+	out.resize(n);
+	ParallelFor(n, [&](int begin, int end) {
+		int i = begin;
+#ifdef BATCH_SSE
+		__m128 one = _mm_set1_ps(1), half = _mm_set1_ps(.5f), pi = _mm_set1_ps(PiHi), epsilon = _mm_set1_ps(.00001f);
+		for (; i+4 <= end; i += 4) {
+			quat4 q0 = Load(a, i), q1 = Load(b, i), r;
+			__m128 t1 = _mm_loadu_ps(t+i), t0 = _mm_sub_ps(one, t1);
+			__m128 c = Dot(q0, q1);
+			__m128 usual = _mm_cmpgt_ps(_mm_add_ps(one, c), epsilon), apart = _mm_cmpgt_ps(_mm_sub_ps(one, c), epsilon);
+			__m128 neg = _mm_set1_ps(-0.f), obtuse = _mm_cmplt_ps(c, _mm_setzero_ps());
+			// usual case: sin((1-t)omega)/sin(omega), sin(t omega)/sin(omega), from r = acos|c| (acos magnifies
+			// the rounding of c as the ends approach, so h = 1-|c| is summed in double); omega = pi-r for c < 0,
+			// and sin(omega) = sin(r) = sqrt(h(2-h))
+			__m128 h = OneMinusAbsDot(q0, q1), r0 = Acos(_mm_andnot_ps(neg, c), h);
+			__m128 sinOmega = _mm_sqrt_ps(_mm_mul_ps(h, _mm_sub_ps(_mm_set1_ps(2), h)));
+			__m128 omega = Select(obtuse, _mm_add_ps(_mm_sub_ps(pi, r0), _mm_set1_ps(PiLo)), r0);
+			// for c < 0, b is near -a and p0, p1 are large and nearly cancel: weight a by p0-p1 =
+			// cos(t pi-(t-1/2)r)/cos(r/2), with cos(r/2) = sqrt(1-h/2), and a+b (small, and exact) by p1
+			__m128 x = _mm_sub_ps(_mm_mul_ps(t1, pi), _mm_mul_ps(_mm_sub_ps(t1, half), r0));
+			__m128 p0 = _mm_div_ps(Sin(Select(obtuse, _mm_add_ps(x, _mm_mul_ps(half, pi)), _mm_mul_ps(t0, omega))), Select(obtuse, _mm_sqrt_ps(_mm_sub_ps(one, _mm_mul_ps(half, h))), sinOmega));
+			__m128 p1 = _mm_div_ps(Sin(_mm_mul_ps(t1, omega)), sinOmega);
+			quat4 q = { Select(obtuse, _mm_add_ps(q0.x, q1.x), q1.x), Select(obtuse, _mm_add_ps(q0.y, q1.y), q1.y),
+						Select(obtuse, _mm_add_ps(q0.z, q1.z), q1.z), Select(obtuse, _mm_add_ps(q0.w, q1.w), q1.w) };
+			// ends very close: linear
+			p0 = Select(apart, p0, t0);
+			p1 = Select(apart, p1, t1);
+			// ends nearly opposite: blend with perpendicular (-y, x, -w, z)
+			if (_mm_movemask_ps(usual) != 15) {
+				p0 = Select(usual, p0, Sin(_mm_mul_ps(_mm_sub_ps(half, t1), pi)));
+				p1 = Select(usual, p1, Sin(_mm_mul_ps(t1, pi)));
+				q.x = Select(usual, q.x, _mm_xor_ps(q0.y, neg));
+				q.y = Select(usual, q.y, q0.x);
+				q.z = Select(usual, q.z, _mm_xor_ps(q0.w, neg));
+				q.w = Select(usual, q.w, q0.z);
+			}
+			r.x = _mm_add_ps(_mm_mul_ps(p0, q0.x), _mm_mul_ps(p1, q.x));
+			r.y = _mm_add_ps(_mm_mul_ps(p0, q0.y), _mm_mul_ps(p1, q.y));
+			r.z = _mm_add_ps(_mm_mul_ps(p0, q0.z), _mm_mul_ps(p1, q.z));
+			r.w = _mm_add_ps(_mm_mul_ps(p0, q0.w), _mm_mul_ps(p1, q.w));
+			Store(out, i, r);
+		}
+#endif
+		for (; i < end; i++) {
+			Quaternion q0 = a[i], q1 = b[i], r;
+			r.Slerp(q0, q1, t[i]);
+			out.Set(i, r);
+		}
+	}, MinChunk);
+}
+
+void GetMatrices(const quatSoA &q, mat4 *out) {
+	ParallelFor(q.size(), [&](int begin, int end) {
+		int i = begin;
+#ifdef BATCH_SSE
+		for (; i+4 <= end; i += 4)
+			StoreMatrices(Rotations(Load(q, i)), _mm_set1_ps(1), NULL, out+i);
+#endif
+		for (; i < end; i++)
+			out[i] = q[i].GetMatrix();
+	}, MinChunk);
+}
+
+namespace {
+
+void ComposeFrames(const Frame *parent, const FrameSoA *a, const FrameSoA &b, FrameSoA &out) {
+	// out[i] = (parent? *parent : a[i])*b[i]
+	int n = b.size();
+	out.resize(n);
+	ParallelFor(n, [&](int begin, int end) {
+		int i = begin;
+#ifdef BATCH_SSE
+		for (; i+4 <= end; i += 4) {
+			quat4 qa = parent? Broadcast(parent->orientation) : Load(a->orientation, i), qb = Load(b.orientation, i);
+			__m128 sa = parent? _mm_set1_ps(parent->scale) : _mm_loadu_ps(a->scale.data()+i);
+			__m128 pa[3], pb[3] = { _mm_loadu_ps(b.position.x.data()+i), _mm_loadu_ps(b.position.y.data()+i), _mm_loadu_ps(b.position.z.data()+i) };
+			for (int k = 0; k < 3; k++)
+				pa[k] = parent? _mm_set1_ps(parent->position[k]) : _mm_loadu_ps((k == 0? a->position.x : k == 1? a->position.y : a->position.z).data()+i);
+			mat3x4x4 r = Rotations(qa);
+			float *po[] = { out.position.x.data()+i, out.position.y.data()+i, out.position.z.data()+i };
+			for (int k = 0; k < 3; k++) {
+				// as Frame::operator*: position+scale*(rotation*f.position)
+				__m128 rp = _mm_add_ps(_mm_add_ps(_mm_mul_ps(r.m[k][0], pb[0]), _mm_mul_ps(r.m[k][1], pb[1])), _mm_mul_ps(r.m[k][2], pb[2]));
+				_mm_storeu_ps(po[k], _mm_add_ps(pa[k], _mm_mul_ps(sa, rp)));
+			}
+			Store(out.orientation, i, Mul(qb, qa));
+			_mm_storeu_ps(out.scale.data()+i, _mm_mul_ps(sa, _mm_loadu_ps(b.scale.data()+i)));
+		}
+#endif
+		for (; i < end; i++)
+			out.Set(i, (parent? *parent : (*a)[i])*b[i]);
+	}, MinChunk);
+}
+
+} // end namespace
+
+void Compose(const FrameSoA &a, const FrameSoA &b, FrameSoA &out) { ComposeFrames(NULL, &a, b, out); }
+
+void Compose(const Frame &a, const FrameSoA &b, FrameSoA &out) { ComposeFrames(&a, NULL, b, out); }
+
+void GetMatrices(const FrameSoA &f, mat4 *out) {
+	ParallelFor(f.size(), [&](int begin, int end) {
+		int i = begin;
+#ifdef BATCH_SSE
+		for (; i+4 <= end; i += 4) {
+			__m128 p[] = { _mm_loadu_ps(f.position.x.data()+i), _mm_loadu_ps(f.position.y.data()+i), _mm_loadu_ps(f.position.z.data()+i) };
+			StoreMatrices(Rotations(Load(f.orientation, i)), _mm_loadu_ps(f.scale.data()+i), p, out+i);
+		}
+#endif
+		for (; i < end; i++)
+			out[i] = f[i].GetMatrix();
+	}, MinChunk);
+}
+
+// Triangles
+
+namespace {
+
+#ifdef BATCH_SSE
+
+inline vec3x4 Gather(const vec3 *p, int i0, int i1, int i2, int i3) {
+	vec3x4 v;
+	v.x = _mm_setr_ps(p[i0].x, p[i1].x, p[i2].x, p[i3].x);
+	v.y = _mm_setr_ps(p[i0].y, p[i1].y, p[i2].y, p[i3].y);
+	v.z = _mm_setr_ps(p[i0].z, p[i1].z, p[i2].z, p[i3].z);
+	return v;
+}
+
+inline void Corners(const vec3 *p, const int3 *t, vec3x4 &p1, vec3x4 &p2, vec3x4 &p3) {
+	p1 = Gather(p, t[0].i1, t[1].i1, t[2].i1, t[3].i1);
+	p2 = Gather(p, t[0].i2, t[1].i2, t[2].i2, t[3].i2);
+	p3 = Gather(p, t[0].i3, t[1].i3, t[2].i3, t[3].i3);
+}
+
+inline vec3x4 Sub(vec3x4 a, vec3x4 b) {
+	vec3x4 v;
+	v.x = _mm_sub_ps(a.x, b.x); v.y = _mm_sub_ps(a.y, b.y); v.z = _mm_sub_ps(a.z, b.z);
+	return v;
+}
+
+inline vec3x4 Unit(vec3x4 v) {
+	__m128 len = _mm_sqrt_ps(Dot(v, v));
+	__m128 r = _mm_and_ps(_mm_cmpgt_ps(len, _mm_setzero_ps()), _mm_div_ps(_mm_set1_ps(1), len));
+	v.x = _mm_mul_ps(v.x, r); v.y = _mm_mul_ps(v.y, r); v.z = _mm_mul_ps(v.z, r);
+	return v;
+}
+
+#endif
+
+} // end namespace
+
+void TriangleNormals(const vec3 *points, const int3 *triangles, vec3 *out, int n, bool unit) {
+	ParallelFor(n, [&](int begin, int end) {
+		int i = begin;
+#ifdef BATCH_SSE
+		for (; i+4 <= end; i += 4) {
+			vec3x4 p1, p2, p3, c;
+			Corners(points, triangles+i, p1, p2, p3);
+			vec3x4 a = Sub(p2, p1), b = Sub(p3, p2);
+			c.x = _mm_sub_ps(_mm_mul_ps(a.y, b.z), _mm_mul_ps(a.z, b.y));
+			c.y = _mm_sub_ps(_mm_mul_ps(a.z, b.x), _mm_mul_ps(a.x, b.z));
+			c.z = _mm_sub_ps(_mm_mul_ps(a.x, b.y), _mm_mul_ps(a.y, b.x));
+			Store(out+i, unit? Unit(c) : c);
+		}
+#endif
+		for (; i < end; i++) {
+			const int3 &t = triangles[i];
+			vec3 c = cross(points[t.i2]-points[t.i1], points[t.i3]-points[t.i2]);
+			float len = length(c);
+			out[i] = !unit? c : len > 0? c/len : vec3(0, 0, 0);
+		}
+	}, MinChunk);
+}
+
+void TriangleAngles(const vec3 *points, const int3 *triangles, float *out, int n) {
+	ParallelFor(n, [&](int begin, int end) {
+		int i = begin;
+#ifdef BATCH_SSE
+		for (; i+4 <= end; i += 4) {
+			vec3x4 p1, p2, p3;
+			Corners(points, triangles+i, p1, p2, p3);
+			vec3x4 e1 = Unit(Sub(p2, p1)), e2 = Unit(Sub(p3, p2)), e3 = Unit(Sub(p1, p3));
+			__m128 neg = _mm_set1_ps(-0.f);
+			__m128 a1 = Acos(_mm_xor_ps(Dot(e1, e3), neg));
+			__m128 a2 = Acos(_mm_xor_ps(Dot(e2, e1), neg));
+			__m128 a3 = Acos(_mm_xor_ps(Dot(e3, e2), neg));
+			// a1, a2, a3 are corners 1, 2, 3 of the four triangles; out is ordered by triangle
+			float f[3][4];
+			_mm_storeu_ps(f[0], a1); _mm_storeu_ps(f[1], a2); _mm_storeu_ps(f[2], a3);
+			for (int k = 0; k < 4; k++)
+				for (int c = 0; c < 3; c++)
+					out[3*(i+k)+c] = f[c][k];
+		}
+#endif
+		for (; i < end; i++) {
+			const int3 &t = triangles[i];
+			vec3 p[] = { points[t.i1], points[t.i2], points[t.i3] };
+			for (int c = 0; c < 3; c++) {
+				vec3 u = p[(c+1)%3]-p[c], v = p[(c+2)%3]-p[c];
+				float lu = length(u), lv = length(v), d = lu > 0 && lv > 0? dot(u, v)/(lu*lv) : 0;
+				out[3*i+c] = acos(d < -1? -1 : d > 1? 1 : d);
+			}
+		}
+	}, MinChunk);
+}
@@ -0,0 +1,156 @@
+// CornerTable.cpp - index-based triangle connectivity: vertex to triangle adjacency, opposite corners
+
+#include "CornerTable.h"
+#include "Parallel.h"
+#include <atomic>
+#include <stdio.h>
+
+// Vertex to Triangle Adjacency
+
+void VertexTriangles::Build(const vector<int3> &triangles, int nVertices) {
+	// counting sort of triangle corners by vertex
+	int nCorners = 3*(int) triangles.size();
+	const int *v = (const int *) triangles.data();
+	offsets.assign(nVertices+1, 0);
+	for (int c = 0; c < nCorners; c++)
+		offsets[v[c]+1]++;
+	for (int i = 0; i < nVertices; i++)
+		offsets[i+1] += offsets[i];
+	vector<int> next(offsets.begin(), offsets.end()-1);
+	corners.resize(nCorners);
+	for (int c = 0; c < nCorners; c++)
+		corners[next[v[c]]++] = c;
+}
+
+// Build
+
+void CornerTable::Build(const vector<int3> &triangles, int nVertices) {
+	double start = TimeMs();
+	int nCorners = 3*(int) triangles.size();
+	const int *v = (const int *) triangles.data();
+	vertices.assign(v, v+nCorners);
+	if (!vertexCorners.Current(nVertices, (int) triangles.size()))
+		vertexCorners.Build(triangles, nVertices);
+	opposite.resize(nCorners);
+	// the edge facing corner c runs n->p; every triangle on that edge has a corner at n, so scanning
+	// the corners at n finds them all: same-direction edges (n->p, c's own included) and reversed
+	// (p->n); the corners c facing edges from n are Prev of the corners at n, so each vertex settles
+	// its own outgoing edges with no locks, atomics, or hash of edge keys
+	std::atomic<int> boundary(0), nonManifold(0);
+	const int *offsets = vertexCorners.offsets.data(), *corners = vertexCorners.corners.data();
+	ParallelFor(nVertices, [&](int begin, int end) {
+		int nb = 0, nm = 0;
+		vector<int> nexts, prevs;
+		for (int n = begin; n < end; n++) {
+			const int *e = corners+offsets[n];
+			int valence = offsets[n+1]-offsets[n];
+			nexts.resize(valence);
+			prevs.resize(valence);
+			for (int k = 0; k < valence; k++) {
+				nexts[k] = v[Next(e[k])];
+				prevs[k] = v[Prev(e[k])];
+			}
+			for (int k = 0; k < valence; k++) {
+				int c = Prev(e[k]), p = nexts[k], nSame = 0, nReversed = 0, o = Boundary, first = c;
+				for (int j = 0; j < valence; j++) {
+					if (nexts[j] == p) {
+						nSame++;
+						first = Prev(e[j]) < first? Prev(e[j]) : first;
+					}
+					if (prevs[j] == p) {
+						nReversed++;
+						o = Next(e[j]);
+						first = o < first? o : first;
+					}
+				}
+				opposite[c] = n == p || nSame > 1 || nReversed > 1? NonManifold : nReversed? o : Boundary;
+				nb += opposite[c] == Boundary;
+				nm += opposite[c] == NonManifold && first == c; // count each edge once, at its lowest corner
+			}
+		}
+		boundary += nb;
+		nonManifold += nm;
+	}, 4096);
+	nBoundaryEdges = boundary;
+	nNonManifoldEdges = nonManifold;
+	buildMs = (float) (TimeMs()-start);
+}
+
+void CornerTable::Clear() {
+	vertices.resize(0);
+	opposite.resize(0);
+	vertexCorners.Clear();
+	nBoundaryEdges = nNonManifoldEdges = 0;
+}
+
+// Queries
+
+void CornerTable::OneRing(int v, vector<int> &neighbors) const {
+	neighbors.resize(0);
+	const int *c = Corners(v);
+	for (int i = 0, n = Valence(v); i < n; i++)
+		for (int w : { vertices[Next(c[i])], vertices[Prev(c[i])] }) {
+			int k = 0, nNeighbors = (int) neighbors.size();
+			while (k < nNeighbors && neighbors[k] != w)
+				k++;
+			if (k == nNeighbors && w != v)
+				neighbors.push_back(w);
+		}
+}
+
+bool CornerTable::IsBoundary(int v) const {
+	// the edges at the corner c of v face Next(c) and Prev(c)
+	const int *c = Corners(v);
+	for (int i = 0, n = Valence(v); i < n; i++)
+		if (opposite[Next(c[i])] == Boundary || opposite[Prev(c[i])] == Boundary)
+			return true;
+	return false;
+}
+
+bool CornerTable::IsManifold(int v) const {
+	const int *c = Corners(v);
+	int n = Valence(v), start = n? c[0] : -1, nStarts = 0;
+	for (int i = 0; i < n; i++) {
+		if (opposite[Next(c[i])] == NonManifold || opposite[Prev(c[i])] == NonManifold)
+			return false;
+		// a fan starts where there is no triangle across the edge from v to Next(c)
+		if (opposite[Prev(c[i])] == Boundary) {
+			start = c[i];
+			nStarts++;
+		}
+	}
+	if (nStarts > 1)
+		return false;
+	// swing from start across the edge from Prev(c) to v; the fan must reach every corner at v
+	int count = 0;
+	for (int s = start; s >= 0 && count <= n; ) {
+		count++;
+		int o = opposite[Next(s)];
+		s = o < 0? -1 : Next(o);
+		if (s == start)
+			break;
+	}
+	return count == n;
+}
+
+// Memory
+
+namespace {
+
+template <class T> size_t Bytes(const vector<T> &v) { return v.capacity()*sizeof(T); }
+
+} // end namespace
+
+size_t CornerTable::Bytes() const {
+	const VertexTriangles &vt = vertexCorners;
+	return ::Bytes(vertices)+::Bytes(opposite)+::Bytes(vt.offsets)+::Bytes(vt.corners)+::Bytes(vt.triNormals)+::Bytes(vt.angles);
+}
+
+void CornerTable::Print() const {
+	int nv = NVertices() > 0? NVertices() : 0, nt = NTriangles();
+	size_t perVertex = ::Bytes(vertexCorners.offsets), perTriangle = Bytes()-perVertex;
+	printf("CornerTable: %i vertices, %i triangles, %i boundary and %i non-manifold edges\n",
+		   nv, nt, nBoundaryEdges, nNonManifoldEdges);
+	printf("  %.1f bytes/vertex + %.1f bytes/triangle (%.1f MB), built in %.1f ms\n",
+		   nv? (float) perVertex/nv : 0.f, nt? (float) perTriangle/nt : 0.f, Bytes()/(1024.f*1024.f), buildMs);
+}
@@ -0,0 +1,183 @@
+// Deformer.cpp - ordered stack of procedural deformations (wave, twist, bend, noise) applied to mesh points
+
+#include "Deformer.h"
+#include "Parallel.h"
+#include <math.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define DEFORMER_SSE
+#include <emmintrin.h>
+#endif
+
+// Deformers
+
+Deformer Wave(int axis, vec3 direction, float amplitude, float frequency, float phase) {
+	Deformer d;
+	d.type = WaveDeformer; d.axis = axis; d.direction = direction;
+	d.amplitude = amplitude; d.frequency = frequency; d.phase = phase;
+	return d;
+}
+
+Deformer Twist(int axis, float radiansPerUnit) {
+	Deformer d;
+	d.type = TwistDeformer; d.axis = axis; d.rate = radiansPerUnit;
+	return d;
+}
+
+Deformer Bend(int axis, int toward, float curvature) {
+	Deformer d;
+	d.type = BendDeformer; d.axis = axis; d.toward = toward; d.rate = curvature;
+	return d;
+}
+
+Deformer Noise(vec3 direction, float amplitude, float frequency, float phase) {
+	Deformer d;
+	d.type = NoiseDeformer; d.direction = direction;
+	d.amplitude = amplitude; d.frequency = frequency; d.phase = phase;
+	return d;
+}
+
+// Evaluation
+
+namespace {
+
+const int Block = 256;                      // points deformed in registers, then interleaved to the output
+const float TwoPi = 6.28318531f;
+
+// one lane type for scalar code and one for four points in SSE registers; Deform is written once for both
+
+inline float Mul(float a, float b) { return a*b; }
+inline float Add(float a, float b) { return a+b; }
+inline float Sub(float a, float b) { return a-b; }
+template <class F> F Set(float a);
+template <> inline float Set<float>(float a) { return a; }
+inline void SinCos(float x, float &s, float &c) { s = sinf(x); c = cosf(x); }
+inline float Sin(float x) { return sinf(x); }
+
+#ifdef DEFORMER_SSE
+
+inline __m128 Mul(__m128 a, __m128 b) { return _mm_mul_ps(a, b); }
+inline __m128 Add(__m128 a, __m128 b) { return _mm_add_ps(a, b); }
+inline __m128 Sub(__m128 a, __m128 b) { return _mm_sub_ps(a, b); }
+template <> inline __m128 Set<__m128>(float a) { return _mm_set1_ps(a); }
+
+inline void SinCos(__m128 x, __m128 &s, __m128 &c) {
+	// reduce to r in [-pi/4, pi/4] with quadrant j (x = j*pi/2+r, pi/2 in three parts), then
+	// minimax polynomials for sin and cos of r (as Cephes sinf, cosf; error about 1e-7 for |x| < 1e4)
+	__m128i j = _mm_cvtps_epi32(_mm_mul_ps(x, _mm_set1_ps(0.636619772f)));
+	__m128 fj = _mm_cvtepi32_ps(j);
+	__m128 r = _mm_sub_ps(x, _mm_mul_ps(fj, _mm_set1_ps(1.5703125f)));
+	r = _mm_sub_ps(r, _mm_mul_ps(fj, _mm_set1_ps(4.837512969970703125e-4f)));
+	r = _mm_sub_ps(r, _mm_mul_ps(fj, _mm_set1_ps(7.54978995489188216e-8f)));
+	__m128 r2 = _mm_mul_ps(r, r);
+	__m128 ps = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(-1.9515295891e-4f), r2), _mm_set1_ps(8.3321608736e-3f));
+	ps = _mm_add_ps(_mm_mul_ps(ps, r2), _mm_set1_ps(-1.6666654611e-1f));
+	ps = _mm_add_ps(r, _mm_mul_ps(_mm_mul_ps(ps, r2), r));
+	__m128 pc = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(2.443315711809948e-5f), r2), _mm_set1_ps(-1.388731625493765e-3f));
+	pc = _mm_add_ps(_mm_mul_ps(pc, r2), _mm_set1_ps(4.166664568298827e-2f));
+	pc = _mm_add_ps(_mm_sub_ps(_mm_set1_ps(1), _mm_mul_ps(r2, _mm_set1_ps(.5f))), _mm_mul_ps(_mm_mul_ps(pc, r2), r2));
+	// quadrant 1, 3: swap sin and cos; sin negated in quadrants 2, 3, cos in 1, 2
+	__m128 swap = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(j, _mm_set1_epi32(1)), _mm_set1_epi32(1)));
+	__m128 sinSign = _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(j, _mm_set1_epi32(2)), 30));
+	__m128 cosSign = _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(_mm_add_epi32(j, _mm_set1_epi32(1)), _mm_set1_epi32(2)), 30));
+	s = _mm_xor_ps(_mm_or_ps(_mm_and_ps(swap, pc), _mm_andnot_ps(swap, ps)), sinSign);
+	c = _mm_xor_ps(_mm_or_ps(_mm_and_ps(swap, ps), _mm_andnot_ps(swap, pc)), cosSign);
+}
+
+inline __m128 Sin(__m128 x) { __m128 s, c; SinCos(x, s, c); return s; }
+
+#endif
+
+template <class F> void Deform(const Deformer &d, F p[3]) {
+	int a = d.axis;
+	if (d.type == WaveDeformer || d.type == NoiseDeformer) {
+		F w = Set<F>(TwoPi*d.frequency), ph = Set<F>(d.phase), n;
+		if (d.type == WaveDeformer)
+			n = Sin(Add(Mul(w, p[a]), ph));
+		else
+			n = Mul(Mul(Sin(Add(Mul(w, Add(p[0], Mul(Set<F>(.53f), p[1]))), ph)),
+						Sin(Add(Mul(w, Sub(Mul(Set<F>(1.31f), p[1]), Mul(Set<F>(.41f), p[2]))), Mul(Set<F>(1.7f), ph)))),
+						Sin(Add(Mul(w, Add(Mul(Set<F>(.87f), p[2]), Mul(Set<F>(.69f), p[0]))), Mul(Set<F>(.6f), ph))));
+		n = Mul(Set<F>(d.amplitude), n);
+		for (int k = 0; k < 3; k++)
+			p[k] = Add(p[k], Mul(Set<F>(d.direction[k]), n));
+	}
+	if (d.type == TwistDeformer) {
+		int u = (a+1)%3, v = (a+2)%3;
+		F s, c, pu = p[u], pv = p[v];
+		SinCos(Mul(Set<F>(d.rate), p[a]), s, c);
+		p[u] = Sub(Mul(c, pu), Mul(s, pv));
+		p[v] = Add(Mul(s, pu), Mul(c, pv));
+	}
+	if (d.type == BendDeformer && d.rate != 0 && d.toward != a) {
+		// Barr's bend: p[axis] = 0 is fixed, the axis becomes an arc about (toward = 1/curvature)
+		int b = d.toward;
+		F s, c, r = Set<F>(1/d.rate), dist = Sub(r, p[b]);
+		SinCos(Mul(Set<F>(d.rate), p[a]), s, c);
+		p[a] = Mul(s, dist);
+		p[b] = Sub(r, Mul(c, dist));
+	}
+}
+
+} // end namespace
+
+// Stack
+
+void DeformerStack::SetRest(const vector<vec3> &pts, const vector<int3> *tris) {
+	nPoints = (int) pts.size();
+	ToSoA(pts.data(), nPoints, rest);
+	rest.resize((nPoints+3)/4*4);
+	triangles.resize(0);
+	if (tris)
+		triangles = *tris;
+	adjacency.Clear();
+}
+
+void DeformerStack::Apply() {
+	double start = TimeMs();
+	int back = 1-front;
+	vector<vec3> &out = points[back];
+	out.resize(nPoints);
+	const float *x = rest.x.data(), *y = rest.y.data(), *z = rest.z.data();
+	int nDeformers = (int) deformers.size();
+	const Deformer *ds = deformers.data();
+	ParallelFor((nPoints+Block-1)/Block, [&](int b0, int b1) {
+		float bx[Block], by[Block], bz[Block];
+		for (int b = b0; b < b1; b++) {
+			int begin = b*Block, n = begin+Block < nPoints? Block : nPoints-begin;
+#ifdef DEFORMER_SSE
+			// rest is padded, so whole groups of four may be read past nPoints
+			for (int i = 0; i < n; i += 4) {
+				__m128 p[] = { _mm_loadu_ps(x+begin+i), _mm_loadu_ps(y+begin+i), _mm_loadu_ps(z+begin+i) };
+				for (int k = 0; k < nDeformers; k++)
+					Deform(ds[k], p);
+				_mm_storeu_ps(bx+i, p[0]); _mm_storeu_ps(by+i, p[1]); _mm_storeu_ps(bz+i, p[2]);
+			}
+#else
+			for (int i = 0; i < n; i++) {
+				float p[] = { x[begin+i], y[begin+i], z[begin+i] };
+				for (int k = 0; k < nDeformers; k++)
+					Deform(ds[k], p);
+				bx[i] = p[0]; by[i] = p[1]; bz[i] = p[2];
+			}
+#endif
+			ToAoS(bx, by, bz, n, out.data()+begin);
+		}
+	}, 16);
+	double mid = TimeMs();
+	deformMs = (float) (mid-start);
+	normalsMs = 0;
+	if (setNormals && triangles.size()) {
+		SetVertexNormals(out, triangles, adjacency, normals[back], weight);
+		normalsMs = (float) (TimeMs()-mid);
+	}
+	front = back;
+}
+
+void DeformerStack::Apply(Mesh &m) {
+	Apply();
+	m.OwnGeometry();
+	m.points.swap(points[front]);
+	if (setNormals && triangles.size())
+		m.normals.swap(normals[front]);
+}
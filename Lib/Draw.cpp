@@ -2,6 +2,7 @@
 
 #include <glad.h>
 #include <gl/glu.h>
+#include "Arena.h"
 #include "Draw.h"
 #include "GLXtras.h"
 #include "Misc.h"
@@ -341,7 +342,8 @@ void LineStrip(int nPoints, vec3 *points, vec3 &color, float opacity, float widt
 		glGenBuffers(1, &lineStripBuffer);
 	glBindBuffer(GL_ARRAY_BUFFER, lineStripBuffer);
 	int pSize = nPoints*sizeof(vec3);
-	std::vector<vec3> colors(nPoints, color);
+	ArenaScope scope;
+	ArenaVector<vec3> colors(nPoints, color);
 	glBufferData(GL_ARRAY_BUFFER, 2*pSize, NULL, GL_STATIC_DRAW);
 	glBufferSubData(GL_ARRAY_BUFFER, 0, pSize, points);
 	glBufferSubData(GL_ARRAY_BUFFER, pSize, pSize, &colors[0]);
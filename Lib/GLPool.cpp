@@ -0,0 +1,210 @@
+// GLPool.cpp - pooled GL buffers, vertex arrays and textures, with live counts and bytes
+
+#include "GLPool.h"
+#include <algorithm>
+#include <stdio.h>
+
+GLPool &glPool = *new GLPool();
+
+namespace {
+
+long long SizeClass(GLsizeiptr size) {
+	// smallest of 4, 5, 6 or 7 times a power of two (at least 256) that holds size
+	long long c = 256;
+	while (c < size)
+		c *= 2;
+	if (c == 256)
+		return c;
+	long long step = c/8;
+	return (size+step-1)/step*step;
+}
+
+int BytesPerTexel(GLenum format) {
+	switch (format) {
+		case GL_RED: case GL_R8: return 1;
+		case GL_RG: case GL_RG8: return 2;
+		case GL_RGB: case GL_RGB8: return 3;
+		default: return 4;
+	}
+}
+
+} // end namespace
+
+// Live objects
+
+GLPool::Object *GLPool::Find(Kind k, GLuint id) {
+	return id && id < live[k].size() && live[k][id].live? &live[k][id] : NULL;
+}
+
+void GLPool::Track(Kind k, GLuint id, Class c, size_t bytes) {
+	if (id >= live[k].size())
+		live[k].resize(id+1, { Class(), 0, false });
+	live[k][id] = { c, bytes, true };
+}
+
+// Acquire
+
+GLuint GLPool::Reuse(Class c, size_t bytes) {
+	auto p = pooled.find(c);
+	if (p == pooled.end() || p->second.empty())
+		return 0;
+	GLuint id = p->second.back();
+	p->second.pop_back();
+	counts.pooled--;
+	counts.pooledBytes -= bytes;
+	counts.reused++;
+	return id;
+}
+
+GLuint GLPool::AcquireBuffer(GLenum target, GLsizeiptr size, GLenum usage) {
+	GLuint id = 0;
+	ResizeBuffer(id, target, size, usage);
+	return id;
+}
+
+bool GLPool::ResizeBuffer(GLuint &buffer, GLenum target, GLsizeiptr size, GLenum usage) {
+	long long capacity = SizeClass(size);
+	Object *o = Find(Buffer, buffer);
+	if (o && std::get<2>(o->type) == (int) usage && (GLsizeiptr) o->bytes >= size && (long long) o->bytes <= 2*capacity) {
+		glBindBuffer(target, buffer);
+		return false;
+	}
+	ReleaseBuffer(buffer);
+	Class c(Buffer, capacity, (int) usage, 0);
+	bool allocate = !(buffer = Reuse(c, (size_t) capacity));
+	if (allocate) {
+		glGenBuffers(1, &buffer);
+		counts.generated++;
+	}
+	glBindBuffer(target, buffer);
+	if (allocate) {
+		glBufferData(target, (GLsizeiptr) capacity, NULL, usage);
+		counts.allocations++;
+	}
+	Track(Buffer, buffer, c, (size_t) capacity);
+	counts.buffers++;
+	counts.bufferBytes += (size_t) capacity;
+	return allocate;
+}
+
+GLsizeiptr GLPool::Capacity(GLuint buffer) const {
+	return buffer && buffer < live[Buffer].size() && live[Buffer][buffer].live? (GLsizeiptr) live[Buffer][buffer].bytes : 0;
+}
+
+GLuint GLPool::AcquireVertexArray() {
+	Class c(VertexArray, 0, 0, 0);
+	GLuint id = Reuse(c, 0);
+	if (id) {
+		// clear state left by the last holder
+		GLint nAttributes = 16;
+		glGetIntegerv(GL_MAX_VERTEX_ATTRIBS, &nAttributes);
+		glBindVertexArray(id);
+		for (int i = 0; i < nAttributes; i++) {
+			glDisableVertexAttribArray(i);
+			glVertexAttribDivisor(i, 0);
+		}
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+		glBindVertexArray(0);
+	}
+	else {
+		glGenVertexArrays(1, &id);
+		counts.generated++;
+	}
+	Track(VertexArray, id, c, 0);
+	counts.vertexArrays++;
+	return id;
+}
+
+GLuint GLPool::AcquireTexture(int width, int height, GLenum internalFormat, bool mipmap) {
+	size_t bytes = (size_t) width*height*BytesPerTexel(internalFormat)*(mipmap? 4 : 3)/3;
+	Class c(Texture, (long long) width << 32 | (unsigned) height, (int) internalFormat, mipmap);
+	GLuint id = Reuse(c, bytes);
+	if (!id) {
+		glGenTextures(1, &id);
+		counts.generated++;
+	}
+	Track(Texture, id, c, bytes);
+	counts.textures++;
+	counts.textureBytes += bytes;
+	return id;
+}
+
+// Release
+
+void GLPool::Delete(int kind, GLuint id) {
+	if (kind == Buffer) glDeleteBuffers(1, &id);
+	if (kind == VertexArray) glDeleteVertexArrays(1, &id);
+	if (kind == Texture) glDeleteTextures(1, &id);
+	counts.deleted++;
+}
+
+void GLPool::Release(Kind k, GLuint &id) {
+	if (!id)
+		return;
+	Object *l = Find(k, id);
+	if (!l)
+		Delete(k, id);							// not acquired here
+	else {
+		Object o = *l;
+		l->live = false;
+		if (k == Buffer) { counts.buffers--; counts.bufferBytes -= o.bytes; }
+		if (k == VertexArray) counts.vertexArrays--;
+		if (k == Texture) { counts.textures--; counts.textureBytes -= o.bytes; }
+		if (counts.pooled < maxPooled && counts.pooledBytes+o.bytes <= maxPooledBytes) {
+			pooled[o.type].push_back(id);
+			counts.pooled++;
+			counts.pooledBytes += o.bytes;
+		}
+		else
+			Delete(k, id);
+	}
+	id = 0;
+}
+
+void GLPool::ReleaseBuffer(GLuint &buffer) { Release(Buffer, buffer); }
+
+void GLPool::ReleaseVertexArray(GLuint &vertexArray) { Release(VertexArray, vertexArray); }
+
+void GLPool::ReleaseTexture(GLuint &texture) { Release(Texture, texture); }
+
+void GLPool::Trim(size_t bytes) {
+	// order classes by the bytes of one object, buffers and textures alike, then delete from the largest;
+	// vertex arrays (no storage) only if trimming to 0
+	std::vector<std::pair<size_t, Class>> classes;
+	for (auto &p : pooled) {
+		const Class &c = p.first;
+		int kind = std::get<0>(c);
+		size_t size = kind == Buffer? (size_t) std::get<1>(c) : 0;
+		if (kind == Texture) {
+			int w = (int) (std::get<1>(c) >> 32), h = (int) (std::get<1>(c) & 0xffffffff);
+			size = (size_t) w*h*BytesPerTexel((GLenum) std::get<2>(c))*(std::get<3>(c)? 4 : 3)/3;
+		}
+		if (!p.second.empty() && (size || !bytes))
+			classes.push_back(std::make_pair(size, c));
+	}
+	std::sort(classes.begin(), classes.end(), [](const std::pair<size_t, Class> &a, const std::pair<size_t, Class> &b) {
+		return a.first > b.first; });
+	for (auto &sc : classes) {
+		std::vector<GLuint> &ids = pooled[sc.second];
+		while (!ids.empty() && (counts.pooledBytes > bytes || !bytes)) {
+			Delete(std::get<0>(sc.second), ids.back());
+			ids.pop_back();
+			counts.pooled--;
+			counts.pooledBytes -= sc.first;
+		}
+	}
+}
+
+// Counts
+
+GLPoolCounts GLPool::Counts() const {
+	return counts;
+}
+
+void GLPool::Print() const {
+	const GLPoolCounts &c = counts;
+	printf("GLPool: live %i buffers (%.2f MB), %i vertex arrays, %i textures (%.2f MB)\n",
+		   c.buffers, c.bufferBytes/(1024.f*1024.f), c.vertexArrays, c.textures, c.textureBytes/(1024.f*1024.f));
+	printf("  pooled %i (%.2f MB); %i generated, %i reused, %i deleted, %i allocations\n",
+		   c.pooled, c.pooledBytes/(1024.f*1024.f), c.generated, c.reused, c.deleted, c.allocations);
+}
@@ -0,0 +1,372 @@
+// Lightmap.cpp - baked and cached shadows for static receivers
+
+#include "Arena.h"
+#include "Lightmap.h"
+#include "Parallel.h"
+#include <float.h>
+
+namespace {
+
+vec3 XformPoint(mat4 &m, vec3 p) { vec4 v = m*vec4(p, 1); return vec3(v.x, v.y, v.z); }
+
+void Bounds(const vector<vec3> &pts, mat4 &m, vec3 &min, vec3 &max) {
+	min = vec3(FLT_MAX);
+	max = vec3(-FLT_MAX);
+	for (size_t i = 0; i < pts.size(); i++) {
+		vec3 p = XformPoint(m, pts[i]);
+		for (int k = 0; k < 3; k++) {
+			if (p[k] < min[k]) min[k] = p[k];
+			if (p[k] > max[k]) max[k] = p[k];
+		}
+	}
+}
+
+bool SameMatrix(mat4 &a, mat4 &b) {
+	for (int i = 0; i < 4; i++)
+		for (int j = 0; j < 4; j++)
+			if (a[i][j] != b[i][j])
+				return false;
+	return true;
+}
+
+unsigned int Hash(unsigned int x) {
+	x ^= x >> 16; x *= 0x7feb352d;
+	x ^= x >> 15; x *= 0x846ca68b;
+	return x ^ (x >> 16);
+}
+
+} // end namespace
+
+// Shadow Change Tracking
+
+bool ShadowFootprint(vec3 bmin, vec3 bmax, vec3 light, float lightRadius,
+					 vec3 planeOrigin, vec3 planeN, vec3 planeU, vec3 planeV, vec2 &rmin, vec2 &rmax) {
+	rmin = vec2(FLT_MAX, FLT_MAX);
+	rmax = vec2(-FLT_MAX, -FLT_MAX);
+	// orient the normal toward the light, so the result doesn't depend on the receiver's winding
+	if (dot(light-planeOrigin, planeN) < 0)
+		planeN = -planeN;
+	int nLights = lightRadius > 0? 8 : 1;
+	for (int l = 0; l < nLights; l++) {
+		vec3 lp = light;
+		if (nLights > 1)
+			lp += lightRadius*vec3(l&1? 1.f : -1.f, l&2? 1.f : -1.f, l&4? 1.f : -1.f);
+		float lHeight = dot(lp-planeOrigin, planeN);
+		for (int c = 0; c < 8; c++) {
+			vec3 corner(c&1? bmax.x : bmin.x, c&2? bmax.y : bmin.y, c&4? bmax.z : bmin.z);
+			float cHeight = dot(corner-planeOrigin, planeN);
+			// shadow cast onto plane only if corner lies between light and plane
+			if (lHeight <= 0 || cHeight <= 0 || cHeight >= lHeight)
+				return false;
+			float t = lHeight/(lHeight-cHeight);
+			vec3 d = lp+t*(corner-lp)-planeOrigin;
+			vec2 q(dot(d, planeU), dot(d, planeV));
+			rmin = vec2(fmin(rmin.x, q.x), fmin(rmin.y, q.y));
+			rmax = vec2(fmax(rmax.x, q.x), fmax(rmax.y, q.y));
+		}
+	}
+	return true;
+}
+
+bool ShadowTracker::SetLight(vec3 l, float radius) {
+	if (radius == lightRadius && l.x == light.x && l.y == light.y && l.z == light.z)
+		return false;
+	light = l;
+	lightRadius = radius;
+	for (size_t i = 0; i < receivers.size(); i++)
+		receivers[i]->Invalidate();
+	return true;
+}
+
+bool ShadowTracker::SetOccluder(Mesh *o) {
+	if (o == occluder && SameMatrix(o->transform, occluderTransform))
+		return false;
+	vec3 newMin, newMax;
+	Bounds(o->Points(), o->transform, newMin, newMax);
+	for (size_t i = 0; i < receivers.size(); i++) {
+		if (occluder == o)
+			receivers[i]->Invalidate(occluderMin, occluderMax, light, lightRadius);
+		else
+			receivers[i]->Invalidate();
+		receivers[i]->Invalidate(newMin, newMax, light, lightRadius);
+	}
+	occluder = o;
+	occluderTransform = o->transform;
+	occluderMin = newMin;
+	occluderMax = newMax;
+	return true;
+}
+
+// Lightmap
+
+void Lightmap::Init(Mesh *r, int resolution) {
+	receiver = r;
+	res = resolution;
+	nTiles = (res+TileSize-1)/TileSize;
+	int nTexels = res*res;
+	visibility.assign(nTexels, 255);
+	texelPoints.assign(nTexels, vec3());
+	texelNormals.assign(nTexels, vec3(0, 0, 1));
+	texelPlanar.assign(nTexels, vec2());
+	texelValid.assign(nTexels, 0);
+	// rasterize receiver triangles (and quads as triangle pairs) in uv space
+	const vector<vec3> &points = r->Points();
+	const vector<vec2> &uvs = r->Uvs();
+	vector<int3> tris = r->Triangles();
+	for (const int4 &q : r->Quads()) {
+		tris.push_back(int3(q.i1, q.i2, q.i3));
+		tris.push_back(int3(q.i1, q.i3, q.i4));
+	}
+	if (uvs.size() != points.size()) {
+		printf("Lightmap.Init: receiver has no uvs\n");
+		tris.resize(0);
+	}
+	mat4 &m = r->transform;
+	for (size_t t = 0; t < tris.size(); t++) {
+		int3 &tri = tris[t];
+		vec2 t1 = uvs[tri.i1], t2 = uvs[tri.i2], t3 = uvs[tri.i3];
+		vec3 p1 = XformPoint(m, points[tri.i1]), p2 = XformPoint(m, points[tri.i2]), p3 = XformPoint(m, points[tri.i3]);
+		vec3 n = normalize(cross(p2-p1, p3-p2));
+		float area = cross(t2-t1, t3-t1);
+		if (fabs(area) < FLT_EPSILON)
+			continue;
+		float umin = fmin(t1.x, fmin(t2.x, t3.x)), umax = fmax(t1.x, fmax(t2.x, t3.x));
+		float vmin = fmin(t1.y, fmin(t2.y, t3.y)), vmax = fmax(t1.y, fmax(t2.y, t3.y));
+		int i0 = (int) floor(umin*res), i1 = (int) ceil(umax*res), j0 = (int) floor(vmin*res), j1 = (int) ceil(vmax*res);
+		for (int j = j0 < 0? 0 : j0; j < res && j <= j1; j++)
+			for (int i = i0 < 0? 0 : i0; i < res && i <= i1; i++) {
+				vec2 uv((i+.5f)/res, (j+.5f)/res);
+				float a = cross(t2-uv, t3-uv)/area, b = cross(t3-uv, t1-uv)/area, c = 1-a-b;
+				float e = -.5f/res;             // admit texel centers just outside edge (avoids seams)
+				if (a < e || b < e || c < e)
+					continue;
+				int id = j*res+i;
+				texelPoints[id] = a*p1+b*p2+c*p3;
+				texelNormals[id] = n;
+				texelValid[id] = 1;
+			}
+	}
+	// test receiver planarity, set plane axes
+	planar = false;
+	for (int id = 0; id < nTexels && !planar; id++)
+		if (texelValid[id]) {
+			planar = true;
+			planeOrigin = texelPoints[id];
+			planeN = texelNormals[id];
+		}
+	if (planar) {
+		planeU = normalize(cross(planeN, fabs(planeN.x) < .9f? vec3(1, 0, 0) : vec3(0, 1, 0)));
+		planeV = cross(planeN, planeU);
+		float tolerance = .001f;
+		for (int id = 0; id < nTexels; id++)
+			if (texelValid[id]) {
+				vec3 d = texelPoints[id]-planeOrigin;
+				if (fabs(dot(d, planeN)) > tolerance)
+					planar = false;
+				texelPlanar[id] = vec2(dot(d, planeU), dot(d, planeV));
+			}
+	}
+	// create texture (a pooled one of this size, if any)
+	glPool.ReleaseTexture(textureName);
+	textureName = glPool.AcquireTexture(res, res, GL_R8);
+	glBindTexture(GL_TEXTURE_2D, textureName);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, res, res, 0, GL_RED, GL_UNSIGNED_BYTE, visibility.data());
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	dirty.assign(nTiles*nTiles, 0);
+	Invalidate();
+	memory.Name("lightmap "+r->objFilename);
+	memory.Set(MemTexture, (size_t) res*res);
+	memory.Set(MemCpuOther, visibility.capacity()+texelPoints.capacity()*sizeof(vec3)+texelNormals.capacity()*sizeof(vec3)+
+			   texelPlanar.capacity()*sizeof(vec2)+texelValid.capacity()+dirty.capacity());
+}
+
+void Lightmap::Invalidate() {
+	for (size_t i = 0; i < dirty.size(); i++)
+		dirty[i] = 1;
+	nDirty = (int) dirty.size();
+}
+
+void Lightmap::Invalidate(vec3 bmin, vec3 bmax, vec3 light, float lightRadius) {
+	if (!planar) {
+		Invalidate();
+		return;
+	}
+	vec2 rmin, rmax;
+	if (!ShadowFootprint(bmin, bmax, light, lightRadius, planeOrigin, planeN, planeU, planeV, rmin, rmax)) {
+		Invalidate();
+		return;
+	}
+	for (int id = 0; id < res*res; id++) {
+		vec2 &q = texelPlanar[id];
+		if (texelValid[id] && q.x >= rmin.x && q.x <= rmax.x && q.y >= rmin.y && q.y <= rmax.y) {
+			int tile = ((id/res)/TileSize)*nTiles+(id%res)/TileSize;
+			if (!dirty[tile]) {
+				dirty[tile] = 1;
+				nDirty++;
+			}
+		}
+	}
+}
+
+void Lightmap::Upload() {
+	if (!changed || !textureName)
+		return;
+	glBindTexture(GL_TEXTURE_2D, textureName);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, res, res, GL_RED, GL_UNSIGNED_BYTE, visibility.data());
+	changed = false;
+}
+
+// Baker
+
+LightmapBaker::~LightmapBaker() {
+	for (size_t i = 0; i < maps.size(); i++)
+		delete maps[i];
+}
+
+Lightmap *LightmapBaker::Add(Mesh *receiver, int res) {
+	Lightmap *m = new Lightmap();
+	m->Init(receiver, res);
+	maps.push_back(m);
+	tracker.receivers.push_back(m);
+	return m;
+}
+
+Lightmap *LightmapBaker::Find(Mesh *receiver) {
+	for (size_t i = 0; i < maps.size(); i++)
+		if (maps[i]->receiver == receiver)
+			return maps[i];
+	return NULL;
+}
+
+void LightmapBaker::SetLight(vec3 l, float radius) {
+	if (!tracker.SetLight(l, radius) && (int) lightOffsets.size() == nSamples)
+		return;
+	// first sample at light center (as in the shader), remainder spread over sphere (golden spiral)
+	lightOffsets.resize(nSamples > 0? nSamples : 1);
+	for (int i = 1; i < (int) lightOffsets.size(); i++) {
+		float z = 1-2*(i-.5f)/(nSamples-1), r = sqrt(fmax(0.f, 1-z*z)), a = 2.39996323f*i;
+		lightOffsets[i] = radius*vec3(r*cos(a), r*sin(a), z);
+	}
+	for (size_t i = 0; i < maps.size(); i++)       // tracker skips this if only nSamples changed
+		maps[i]->Invalidate();
+}
+
+void LightmapBaker::SetOccluder(Mesh *o) {
+	if (tracker.SetOccluder(o))
+		occluder.Prepare(*o, o->transform);     // transform occluder once, not per ray
+}
+
+void LightmapBaker::BakeTile(Lightmap *m, int tile) {
+	int ti = tile%m->nTiles, tj = tile/m->nTiles, nLights = (int) lightOffsets.size();
+	vec3 light = tracker.light;
+	for (int j = tj*Lightmap::TileSize; j < (tj+1)*Lightmap::TileSize && j < m->res; j++)
+		for (int i = ti*Lightmap::TileSize; i < (ti+1)*Lightmap::TileSize && i < m->res; i++) {
+			int id = j*m->res+i;
+			if (!m->texelValid[id])
+				continue;
+			vec3 p = m->texelPoints[id]+.0001f*m->texelNormals[id]; // avoid self-blocking
+			// rotate the sample set per texel so banding becomes noise
+			int rot = (int) (Hash(id)%(nLights > 1? nLights-1 : 1)), nLit = 0;
+			for (int k = 0; k < nLights; k++) {
+				int s = k == 0? 0 : 1+(k-1+rot)%(nLights-1);
+				if (!occluder.Intersect(p, light+lightOffsets[s]))
+					nLit++;
+			}
+			m->visibility[id] = (unsigned char) (255.f*nLit/nLights+.5f);
+		}
+}
+
+int LightmapBaker::Update() {
+	if (!tracker.occluder || tracker.lightRadius < 0)
+		return 0;
+	double start = TimeMs();
+	int nBaked = 0, batch = 4*NumThreads();
+	struct Job { Lightmap *m; int tile; };
+	ArenaScope scope;
+	ArenaVector<Job> jobs;
+	for (size_t i = 0; i < maps.size(); i++)
+		for (int t = 0; t < (int) maps[i]->dirty.size(); t++)
+			if (maps[i]->dirty[t])
+				jobs.push_back({maps[i], t});
+	// bake in batches of tiles, checking the budget between batches
+	for (int b = 0; b < (int) jobs.size() && TimeMs()-start < budgetMs; b += batch) {
+		int n = (int) jobs.size()-b < batch? (int) jobs.size()-b : batch;
+		ParallelFor(n, [&](int begin, int end) {
+			for (int k = begin; k < end; k++)
+				BakeTile(jobs[b+k].m, jobs[b+k].tile);
+		}, 1);
+		for (int k = b; k < b+n; k++) {
+			Lightmap *m = jobs[k].m;
+			m->dirty[jobs[k].tile] = 0;
+			m->nDirty--;
+			m->changed = true;
+			nBaked += Lightmap::TileSize*Lightmap::TileSize;
+		}
+	}
+	for (size_t i = 0; i < maps.size(); i++)
+		maps[i]->Upload();
+	return nBaked;
+}
+
+bool LightmapBaker::Done() {
+	for (size_t i = 0; i < maps.size(); i++)
+		if (maps[i]->nDirty)
+			return false;
+	return true;
+}
+
+// Shadow Grid
+
+void ShadowGrid::Init(vec3 p1, vec3 p2, vec3 p3, vec3 p4, int resolution) {
+	res = resolution;
+	int n = res*res;
+	points.resize(n);
+	planar.resize(n);
+	values.assign(n, 0);
+	planeOrigin = p1;
+	planeU = normalize(p2-p1);
+	planeN = normalize(cross(p2-p1, p4-p1));
+	planeV = cross(planeN, planeU);
+	for (int i = 0; i < res; i++)
+		for (int j = 0; j < res; j++) {
+			float s = (float) i/(res-1), t = (float) j/(res-1);
+			vec3 a = p1+s*(p2-p1), b = p4+s*(p3-p4), p = a+t*(b-a), d = p-planeOrigin;
+			points[i*res+j] = p;
+			planar[i*res+j] = vec2(dot(d, planeU), dot(d, planeV));
+		}
+	Invalidate();
+}
+
+void ShadowGrid::Invalidate() {
+	stale.assign(points.size(), 1);
+}
+
+void ShadowGrid::Invalidate(vec3 bmin, vec3 bmax, vec3 light, float lightRadius) {
+	vec2 rmin, rmax;
+	if (!ShadowFootprint(bmin, bmax, light, lightRadius, planeOrigin, planeN, planeU, planeV, rmin, rmax)) {
+		Invalidate();
+		return;
+	}
+	for (size_t i = 0; i < points.size(); i++) {
+		vec2 &q = planar[i];
+		if (q.x >= rmin.x && q.x <= rmax.x && q.y >= rmin.y && q.y <= rmax.y)
+			stale[i] = 1;
+	}
+}
+
+void ShadowGrid::Update(std::function<float(vec3 p)> trace) {
+	nReused = nRecomputed = 0;
+	for (size_t i = 0; i < points.size(); i++)
+		if (stale[i]) {
+			values[i] = trace(points[i]);
+			stale[i] = 0;
+			nRecomputed++;
+		}
+		else
+			nReused++;
+}
@@ -0,0 +1,231 @@
+// MemoryLedger.cpp - bytes held per owner and category, CPU and GPU, with high-water marks and JSON reports
+
+#include "MemoryLedger.h"
+#include "Arena.h"
+#include "GLPool.h"
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+
+MemoryLedger &memoryLedger = *new MemoryLedger();
+
+namespace {
+
+const char *categoryNames[] = {
+	"points", "normals", "uvs", "triangles", "quads", "cpuOther",
+	"vertexBuffer", "elementBuffer", "storageBuffer", "texture"
+};
+
+} // end namespace
+
+const char *MemoryCategoryName(int category) {
+	return category >= 0 && category < MemCategories? categoryNames[category] : "?";
+}
+
+size_t MemoryAccount::Cpu() const {
+	size_t sum = 0;
+	for (int c = 0; c < MemVertexBuffer; c++)
+		sum += bytes[c];
+	return sum;
+}
+
+size_t MemoryAccount::Gpu() const {
+	size_t sum = 0;
+	for (int c = MemVertexBuffer; c < MemCategories; c++)
+		sum += bytes[c];
+	return sum;
+}
+
+// Owners
+
+int MemoryLedger::Open(const string &name) {
+	int slot = (int) accounts.size();
+	if (freeSlots.size()) {
+		slot = freeSlots.back();
+		freeSlots.pop_back();
+	}
+	else {
+		accounts.resize(slot+1);
+		open.resize(slot+1);
+	}
+	MemoryAccount &a = accounts[slot];
+	a = MemoryAccount();
+	a.serial = ++serials;
+	a.name = name;
+	open[slot] = 1;
+	return slot;
+}
+
+void MemoryLedger::Rename(int owner, const string &name) {
+	accounts[owner].name = name;
+}
+
+void MemoryLedger::Set(int owner, MemoryCategory category, size_t bytes) {
+	MemoryAccount &a = accounts[owner];
+	size_t was = a.bytes[category];
+	if (bytes == was)
+		return;
+	a.bytes[category] = bytes;
+	totals[category] += bytes-was;				// unsigned wrap-around subtracts if smaller
+	size_t &side = GpuCategory(category)? gpu : cpu;
+	side += bytes-was;
+	if (bytes > was) {
+		highWater[category] = std::max(highWater[category], totals[category]);
+		cpuHighWater = std::max(cpuHighWater, cpu);
+		gpuHighWater = std::max(gpuHighWater, gpu);
+		a.peak = std::max(a.peak, a.Cpu()+a.Gpu());
+	}
+}
+
+void MemoryLedger::Close(int owner) {
+	for (int c = 0; c < MemCategories; c++)
+		Set(owner, (MemoryCategory) c, 0);
+	open[owner] = 0;
+	freeSlots.push_back(owner);
+}
+
+// Reports
+
+MemorySnapshot MemoryLedger::Snapshot() const {
+	MemorySnapshot s;
+	for (size_t i = 0; i < accounts.size(); i++)
+		if (open[i])
+			s.owners.push_back(accounts[i]);
+	std::sort(s.owners.begin(), s.owners.end(), [](const MemoryAccount &a, const MemoryAccount &b) {
+		return a.serial < b.serial; });
+	for (int c = 0; c < MemCategories; c++) {
+		s.totals[c] = totals[c];
+		s.highWater[c] = highWater[c];
+	}
+	s.cpu = cpu;
+	s.gpu = gpu;
+	s.cpuHighWater = cpuHighWater;
+	s.gpuHighWater = gpuHighWater;
+	GLPoolCounts p = glPool.Counts();
+	s.poolBufferBytes = p.bufferBytes;
+	s.poolTextureBytes = p.textureBytes;
+	s.poolIdleBytes = p.pooledBytes;
+	s.arenaCapacity = frameArena.Capacity();
+	s.arenaHighWater = frameArena.highWater;
+	s.heapAllocations = HeapAllocations();
+	return s;
+}
+
+namespace {
+
+string Quote(const string &s) {
+	string q = "\"";
+	for (char c : s) {
+		if (c == '"' || c == '\\')
+			q += '\\';
+		if ((unsigned char) c < ' ')
+			continue;
+		q += c;
+	}
+	return q+"\"";
+}
+
+string Number(long long n) {
+	char buf[32];
+	snprintf(buf, sizeof(buf), "%lld", n);
+	return buf;
+}
+
+string Categories(const size_t *bytes) {
+	string j = "{";
+	for (int c = 0; c < MemCategories; c++)
+		j += string(c? ", " : "")+Quote(categoryNames[c])+": "+Number((long long) bytes[c]);
+	return j+"}";
+}
+
+string CategoryDeltas(const size_t *before, const size_t *after) {
+	// nonzero differences only
+	string j = "{";
+	for (int c = 0; c < MemCategories; c++)
+		if (after[c] != before[c])
+			j += string(j.size() > 1? ", " : "")+Quote(categoryNames[c])+": "+Number((long long) after[c]-(long long) before[c]);
+	return j+"}";
+}
+
+string Owner(const MemoryAccount &a) {
+	return "{\"serial\": "+Number(a.serial)+", \"name\": "+Quote(a.name)+", \"cpu\": "+Number((long long) a.Cpu())+
+		   ", \"gpu\": "+Number((long long) a.Gpu())+", \"peak\": "+Number((long long) a.peak)+", \"bytes\": "+Categories(a.bytes)+"}";
+}
+
+} // end namespace
+
+string Json(const MemorySnapshot &s) {
+	string j = "{\n";
+	j += "  \"cpu\": "+Number((long long) s.cpu)+", \"gpu\": "+Number((long long) s.gpu)+
+		 ", \"cpuHighWater\": "+Number((long long) s.cpuHighWater)+", \"gpuHighWater\": "+Number((long long) s.gpuHighWater)+",\n";
+	j += "  \"totals\": "+Categories(s.totals)+",\n";
+	j += "  \"highWater\": "+Categories(s.highWater)+",\n";
+	j += "  \"glPool\": {\"bufferBytes\": "+Number((long long) s.poolBufferBytes)+", \"textureBytes\": "+
+		 Number((long long) s.poolTextureBytes)+", \"idleBytes\": "+Number((long long) s.poolIdleBytes)+"},\n";
+	j += "  \"frameArena\": {\"capacity\": "+Number((long long) s.arenaCapacity)+", \"highWater\": "+
+		 Number((long long) s.arenaHighWater)+"},\n";
+	j += "  \"heapAllocations\": "+Number(s.heapAllocations)+",\n";
+	j += "  \"owners\": [";
+	for (size_t i = 0; i < s.owners.size(); i++)
+		j += string(i? ",\n    " : "\n    ")+Owner(s.owners[i]);
+	return j+"\n  ]\n}\n";
+}
+
+string JsonDiff(const MemorySnapshot &before, const MemorySnapshot &after) {
+	string added, removed, changed;
+	auto Append = [](string &list, const string &item) { list += string(list.empty()? "\n    " : ",\n    ")+item; };
+	size_t b = 0, a = 0;
+	// owners are sorted by serial: merge
+	while (b < before.owners.size() || a < after.owners.size()) {
+		const MemoryAccount *ob = b < before.owners.size()? &before.owners[b] : NULL;
+		const MemoryAccount *oa = a < after.owners.size()? &after.owners[a] : NULL;
+		if (oa && (!ob || oa->serial < ob->serial)) {
+			Append(added, Owner(*oa));
+			a++;
+		}
+		else if (ob && (!oa || ob->serial < oa->serial)) {
+			Append(removed, Owner(*ob));
+			b++;
+		}
+		else {
+			if (memcmp(ob->bytes, oa->bytes, sizeof(oa->bytes)) || ob->name != oa->name)
+				Append(changed, "{\"serial\": "+Number(oa->serial)+", \"name\": "+Quote(oa->name)+", \"delta\": "+
+						CategoryDeltas(ob->bytes, oa->bytes)+"}");
+			a++;
+			b++;
+		}
+	}
+	string j = "{\n";
+	j += "  \"cpu\": "+Number((long long) after.cpu-(long long) before.cpu)+", \"gpu\": "+
+		 Number((long long) after.gpu-(long long) before.gpu)+",\n";
+	j += "  \"totals\": "+CategoryDeltas(before.totals, after.totals)+",\n";
+	j += "  \"glPool\": {\"bufferBytes\": "+Number((long long) after.poolBufferBytes-(long long) before.poolBufferBytes)+
+		 ", \"textureBytes\": "+Number((long long) after.poolTextureBytes-(long long) before.poolTextureBytes)+
+		 ", \"idleBytes\": "+Number((long long) after.poolIdleBytes-(long long) before.poolIdleBytes)+"},\n";
+	j += "  \"heapAllocations\": "+Number(after.heapAllocations-before.heapAllocations)+",\n";
+	j += "  \"added\": ["+added+(added.empty()? "" : "\n  ")+"],\n";
+	j += "  \"removed\": ["+removed+(removed.empty()? "" : "\n  ")+"],\n";
+	j += "  \"changed\": ["+changed+(changed.empty()? "" : "\n  ")+"]\n}\n";
+	return j;
+}
+
+bool WriteJson(const char *filename, const string &json) {
+	FILE *out = fopen(filename, "w");
+	if (!out) {
+		printf("can't save %s\n", filename);
+		return false;
+	}
+	fwrite(json.data(), 1, json.size(), out);
+	fclose(out);
+	return true;
+}
+
+// Owner handles
+
+void MemoryOwner::Name(const string &n) {
+	if (n == name)
+		return;
+	name = n;
+	if (slot >= 0)
+		memoryLedger.Rename(slot, name);
+}
@@ -0,0 +1,207 @@
+// Meshlet.cpp - triangle clusters with bounding spheres and normal cones, culled per frame on the CPU
+
+#include "Meshlet.h"
+#include "Parallel.h"
+#include <float.h>
+#include <math.h>
+#include <stdio.h>
+
+// Build
+
+namespace {
+
+void SetBounds(const vector<vec3> &points, const vector<int3> &triangles, Meshlet &m) {
+	// sphere about the box center, cone about the area-weighted average normal
+	vec3 min(FLT_MAX, FLT_MAX, FLT_MAX), max(-FLT_MAX, -FLT_MAX, -FLT_MAX), sum(0, 0, 0);
+	for (int t = m.first; t < m.first+m.count; t++) {
+		const int3 &tri = triangles[t];
+		for (int k = 0; k < 3; k++) {
+			const vec3 &p = points[tri[k]];
+			for (int a = 0; a < 3; a++) {
+				min[a] = p[a] < min[a]? p[a] : min[a];
+				max[a] = p[a] > max[a]? p[a] : max[a];
+			}
+		}
+		sum += cross(points[tri.i2]-points[tri.i1], points[tri.i3]-points[tri.i2]);
+	}
+	m.center = .5f*(min+max);
+	float r2 = 0;
+	for (int t = m.first; t < m.first+m.count; t++)
+		for (int k = 0; k < 3; k++) {
+			vec3 d = points[triangles[t][k]]-m.center;
+			r2 = dot(d, d) > r2? dot(d, d) : r2;
+		}
+	m.radius = sqrt(r2);
+	float len = length(sum), minDot = 1;
+	m.coneAxis = len > 0? sum/len : vec3(0, 0, 1);
+	m.coneCutoff = 2;
+	if (len <= 0)
+		return;
+	for (int t = m.first; t < m.first+m.count; t++) {
+		const int3 &tri = triangles[t];
+		vec3 n = cross(points[tri.i2]-points[tri.i1], points[tri.i3]-points[tri.i2]);
+		float l = length(n);
+		if (l > 0) {
+			float d = dot(n, m.coneAxis)/l;
+			minDot = d < minDot? d : minDot;
+		}
+	}
+	if (minDot > 0)
+		m.coneCutoff = sqrt(1-minDot*minDot);
+}
+
+} // end namespace
+
+void BuildMeshlets(vector<vec3> &points, vector<int3> &triangles, vector<Meshlet> &meshlets,
+				   int maxVertices, int maxTriangles, vector<int> *order) {
+	int nPoints = (int) points.size(), nTriangles = (int) triangles.size();
+	VertexTriangles adjacency;
+	adjacency.Build(triangles, nPoints);
+	// marks hold the id of the last meshlet to use a vertex or consider a triangle, so need no clearing
+	vector<int> vertexMark(nPoints, -1), candidateMark(nTriangles, -1), newOrder, candidates;
+	vector<char> assigned(nTriangles, 0);
+	newOrder.reserve(nTriangles);
+	meshlets.resize(0);
+	int seed = 0;
+	while ((int) newOrder.size() < nTriangles) {
+		// seed with a triangle left over from the previous meshlet, if any, else the first unassigned
+		int next = -1;
+		for (int t : candidates)
+			if (!assigned[t]) {
+				next = t;
+				break;
+			}
+		if (next < 0) {
+			while (assigned[seed])
+				seed++;
+			next = seed;
+		}
+		int id = (int) meshlets.size();
+		Meshlet m;
+		m.first = (int) newOrder.size();
+		vec3 sum(0, 0, 0);
+		candidates.resize(0);
+		while (next >= 0) {
+			assigned[next] = 1;
+			newOrder.push_back(next);
+			for (int k = 0; k < 3; k++) {
+				int v = triangles[next][k];
+				if (vertexMark[v] == id)
+					continue;
+				vertexMark[v] = id;
+				m.nVertices++;
+				sum += points[v];
+				for (int i = adjacency.offsets[v]; i < adjacency.offsets[v+1]; i++) {
+					int t = adjacency.corners[i]/3;
+					if (!assigned[t] && candidateMark[t] != id) {
+						candidateMark[t] = id;
+						candidates.push_back(t);
+					}
+				}
+			}
+			if ((int) newOrder.size()-m.first >= maxTriangles)
+				break;
+			// fewest new vertices, then nearest the meshlet's vertex centroid
+			vec3 center = sum/(float) m.nVertices;
+			int bestNew = 4, n = 0;
+			float bestDist = FLT_MAX;
+			next = -1;
+			for (int t : candidates) {
+				if (assigned[t])
+					continue;
+				candidates[n++] = t;
+				const int3 &tri = triangles[t];
+				int nNew = (vertexMark[tri.i1] != id)+(vertexMark[tri.i2] != id)+(vertexMark[tri.i3] != id);
+				if (m.nVertices+nNew > maxVertices || nNew > bestNew)
+					continue;
+				vec3 d = (points[tri.i1]+points[tri.i2]+points[tri.i3])/3.f-center;
+				float dist = dot(d, d);
+				if (nNew < bestNew || dist < bestDist) {
+					bestNew = nNew;
+					bestDist = dist;
+					next = t;
+				}
+			}
+			candidates.resize(n);
+		}
+		m.count = (int) newOrder.size()-m.first;
+		meshlets.push_back(m);
+	}
+	vector<int3> reordered(nTriangles);
+	for (int i = 0; i < nTriangles; i++)
+		reordered[i] = triangles[newOrder[i]];
+	triangles.swap(reordered);
+	if (order)
+		order->swap(newOrder);
+	ParallelFor((int) meshlets.size(), [&](int begin, int end) {
+		for (int i = begin; i < end; i++)
+			SetBounds(points, triangles, meshlets[i]);
+	}, 64);
+}
+
+// Cull
+
+void CullMeshlets(vector<Meshlet> &meshlets, mat4 modelview, mat4 persp, MeshletCull &cull) {
+	double start = TimeMs();
+	int nMeshlets = (int) meshlets.size();
+	// object space frustum planes (rows of the clip transform, Gribb-Hartmann) and eye point
+	mat4 m = persp*modelview;
+	vec4 planes[6];
+	for (int i = 0; i < 3; i++) {
+		planes[2*i] = m[3]+m[i];
+		planes[2*i+1] = m[3]-m[i];
+	}
+	for (vec4 &p : planes)
+		p = p/length(vec3(p.x, p.y, p.z));
+	mat4 inv = Invert(modelview);
+	vec3 eye(inv[0].w, inv[1].w, inv[2].w);
+	cull.visible.resize(nMeshlets);
+	char *visible = cull.visible.data();
+	const Meshlet *ms = meshlets.data();
+	bool frustum = cull.frustum, backface = cull.backface;
+	ParallelFor(nMeshlets, [&](int begin, int end) {
+		for (int i = begin; i < end; i++) {
+			const Meshlet &ml = ms[i];
+			char v = 1;
+			if (frustum)
+				for (int k = 0; k < 6 && v; k++)
+					if (dot(vec3(planes[k].x, planes[k].y, planes[k].z), ml.center)+planes[k].w < -ml.radius)
+						v = 0;
+			if (v && backface && ml.coneCutoff <= 1) {
+				// back facing from every point of the sphere
+				vec3 d = ml.center-eye;
+				if (dot(d, ml.coneAxis) >= ml.coneCutoff*length(d)+ml.radius)
+					v = 2;
+			}
+			visible[i] = v;
+		}
+	}, 512);
+	// count, and merge adjacent visible meshlets into ranges
+	cull.counts.resize(0);
+	cull.offsets.resize(0);
+	cull.nMeshlets = nMeshlets;
+	cull.nFrustumCulled = cull.nBackfaceCulled = cull.nTriangles = cull.nTrianglesCulled = 0;
+	for (int i = 0; i < nMeshlets; i++) {
+		const Meshlet &ml = ms[i];
+		cull.nTriangles += ml.count;
+		if (visible[i] != 1) {
+			cull.nTrianglesCulled += ml.count;
+			if (visible[i] == 0) cull.nFrustumCulled++; else cull.nBackfaceCulled++;
+			continue;
+		}
+		if (i > 0 && visible[i-1] == 1)
+			cull.counts.back() += 3*ml.count;
+		else {
+			cull.counts.push_back(3*ml.count);
+			cull.offsets.push_back((const void *) (size_t) (3*ml.first*cull.indexBytes));
+		}
+	}
+	cull.cullMs = (float) (TimeMs()-start);
+}
+
+void MeshletCull::Print() const {
+	printf("MeshletCull: %i meshlets, %i outside frustum, %i back facing, %i draw ranges\n",
+		   nMeshlets, nFrustumCulled, nBackfaceCulled, (int) counts.size());
+	printf("  %i of %i triangles culled (%.0f%%) in %.3f ms\n",
+		   nTrianglesCulled, nTriangles, nTriangles? 100.f*nTrianglesCulled/nTriangles : 0.f, cullMs);
+}
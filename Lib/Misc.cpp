@@ -4,9 +4,16 @@
 #include <stdio.h>
 #include <float.h>
 #include <stdlib.h>
+#include <vector>
 #include "Draw.h"
 #include "Misc.h"
 #include <sys/stat.h>
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
 
 #define STB_IMAGE_IMPLEMENTATION
 #include "STB_Image.h"
@@ -41,6 +48,16 @@ bool FileExists(const char *name) {
 	return fopen(name, "r") != NULL;
 }
 
+size_t PeakMemory() {
+#ifdef _WIN32
+	PROCESS_MEMORY_COUNTERS counters;
+	return GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))? counters.PeakWorkingSetSize : 0;
+#else
+	struct rusage usage;
+	return getrusage(RUSAGE_SELF, &usage) == 0? (size_t) usage.ru_maxrss*1024 : 0;
+#endif
+}
+
 // Sphere
 
 int LineSphere(vec3 ln1, vec3 ln2, vec3 center, float radius, vec3 &p1, vec3 &p2) {
@@ -133,19 +150,10 @@ bool WriteTarga(const char *filename, unsigned char *pixels, int width, int heig
 bool WriteTarga(const char *filename) {
 	int width, height;
 	GetViewportSize(width, height);
-	int npixels = width*height;
-	unsigned char *cPixels = new unsigned char[3*npixels], *c = cPixels;
-	float *fPixels = new float[3*npixels*sizeof(float)], *f = fPixels;
-	glReadPixels(0, 0, width, height, GL_BGR, GL_FLOAT, fPixels);   // Targa is BGR ordered
-	for (int i = 0; i < npixels; i++) {
-		*c++ = (unsigned char) (255.f*(*f++));
-		*c++ = (unsigned char) (255.f*(*f++));
-		*c++ = (unsigned char) (255.f*(*f++));
-	}
-	bool ok = WriteTarga(filename, (unsigned char *) cPixels, width, height);
-	delete [] fPixels;
-	delete [] cPixels;
-	return ok;
+	std::vector<unsigned char> pixels(3*width*height);				// heap: a one-off, not per frame
+	glPixelStorei(GL_PACK_ALIGNMENT, 1);                            // rows not padded to 4 bytes
+	glReadPixels(0, 0, width, height, GL_BGR, GL_UNSIGNED_BYTE, pixels.data()); // Targa is BGR ordered
+	return WriteTarga(filename, pixels.data(), width, height);
 }
 
 // Texture
@@ -0,0 +1,161 @@
+// Occluder.cpp - occluder triangles transformed once per frame for shadow ray tests
+
+#include "Batch.h"
+#include "GLXtras.h"
+#include "Occluder.h"
+#include "Parallel.h"
+#include <algorithm>
+#include <float.h>
+
+// Occluder
+
+void Occluder::Prepare(Mesh &m, mat4 transform) {
+	double start = TimeMs();
+	const vector<int3> &meshTriangles = m.Triangles();
+	int nPoints = (int) m.Points().size();
+	nTriangles = (int) meshTriangles.size();
+	points.resize(nPoints);
+	triangles.resize(nTriangles);
+	XformPoints(transform, m.Points().data(), points.data(), nPoints);
+	ParallelFor(nTriangles, [&](int begin, int end) {
+		for (int i = begin; i < end; i++) {
+			const int3 &t = meshTriangles[i];
+			vec3 p1 = points[t.i1], e1 = points[t.i2]-p1, e2 = points[t.i3]-p1, n = cross(e1, e2);
+			float len = length(n);
+			n = len > FLT_MIN? n/len : vec3(0, 0, 0);
+			triangles[i] = { vec4(p1, 1), vec4(e1, 0), vec4(e2, 0), vec4(n, -dot(n, p1)) };
+		}
+	}, 4096);
+	prepareMs = (float) (TimeMs()-start);
+	memory.Set(MemCpuOther, points.capacity()*sizeof(vec3)+triangles.capacity()*sizeof(OccluderTriangle));
+}
+
+void Occluder::Reserve(GLuint binding) {
+	int size = nTriangles*sizeof(OccluderTriangle);
+	if (!buffer || size > buffer.Capacity())
+		buffer.Reserve(GL_SHADER_STORAGE_BUFFER, size, GL_DYNAMIC_DRAW);
+	memory.Set(MemStorageBuffer, buffer.Capacity());
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, binding, buffer);
+}
+
+void Occluder::Upload(GLuint binding) {
+	Reserve(binding);
+	glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, nTriangles*sizeof(OccluderTriangle), triangles.data());
+}
+
+namespace {
+
+GLuint prepareShader = 0;
+
+const char *prepareComputeShader = R"(
+	#version 430
+	layout (local_size_x = 64) in;
+	layout (std430) buffer Points { uint objPts[]; };
+	layout (std430) buffer Triangles { uint objEids[]; };
+	layout (std430) buffer OccluderTriangles { vec4 objTris[]; };
+	uniform mat4 objTransform;
+	uniform int nTriangles = 0;
+	uniform bool packedPoints = false;		// objPts holds PackedVertex (see Quantize.h), else tight xyz floats
+	uniform mat4 dequantize = mat4(1);		// packed point to object space
+	uniform bool shortIndices = false;		// objEids holds uint16 indices, two per word
+	uint Index(int k) {
+		if (!shortIndices) return objEids[k];
+		uint w = objEids[k >> 1];
+		return (k & 1) == 1? w >> 16 : w & 0xffffu;
+	}
+	vec3 Point(int k) {
+		uint j = Index(k);
+		vec4 p;
+		if (packedPoints) {
+			uint xy = objPts[4*j], zo = objPts[4*j+1];	// x | y << 16, z | occlusion << 16
+			p = dequantize*vec4(vec3(xy & 0xffffu, xy >> 16, zo & 0xffffu)/65535., 1);
+		}
+		else
+			p = vec4(uintBitsToFloat(uvec3(objPts[3*j], objPts[3*j+1], objPts[3*j+2])), 1);	// float[3n], not vec4s
+		return (objTransform*p).xyz;
+	}
+	void main() {
+		int i = int(gl_GlobalInvocationID.x);
+		if (i >= nTriangles) return;
+		vec3 p1 = Point(3*i), p2 = Point(3*i+1), p3 = Point(3*i+2);
+		vec3 e1 = p2-p1, e2 = p3-p1, n = cross(e1, e2);
+		float len = length(n);
+		n = len > 0? n/len : vec3(0);
+		objTris[4*i] = vec4(p1, 1);
+		objTris[4*i+1] = vec4(e1, 0);
+		objTris[4*i+2] = vec4(e2, 0);
+		objTris[4*i+3] = vec4(n, -dot(n, p1));
+	}
+)";
+
+void BindBlock(GLuint program, const char *name, GLuint binding) {
+	GLuint index = glGetProgramResourceIndex(program, GL_SHADER_STORAGE_BLOCK, name);
+	if (index != GL_INVALID_INDEX)
+		glShaderStorageBlockBinding(program, index, binding);
+}
+
+} // end namespace
+
+void Occluder::PrepareOnGPU(Meshadow &m, mat4 transform, GLuint binding) {
+	double start = TimeMs();
+	if (!prepareShader)
+		prepareShader = LinkProgramViaCode(&prepareComputeShader);
+	nTriangles = (int) m.Triangles().size();
+	Reserve(binding);
+	int program = CurrentProgram();
+	glUseProgram(prepareShader);
+	BindBlock(prepareShader, "Points", m.pos.binding);
+	BindBlock(prepareShader, "Triangles", m.eid.binding);
+	BindBlock(prepareShader, "OccluderTriangles", binding);
+	SetUniform(prepareShader, "objTransform", transform);
+	SetUniform(prepareShader, "nTriangles", nTriangles);
+	SetUniform(prepareShader, "packedPoints", m.packed);
+	SetUniform(prepareShader, "dequantize", m.packed? m.packer.Dequantize() : mat4());
+	SetUniform(prepareShader, "shortIndices", m.indexType == GL_UNSIGNED_SHORT);
+	glDispatchCompute((nTriangles+63)/64, 1, 1);
+	glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+	glUseProgram(program);
+	prepareMs = (float) (TimeMs()-start);
+}
+
+float Occluder::CompareGPU(Meshadow &m, mat4 transform, GLuint binding) {
+	Prepare(m, transform);
+	PrepareOnGPU(m, transform, binding);
+	vector<OccluderTriangle> gpu(nTriangles);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffer);
+	glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, nTriangles*sizeof(OccluderTriangle), gpu.data());
+	const float *a = (const float *) triangles.data(), *b = (const float *) gpu.data();
+	float maxDifference = 0;
+	for (int i = 0; i < 16*nTriangles; i++)
+		maxDifference = std::max(maxDifference, fabsf(a[i]-b[i]));
+	return maxDifference;
+}
+
+bool Occluder::Intersect(vec3 a, vec3 b) {
+	vec3 d = b-a;
+	for (int i = 0; i < nTriangles; i++) {
+		OccluderTriangle &t = triangles[i];
+		vec3 n(t.plane.x, t.plane.y, t.plane.z), p(t.p.x, t.p.y, t.p.z);
+		float da = dot(n, a)+t.plane.w, db = dot(n, b)+t.plane.w;
+		if ((da > 0 && db > 0) || (da < 0 && db < 0))
+			continue;                                   // segment on one side of plane
+		vec3 e1(t.e1.x, t.e1.y, t.e1.z), e2(t.e2.x, t.e2.y, t.e2.z);
+		vec3 h = cross(d, e2);
+		float det = dot(e1, h);
+		if (fabsf(det) <= ParallelEpsilon*length(d)*length(e1)*length(e2))
+			continue;                                   // segment parallel to triangle, relative to their sizes
+		float f = 1/det;
+		vec3 s = a-p;
+		float u = f*dot(s, h);
+		if (u < 0 || u > 1)
+			continue;
+		vec3 q = cross(s, e1);
+		float v = f*dot(d, q);
+		if (v < 0 || u+v > 1)
+			continue;
+		float alpha = f*dot(e2, q);
+		if (alpha > 0 && alpha < 1)
+			return true;
+	}
+	return false;
+}
@@ -0,0 +1,110 @@
+// Parallel.cpp - chunked multithreaded loops
+
+#include "Parallel.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+int NumThreads() {
+	static int n = (int) std::thread::hardware_concurrency();
+	return n > 0? n : 1;
+}
+
+namespace {
+
+// workers are started on the first parallel loop and kept: each loop wakes them rather than creating
+// and joining threads, so a loop run every frame costs no thread creation and no heap allocation
+
+class WorkerPool {
+public:
+	std::atomic<bool> busy{false};						// a loop is running
+	void Run(int n, int chunk, ChunkFunction &f);
+private:
+	std::mutex mutex;
+	std::condition_variable wake, done;
+	std::vector<std::thread> workers;
+	int generation = 0;									// loops started
+	int working = 0;									// workers not yet through the current loop
+	// current loop
+	ChunkFunction *f = NULL;
+	int n = 0, chunk = 0, nChunks = 0;
+	std::atomic<int> next{0};
+	void Chunks();
+	void Work();
+};
+
+void WorkerPool::Chunks() {
+	for (int c = next++; c < nChunks; c = next++) {
+		int begin = c*chunk, end = begin+chunk < n? begin+chunk : n;
+		(*f)(begin, end);
+	}
+}
+
+void WorkerPool::Work() {
+	int seen = 0;
+	for (;;) {
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			wake.wait(lock, [&]() { return generation != seen; });
+			seen = generation;
+		}
+		Chunks();
+		std::lock_guard<std::mutex> lock(mutex);
+		if (--working == 0)
+			done.notify_one();
+	}
+}
+
+void WorkerPool::Run(int count, int chunkSize, ChunkFunction &function) {
+	if (workers.empty())
+		for (int i = 1; i < NumThreads(); i++) {
+			workers.push_back(std::thread(&WorkerPool::Work, this));
+			workers.back().detach();					// the pool is never destroyed
+		}
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		f = &function;
+		n = count;
+		chunk = chunkSize;
+		nChunks = (n+chunk-1)/chunk;
+		next = 0;
+		working = (int) workers.size();
+		generation++;
+	}
+	wake.notify_all();
+	Chunks();											// calling thread also works
+	std::unique_lock<std::mutex> lock(mutex);
+	done.wait(lock, [&]() { return working == 0; });	// f and its captures live on the caller's stack
+}
+
+WorkerPool &workerPool = *new WorkerPool();
+
+} // end namespace
+
+void ParallelFor(int n, ChunkFunction f, int minChunk) {
+	if (n <= 0)
+		return;
+	int nThreads = NumThreads();
+	if (minChunk < 1) minChunk = 1;
+	// a loop within a loop, or beside one on another thread, runs on the calling thread
+	if (nThreads == 1 || n < 2*minChunk || workerPool.busy.exchange(true)) {
+		f(0, n);
+		return;
+	}
+	// about four chunks per thread so uneven chunks balance out; for fine-grained loops chunks start at
+	// multiples of 16, so four-wide kernels leave a scalar remainder only at n and float outputs don't
+	// share cache lines
+	int chunk = n/(4*nThreads);
+	if (minChunk%16 == 0) chunk = (chunk+15) & ~15;
+	if (chunk < minChunk) chunk = minChunk;
+	workerPool.Run(n, chunk, f);
+	workerPool.busy = false;
+}
+
+double TimeMs() {
+	using namespace std::chrono;
+	return duration<double, std::milli>(steady_clock::now().time_since_epoch()).count();
+}
@@ -0,0 +1,205 @@
+// Quantize.cpp - packed vertex format: 16-bit positions, octahedral normals, half-float uvs, 16-bit indices
+
+#include "Batch.h"
+#include "Parallel.h"
+#include "Quantize.h"
+#include <algorithm>
+#include <math.h>
+#include <mutex>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+
+// Encoding
+
+uint16_t FloatToHalf(float f) {
+	uint32_t x;
+	memcpy(&x, &f, 4);
+	uint32_t sign = (x >> 16) & 0x8000, e = (x >> 23) & 0xff, m = x & 0x7fffff;
+	if (e == 0xff)
+		return (uint16_t) (sign | 0x7c00 | (m? 0x200 : 0));		// infinity, nan
+	int he = (int) e-127+15;
+	if (he >= 0x1f)
+		return (uint16_t) (sign | 0x7c00);						// overflow
+	if (he <= 0) {
+		// subnormal (or zero)
+		if (he < -10)
+			return (uint16_t) sign;
+		m |= 0x800000;
+		int shift = 14-he;
+		uint32_t h = m >> shift, rem = m & ((1u << shift)-1), half = 1u << (shift-1);
+		if (rem > half || (rem == half && (h & 1)))
+			h++;
+		return (uint16_t) (sign | h);
+	}
+	uint32_t h = ((uint32_t) he << 10) | (m >> 13), rem = m & 0x1fff;
+	if (rem > 0x1000 || (rem == 0x1000 && (h & 1)))
+		h++;													// a carry rounds up the exponent
+	return (uint16_t) (sign | h);
+}
+
+float HalfToFloat(uint16_t h) {
+	uint32_t sign = (uint32_t) (h & 0x8000) << 16, e = (h >> 10) & 0x1f, m = h & 0x3ff, x;
+	if (e == 0) {
+		if (!m)
+			x = sign;
+		else {
+			// normalize subnormal
+			e = 127-15+1;
+			while (!(m & 0x400)) {
+				m <<= 1;
+				e--;
+			}
+			x = sign | (e << 23) | ((m & 0x3ff) << 13);
+		}
+	}
+	else if (e == 31)
+		x = sign | 0x7f800000 | (m << 13);
+	else
+		x = sign | ((e+127-15) << 23) | (m << 13);
+	float f;
+	memcpy(&f, &x, 4);
+	return f;
+}
+
+namespace {
+
+inline float SignNotZero(float f) { return f >= 0? 1.f : -1.f; }
+
+inline int16_t Snorm16(float f) {
+	f = f < -1? -1 : f > 1? 1 : f;
+	return (int16_t) lroundf(32767*f);
+}
+
+inline float FromSnorm16(int16_t s) {
+	float f = s/32767.f;
+	return f < -1? -1 : f;
+}
+
+inline uint16_t Unorm16(float f) {
+	f = f < 0? 0 : f > 1? 1 : f;
+	return (uint16_t) lroundf(65535*f);
+}
+
+} // end namespace
+
+void OctEncode(vec3 n, int16_t e[2]) {
+	// project onto the octahedron |x|+|y|+|z| = 1, fold the lower half over the upper
+	float s = fabsf(n.x)+fabsf(n.y)+fabsf(n.z);
+	float x = s > 0? n.x/s : 0, y = s > 0? n.y/s : 0;
+	if (n.z < 0) {
+		float fx = (1-fabsf(y))*SignNotZero(x), fy = (1-fabsf(x))*SignNotZero(y);
+		x = fx;
+		y = fy;
+	}
+	e[0] = Snorm16(x);
+	e[1] = Snorm16(y);
+}
+
+vec3 OctDecode(const int16_t e[2]) {
+	float x = FromSnorm16(e[0]), y = FromSnorm16(e[1]);
+	vec3 n(x, y, 1-fabsf(x)-fabsf(y));
+	if (n.z < 0) {
+		n.x = (1-fabsf(y))*SignNotZero(x);
+		n.y = (1-fabsf(x))*SignNotZero(y);
+	}
+	return normalize(n);
+}
+
+// Packing
+
+void VertexPacker::Pack(const vec3 *points, const vec3 *normals, const vec2 *uvs, const float *occlusion, int n, PackedVertex *out) {
+	double start = TimeMs();
+	vec3 max;
+	MinMax(points, n, min, max);
+	extent = max-min;
+	vec3 inverse;
+	for (int k = 0; k < 3; k++)
+		inverse[k] = extent[k] > 0? 1/extent[k] : 0;
+	maxPositionError = maxNormalDegrees = maxUvError = 0;
+	float minNormalDot = 1;
+	std::mutex m;
+	ParallelFor(n, [&](int begin, int end) {
+		float posError = 0, normalDot = 1, uvError = 0;
+		for (int i = begin; i < end; i++) {
+			PackedVertex &v = out[i];
+			vec3 p = points[i], d;
+			for (int k = 0; k < 3; k++) {
+				v.position[k] = Unorm16((p[k]-min[k])*inverse[k]);
+				d[k] = min[k]+extent[k]*(v.position[k]/65535.f)-p[k];
+			}
+			posError = std::max(posError, length(d));
+			v.occlusion = occlusion? Unorm16(occlusion[i]) : 0;
+			v.normal[0] = v.normal[1] = 0;
+			if (normals) {
+				float len = length(normals[i]);
+				if (len > 0) {
+					vec3 nrm = normals[i]/len;
+					OctEncode(nrm, v.normal);
+					normalDot = std::min(normalDot, dot(nrm, OctDecode(v.normal)));
+				}
+			}
+			v.uv[0] = v.uv[1] = 0;
+			if (uvs) {
+				v.uv[0] = FloatToHalf(uvs[i].x);
+				v.uv[1] = FloatToHalf(uvs[i].y);
+				uvError = std::max(uvError, length(vec2(HalfToFloat(v.uv[0]), HalfToFloat(v.uv[1]))-uvs[i]));
+			}
+		}
+		std::lock_guard<std::mutex> lock(m);
+		maxPositionError = std::max(maxPositionError, posError);
+		minNormalDot = std::min(minNormalDot, normalDot);
+		maxUvError = std::max(maxUvError, uvError);
+	}, 4096);
+	maxNormalDegrees = (float) (acos(std::min(1.f, minNormalDot))*180/3.14159265358979);
+	packMs = (float) (TimeMs()-start);
+}
+
+mat4 VertexPacker::Dequantize() const {
+	return Translate(min)*Scale(extent);
+}
+
+void VertexPacker::Print(int nVertices, int nTriangles, bool normals, bool uvs, bool occlusion, bool shortIndices) const {
+	int floatBytes = sizeof(vec3)+(normals? sizeof(vec3) : 0)+(uvs? sizeof(vec2) : 0)+(occlusion? sizeof(float) : 0);
+	int indexBytes = shortIndices? 3*sizeof(uint16_t) : sizeof(int3);
+	float floatMB = (nVertices*floatBytes+nTriangles*sizeof(int3))/(1024.f*1024.f);
+	float packedMB = (nVertices*sizeof(PackedVertex)+nTriangles*indexBytes)/(1024.f*1024.f);
+	printf("VertexPacker: %i vertices, %i triangles packed in %.1f ms\n", nVertices, nTriangles, packMs);
+	printf("  %i bytes/vertex (float %i), %i bytes/triangle (int %i): %.2f MB (float %.2f MB)\n",
+		   (int) sizeof(PackedVertex), floatBytes, indexBytes, (int) sizeof(int3), packedMB, floatMB);
+	printf("  max error: position %.2e (%.2e of box), normal %.3f degrees, uv %.2e\n", maxPositionError,
+		   maxPositionError/std::max(length(extent), 1e-30f), maxNormalDegrees, maxUvError);
+}
+
+bool ShortIndices(int nVertices) {
+	return nVertices <= 65536;
+}
+
+void ToShortIndices(const int3 *triangles, int n, uint16_t *out) {
+	const int *in = (const int *) triangles;
+	for (int i = 0; i < 3*n; i++)
+		out[i] = (uint16_t) in[i];
+}
+
+void EnablePackedVertex(bool normals, bool uvs, bool occlusion, int offset) {
+	GLsizei stride = sizeof(PackedVertex);
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(0, 3, GL_UNSIGNED_SHORT, GL_TRUE, stride, (void *) (size_t) offset);
+	int attribs[] = { 1, 2, 8 };
+	bool enables[] = { normals, uvs, occlusion };
+	for (int i = 0; i < 3; i++)
+		if (!enables[i])
+			glDisableVertexAttribArray(attribs[i]);
+	if (normals) {
+		glEnableVertexAttribArray(1);
+		glVertexAttribPointer(1, 2, GL_SHORT, GL_TRUE, stride, (void *) (size_t) (offset+offsetof(PackedVertex, normal)));
+	}
+	if (uvs) {
+		glEnableVertexAttribArray(2);
+		glVertexAttribPointer(2, 2, GL_HALF_FLOAT, GL_FALSE, stride, (void *) (size_t) (offset+offsetof(PackedVertex, uv)));
+	}
+	if (occlusion) {
+		glEnableVertexAttribArray(8);
+		glVertexAttribPointer(8, 1, GL_UNSIGNED_SHORT, GL_TRUE, stride, (void *) (size_t) (offset+offsetof(PackedVertex, occlusion)));
+	}
+}
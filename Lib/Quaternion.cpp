@@ -7,12 +7,6 @@
 const int X = 0, Y = 1, Z = 2;
 #define _PI 3.141592f
 
-Quaternion::Quaternion(vec3 axis, float radAng) {
-	float c = cos(radAng/2), s = sin(radAng/2);
-	vec3 a = normalize(axis);
-	x = s*a.x; y = s*a.y; z = s*a.z; w = c;
-}
-
 Quaternion::Quaternion(mat4 m) {
 	mat3 t = mat3(vec3(m[0][0], m[1][0], m[2][0]), vec3(m[0][1], m[1][1], m[2][1]), vec3(m[0][2], m[1][2], m[2][2]));
 	// the following transpose for left-handed coord sys
@@ -56,26 +50,6 @@ Quaternion::Quaternion(mat3 &mat) {
   }
 }
 
-mat3 Quaternion::Get3x3() {
-	float norm = Norm();
-	if (fabs(norm) < FLT_EPSILON)
-		return mat3(vec3(1, 0, 0), vec3(0, 1, 0), vec3(0, 0, 1));
-	float s = 2/norm;
-	float xs = x*s,  ys = y*s,  zs = z*s;
-	float wx = w*xs, wy = w*ys, wz = w*zs;
-	float xx = x*xs, xy = x*ys, xz = x*zs;
-	float yy = y*ys, yz = y*zs, zz = z*zs;
-	return mat3(
-		vec3(1 - (yy + zz), xy + wz,       xz - wy),
-		vec3(xy - wz,       1 - (xx + zz), yz + wx),
-		vec3(xz + wy,       yz - wx,       1 - (xx + yy)));
-}
-
-mat4 Quaternion::GetMatrix() {
-	mat3 m3 = Get3x3();
-	return mat4(m3);
-}
-
 void Quaternion::SetMatrix(mat4 &m, float scale) {
 	mat3 m3 = this->Get3x3();
 	for (int i = 0; i < 3; i++)
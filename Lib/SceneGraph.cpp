@@ -0,0 +1,124 @@
+// SceneGraph.cpp - flat transform hierarchy, updated in one pass over dirty subtrees
+
+#include "Mesh.h"
+#include "Parallel.h"
+#include "SceneGraph.h"
+#include <atomic>
+
+// Build
+
+int SceneGraph::Add(int parent, const mat3x4 &m, Mesh *mesh) {
+	int id = Size();
+	if (parent >= id) {
+		printf("SceneGraph::Add: parent %i not yet added\n", parent);
+		return -1;
+	}
+	parents.push_back(parent < 0? -1 : parent);
+	local.push_back(m);
+	world.push_back(m);
+	meshes.push_back(mesh);
+	dirty.push_back(1);
+	stamps.push_back(0);
+	depth.push_back(parent < 0? 0 : depth[parent]+1);
+	firstDirty = firstDirty < id? firstDirty : id;
+	levelsCurrent = false;
+	return id;
+}
+
+int SceneGraph::Add(Mesh *m, int parent) {
+	mat3x4 w(m->transform);
+	int id = Add(parent, parent < 0? w : Invert(world[parent])*w, m);
+	world[id] = w;
+	for (int i = 0; i < (int) m->children.size(); i++)
+		Add(m->children[i], id);
+	return id;
+}
+
+void SceneGraph::SetLocal(int node, const mat3x4 &m) {
+	local[node] = m;
+	dirty[node] = 1;
+	firstDirty = firstDirty < node? firstDirty : node;
+}
+
+void SceneGraph::Capture() {
+	for (int i = 0, n = Size(); i < n; i++) {
+		int p = parents[i];
+		if (meshes[i]) {
+			world[i] = mat3x4(meshes[i]->transform);
+			local[i] = p < 0? world[i] : Invert(world[p])*world[i];
+		}
+		else
+			world[i] = p < 0? local[i] : world[p]*local[i];
+		dirty[i] = 0;
+	}
+	firstDirty = Size();
+}
+
+void SceneGraph::Clear() {
+	parents.resize(0); local.resize(0); world.resize(0); meshes.resize(0);
+	dirty.resize(0); stamps.resize(0); depth.resize(0);
+	firstDirty = 0;
+	levelsCurrent = false;
+}
+
+// Update
+
+void SceneGraph::SetLevels() {
+	// counting sort of nodes by depth; within a level, nodes are independent
+	int n = Size(), nLevels = 0;
+	for (int i = 0; i < n; i++)
+		nLevels = depth[i]+1 > nLevels? depth[i]+1 : nLevels;
+	levelStart.assign(nLevels+1, 0);
+	for (int i = 0; i < n; i++)
+		levelStart[depth[i]+1]++;
+	for (int l = 0; l < nLevels; l++)
+		levelStart[l+1] += levelStart[l];
+	vector<int> next(levelStart.begin(), levelStart.end()-1);
+	levelOrder.resize(n);
+	for (int i = 0; i < n; i++)
+		levelOrder[next[depth[i]]++] = i;
+	levelsCurrent = true;
+}
+
+bool SceneGraph::UpdateNode(int i) {
+	// recompute if set or parent recomputed (during this Update)
+	int p = parents[i];
+	if (!dirty[i] && (p < 0 || stamps[p] != stamp))
+		return false;
+	dirty[i] = 0;
+	stamps[i] = stamp;
+	world[i] = p < 0? local[i] : world[p]*local[i];
+	if (meshes[i])
+		meshes[i]->transform = world[i];
+	return true;
+}
+
+void SceneGraph::Update() {
+	double start = TimeMs();
+	int n = Size();
+	nUpdated = 0;
+	if (firstDirty < n) {
+		stamp++;
+		if (!parallel)
+			for (int i = firstDirty; i < n; i++)
+				nUpdated += UpdateNode(i);
+		else {
+			if (!levelsCurrent)
+				SetLevels();
+			std::atomic<int> count(0);
+			for (int l = 0; l+1 < (int) levelStart.size(); l++)
+				ParallelFor(levelStart[l+1]-levelStart[l], [&](int begin, int end) {
+					int c = 0;
+					for (int k = levelStart[l]+begin; k < levelStart[l]+end; k++) {
+						int i = levelOrder[k];
+						if (i >= firstDirty)
+							c += UpdateNode(i);
+					}
+					count += c;
+				}, 4096);
+			nUpdated = count;
+		}
+		firstDirty = n;
+	}
+	updateMs = (float) (TimeMs()-start);
+}
@@ -0,0 +1,274 @@
+// ShadowVolume.cpp - stencil shadows from silhouette edges of an occluder
+
+#include "Arena.h"
+#include "Batch.h"
+#include "GLXtras.h"
+#include "Parallel.h"
+#include "ShadowVolume.h"
+#include <algorithm>
+#include <stdint.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define VOLUME_SSE
+#include <xmmintrin.h>
+#endif
+
+// Edge Adjacency
+
+namespace {
+
+struct HalfEdge {
+	uint64_t key;                           // welded end ids, smaller in high word
+	int a, b, t;                            // point ids in winding order of triangle t
+	bool forward;                           // welded a < welded b
+};
+
+} // end namespace
+
+void ShadowVolume::Init(Mesh &m) {
+	const vector<vec3> &pts = m.Points();
+	const vector<int3> &triangles = m.Triangles();
+	int nPoints = (int) pts.size(), nTriangles = (int) triangles.size();
+	// weld points with identical positions
+	vector<int> order(nPoints), weld(nPoints);
+	for (int i = 0; i < nPoints; i++)
+		order[i] = i;
+	std::sort(order.begin(), order.end(), [&](int i, int j) {
+		return pts[i].x != pts[j].x? pts[i].x < pts[j].x : pts[i].y != pts[j].y? pts[i].y < pts[j].y : pts[i].z < pts[j].z;
+	});
+	for (int i = 0; i < nPoints; i++) {
+		int id = order[i], prev = i? order[i-1] : -1;
+		weld[id] = prev >= 0 && pts[id].x == pts[prev].x && pts[id].y == pts[prev].y && pts[id].z == pts[prev].z? weld[prev] : id;
+	}
+	// half-edges sorted so that the two sides of an edge are adjacent
+	vector<HalfEdge> halfEdges;
+	halfEdges.reserve(3*nTriangles);
+	for (int t = 0; t < nTriangles; t++)
+		for (int k = 0; k < 3; k++) {
+			int a = triangles[t][k], b = triangles[t][(k+1)%3], wa = weld[a], wb = weld[b];
+			if (wa == wb)
+				continue;
+			uint64_t key = ((uint64_t) std::min(wa, wb) << 32) | (uint32_t) std::max(wa, wb);
+			halfEdges.push_back({ key, a, b, t, wa < wb });
+		}
+	std::sort(halfEdges.begin(), halfEdges.end(), [](const HalfEdge &h1, const HalfEdge &h2) {
+		return h1.key != h2.key? h1.key < h2.key : h1.forward > h2.forward;
+	});
+	// pair opposite half-edges; unpaired (boundary or non-manifold) become one-sided edges
+	edges.resize(0);
+	for (int g = 0, nHalfEdges = (int) halfEdges.size(); g < nHalfEdges; ) {
+		int end = g, nForward = 0;
+		while (end < nHalfEdges && halfEdges[end].key == halfEdges[g].key)
+			nForward += halfEdges[end++].forward? 1 : 0;
+		int nBackward = end-g-nForward, nPairs = std::min(nForward, nBackward);
+		for (int i = 0; i < nForward; i++) {
+			HalfEdge &h = halfEdges[g+i];
+			edges.push_back({ h.a, h.b, h.t, i < nPairs? halfEdges[g+nForward+i].t : -1 });
+		}
+		for (int i = nPairs; i < nBackward; i++) {
+			HalfEdge &h = halfEdges[g+nForward+i];
+			edges.push_back({ h.a, h.b, h.t, -1 });
+		}
+		g = end;
+	}
+}
+
+// Update
+
+namespace {
+
+#ifdef VOLUME_SSE
+inline __m128 Gather(const vec3 *p, const int3 *t, int v, int c) {
+	return _mm_setr_ps(p[t[0][v]][c], p[t[1][v]][c], p[t[2][v]][c], p[t[3][v]][c]);
+}
+#endif
+
+void SetFacing(const vec3 *p, const int3 *tris, vec3 light, char *facing, int begin, int end) {
+	// facing if light is on the positive side of the triangle: dot(cross(p2-p1, p3-p1), light-p1) > 0
+	int i = begin;
+#ifdef VOLUME_SSE
+	__m128 lx = _mm_set1_ps(light.x), ly = _mm_set1_ps(light.y), lz = _mm_set1_ps(light.z);
+	for (; i+4 <= end; i += 4) {
+		const int3 *t = tris+i;
+		__m128 ax = Gather(p, t, 0, 0), ay = Gather(p, t, 0, 1), az = Gather(p, t, 0, 2);
+		__m128 e1x = _mm_sub_ps(Gather(p, t, 1, 0), ax), e1y = _mm_sub_ps(Gather(p, t, 1, 1), ay), e1z = _mm_sub_ps(Gather(p, t, 1, 2), az);
+		__m128 e2x = _mm_sub_ps(Gather(p, t, 2, 0), ax), e2y = _mm_sub_ps(Gather(p, t, 2, 1), ay), e2z = _mm_sub_ps(Gather(p, t, 2, 2), az);
+		__m128 nx = _mm_sub_ps(_mm_mul_ps(e1y, e2z), _mm_mul_ps(e1z, e2y));
+		__m128 ny = _mm_sub_ps(_mm_mul_ps(e1z, e2x), _mm_mul_ps(e1x, e2z));
+		__m128 nz = _mm_sub_ps(_mm_mul_ps(e1x, e2y), _mm_mul_ps(e1y, e2x));
+		__m128 d = _mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, _mm_sub_ps(lx, ax)), _mm_mul_ps(ny, _mm_sub_ps(ly, ay))), _mm_mul_ps(nz, _mm_sub_ps(lz, az)));
+		int mask = _mm_movemask_ps(_mm_cmpgt_ps(d, _mm_setzero_ps()));
+		for (int k = 0; k < 4; k++)
+			facing[i+k] = (mask >> k) & 1;
+	}
+#endif
+	for (; i < end; i++) {
+		const int3 &t = tris[i];
+		vec3 a = p[t.i1];
+		facing[i] = dot(cross(p[t.i2]-a, p[t.i3]-a), light-a) > 0;
+	}
+}
+
+} // end namespace
+
+void ShadowVolume::Update(Mesh &m, mat4 transform, vec3 light) {
+	double start = TimeMs();
+	const vector<int3> &triangles = m.Triangles();
+	int nPoints = (int) m.Points().size(), nTriangles = (int) triangles.size(), nEdges = (int) edges.size();
+	points.resize(nPoints);
+	facing.resize(nTriangles);
+	XformPoints(transform, m.Points().data(), points.data(), nPoints);
+	ParallelFor(nTriangles, [&](int begin, int end) {
+		SetFacing(points.data(), triangles.data(), light, facing.data(), begin, end);
+	}, 4096);
+	// silhouette edge: lit on one side only; return 1 if t1 is lit, 2 if t2 is lit, else 0
+	auto Silhouette = [&](const VolumeEdge &e) {
+		bool f1 = facing[e.t1] != 0, f2 = e.t2 >= 0 && facing[e.t2] != 0;
+		return f1 == f2? 0 : f1? 1 : 2;
+	};
+	auto Far = [&](vec3 p) { vec3 d = p-light; return p+(extrude/length(d))*d; };
+	// count per chunk, then emit at prefix offsets: side quads first, caps after
+	int nChunks = 4*NumThreads();
+	ArenaScope scope;
+	ArenaVector<int> nSides(nChunks+1, 0), nCaps(nChunks+1, 0);
+	auto Range = [&](int n, int c, int &begin, int &end) {
+		begin = (int) ((int64_t) n*c/nChunks);
+		end = (int) ((int64_t) n*(c+1)/nChunks);
+	};
+	ParallelFor(nChunks, [&](int c0, int c1) {
+		for (int c = c0; c < c1; c++) {
+			int begin, end;
+			Range(nEdges, c, begin, end);
+			for (int i = begin; i < end; i++)
+				nSides[c+1] += Silhouette(edges[i]) != 0;
+			Range(nTriangles, c, begin, end);
+			for (int i = begin; i < end; i++)
+				nCaps[c+1] += facing[i];
+		}
+	}, 1);
+	for (int c = 0; c < nChunks; c++) {
+		nSides[c+1] += nSides[c];
+		nCaps[c+1] += nCaps[c];
+	}
+	nSilhouette = nSides[nChunks];
+	nCapTriangles = nCaps[nChunks];
+	vertices.resize(6*(nSilhouette+nCapTriangles));
+	ParallelFor(nChunks, [&](int c0, int c1) {
+		for (int c = c0; c < c1; c++) {
+			int begin, end;
+			vec3 *v = vertices.data()+6*nSides[c];
+			Range(nEdges, c, begin, end);
+			for (int i = begin; i < end; i++) {
+				VolumeEdge &e = edges[i];
+				int s = Silhouette(e);
+				if (!s)
+					continue;
+				// quad (b, a, a', b') for edge a->b in the winding of the lit triangle faces out of the volume
+				vec3 a = points[s == 1? e.v1 : e.v2], b = points[s == 1? e.v2 : e.v1], fa = Far(a), fb = Far(b);
+				*v++ = b; *v++ = a; *v++ = fa;
+				*v++ = b; *v++ = fa; *v++ = fb;
+			}
+			v = vertices.data()+6*(nSilhouette+nCaps[c]);
+			Range(nTriangles, c, begin, end);
+			for (int i = begin; i < end; i++) {
+				if (!facing[i])
+					continue;
+				const int3 &t = triangles[i];
+				vec3 p1 = points[t.i1], p2 = points[t.i2], p3 = points[t.i3];
+				// front cap as is, back cap reversed
+				*v++ = p1; *v++ = p2; *v++ = p3;
+				*v++ = Far(p1); *v++ = Far(p3); *v++ = Far(p2);
+			}
+		}
+	}, 1);
+	updateMs = (float) (TimeMs()-start);
+}
+
+// Rendering
+
+namespace {
+
+GLuint volumeShader = 0;
+
+const char *volumeVertexShader = R"(
+	#version 330
+	layout (location = 0) in vec3 point;
+	uniform mat4 view;
+	void main() {
+		gl_Position = view*vec4(point, 1);
+	}
+)";
+
+const char *volumePixelShader = R"(
+	#version 330
+	out vec4 pColor;
+	uniform vec4 color = vec4(0, 0, 0, 1);
+	void main() {
+		pColor = color;
+	}
+)";
+
+// screen-filling quad (NDC) appended to the vertex buffer for the darkening pass
+vec3 screenQuad[] = { {-1, -1, 0}, {1, -1, 0}, {1, 1, 0}, {-1, -1, 0}, {1, 1, 0}, {-1, 1, 0} };
+
+} // end namespace
+
+void ShadowVolume::Upload() {
+	vao.Acquire();
+	glBindVertexArray(vao);
+	nUploaded = (int) vertices.size();
+	int size = (nUploaded+6)*sizeof(vec3);
+	if (!vbo || size > vbo.Capacity()) {
+		// a larger buffer from the pool: point the attribute at it
+		vbo.Reserve(GL_ARRAY_BUFFER, size, GL_DYNAMIC_DRAW);
+		glEnableVertexAttribArray(0);
+		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, (void *) 0);
+	}
+	else
+		glBindBuffer(GL_ARRAY_BUFFER, vbo);
+	glBufferSubData(GL_ARRAY_BUFFER, 0, nUploaded*sizeof(vec3), vertices.data());
+	glBufferSubData(GL_ARRAY_BUFFER, nUploaded*sizeof(vec3), sizeof(screenQuad), screenQuad);
+	glBindVertexArray(0);
+	// arrays grow to the largest silhouette seen
+	memory.Set(MemVertexBuffer, vbo.Capacity());
+	memory.Set(MemCpuOther, edges.capacity()*sizeof(VolumeEdge)+points.capacity()*sizeof(vec3)+facing.capacity()+
+			   vertices.capacity()*sizeof(vec3));
+}
+
+void ShadowVolume::Render(mat4 fullview, float shade) {
+	if (!volumeShader)
+		volumeShader = LinkProgramViaCode(&volumeVertexShader, &volumePixelShader);
+	Upload();
+	int program = CurrentProgram();
+	glUseProgram(volumeShader);
+	glBindVertexArray(vao);
+	// count volume faces behind the scene: back faces increment, front faces decrement (depth-fail)
+	glEnable(GL_STENCIL_TEST);
+	glClear(GL_STENCIL_BUFFER_BIT);
+	glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+	glDepthMask(GL_FALSE);
+	glEnable(GL_DEPTH_CLAMP);               // keep back caps beyond the far plane
+	glDisable(GL_CULL_FACE);
+	glStencilFunc(GL_ALWAYS, 0, 0xff);
+	glStencilOpSeparate(GL_BACK, GL_KEEP, GL_INCR_WRAP, GL_KEEP);
+	glStencilOpSeparate(GL_FRONT, GL_KEEP, GL_DECR_WRAP, GL_KEEP);
+	SetUniform(volumeShader, "view", fullview);
+	glDrawArrays(GL_TRIANGLES, 0, nUploaded);
+	// darken pixels with non-zero count
+	glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+	glDisable(GL_DEPTH_CLAMP);
+	glDisable(GL_DEPTH_TEST);
+	glEnable(GL_BLEND);
+	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	glStencilFunc(GL_NOTEQUAL, 0, 0xff);
+	glStencilOp(GL_KEEP, GL_KEEP, GL_KEEP);
+	SetUniform(volumeShader, "view", mat4());
+	SetUniform(volumeShader, "color", vec4(0, 0, 0, shade));
+	glDrawArrays(GL_TRIANGLES, nUploaded, 6);
+	// restore
+	glDisable(GL_STENCIL_TEST);
+	glEnable(GL_DEPTH_TEST);
+	glDepthMask(GL_TRUE);
+	glBindVertexArray(0);
+	glUseProgram(program);
+}
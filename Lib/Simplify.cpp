@@ -0,0 +1,390 @@
+// Simplify.cpp - quadric error mesh simplification into level-of-detail chains
+
+#include "Batch.h"
+#include "CornerTable.h"
+#include "Misc.h"
+#include "Parallel.h"
+#include "Simplify.h"
+#include <algorithm>
+#include <float.h>
+#include <queue>
+#include <string.h>
+
+namespace {
+
+// Quadrics
+
+struct Quadric {
+	// symmetric 4x4 matrix of a sum of squared plane distances (a, b, c, d), weighted
+	double a2 = 0, ab = 0, ac = 0, ad = 0, b2 = 0, bc = 0, bd = 0, c2 = 0, cd = 0, d2 = 0;
+	Quadric() { }
+	Quadric(vec3 n, float d, double w) :
+		a2(w*n.x*n.x), ab(w*n.x*n.y), ac(w*n.x*n.z), ad(w*n.x*d), b2(w*n.y*n.y), bc(w*n.y*n.z),
+		bd(w*n.y*d), c2(w*n.z*n.z), cd(w*n.z*d), d2(w*d*d) { }
+	void operator += (const Quadric &q) {
+		a2 += q.a2; ab += q.ab; ac += q.ac; ad += q.ad; b2 += q.b2;
+		bc += q.bc; bd += q.bd; c2 += q.c2; cd += q.cd; d2 += q.d2;
+	}
+	Quadric operator + (const Quadric &q) const { Quadric r(*this); r += q; return r; }
+	double Error(vec3 p) const {
+		double x = p.x, y = p.y, z = p.z;
+		return a2*x*x+2*ab*x*y+2*ac*x*z+2*ad*x+b2*y*y+2*bc*y*z+2*bd*y+c2*z*z+2*cd*z+d2;
+	}
+};
+
+// Collapses
+
+struct Scratch {
+	// per-thread work arrays for Best
+	vector<int> nv, nw, ring;
+	vector<std::pair<double, int>> costs;
+};
+
+struct Collapse {
+	double cost;
+	int v, w;                               // move v to w
+	unsigned int stamp;                     // of v when evaluated
+	bool operator < (const Collapse &c) const { return cost > c.cost; } // cheapest on top
+};
+
+class Simplifier {
+public:
+	LodBuilder &settings;
+	const vector<vec3> &points;
+	const vector<vec3> *normals;
+	const vector<vec2> *uvs;
+	vector<int3> tris;                      // current vertex ids
+	vector<char> triAlive, alive, boundary;
+	vector<vector<int>> vertexTris;         // may include dead triangles
+	vector<Quadric> quadrics;
+	vector<double> areas;
+	vector<unsigned int> stamps;
+	std::priority_queue<Collapse> queue;
+	int nAlive = 0;
+	Scratch scratch;                        // for the serial collapse loop
+	Simplifier(LodBuilder &s, const vector<vec3> &p, const vector<vec3> *n, const vector<vec2> *u, const vector<int3> &t);
+	void Neighbors(int v, vector<int> &n) const;
+	int EdgeTriangles(int v, int w) const;
+	bool Valid(int v, int w, vector<int> &nv, vector<int> &nw) const;
+	double Cost(int v, int w) const;
+	bool Best(int v, Collapse &c, Scratch &s) const;
+	float Apply(const Collapse &c);
+		// return geometric error of the collapse
+};
+
+Simplifier::Simplifier(LodBuilder &s, const vector<vec3> &p, const vector<vec3> *n, const vector<vec2> *u, const vector<int3> &t)
+	: settings(s), points(p), tris(t) {
+	int nPoints = (int) p.size(), nTriangles = (int) t.size();
+	normals = n && n->size() == p.size()? n : NULL;
+	uvs = u && u->size() == p.size()? u : NULL;
+	nAlive = nTriangles;
+	triAlive.assign(nTriangles, 1);
+	alive.assign(nPoints, 1);
+	boundary.assign(nPoints, 0);
+	stamps.assign(nPoints, 0);
+	quadrics.resize(nPoints);
+	areas.assign(nPoints, 0);
+	vertexTris.resize(nPoints);
+	CornerTable ct;
+	ct.Build(t, nPoints);
+	// triangle planes, then per-vertex gathers of plane and boundary quadrics (vertices are independent)
+	vector<vec3> triNormals(nTriangles);
+	vector<float> triAreas(nTriangles);
+	ParallelFor(nTriangles, [&](int begin, int end) {
+		for (int i = begin; i < end; i++) {
+			vec3 c = cross(p[t[i].i2]-p[t[i].i1], p[t[i].i3]-p[t[i].i2]);
+			float len = length(c);
+			triNormals[i] = len > 0? c/len : vec3(0, 0, 0);
+			triAreas[i] = .5f*len;
+		}
+	}, 4096);
+	ParallelFor(nPoints, [&](int begin, int end) {
+		for (int v = begin; v < end; v++) {
+			const int *corners = ct.Corners(v);
+			for (int k = 0, valence = ct.Valence(v); k < valence; k++) {
+				int c = corners[k], tri = c/3;
+				vec3 nrm = triNormals[tri];
+				quadrics[v] += Quadric(nrm, -dot(nrm, p[v]), triAreas[tri]);
+				areas[v] += triAreas[tri];
+				vertexTris[v].push_back(tri);
+				// the edges at v face Next(c) and Prev(c); a boundary edge adds a plane through it,
+				// perpendicular to its triangle
+				for (int e : { CornerTable::Next(c), CornerTable::Prev(c) })
+					if (ct.Opposite(e) == CornerTable::Boundary) {
+						boundary[v] = 1;
+						vec3 a = p[ct.Vertex(CornerTable::Next(e))], b = p[ct.Vertex(CornerTable::Prev(e))];
+						vec3 bn = cross(b-a, nrm);
+						float len = length(bn);
+						if (len > 0)
+							quadrics[v] += Quadric(bn/len, -dot(bn/len, a), settings.boundaryWeight*dot(b-a, b-a));
+					}
+			}
+		}
+	}, 1024);
+	// initial collapses
+	vector<Collapse> best(nPoints);
+	vector<char> has(nPoints, 0);
+	ParallelFor(nPoints, [&](int begin, int end) {
+		Scratch scratch;
+		for (int v = begin; v < end; v++)
+			has[v] = Best(v, best[v], scratch);
+	}, 1024);
+	vector<Collapse> initial;
+	initial.reserve(nPoints);
+	for (int v = 0; v < nPoints; v++)
+		if (has[v])
+			initial.push_back(best[v]);
+	queue = std::priority_queue<Collapse>(std::less<Collapse>(), std::move(initial));
+}
+
+void Simplifier::Neighbors(int v, vector<int> &n) const {
+	n.resize(0);
+	for (int t : vertexTris[v])
+		if (triAlive[t])
+			for (int k = 0; k < 3; k++) {
+				int u = tris[t][k];
+				if (u != v && std::find(n.begin(), n.end(), u) == n.end())
+					n.push_back(u);
+			}
+}
+
+int Simplifier::EdgeTriangles(int v, int w) const {
+	int count = 0;
+	for (int t : vertexTris[v])
+		if (triAlive[t]) {
+			const int3 &tri = tris[t];
+			count += tri.i1 == w || tri.i2 == w || tri.i3 == w;
+		}
+	return count;
+}
+
+bool Simplifier::Valid(int v, int w, vector<int> &nv, vector<int> &nw) const {
+	int nEdge = EdgeTriangles(v, w);
+	// boundary vertices move only along the boundary
+	if (boundary[v] && (!boundary[w] || nEdge != 1))
+		return false;
+	// link condition: the only common neighbors are the apexes of the edge's triangles
+	Neighbors(w, nw);
+	int nCommon = 0;
+	for (int u : nv)
+		nCommon += std::find(nw.begin(), nw.end(), u) != nw.end();
+	if (nCommon != nEdge || nEdge == 0)
+		return false;
+	// no surviving triangle may flip or become degenerate
+	for (int t : vertexTris[v])
+		if (triAlive[t]) {
+			const int3 &tri = tris[t];
+			if (tri.i1 == w || tri.i2 == w || tri.i3 == w)
+				continue;
+			vec3 p[3], q[3];
+			for (int k = 0; k < 3; k++) {
+				p[k] = points[tri[k]];
+				q[k] = tri[k] == v? points[w] : p[k];
+			}
+			vec3 n0 = cross(p[1]-p[0], p[2]-p[1]), n1 = cross(q[1]-q[0], q[2]-q[1]);
+			float l0 = length(n0), l1 = length(n1);
+			if (l1 <= 1e-12f || dot(n0, n1) < .2f*l0*l1)
+				return false;
+		}
+	return true;
+}
+
+double Simplifier::Cost(int v, int w) const {
+	double e = (quadrics[v]+quadrics[w]).Error(points[w]);
+	vec3 d = points[w]-points[v];
+	double penalty = 0;
+	if (normals)
+		penalty += settings.normalWeight*(1-dot((*normals)[v], (*normals)[w]));
+	if (uvs) {
+		vec2 du = (*uvs)[w]-(*uvs)[v];
+		penalty += settings.uvWeight*dot(du, du);
+	}
+	return (e > 0? e : 0)+penalty*areas[v]*dot(d, d);
+}
+
+bool Simplifier::Best(int v, Collapse &c, Scratch &s) const {
+	// cheapest valid collapse of v into a neighbor
+	Neighbors(v, s.nv);
+	s.costs.resize(0);
+	for (int w : s.nv)
+		s.costs.push_back({ Cost(v, w), w });
+	std::sort(s.costs.begin(), s.costs.end());
+	for (auto &cw : s.costs)
+		if (Valid(v, cw.second, s.nv, s.nw)) {
+			c = { cw.first, v, cw.second, stamps[v] };
+			return true;
+		}
+	return false;
+}
+
+float Simplifier::Apply(const Collapse &c) {
+	int v = c.v, w = c.w;
+	double areaSum = areas[v]+areas[w];
+	float error = areaSum > 0? (float) sqrt(std::max(0., (quadrics[v]+quadrics[w]).Error(points[w]))/areaSum) : 0;
+	alive[v] = 0;
+	for (int t : vertexTris[v])
+		if (triAlive[t]) {
+			int3 &tri = tris[t];
+			if (tri.i1 == w || tri.i2 == w || tri.i3 == w) {
+				triAlive[t] = 0;
+				nAlive--;
+			}
+			else {
+				for (int k = 0; k < 3; k++)
+					if (tri[k] == v)
+						tri[k] = w;
+				vertexTris[w].push_back(t);
+			}
+		}
+	vertexTris[v].clear();
+	vector<int> &wt = vertexTris[w];
+	wt.erase(std::remove_if(wt.begin(), wt.end(), [&](int t) { return !triAlive[t]; }), wt.end());
+	quadrics[w] += quadrics[v];
+	areas[w] = areaSum;
+	// w and its neighbors have new costs; their queued collapses are stale
+	vector<int> &ring = scratch.ring;
+	Neighbors(w, ring);
+	ring.push_back(w);
+	for (int u : ring) {
+		stamps[u]++;
+		Collapse b;
+		if (Best(u, b, scratch))
+			queue.push(b);
+	}
+	return error;
+}
+
+} // end namespace
+
+// Build
+
+void LodBuilder::Build(const vector<vec3> &points, const vector<vec3> *normals, const vector<vec2> *uvs,
+					   const vector<int3> &triangles, vector<int3> &lodTriangles, vector<LodLevel> &lods) {
+	double start = TimeMs();
+	int nTriangles = (int) triangles.size();
+	lodTriangles.resize(0);
+	lods.assign(1, LodLevel());
+	lods[0].count = nTriangles;
+	Simplifier s(*this, points, normals, uvs, triangles);
+	float maxError = 0;
+	Scratch &scratch = s.scratch;
+	for (int level = 1; level < maxLevels; level++) {
+		int target = (int) (ratio*lods[level-1].count);
+		if (target < minTriangles)
+			break;
+		while (s.nAlive > target && !s.queue.empty()) {
+			Collapse c = s.queue.top();
+			s.queue.pop();
+			if (!s.alive[c.v] || c.stamp != s.stamps[c.v])
+				continue;
+			s.Neighbors(c.v, scratch.nv);
+			if (!s.alive[c.w] || !s.Valid(c.v, c.w, scratch.nv, scratch.nw)) {
+				// target removed, or its neighborhood changed, since evaluated: find another
+				Collapse b;
+				s.stamps[c.v]++;
+				if (s.Best(c.v, b, scratch))
+					s.queue.push(b);
+				continue;
+			}
+			float e = s.Apply(c);
+			maxError = e > maxError? e : maxError;
+		}
+		if (s.nAlive >= lods[level-1].count)
+			break;
+		// record surviving triangles
+		LodLevel l;
+		l.first = nTriangles+(int) lodTriangles.size();
+		l.error = maxError;
+		for (int t = 0; t < nTriangles; t++)
+			if (s.triAlive[t])
+				lodTriangles.push_back(s.tris[t]);
+		l.count = nTriangles+(int) lodTriangles.size()-l.first;
+		lods.push_back(l);
+	}
+	buildMs = (float) (TimeMs()-start);
+}
+
+bool LodBuilder::Build(Mesh &m) {
+	string cacheFile = m.objFilename+".lod";
+	const vector<vec3> &points = m.Points();
+	int nPoints = (int) points.size(), nTriangles = (int) m.Triangles().size();
+	bool read = false;
+	if (useCache && m.objFilename.size()) {
+		FILE *in = fopen(cacheFile.c_str(), "rb");
+		bool current = in != NULL && FileModified(cacheFile.c_str()) >= FileModified(m.objFilename.c_str());
+		if (in)
+			fclose(in);
+		if (current && ReadLods(cacheFile.c_str(), nPoints, nTriangles, ratio, m.lodTriangles, m.lods)) {
+			buildMs = 0;
+			read = true;
+		}
+	}
+	if (!read) {
+		Build(points, &m.Normals(), &m.Uvs(), m.Triangles(), m.lodTriangles, m.lods);
+		if (useCache && m.objFilename.size() && !WriteLods(cacheFile.c_str(), nPoints, nTriangles, ratio, m.lodTriangles, m.lods))
+			printf("LodBuilder: can't write %s\n", cacheFile.c_str());
+	}
+	// bounding sphere for SelectLod
+	vec3 min, max;
+	MinMax(points.data(), nPoints, min, max);
+	m.lodCenter = .5f*(min+max);
+	m.lodRadius = .5f*length(max-min);
+	if (m.vao)
+		m.Buffer();
+	else
+		m.AccountMemory();
+	return read;
+}
+
+// Cache File
+
+namespace {
+
+const char lodTag[4] = { 'L', 'O', 'D', '1' };
+
+struct LodHeader {
+	char tag[4];
+	int nPoints, nTriangles, nLevels, nLodTriangles;
+	float ratio;
+};
+
+} // end namespace
+
+bool ReadLods(const char *filename, int nPoints, int nTriangles, float ratio, vector<int3> &lodTriangles, vector<LodLevel> &lods) {
+	FILE *in = fopen(filename, "rb");
+	if (!in)
+		return false;
+	LodHeader h;
+	bool ok = fread(&h, sizeof(h), 1, in) == 1 && !strncmp(h.tag, lodTag, 4) &&
+			  h.nPoints == nPoints && h.nTriangles == nTriangles && h.ratio == ratio && h.nLevels > 0;
+	if (ok) {
+		lods.resize(h.nLevels);
+		lodTriangles.resize(h.nLodTriangles);
+		ok = (int) fread(lods.data(), sizeof(LodLevel), h.nLevels, in) == h.nLevels &&
+			 (int) fread(lodTriangles.data(), sizeof(int3), h.nLodTriangles, in) == h.nLodTriangles;
+	}
+	if (!ok) {
+		lods.resize(0);
+		lodTriangles.resize(0);
+	}
+	fclose(in);
+	return ok;
+}
+
+bool WriteLods(const char *filename, int nPoints, int nTriangles, float ratio, vector<int3> &lodTriangles, vector<LodLevel> &lods) {
+	FILE *out = fopen(filename, "wb");
+	if (!out)
+		return false;
+	LodHeader h;
+	memcpy(h.tag, lodTag, 4);
+	h.nPoints = nPoints;
+	h.nTriangles = nTriangles;
+	h.nLevels = (int) lods.size();
+	h.nLodTriangles = (int) lodTriangles.size();
+	h.ratio = ratio;
+	bool ok = fwrite(&h, sizeof(h), 1, out) == 1 &&
+			  fwrite(lods.data(), sizeof(LodLevel), lods.size(), out) == lods.size() &&
+			  fwrite(lodTriangles.data(), sizeof(int3), lodTriangles.size(), out) == lodTriangles.size();
+	fclose(out);
+	return ok;
+}
@@ -0,0 +1,106 @@
+// HeapCount.cpp - count heap allocations by replacing the global operator new (see HeapAllocations in Arena.h)
+// instrumentation: link it only into programs that report allocations (RandRay's 'D' diagnostics, tests),
+// as every allocation, on every thread, then pays an atomic increment
+
+#include <atomic>
+#include <new>
+#include <stdlib.h>
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+
+extern long long (*heapAllocationCounter)();
+
+namespace {
+
+std::atomic<long long> heapAllocations(0);
+
+long long Count() { return heapAllocations.load(std::memory_order_relaxed); }
+
+struct Install { Install() { heapAllocationCounter = Count; } } install;
+
+void *Allocate(size_t size) {
+	heapAllocations.fetch_add(1, std::memory_order_relaxed);
+	return malloc(size? size : 1);
+}
+
+} // end namespace
+
+// the array forms call the single forms by default, but replace them too, so all are counted alike
+
+void *operator new(size_t size) {
+	if (void *p = Allocate(size))
+		return p;
+	throw std::bad_alloc();
+}
+
+void *operator new[](size_t size) { return operator new(size); }
+
+void *operator new(size_t size, const std::nothrow_t &) noexcept { return Allocate(size); }
+
+void *operator new[](size_t size, const std::nothrow_t &) noexcept { return Allocate(size); }
+
+void operator delete(void *p) noexcept { free(p); }
+
+void operator delete[](void *p) noexcept { free(p); }
+
+void operator delete(void *p, size_t) noexcept { free(p); }
+
+void operator delete[](void *p, size_t) noexcept { free(p); }
+
+void operator delete(void *p, const std::nothrow_t &) noexcept { free(p); }
+
+void operator delete[](void *p, const std::nothrow_t &) noexcept { free(p); }
+
+#ifdef __cpp_aligned_new
+
+// over-aligned types (alignas beyond max_align_t); memory from these is freed only by the aligned deletes
+
+namespace {
+
+void *AllocateAligned(size_t size, std::align_val_t align) {
+	heapAllocations.fetch_add(1, std::memory_order_relaxed);
+	size = size? size : 1;
+#ifdef _WIN32
+	return _aligned_malloc(size, (size_t) align);
+#else
+	void *p = NULL;
+	return posix_memalign(&p, (size_t) align < sizeof(void *)? sizeof(void *) : (size_t) align, size)? NULL : p;
+#endif
+}
+
+void FreeAligned(void *p) {
+#ifdef _WIN32
+	_aligned_free(p);
+#else
+	free(p);
+#endif
+}
+
+} // end namespace
+
+void *operator new(size_t size, std::align_val_t align) {
+	if (void *p = AllocateAligned(size, align))
+		return p;
+	throw std::bad_alloc();
+}
+
+void *operator new[](size_t size, std::align_val_t align) { return operator new(size, align); }
+
+void *operator new(size_t size, std::align_val_t align, const std::nothrow_t &) noexcept { return AllocateAligned(size, align); }
+
+void *operator new[](size_t size, std::align_val_t align, const std::nothrow_t &) noexcept { return AllocateAligned(size, align); }
+
+void operator delete(void *p, std::align_val_t) noexcept { FreeAligned(p); }
+
+void operator delete[](void *p, std::align_val_t) noexcept { FreeAligned(p); }
+
+void operator delete(void *p, size_t, std::align_val_t) noexcept { FreeAligned(p); }
+
+void operator delete[](void *p, size_t, std::align_val_t) noexcept { FreeAligned(p); }
+
+void operator delete(void *p, std::align_val_t, const std::nothrow_t &) noexcept { FreeAligned(p); }
+
+void operator delete[](void *p, std::align_val_t, const std::nothrow_t &) noexcept { FreeAligned(p); }
+
+#endif
@@ -1,10 +1,17 @@
 // Mesh.cpp - mesh IO and operations (c) 2019-2022 Jules Bloomenthal
 
+#include "Arena.h"
+#include "AssetCache.h"
+#include "Batch.h"
 #include "CameraArcball.h"
 #include "GLXtras.h"
 #include "Draw.h"
+#include "GLPool.h"
 #include "Mesh.h"
 #include "Misc.h"
+#include "Parallel.h"
+#include "STB_Image.h"
+#include <algorithm>
 #include <assert.h>
 #include <iostream>
 #include <fstream>
@@ -34,17 +41,21 @@ void MeshFramer::Set(Mesh *m, float radius, mat4 fullview) {
 	arcball.SetBody(m->transform, radius);
 	arcball.SetCenter(ScreenPoint(m->frameDown.position, fullview));
 	moverPicked = false;
+	hierarchy.Clear();
+	hierarchy.Add(m);
 }
 
-void MeshFramer::SetFramedown(Mesh *m) {
-	m->frameDown = Frame(Quaternion(m->transform), MatrixOrigin(m->transform), MatrixScale(m->transform));
-	for (int i = 0; i < (int) m->children.size(); i++)
-		SetFramedown(m->children[i]);
+void MeshFramer::SetTransform(mat4 m) {
+	// set mesh transform, move descendants
+	hierarchy.SetLocal(0, mat3x4(m));
+	hierarchy.Update();
 }
 
 void MeshFramer::Down(int x, int y, mat4 modelview, mat4 persp, bool control) {
 	moverPicked = arcball.MouseOver(x, y);
-	SetFramedown(mesh);
+	mesh->frameDown = Frame(Quaternion(mesh->transform), MatrixOrigin(mesh->transform), MatrixScale(mesh->transform));
+	hierarchy.Capture();
+		// pick up transforms changed since the last drag
 	if (moverPicked)
 		mover.Down(&mesh->frameDown.position, x, y, modelview, persp);
 	else
@@ -53,43 +64,19 @@ void MeshFramer::Down(int x, int y, mat4 modelview, mat4 persp, bool control) {
 }
 
 void MeshFramer::Drag(int x, int y, mat4 modelview, mat4 persp) {
+	mat4 m = mesh->transform;
 	if (moverPicked) {
-		vec3 pDif = mover.Drag(x, y, modelview, persp);
-		SetMatrixOrigin(mesh->transform, mesh->frameDown.position);
-		for (int i = 0; i < (int) mesh->children.size(); i++)
-			TranslateTransform(mesh->children[i], pDif);
+		mover.Drag(x, y, modelview, persp);
+		SetMatrixOrigin(m, mesh->frameDown.position);
 		arcball.SetCenter(ScreenPoint(mesh->frameDown.position, persp*modelview));
 	}
 	else {
+		// apply arcball rotation to orientation on mouse down
 		Quaternion qrot = arcball.Drag(x, y);
-		RotateTransform(mesh, qrot, NULL);
-	}
-}
-
-void MeshFramer::RotateTransform(Mesh *m, Quaternion qrot, vec3 *center) {
-	// rotate selected mesh and child meshes by qrot (returned by Arcball::Drag)
-	//   apply qrot to rotation elements of m->transform (upper left 3x3)
-	//   if non-null center, rotate origin of m about center
-	// recursive routine initially called with null center
-	Quaternion qq = m->frameDown.orientation*qrot; // arcball:use=Camera(?) works (qrot*m->qstart Body? fails)
-	// rotate m
-	qq.SetMatrix(m->transform, m->frameDown.scale);
-	if (center) {
-		// this is a child mesh: rotate origin of mesh around center
-		mat4 rot = qrot.GetMatrix();
-		mat4 x = Translate((*center))*rot*Translate(-(*center));
-		vec4 xbase = x*vec4(m->frameDown.position, 1);
-		SetMatrixOrigin(m->transform, vec3(xbase.x, xbase.y, xbase.z));
+		Quaternion qq = mesh->frameDown.orientation*qrot; // arcball:use=Camera(?) works (qrot*m->qstart Body? fails)
+		qq.SetMatrix(m, mesh->frameDown.scale);
 	}
-	for (int i = 0; i < (int) m->children.size(); i++)
-		RotateTransform(m->children[i], qrot, center? center : &m->frameDown.position);
-			// rotate descendant children around initial mesh base  
-}
-
-void MeshFramer::TranslateTransform(Mesh *m, vec3 pDif) {
-	SetMatrixOrigin(m->transform, m->frameDown.position+pDif);
-	for (int i = 0; i < (int) m->children.size(); i++)
-		TranslateTransform(m->children[i], pDif);
+	SetTransform(m);
 }
 
 void MeshFramer::Wheel(double spin, bool shift) {
@@ -118,20 +105,31 @@ const char *meshVertexShader = R"(
 	layout (location = 3) in mat4 instance; // for use with glDrawArrays/ElementsInstanced
 											// uses locations 3,4,5,6 for 4 vec4s = mat4
 	layout (location = 7) in vec3 color;	// for instanced color (vec4?)
+	layout (location = 8) in float occlusion;
 	out vec3 vPoint;
 	out vec3 vNormal;
 	out vec2 vUv;
 	out vec3 vColor;
+	out float vOcclusion;
 	uniform bool useInstance = false;
 	uniform mat4 modelview;
 	uniform mat4 persp;
+	uniform mat4 dequantize = mat4(1);		// packed point to object space (see Quantize.h)
+	uniform bool packedNormals = false;		// normal.xy octahedral
+	vec3 OctDecode(vec2 e) {
+		vec3 n = vec3(e, 1-abs(e.x)-abs(e.y));
+		if (n.z < 0)
+			n.xy = (1-abs(n.yx))*vec2(n.x >= 0? 1 : -1, n.y >= 0? 1 : -1);
+		return normalize(n);
+	}
 	void main() {
 		mat4 m = useInstance? modelview*instance : modelview;
-		vPoint = (m*vec4(point, 1)).xyz;
-		vNormal = (m*vec4(normal, 0)).xyz;
+		vPoint = (m*dequantize*vec4(point, 1)).xyz;
+		vNormal = (m*vec4(packedNormals? OctDecode(normal.xy) : normal, 0)).xyz;
 		gl_Position = persp*vec4(vPoint, 1);
 		vUv = uv;
 		vColor = color;
+		vOcclusion = occlusion;
 	}
 )";
 
@@ -141,6 +139,7 @@ const char *meshPixelShader = R"(
 	in vec3 vNormal;
 	in vec2 vUv;
 	in vec3 vColor;
+	in float vOcclusion;
 	out vec4 pColor;
 	uniform vec3 light;
 	uniform vec3 lights[20];
@@ -154,6 +153,7 @@ const char *meshPixelShader = R"(
 	uniform bool useTint = false;
 	uniform bool fwdFacing = false;
 	uniform bool facetedShading = false;
+	uniform bool useOcclusion = false;
 	float Intensity(vec3 normalV, vec3 eyeV, vec3 point, vec3 light) {
 		vec3 lightV = normalize(light-point);		// light vector
 		vec3 reflectV = reflect(lightV, normalV);   // highlight vector
@@ -171,6 +171,7 @@ const char *meshPixelShader = R"(
 			for (int i = 0; i < nlights; i++)
 				intensity += Intensity(N, E, vPoint, lights[i]);
 			intensity = clamp(intensity, 0, 1);
+			if (useOcclusion) intensity *= 1-vOcclusion;
 		}
 		vec3 color = useTexture? texture(textureName, vUv).rgb : useDefaultColor? defaultColor : vColor;
 		if (useTexture && useTint) {
@@ -205,40 +206,179 @@ void Enable(int id, int ncomps, int offset) {
 	glVertexAttribPointer(id, ncomps, GL_FLOAT, GL_FALSE, 0, (void *) offset);
 }
 
-void Mesh::Buffer(vector<vec3> &pts, vector<vec3> *nrms, vector<vec2> *tex) {
-	int nPts = pts.size(), nNrms = nrms? nrms->size() : 0, nUvs = tex? tex->size() : 0;
+MeshCounters meshCounters;
+
+bool ReserveBuffer(GLuint &buffer, GLenum target, GLsizeiptr size, GLenum usage) {
+	meshCounters.objectsCreated += buffer? 0 : 1;
+	GLuint was = buffer;
+	bool allocated = glPool.ResizeBuffer(buffer, target, size, usage);
+	if (was && buffer != was) {
+		meshCounters.objectsDeleted++;
+		meshCounters.objectsCreated++;
+	}
+	meshCounters.allocations += allocated? 1 : 0;
+	return allocated;
+}
+
+GLuint AcquireVertexArray() {
+	meshCounters.objectsCreated++;
+	return glPool.AcquireVertexArray();
+}
+
+void FreeBuffer(GLuint &buffer) {
+	meshCounters.objectsDeleted += buffer? 1 : 0;
+	glPool.ReleaseBuffer(buffer);
+}
+
+void FreeVertexArray(GLuint &vertexArray) {
+	meshCounters.objectsDeleted += vertexArray? 1 : 0;
+	glPool.ReleaseVertexArray(vertexArray);
+}
+
+Mesh::~Mesh() {
+	ReleaseMeshAsset();
+	ReleaseTextures();
+	FreeBuffer(vBufferId);
+	FreeBuffer(eBufferId);
+	FreeBuffer(edges.buffer);
+	FreeVertexArray(vao);
+}
+
+void Mesh::CreateBuffers() {
+	// acquire vertex array if needed, size element buffer; load triangles into it
+	// (the index arrays are heap, not frameArena: they are sized by the mesh, and made at load, not per frame)
+	ReleaseMeshAsset();								// buffers shared with other meshes aren't written
+	if (!vao)
+		vao = AcquireVertexArray();
+	// triangles, quads as triangle pairs (so one draw covers both), then any coarser levels of detail
+	edges.Clear();
+	nElementQuads = Quads().size();
+	vector<int3> quadTriangles(2*nElementQuads);
+	TriangulateQuads(Quads().data(), nElementQuads, quadTriangles.data());
+	const int3 *sections[] = { Triangles().data(), quadTriangles.data(), lodTriangles.data() };
+	int sizes[] = { (int) Triangles().size(), 2*nElementQuads, (int) lodTriangles.size() };
+	int indexBytes = indexType == GL_UNSIGNED_SHORT? 2 : 4, size = 0;
+	for (int n : sizes)
+		size += 3*indexBytes*n;
+	ReserveBuffer(eBufferId, GL_ELEMENT_ARRAY_BUFFER, size);
+	vector<uint16_t> shortIndices;
+	for (int i = 0, offset = 0; i < 3; i++) {
+		int n = sizes[i], sectionSize = 3*indexBytes*n;
+		if (!n)
+			continue;
+		if (indexType == GL_UNSIGNED_SHORT) {
+			shortIndices.resize(3*n);
+			ToShortIndices(sections[i], n, shortIndices.data());
+			glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, offset, sectionSize, shortIndices.data());
+		}
+		else
+			glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, offset, sectionSize, sections[i]);
+		offset += sectionSize;
+	}
+	meshCounters.bytesUploaded += size;
+}
+
+void Mesh::Buffer(const vector<vec3> &pts, const vector<vec3> *nrms, const vector<vec2> *tex, const vector<float> *occ) {
+	int nPts = pts.size(), nNrms = nrms? nrms->size() : 0, nUvs = tex? tex->size() : 0, nOcc = occ? occ->size() : 0;
 	if (!nPts) { printf("mesh missing points\n"); return; }
-	// create vertex buffer
-	if (!vBufferId)
-		glGenBuffers(1, &vBufferId);
-	glBindBuffer(GL_ARRAY_BUFFER, vBufferId);
-	// allocate GPU memory for vertex position, texture, normals
-	int sizePoints = nPts*sizeof(vec3), sizeNormals = nNrms*sizeof(vec3), sizeUvs = nUvs*sizeof(vec2);
-	int bufferSize = sizePoints+sizeUvs+sizeNormals;
-	glBufferData(GL_ARRAY_BUFFER, bufferSize, NULL, GL_STATIC_DRAW);
+	ringPoints = 0;
+	packed = quantize;
+	indexType = packed && ShortIndices(nPts)? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+	CreateBuffers();
+	if (packed) {
+		// one interleaved array of PackedVertex (heap, as the index arrays)
+		vector<PackedVertex> vertices(nPts);
+		packer.Pack(pts.data(), nNrms? nrms->data() : NULL, nUvs? tex->data() : NULL, nOcc? occ->data() : NULL, nPts, vertices.data());
+		int bufferSize = nPts*sizeof(PackedVertex);
+		ReserveBuffer(vBufferId, GL_ARRAY_BUFFER, bufferSize);
+		glBufferSubData(GL_ARRAY_BUFFER, 0, bufferSize, vertices.data());
+		meshCounters.bytesUploaded += bufferSize;
+		glBindVertexArray(vao);
+		EnablePackedVertex(nNrms > 0, nUvs > 0, nOcc > 0);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+		glBindVertexArray(0);
+		AccountMemory();
+		return;
+	}
+	// size GPU memory for vertex position, texture, normals, occlusion
+	int sizePoints = nPts*sizeof(vec3), sizeNormals = nNrms*sizeof(vec3), sizeUvs = nUvs*sizeof(vec2), sizeOcc = nOcc*sizeof(float);
+	int bufferSize = sizePoints+sizeUvs+sizeNormals+sizeOcc;
+	ReserveBuffer(vBufferId, GL_ARRAY_BUFFER, bufferSize);
 	// load vertex buffer
 	if (nPts) glBufferSubData(GL_ARRAY_BUFFER, 0, sizePoints, pts.data());
 	if (nNrms) glBufferSubData(GL_ARRAY_BUFFER, sizePoints, sizeNormals, nrms->data());
 	if (nUvs) glBufferSubData(GL_ARRAY_BUFFER, sizePoints+sizeNormals, sizeUvs, tex->data());
-	// create and load element buffer for triangles
-	int sizeTriangles = sizeof(int3)*triangles.size();
-	glGenBuffers(1, &eBufferId);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, eBufferId);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeTriangles, triangles.data(), GL_STATIC_DRAW);
-	// create vertex array object for mesh
-	glGenVertexArrays(1, &vao);
+	if (nOcc) glBufferSubData(GL_ARRAY_BUFFER, sizePoints+sizeNormals+sizeUvs, sizeOcc, occ->data());
+	meshCounters.bytesUploaded += bufferSize;
 	glBindVertexArray(vao);
 	// enable attributes
 	if (nPts) Enable(0, 3, 0);						// VertexAttribPointer(shader, "point", 3, 0, (void *) 0);
 	if (nNrms) Enable(1, 3, sizePoints);			// VertexAttribPointer(shader, "normal", 3, 0, (void *) sizePoints);
 	if (nUvs) Enable(2, 2, sizePoints+sizeNormals); // VertexAttribPointer(shader, "uv", 2, 0, (void *) (sizePoints+sizeNormals));
+	if (nOcc) Enable(8, 1, sizePoints+sizeNormals+sizeUvs);
+	else glDisableVertexAttribArray(8);
 	glBindBuffer(GL_ARRAY_BUFFER, 0);
 	glBindVertexArray(0);
+	AccountMemory();
 }
 
-void Mesh::Buffer() { Buffer(points, normals.size()? &normals : NULL, uvs.size()? &uvs : NULL); }
+void Mesh::UpdatePoints() {
+	const vector<vec3> &pts = Points(), &nrms = Normals();
+	const vector<vec2> &tex = Uvs();
+	int nPts = pts.size(), nNrms = nrms.size() == pts.size()? nPts : 0;
+	if (!nPts) { printf("mesh missing points\n"); return; }
+	int sizePoints = nPts*sizeof(vec3), sizeNormals = nNrms*sizeof(vec3), slotSize = sizePoints+sizeNormals;
+	if (nPts != ringPoints || (nNrms > 0) != ringNormals) {
+		// buffer layout: ringSlots of (points, normals), then uvs and occlusion, which do not change
+		int nUvs = tex.size() == pts.size()? nPts : 0, nOcc = occlusion.size() == pts.size()? nPts : 0;
+		int sizeUvs = nUvs*sizeof(vec2), sizeOcc = nOcc*sizeof(float), ringSize = ringSlots*slotSize;
+		CreateBuffers();
+		ReserveBuffer(vBufferId, GL_ARRAY_BUFFER, ringSize+sizeUvs+sizeOcc, GL_STREAM_DRAW);
+		if (nUvs) glBufferSubData(GL_ARRAY_BUFFER, ringSize, sizeUvs, tex.data());
+		if (nOcc) glBufferSubData(GL_ARRAY_BUFFER, ringSize+sizeUvs, sizeOcc, occlusion.data());
+		meshCounters.bytesUploaded += sizeUvs+sizeOcc;
+		glBindVertexArray(vao);
+		if (nUvs) Enable(2, 2, ringSize);
+		else glDisableVertexAttribArray(2);
+		if (nOcc) Enable(8, 1, ringSize+sizeUvs);
+		else glDisableVertexAttribArray(8);
+		ringPoints = nPts;
+		ringNormals = nNrms > 0;
+		packed = false;
+		ringSlot = ringSlots-1;
+		AccountMemory();
+	}
+	// write the next slot and point the vertex array at it
+	ringSlot = (ringSlot+1)%ringSlots;
+	int offset = ringSlot*slotSize;
+	glBindBuffer(GL_ARRAY_BUFFER, vBufferId);
+	char *p = (char *) glMapBufferRange(GL_ARRAY_BUFFER, offset, slotSize,
+		GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+	if (p) {
+		memcpy(p, pts.data(), sizePoints);
+		if (nNrms) memcpy(p+sizePoints, nrms.data(), sizeNormals);
+		glUnmapBuffer(GL_ARRAY_BUFFER);
+	}
+	else {
+		glBufferSubData(GL_ARRAY_BUFFER, offset, sizePoints, pts.data());
+		if (nNrms) glBufferSubData(GL_ARRAY_BUFFER, offset+sizePoints, sizeNormals, nrms.data());
+	}
+	meshCounters.bytesUploaded += slotSize;
+	glBindVertexArray(vao);
+	Enable(0, 3, offset);
+	if (nNrms) Enable(1, 3, offset+sizePoints);
+	else glDisableVertexAttribArray(1);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	glBindVertexArray(0);
+}
+
+void Mesh::Buffer() {
+	Buffer(Points(), Normals().size()? &Normals() : NULL, Uvs().size()? &Uvs() : NULL,
+		   occlusion.size() == Points().size()? &occlusion : NULL);
+}
 
 void Mesh::Set(vector<vec3> &pts, vector<vec3> *nrms, vector<vec2> *tex, vector<int> *tris, vector<int> *quas) {
+	OwnGeometry();
 	if (tris) {
 		triangles.resize(tris->size()/3);
 		for (int i = 0; i < (int) triangles.size(); i++)
@@ -249,17 +389,158 @@ void Mesh::Set(vector<vec3> &pts, vector<vec3> *nrms, vector<vec2> *tex, vector<
 		for (int i = 0; i < (int) quads.size(); i++)
 			quads[i] = { (*quas)[4*i], (*quas)[4*i+1], (*quas)[4*i+2], (*quas)[4*i+3] };
 	}
+	topology.Clear();
+	lodTriangles.resize(0);
+	lods.resize(0);
+	meshlets.resize(0);
 	Buffer(pts, nrms, tex);
 }
 
+void Mesh::SetNormals(NormalWeight w) {
+	OwnGeometry();
+	SetVertexNormals(points, triangles, topology.vertexCorners, normals, w);
+}
+
+CornerTable &Mesh::Topology() {
+	int nPoints = (int) Points().size();
+	if (!topology.Current(nPoints, (int) Triangles().size()))
+		topology.Build(Triangles(), nPoints);
+	return topology;
+}
+
+void Mesh::BuildMeshlets(int maxVertices, int maxTriangles) {
+	OwnGeometry();
+	::BuildMeshlets(points, triangles, meshlets, maxVertices, maxTriangles);
+	topology.Clear();
+	CornerTable &t = Topology();
+	meshletCull.backface = t.nBoundaryEdges == 0 && t.nNonManifoldEdges == 0;
+	if (meshAsset)
+		Buffer();									// own buffers, as the asset's keep the old order
+	else if (vao)
+		CreateBuffers();
+	AccountMemory();
+}
+
+int Mesh::SelectLod(CameraAB &camera) {
+	int nLevels = (int) lods.size(), level = 0;
+	if (nLevels < 2 || lodPixels <= 0)
+		return 0;
+	// pixels per object space unit at the near side of the bounding sphere
+	mat3x4 m(camera.modelview*transform);
+	vec3 c = m.Point(lodCenter);
+	float scale = 0;
+	for (int k = 0; k < 3; k++) {
+		float s = length(vec3(m.row[0][k], m.row[1][k], m.row[2][k]));
+		scale = s > scale? s : scale;
+	}
+	float dist = -c.z-scale*lodRadius;
+	if (dist <= 0)
+		return 0;
+	int width, height;
+	GetViewportSize(width, height);
+	float pixelsPerUnit = scale*camera.persp[1][1]*.5f*height/dist;
+	while (level+1 < nLevels && lods[level+1].error*pixelsPerUnit < lodPixels)
+		level++;
+	return level;
+}
+
+void TriangulateQuads(const int4 *quads, int n, int3 *out) {
+	for (int i = 0; i < n; i++) {
+		const int4 &q = quads[i];
+		out[2*i] = int3(q.i1, q.i2, q.i3);
+		out[2*i+1] = int3(q.i1, q.i3, q.i4);
+	}
+}
+
+// Edges
+
+void AddEdges(const int3 *triangles, int nTriangles, const int4 *quads, int nQuads,
+			  vector<uint64_t> &keys, vector<uint64_t> &added) {
+	added.resize(0);
+	added.reserve(3*nTriangles+4*nQuads);
+	auto Add = [&added](int a, int b) {
+		if (a != b)
+			added.push_back(a < b? (uint64_t) a << 32 | (uint32_t) b : (uint64_t) b << 32 | (uint32_t) a);
+	};
+	for (int i = 0; i < nTriangles; i++) {
+		const int3 &t = triangles[i];
+		Add(t.i1, t.i2); Add(t.i2, t.i3); Add(t.i3, t.i1);
+	}
+	for (int i = 0; i < nQuads; i++) {
+		const int4 &q = quads[i];
+		Add(q.i1, q.i2); Add(q.i2, q.i3); Add(q.i3, q.i4); Add(q.i4, q.i1);
+	}
+	std::sort(added.begin(), added.end());
+	added.erase(std::unique(added.begin(), added.end()), added.end());
+	if (keys.size())
+		added.erase(std::remove_if(added.begin(), added.end(), [&keys](uint64_t k) {
+			return std::binary_search(keys.begin(), keys.end(), k); }), added.end());
+	size_t nKeys = keys.size();
+	keys.insert(keys.end(), added.begin(), added.end());
+	std::inplace_merge(keys.begin(), keys.begin()+nKeys, keys.end());
+}
+
+void Mesh::UpdateEdges() {
+	const vector<int3> &tris = Triangles();
+	const vector<int4> &quas = Quads();
+	int nTris = tris.size(), nQuads = quas.size();
+	if (nTris < edges.nTriangles || nQuads < edges.nQuads || indexType != edges.indexType)
+		edges.Clear();
+	if (edges.buffer && nTris == edges.nTriangles && nQuads == edges.nQuads)
+		return;
+	vector<uint64_t> added;
+	AddEdges(tris.data()+edges.nTriangles, nTris-edges.nTriangles,
+			 quas.data()+edges.nQuads, nQuads-edges.nQuads, edges.keys, added);
+	edges.nTriangles = nTris;
+	edges.nQuads = nQuads;
+	edges.indexType = indexType;
+	// append the new edges, or, if they don't fit, reallocate and load all
+	int indexBytes = indexType == GL_UNSIGNED_SHORT? 2 : 4;
+	GLsizeiptr size = 2*indexBytes*(GLsizeiptr) edges.keys.size();
+	bool grow = !edges.buffer || size > edges.capacity;
+	vector<uint64_t> &load = grow? edges.keys : added;
+	if (grow) {
+		ReserveBuffer(edges.buffer, GL_ELEMENT_ARRAY_BUFFER, std::max(size, 3*edges.capacity/2), GL_DYNAMIC_DRAW);
+		edges.capacity = glPool.Capacity(edges.buffer);
+		edges.nBuffered = 0;
+		AccountMemory();
+	}
+	else
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, edges.buffer);
+	int n = load.size();
+	if (!n)
+		return;
+	ArenaScope scope;
+	ArenaVector<uint32_t> ints(indexBytes == 4? 2*n : 0);
+	ArenaVector<uint16_t> shorts(indexBytes == 2? 2*n : 0);
+	for (int i = 0; i < n; i++) {
+		uint32_t a = (uint32_t) (load[i] >> 32), b = (uint32_t) load[i];
+		if (indexBytes == 2) {
+			shorts[2*i] = (uint16_t) a;
+			shorts[2*i+1] = (uint16_t) b;
+		}
+		else {
+			ints[2*i] = a;
+			ints[2*i+1] = b;
+		}
+	}
+	glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, 2*indexBytes*edges.nBuffered, 2*indexBytes*n,
+					indexBytes == 2? (void *) shorts.data() : (void *) ints.data());
+	meshCounters.bytesUploaded += 2*indexBytes*n;
+	edges.nBuffered += n;
+}
+
+// Display
+
 void Mesh::Display(CameraAB camera, bool lines) {
-	int nTris = triangles.size(), nQuads = quads.size();
-	bool useTexture = textureUnit > 0 && uvs.size() > 0;
+	int nTris = Triangles().size();
+	bool useTexture = textureUnit > 0 && Uvs().size() > 0;
 	// enable shader and vertex array object
 	int shader = UseMeshShader();
 	glBindVertexArray(vao);
 	// texture
 	SetUniform(shader, "useTexture", useTexture);
+	SetUniform(shader, "useOcclusion", occlusion.size() == Points().size());
 	if (useTexture) {
 		glActiveTexture(GL_TEXTURE0+textureName);   // Unit? active texture corresponds with textureUnit or textureName?
 		glBindTexture(GL_TEXTURE_2D, textureName);  // bound texture and shader id correspond with textureName
@@ -268,30 +549,181 @@ void Mesh::Display(CameraAB camera, bool lines) {
 	// set custom transform and draw (xform = mesh transforms X view transform)
 	SetUniform(shader, "modelview", camera.modelview*transform);
 	SetUniform(shader, "persp", camera.persp);
+	SetUniform(shader, "dequantize", packed? packer.Dequantize() : mat4());
+	SetUniform(shader, "packedNormals", packed);
 	if (lines) {
-		for (int i = 0; i < nTris; i++)
-			glDrawElements(GL_LINE_LOOP, 3, GL_UNSIGNED_INT, &triangles[i]);
-		for (int i = 0; i < nQuads; i++)
-			glDrawElements(GL_LINE_LOOP, 4, GL_UNSIGNED_INT, &quads[i]);
+		UpdateEdges();
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, edges.buffer);
+		glDrawElements(GL_LINES, 2*edges.nBuffered, edges.indexType, 0);
+		meshCounters.drawCalls++;
 	}
 	else {
+		// triangles and quads from the element buffer; quad triangles follow triangles, so level 0 is one
+		// range, and coarser levels (past the quads) or culled meshlets add the quads as a last range
+		lodLevel = SelectLod(camera);
+		int indexBytes = indexType == GL_UNSIGNED_SHORT? 2 : 4, nQuadTris = 2*nElementQuads;
+		auto Offset = [indexBytes](int triangle) { return (const void *) (size_t) (3*triangle*indexBytes); };
 		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, eBufferId);
-		glDrawElements(GL_TRIANGLES, 3*nTris, GL_UNSIGNED_INT, 0);
-//		glDrawElements(GL_TRIANGLES, 3*nTris, GL_UNSIGNED_INT, triangles.data());
-#ifdef GL_QUADS
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
-		glDrawElements(GL_QUADS, 4*nQuads, GL_UNSIGNED_INT, quads.data());
-#endif
+		if (lodLevel == 0 && meshlets.size()) {
+			meshletCull.indexBytes = indexBytes;
+			CullMeshlets(meshlets, camera.modelview*transform, camera.persp, meshletCull);
+			if (nQuadTris) {
+				meshletCull.counts.push_back(3*nQuadTris);
+				meshletCull.offsets.push_back(Offset(nTris));
+			}
+			glMultiDrawElements(GL_TRIANGLES, meshletCull.counts.data(), indexType,
+								meshletCull.offsets.data(), (GLsizei) meshletCull.counts.size());
+		}
+		else if (lodLevel > 0) {
+			GLsizei counts[] = { 3*lods[lodLevel].count, 3*nQuadTris };
+			const void *offsets[] = { Offset(lods[lodLevel].first+nQuadTris), Offset(nTris) };
+			glMultiDrawElements(GL_TRIANGLES, counts, indexType, offsets, nQuadTris? 2 : 1);
+		}
+		else
+			glDrawElements(GL_TRIANGLES, 3*(nTris+nQuadTris), indexType, 0);
+		meshCounters.drawCalls++;
 	}
 	glBindVertexArray(0);
 }
 
+// Assets
+
+size_t MeshGeometry::Bytes() const {
+	return points.capacity()*sizeof(vec3)+normals.capacity()*sizeof(vec3)+uvs.capacity()*sizeof(vec2)+
+		   triangles.capacity()*sizeof(int3)+quads.capacity()*sizeof(int4);
+}
+
+void Mesh::OwnGeometry() {
+	if (!sharedGeometry)
+		return;
+	const MeshGeometry &g = *sharedGeometry;
+	points = g.points;
+	normals = g.normals;
+	uvs = g.uvs;
+	triangles = g.triangles;
+	quads = g.quads;
+	sharedGeometry.reset();
+	AccountMemory();
+}
+
+void Mesh::ShareGeometry() {
+	OwnGeometry();
+	MeshGeometry *g = new MeshGeometry();
+	g->points.swap(points);
+	g->normals.swap(normals);
+	g->uvs.swap(uvs);
+	g->triangles.swap(triangles);
+	g->quads.swap(quads);
+	sharedGeometry.reset(g);
+	AccountMemory();
+}
+
+void Mesh::Share(MeshAsset *a) {
+	Mesh &s = *a->mesh;
+	ReleaseMeshAsset();
+	FreeBuffer(vBufferId);
+	FreeBuffer(eBufferId);
+	FreeVertexArray(vao);
+	meshAsset = a;
+	objFilename = s.objFilename;
+	sharedGeometry = s.sharedGeometry;
+	// the mesh's own arrays, freed
+	vector<vec3>().swap(points);
+	vector<vec3>().swap(normals);
+	vector<vec2>().swap(uvs);
+	vector<int3>().swap(triangles);
+	vector<int4>().swap(quads);
+	occlusion.resize(0);
+	topology.Clear();
+	lodTriangles.resize(0);
+	lods.resize(0);
+	meshlets.resize(0);
+	edges.Clear();
+	packed = s.packed;
+	packer = s.packer;
+	indexType = s.indexType;
+	vao = s.vao;
+	vBufferId = s.vBufferId;
+	eBufferId = s.eBufferId;
+	nElementQuads = s.nElementQuads;
+	ringPoints = 0;
+	AccountMemory();
+}
+
+void Mesh::ReleaseMeshAsset() {
+	if (!meshAsset)
+		return;
+	vao = vBufferId = eBufferId = 0;
+	meshAsset->Release();
+	meshAsset = NULL;
+}
+
+GLuint Mesh::ReadTexture(string texFile) {
+	if (!shareAssets) {
+		// as assetCache loads it, but held by this mesh alone
+		int width, height, channels;
+		stbi_set_flip_vertically_on_load(true);
+		unsigned char *data = stbi_load(texFile.c_str(), &width, &height, &channels, 0);
+		if (!data) {
+			printf("ReadTexture: can't open %s (%s)\n", texFile.c_str(), stbi_failure_reason());
+			return 0;
+		}
+		GLuint name = glPool.AcquireTexture(width, height, channels == 4? GL_RGBA : GL_RGB, true);
+		LoadTexture(data, width, height, channels, textureUnit, name, false, true);
+		stbi_image_free(data);
+		ownTextures.push_back(name);
+		textureBytes += (size_t) width*height*(channels == 4? 4 : 3)*4/3;	// with mipmaps
+		return name;
+	}
+	TextureAsset *t = assetCache.GetTexture(texFile);
+	if (!t)
+		return 0;
+	textureAssets.push_back(t);
+	return t->textureName;
+}
+
+void Mesh::ReleaseTextures() {
+	for (TextureAsset *t : textureAssets)
+		t->Release();
+	textureAssets.resize(0);
+	for (GLuint &t : ownTextures)
+		glPool.ReleaseTexture(t);
+	ownTextures.resize(0);
+	textureBytes = 0;
+}
+
+// Read
+
 bool Mesh::Read(string objFile, mat4 *m, bool normalize) {
+	if (shareAssets) {
+		// read and buffer once per file and options
+		string options = string("Mesh")+(normalize? " normalize" : "")+(quantize? " quantize" : "");
+		MeshAsset *a = assetCache.GetMesh(AssetKey(objFile, options), [&]() -> Mesh * {
+			Mesh *mesh = new Mesh();
+			mesh->shareAssets = false;
+			mesh->quantize = quantize;
+			if (mesh->Read(objFile, NULL, normalize))
+				return mesh;
+			delete mesh;
+			return NULL;
+		});
+		if (!a)
+			return false;
+		Share(a);
+		if (m)
+			transform = *m;
+		return true;
+	}
+	sharedGeometry.reset();
 	if (!ReadAsciiObj((char *) objFile.c_str(), points, triangles, &normals, &uvs, NULL, NULL, &quads)) {
 		printf("Mesh.Read: can't read %s\n", objFile.c_str());
 		return false;
 	}
 	objFilename = objFile;
+	topology.Clear();
+	lodTriangles.resize(0);
+	lods.resize(0);
+	meshlets.resize(0);
 	if (normalize)
 		Normalize(points, 1);
 	Buffer();
@@ -310,12 +742,31 @@ bool Mesh::Read(string objFile, string texFile, int texUnit, mat4 *m, bool norma
 	objFilename = objFile;
 	texFilename = texFile;
 	textureUnit = texUnit;
-	textureName = LoadTexture((char *) texFile.c_str(), textureUnit);
+	ReleaseTextures();
+	textureName = ReadTexture(texFile);
 	if (!textureName)
 		printf("Mesh.Read: bad texture name\n");
+	AccountMemory();
 	return textureName > 0;
 }
 
+// Memory
+
+void Mesh::AccountMemory() {
+	memory.Name(objFilename.size()? objFilename : "mesh");
+	memory.Set(MemPoints, points.capacity()*sizeof(vec3));
+	memory.Set(MemNormals, normals.capacity()*sizeof(vec3));
+	memory.Set(MemUvs, uvs.capacity()*sizeof(vec2));
+	memory.Set(MemTriangles, triangles.capacity()*sizeof(int3));
+	memory.Set(MemQuads, quads.capacity()*sizeof(int4));
+	memory.Set(MemCpuOther, occlusion.capacity()*sizeof(float)+lodTriangles.capacity()*sizeof(int3)+
+			   lods.capacity()*sizeof(LodLevel)+meshlets.capacity()*sizeof(Meshlet)+edges.keys.capacity()*sizeof(uint64_t));
+	// buffers drawn from a shared asset are reported by the asset's mesh
+	memory.Set(MemVertexBuffer, meshAsset? 0 : glPool.Capacity(vBufferId));
+	memory.Set(MemElementBuffer, (meshAsset? 0 : glPool.Capacity(eBufferId))+glPool.Capacity(edges.buffer));
+	memory.Set(MemTexture, textureBytes);
+}
+
 // intersections
 
 vec2 MajPln(vec3 &p, int mp) { return mp == 1? vec2(p.y, p.z) : mp == 2? vec2(p.x, p.z) : vec2(p.x, p.y); }
@@ -453,49 +904,54 @@ void Normalize(vector<VertexSTL> &vertices, float scale) {
 // normalize vec3 models
 
 void MinMax(vector<vec3> &points, vec3 &min, vec3 &max) {
-	min[0] = min[1] = min[2] = FLT_MAX;
-	max[0] = max[1] = max[2] = -FLT_MAX;
-	for (int i = 0; i < (int) points.size(); i++) {
-		vec3 &v = points[i];
-		for (int k = 0; k < 3; k++) {
-			if (v[k] < min[k]) min[k] = v[k];
-			if (v[k] > max[k]) max[k] = v[k];
-		}
-	}
+	MinMax(points.data(), (int) points.size(), min, max);
 }
 
 void Normalize(vector<vec3> &points, float scale) {
-	vec3 min, max;
+	vec3 min, max, center;
 	MinMax(points, min, max);
-	vec3 center(.5f*(min[0]+max[0]), .5f*(min[1]+max[1]), .5f*(min[2]+max[2]));
-	float maxrange = 0;
-	for (int k = 0; k < 3; k++)
-		if ((max[k]-min[k]) > maxrange)
-			maxrange = max[k]-min[k];
-	float s = scale*2.f/maxrange;
-	for (int i = 0; i < (int) points.size(); i++) {
-		vec3 &v = points[i];
-		for (int k = 0; k < 3; k++)
-			v[k] = s*(v[k]-center[k]);
-	}
+	float s = GetScaleCenter(min, max, scale, center);
+	XformPoints(Scale(s, s, s)*Translate(-center), points);
 }
 
-void SetVertexNormals(vector<vec3> &points, vector<int3> &triangles, vector<vec3> &normals) {
-	// size normals array and initialize to zero
-	int nverts = (int) points.size();
-	normals.resize(nverts, vec3(0,0,0));
-	// accumulate each triangle normal into its three vertex normals
-	for (int i = 0; i < (int) triangles.size(); i++) {
-		int3 &t = triangles[i];
-		vec3 &p1 = points[t.i1], &p2 = points[t.i2], &p3 = points[t.i3];
-		vec3 a(p2-p1), b(p3-p2), n(normalize(cross(a, b)));
-		normals[t.i1] += n;
-		normals[t.i2] += n;
-		normals[t.i3] += n;
+void SetVertexNormals(const vector<vec3> &points, const vector<int3> &triangles, VertexTriangles &adjacency,
+					  vector<vec3> &normals, NormalWeight w) {
+	int nverts = (int) points.size(), ntris = (int) triangles.size();
+	if (!adjacency.Current(nverts, ntris))
+		adjacency.Build(triangles, nverts);
+	// triangle normals (unit unless weighted by area) and, if needed, corner angles
+	vector<vec3> &triNormals = adjacency.triNormals;
+	vector<float> &angles = adjacency.angles;
+	triNormals.resize(ntris);
+	TriangleNormals(points.data(), triangles.data(), triNormals.data(), ntris, w != AreaWeight);
+	if (w == AngleWeight) {
+		angles.resize(3*ntris);
+		TriangleAngles(points.data(), triangles.data(), angles.data(), ntris);
 	}
+	// gather: each vertex sums its own triangles, so vertices are independent
+	normals.resize(nverts);
+	const int *offsets = adjacency.offsets.data(), *corners = adjacency.corners.data();
+	const vec3 *tn = triNormals.data();
+	const float *a = angles.data();
+	ParallelFor(nverts, [&](int begin, int end) {
+		for (int i = begin; i < end; i++) {
+			vec3 n(0, 0, 0);
+			if (w == AngleWeight)
+				for (int k = offsets[i]; k < offsets[i+1]; k++)
+					n += a[corners[k]]*tn[corners[k]/3];
+			else
+				for (int k = offsets[i]; k < offsets[i+1]; k++)
+					n += tn[corners[k]/3];
+			normals[i] = n;
+		}
+	}, 4096);
 	// set to unit length
-	for (int i = 0; i < nverts; i++)
-		normals[i] = normalize(normals[i]);
+	NormalizeVectors(normals.data(), nverts);
+}
+
+void SetVertexNormals(const vector<vec3> &points, const vector<int3> &triangles, vector<vec3> &normals, NormalWeight w) {
+	VertexTriangles adjacency;
+	SetVertexNormals(points, triangles, adjacency, normals, w);
 }
 
 // ASCII support
@@ -685,6 +1141,8 @@ bool ReadAsciiObj(const char    *filename,
 	vec3 v;
 	int group = 0;
 	char line[LineLim], word[WordLim];
+	ArenaScope scope;
+	ArenaVector<int> vids;                                  // of the current face
 	vector<vec3> tmpVertices, tmpNormals;
 	vector<vec2> tmpTextures;
 	VidMap vidMap;
@@ -769,7 +1227,6 @@ bool ReadAsciiObj(const char    *filename,
 			tmpTextures.push_back(vec2(t.x, t.y));
 		}
 		else if (!strcmp(word, "f")) {                      // read triangle or polygon
-			static vector<int> vids;
 			vids.resize(0);
 			while (ReadWord(ptr, word, WordLim)) {          // read arbitrary # face vid/tid/nid
 				// set texture and normal pointers to preceding /
@@ -4,9 +4,15 @@
 #define MESH_HDR
 
 #include <glad.h>
+#include <memory>
 #include <stdio.h>
 #include <vector>
 #include "CameraArcball.h"
+#include "CornerTable.h"
+#include "MemoryLedger.h"
+#include "Meshlet.h"
+#include "Quantize.h"
+#include "SceneGraph.h"
 #include "VecMat.h"
 
 using std::string;
@@ -17,63 +23,186 @@ using std::vector;
 GLuint GetMeshShader();
 GLuint UseMeshShader();
 
-class Frame {
-public:
-	Frame() { };
-	Frame(Quaternion q, vec3 p, float s) : orientation(q), position(p), scale(s) { };
-	Quaternion orientation;
-	vec3 position;
-	float scale = 1;
+struct MeshAsset;
+struct TextureAsset;
+
+struct MeshCounters {
+	size_t bytesUploaded = 0;			// vertex and element data written to GPU buffers
+	int allocations = 0;				// glBufferData calls, each (re)allocating GPU storage
+	int objectsCreated = 0;				// buffers and vertex arrays acquired (from glPool: generated or reused)
+	int objectsDeleted = 0;				// released to glPool
+	int drawCalls = 0;					// glDraw* calls (a multi-draw counts once)
+};
+
+extern MeshCounters meshCounters;
+	// totals over all meshes since the last reset (meshCounters = MeshCounters()), eg, once per frame
+
+bool ReserveBuffer(GLuint &buffer, GLenum target, GLsizeiptr size, GLenum usage = GL_STATIC_DRAW);
+	// glPool.ResizeBuffer, counted in meshCounters
+GLuint AcquireVertexArray();
+void FreeBuffer(GLuint &buffer);
+void FreeVertexArray(GLuint &vertexArray);
+	// release to glPool, counted in meshCounters
+
+struct LodLevel {
+	int first = 0, count = 0;			// triangles [first, first+count) of triangles then lodTriangles
+	float error = 0;					// geometric error (object space distance) of the level
+};
+
+struct MeshEdges {
+	vector<uint64_t> keys;				// unique edges, sorted, each (lower index << 32) | higher index
+	int nTriangles = 0, nQuads = 0;		// faces listed (a prefix of triangles and quads)
+	GLuint buffer = 0;					// element buffer of edge index pairs, drawn as GL_LINES
+	int nBuffered = 0;					// edges in buffer (appended as listed)
+	GLsizeiptr capacity = 0;			// bytes allocated for buffer
+	GLenum indexType = GL_UNSIGNED_INT;
+	void Clear() { keys.resize(0); nTriangles = nQuads = nBuffered = 0; }
+		// relist all faces on the next update; buffer is kept
+};
+
+void AddEdges(const int3 *triangles, int nTriangles, const int4 *quads, int nQuads,
+			  vector<uint64_t> &keys, vector<uint64_t> &added);
+	// set added to the edges of the faces not already in keys (each once, sorted), and merge them into keys;
+	// a quad has four edges (not its diagonal)
+
+enum NormalWeight { UniformWeight = 0, AreaWeight, AngleWeight };
+	// contribution of a triangle normal to a vertex normal: equal, by triangle area, or by angle at the vertex
+
+struct MeshGeometry {
+	// read-only arrays shared by the meshes drawn from one asset (see Mesh::Share)
+	vector<vec3> points, normals;
+	vector<vec2> uvs;
+	vector<int3> triangles;
+	vector<int4> quads;
+	size_t Bytes() const;
 };
 
 class Mesh {
 public:
 	Mesh() { };
-	~Mesh() { glDeleteBuffers(1, &vBufferId); };
+	virtual ~Mesh();					// virtual, as assets hold a Meshadow as a Mesh
 	string objFilename, texFilename;
-	// vertices and facets
+	// vertices and facets, the mesh's own (empty while sharedGeometry is set: read with Points() etc.)
 	vector<vec3> points;
 	vector<vec3> normals;
 	vector<vec2> uvs;
+	vector<float> occlusion;			// optional per-vertex ambient occlusion (see AmbientOcclusion.h)
 	vector<int3> triangles;
 	vector<int4> quads;
 	// position/orientation
 	mat4 transform;						// object to world space, set during drag
 	Frame frameDown;					// reference frame on mouse down
 	// hierarchy
-	vector<Mesh *> children;
+	vector<Mesh *> children;			// moved with this mesh by MeshFramer (see SceneGraph.h)
+	// level of detail (see Simplify.h)
+	vector<int3> lodTriangles;			// levels 1 on, after triangles in the element buffer
+	vector<LodLevel> lods;				// empty, or level 0 (triangles) through the coarsest
+	vec3 lodCenter;						// bounding sphere, object space
+	float lodRadius = 0;
+	float lodPixels = 1;				// Display draws the coarsest level whose error projects below this
+	int lodLevel = 0;					// level drawn by the last Display
+	// clusters (see Meshlet.h)
+	vector<Meshlet> meshlets;			// if set, Display culls them when drawing level 0
+	MeshletCull meshletCull;			// options and counts of the last cull
+	// packed vertex format (see Quantize.h)
+	bool quantize = false;				// Buffer packs points, normals, uvs, occlusion and, if possible, indices
+	bool packed = false;				// the vertex buffer holds PackedVertex (else floats)
+	VertexPacker packer;				// dequantization and round trip errors of the last packed Buffer
+	GLenum indexType = GL_UNSIGNED_INT;	// of the element buffer; GL_UNSIGNED_SHORT if packed with < 65537 points
+	// connectivity
+	CornerTable topology;				// built on demand (Topology, SetNormals), cleared by Read and Set
 	// GPU vertex buffer and texture
 	GLuint vao = 0;						// vertex array object
 	GLuint vBufferId = 0;				// vertex buffer
-	GLuint eBufferId = 0;				// element (triangle) buffer
+	GLuint eBufferId = 0;				// element buffer: triangles, quads (two triangles each), lodTriangles
+	int nElementQuads = 0;				// quads in the element buffer when last loaded
 	GLuint textureName = 0, textureUnit = 0;
+	// wireframe (see UpdateEdges)
+	MeshEdges edges;
+	// shared assets (see AssetCache.h)
+	bool shareAssets = true;			// Read acquires geometry, buffers and textures from assetCache
+	MeshAsset *meshAsset = NULL;		// if set, vao and buffers are the asset's, until the mesh re-buffers
+	std::shared_ptr<const MeshGeometry> sharedGeometry;	// if set, the asset's, until the mesh changes it
+	vector<TextureAsset *> textureAssets;	// textures held
+	vector<GLuint> ownTextures;			// textures read for this mesh alone (shareAssets false), from glPool
+	// memory accounting (see MemoryLedger.h)
+	MemoryOwner memory{"mesh"};			// named by objFilename
+	size_t textureBytes = 0;			// textures loaded by this mesh (shared ones are assetCache's)
+	// streamed points (see UpdatePoints)
+	int ringSlots = 3;					// copies of points and normals in the vertex buffer
+	int ringSlot = 0, ringPoints = 0;	// slot last written, points per slot (0 if not streaming)
+	bool ringNormals = false;
+	// geometry: shared or own
+	const vector<vec3> &Points() const { return sharedGeometry? sharedGeometry->points : points; }
+	const vector<vec3> &Normals() const { return sharedGeometry? sharedGeometry->normals : normals; }
+	const vector<vec2> &Uvs() const { return sharedGeometry? sharedGeometry->uvs : uvs; }
+	const vector<int3> &Triangles() const { return sharedGeometry? sharedGeometry->triangles : triangles; }
+	const vector<int4> &Quads() const { return sharedGeometry? sharedGeometry->quads : quads; }
+	void OwnGeometry();
+		// copy shared geometry into points, normals, uvs, triangles and quads (copy on first write); call it
+		// before changing them; SetNormals, BuildMeshlets, Set and Read do
+	void ShareGeometry();
+		// move points, normals, uvs, triangles and quads into sharedGeometry, for other meshes to share
 	// operations
 	void Buffer();
-	void Buffer(vector<vec3> &pts, vector<vec3> *nrms = NULL, vector<vec2> *uvs = NULL);
-		// if non-null, nrms and uvs assumed same size as pts
+		// buffer points, normals, uvs, and occlusion (if set), packed if quantize
+	void Buffer(const vector<vec3> &pts, const vector<vec3> *nrms = NULL, const vector<vec2> *uvs = NULL,
+				const vector<float> *occ = NULL);
+		// if non-null, nrms, uvs, and occ assumed same size as pts; may be called again to re-buffer
+	void UpdatePoints();
+		// stream points (and normals, if set) after an in-place change (OwnGeometry first), eg, a deformation
+		// the first call (or one after a change in point count) allocates a vertex buffer holding ringSlots
+		// copies of them, plus uvs and occlusion; later calls write the next copy (unsynchronized, as
+		// the GPU may still read the last ringSlots-1) and allocate nothing; triangles and quads must
+		// not change between calls; streamed points are not packed
 	void Set(vector<vec3> &pts, vector<vec3> *nrms = NULL, vector<vec2> *tex = NULL,
 			 vector<int> *tris = NULL, vector<int> *quas = NULL);
 			 // **** maybe we don't want this routine
 	void Display(CameraAB camera, bool lines = false);
+		// lines draws each edge once, in one call
+	void UpdateEdges();
+		// list the edges of triangles and quads added since the last call (all of them, after Read, Set,
+		// or a re-layout by Buffer or UpdatePoints) and append them to the edge buffer, growing it by half
+		// if full; a fixed topology (eg, streamed points) costs nothing; Display calls it in line mode
+	virtual void AccountMemory();
+		// report the bytes of arrays, buffers and textures held to memoryLedger (shared geometry is the
+		// asset's to report); called by Read, Buffer, UpdatePoints (on re-layout), UpdateEdges (on growth),
+		// BuildMeshlets, Share and OwnGeometry; call it after other changes to the arrays
+	void BuildMeshlets(int maxVertices = 64, int maxTriangles = 124);
+		// reorder triangles into meshlets (re-buffer if set); back-face culling is enabled only if closed
+	int SelectLod(CameraAB &camera);
+		// coarsest level whose error, projected at the near side of the bounding sphere, is below lodPixels
+	void SetNormals(NormalWeight w = UniformWeight);
+		// recompute normals from points (eg, after deformation; then Buffer); adjacency is built once, then reused
+	CornerTable &Topology();
+		// build topology if not current; call topology.Clear() after changing triangles
 	bool Read(string objFile, mat4 *m = NULL, bool normalize = true);
 		// read in object file (with normals, uvs), initialize matrix, build vertex buffer
 	bool Read(string objFile, string texFile, int textureUnit, mat4 *m = NULL, bool normalize = true);
 		// read in object file (with normals, uvs) and texture file, initialize matrix, build vertex buffer
 		// textureUnit must be > 0
+	void Share(MeshAsset *a);
+		// read the asset's geometry in place and draw with its vertex array and buffers (freeing the mesh's own)
+	void ReleaseMeshAsset();
+		// drop the asset and forget its buffers, so the next Buffer creates the mesh's own
+	GLuint ReadTexture(string texFile);
+		// texture name of texFile, from assetCache (held until destruction or the next Read) if shareAssets,
+		// else loaded into textureUnit (a glPool name, released likewise); 0 if it can't be read
+	void ReleaseTextures();
+private:
+	void CreateBuffers();
 };
 
 class MeshFramer {
 public:
 	Mesh *mesh = NULL;
 	Arcball arcball;
+	SceneGraph hierarchy;
+		// mesh and its descendants (node 0 is mesh); on drag, only mesh is set and
+		// descendants follow through their transforms relative to their parents
 	MeshFramer() { }
 	void Set(Mesh *m, float radius, mat4 fullview);
-	void SetFramedown(Mesh *m);
-		// set m.qstart from m.transform and recurse on m.children
-	void RotateTransform(Mesh *m, Quaternion qrot, vec3 *center = NULL);
-		// apply qrot to qstart, optionally rotate base around center
-		// set m.transform, recurse on m.children
-	void TranslateTransform(Mesh *m, vec3 pDif);
+		// build hierarchy from m and m->children (again if children change)
 	bool Hit(int x, int y);
 	void Down(int x, int y, mat4 modelview, mat4 persp, bool control = false);
 	void Drag(int x, int y, mat4 modelview, mat4 persp);
@@ -83,6 +212,7 @@ public:
 private:
 	bool moverPicked = false;
 	Mover mover;
+	void SetTransform(mat4 m);
 };
 
 // Read STL Format
@@ -142,10 +272,20 @@ void Normalize(vector<vec3> &points, float scale = 1);
 void Normalize(vector<VertexSTL> &vertices, float scale = 1);
 	// as above
 
+// Quads
+
+void TriangulateQuads(const int4 *quads, int n, int3 *out);
+	// 2n triangles, each quad split along its i1-i3 diagonal (winding kept)
+
 // Normals
 
-void SetVertexNormals(vector<vec3> &points, vector<int3> &triangles, vector<vec3> &normals);
-	// compute/recompute vertex normals as the average of surrounding triangle normals
+void SetVertexNormals(const vector<vec3> &points, const vector<int3> &triangles, vector<vec3> &normals,
+					  NormalWeight w = UniformWeight);
+	// compute/recompute vertex normals as the (weighted) average of surrounding triangle normals
+
+void SetVertexNormals(const vector<vec3> &points, const vector<int3> &triangles, VertexTriangles &adjacency,
+					  vector<vec3> &normals, NormalWeight w = UniformWeight);
+	// as above, building adjacency only if not current; vertices are gathered in parallel
 
 // Intersections
 
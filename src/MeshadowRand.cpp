@@ -1,3 +1,5 @@
+#include "AssetCache.h"
+#include "GLPool.h"
 #include "GLXtras.h"
 #include "Meshadow.h"
 #include "Misc.h"
@@ -14,35 +16,46 @@ namespace {
 	layout (location = 0) in vec4 point;
 	layout (location = 1) in vec4 normal;
 	layout (location = 2) in vec4 uv;
+	layout (location = 8) in float occlusion;
 	uniform vec4 cubeCenter;
 	out vec3 vPoint;
 	out vec3 vNormal;
 	out vec2 vUv;
+	out float vOcclusion;
 	uniform bool useInstance = false;
 	uniform mat4 modelview;
 	uniform mat4 persp;
+	uniform mat4 dequantize = mat4(1);		// packed point to object space (see Quantize.h)
+	uniform bool packedNormals = false;		// normal.xy octahedral
+	vec3 OctDecode(vec2 e) {
+		vec3 n = vec3(e, 1-abs(e.x)-abs(e.y));
+		if (n.z < 0)
+			n.xy = (1-abs(n.yx))*vec2(n.x >= 0? 1 : -1, n.y >= 0? 1 : -1);
+		return normalize(n);
+	}
 	void main() {
 		mat4 m = modelview; 
-		vPoint = (modelview*point).xyz;
+		vPoint = (modelview*dequantize*point).xyz;
 		vec3 tmp = (modelview*cubeCenter).xyz;
-		vNormal = (modelview*normal).xyz;
+		vNormal = (modelview*vec4(packedNormals? OctDecode(normal.xy) : normal.xyz, 0)).xyz;
 		gl_Position = persp*vec4(vPoint, 1);
 		vUv = vec2(uv.x, uv.y);
+		vOcclusion = occlusion;
 	}
 )";
 
 	const char* meshadowPixelShader = R"(
 	#version 430
 	// access to shading object
-	layout (std430, binding = 12) buffer Points { vec4 objPts[]; };
-	layout (std430, binding = 15) buffer Triangles { int objEids[]; };
+	// occluder triangles prepared once per frame (see Occluder.h): point, edge, edge, plane
+	layout (std430, binding = 16) buffer OccluderTriangles { vec4 objTris[]; };
 	in vec3 vPoint, vNormal;
 
 	in vec2 vUv;
+	in float vOcclusion;
 	out vec4 pColor;
 	uniform bool shadowing = false;
 	uniform int nObjTriangles = 0;
-	uniform mat4 objTransform;
 	uniform bool useLight = true;
 	uniform vec3 light;
 	uniform float lsize = 0.2;
@@ -58,6 +71,9 @@ namespace {
 	uniform bool fwdFacing = false;
 	uniform bool facetedShading = false;
 	uniform float numlight = 5;
+	uniform bool useLightmap = false;			// baked visibility replaces ray tests (static receivers)
+	uniform sampler2D lightmap;
+	uniform bool useOcclusion = false;			// baked per-vertex ambient occlusion
 	// SHADING
 	float Intensity(vec3 normalV, vec3 eyeV, vec3 point, vec3 light) {
 		vec3 lightV = normalize(light-point);		// light vector
@@ -67,38 +83,19 @@ namespace {
 		return clamp(d+pow(s, 50), 0, 1);
 	}
 	// SHADOWING
-	float cross2d(vec2 v1, vec2 v2) { return v1.x*v2.y-v1.y*v2.x; }
-	vec4 PlaneFromTriangle(vec3 p1, vec3 p2, vec3 p3) {
-		vec3 v1 = vec3(p2-p1), v2 = vec3(p3-p2), x = normalize(cross(v1, v2));
-		return vec4(x.x, x.y, x.z, -dot(p1, x));
-	}
-	bool LinePlaneIntersect(vec3 p1, vec3 p2, vec4 plane, out vec3 intersection, out float alpha) {
-		vec3 normal = vec3(plane.x, plane.y, plane.z), axis = vec3(p2-p1);
-		float pdDot = dot(axis, normal);
-		if (abs(pdDot) < .001) return false;
-		alpha = (-plane.w-dot(p1, normal))/pdDot;
-		intersection = p1+alpha*axis;
-		return true;
-	}
-	int GetMajorPlane(vec4 plane) {
-		float ax = abs(plane.x), ay = abs(plane.y), az = abs(plane.z);
-		return ax > ay? (ax > az? 1 : 3) : (ay > az? 2 : 3);
-	}
-	vec2 MajorPlane(vec3 p, int mp) { return mp == 1? vec2(p.y, p.z) : mp == 2? vec2(p.x, p.z) : vec2(p.x, p.y); }
-	bool CrossPositive(vec2 a, vec2 b, vec2 c) { return cross2d(vec2(b-a), vec2(c-b)) > 0; }
-	bool TestInclude(vec2 test, vec2 t1, vec2 t2, vec2 t3) {
-		bool c1 = CrossPositive(test, t1, t2), c2 = CrossPositive(test, t2, t3), c3 = CrossPositive(test, t3, t1);
-		return c1 == c2 && c2 == c3;
-	}
-	bool LineTriangleIntersect(vec3 a, vec3 b, vec3 p1, vec3 p2, vec3 p3) {
-		// does line between a and b intersect triangle p1p2p3?
-		vec3 intersection;
-		float alpha = 0;
-		vec4 plane = PlaneFromTriangle(p1, p2, p3);
-		if (!LinePlaneIntersect(a, b, plane, intersection, alpha)) return false;
-		if (alpha < 0 || alpha > 1) return false;
-		int mp = GetMajorPlane(plane);
-		return TestInclude(MajorPlane(intersection, mp), MajorPlane(p1, mp), MajorPlane(p2, mp), MajorPlane(p3, mp));
+	bool LineTriangleIntersect(vec3 a, vec3 b, int i) {
+		// does line between a and b intersect prepared triangle i? (Moller-Trumbore)
+		vec4 plane = objTris[4*i+3];
+		float da = dot(plane.xyz, a)+plane.w, db = dot(plane.xyz, b)+plane.w;
+		if (da*db > 0) return false;				// both ends on one side
+		vec3 p = objTris[4*i].xyz, e1 = objTris[4*i+1].xyz, e2 = objTris[4*i+2].xyz;
+		vec3 d = b-a, h = cross(d, e2);
+		float det = dot(e1, h);
+		if (abs(det) <= 1e-6*length(d)*length(e1)*length(e2)) return false;	// parallel, as Occluder::Intersect
+		float f = 1/det;
+		vec3 s = a-p, q = cross(s, e1);
+		float u = f*dot(s, h), v = f*dot(d, q), alpha = f*dot(e2, q);
+		return u >= 0 && v >= 0 && u+v <= 1 && alpha >= 0 && alpha <= 1;
 	}
 	// use builtin variables instead
 	// code for generating pseudorandom floats from a vec3: https://stackoverflow.com/a/17479300
@@ -136,12 +133,10 @@ namespace {
 		vec3 p = vPoint+.0001*v, hit;				// .0001 offset: avoid self-blocking
 		float avg = 0;
 		
-		for (int i = 0; i < nObjTriangles; i++) {
-			int id1 = objEids[3*i], id2 = objEids[3*i+1], id3 = objEids[3*i+2];
-			vec4 p1 = objTransform*objPts[id1], p2 = objTransform*objPts[id2], p3 = objTransform*objPts[id3];
+		for (int t = 0; t < nObjTriangles; t++) {
 			for(int i = 1; i <= numlight; i++){
 				vec3 offset = lsize * vec3(random(p*i), random(vec3(p.y*i, p.z*i, i*p.x)), random(vec3(i*p.z, i*p.x, i*p.y*i)));
-				if (LineTriangleIntersect(p, light + offset, vec3(p1), vec3(p2), vec3(p3)))
+				if (LineTriangleIntersect(p, light + offset, t))
 					avg++; 
 			}
 		}
@@ -158,7 +153,11 @@ namespace {
 			for (int i = 0; i < nlights; i++)
 				intensity += Intensity(N, E, vPoint, lights[i]);
 			intensity = clamp(intensity, 0, 1);
-			if (shadowing) 				
+			if (useOcclusion)
+				intensity *= 1-vOcclusion;
+			if (useLightmap)
+				intensity *= mix(.7, 1, texture(lightmap, vUv).r);
+			else if (shadowing)
 				intensity *= InShadow();
 			
 		}
@@ -188,44 +187,151 @@ GLuint UseMeshadowShader() {
 	return s;
 }
 
-void SetVertexBuffer(ShaderStorage& ss, GLuint index, vector<vec4>& attrib) {
-	// bind a buffer object to an indexed buffer target (GL_SHADER_STORAGE_BUFFER)
-	// index: binding point index within the array specified by target
-	// buffer: name of a buffer object to bind to the specified binding point
-	ss.binding = index;
-	glGenBuffers(1, &ss.buffer);
-	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, ss.binding, ss.buffer);
-	glBufferData(GL_SHADER_STORAGE_BUFFER, attrib.size() * sizeof(vec4), attrib.data(), GL_DYNAMIC_DRAW);
+namespace {
+
+GLintptr AlignStorage(GLintptr offset) {
+	static GLint align = 0;
+	if (!align) {
+		glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &align);
+		align = align > 16? align : 16;
+	}
+	return (offset+align-1)/align*align;
+}
+
+void SetRange(ShaderStorage &ss, GLuint binding, GLuint buffer, GLintptr &offset, GLsizeiptr size) {
+	// place ss at the next aligned offset and advance it
+	ss.binding = binding;
+	ss.buffer = buffer;
+	ss.offset = size? AlignStorage(offset) : 0;
+	ss.size = size;
+	if (size)
+		offset = ss.offset+size;
+}
+
+} // end namespace
+
+Meshadow::~Meshadow() {
+	if (meshAsset)
+		storage = 0;					// the asset's
+	FreeBuffer(storage);
+	FreeBuffer(occlusionBuffer);
 }
 
 void Meshadow::Buffer(int bindingOffset) {
-	int nPoints = points.size(), nNormals = normals.size(), nUvs = uvs.size();
-	vector<vec4> tempPoints(nPoints), tempNormals(nNormals), tempUvs(nUvs);
-	for (int i = 0; i < nPoints; i++) tempPoints[i] = vec4(points[i], 1);
-	for (int i = 0; i < nNormals; i++) tempNormals[i] = vec4(normals[i], 0);
-	for (int i = 0; i < nUvs; i++) tempUvs[i] = vec4(uvs[i], 0, 1);
-	glGenVertexArrays(1, &vao);
+	const vector<vec3> &pts = Points(), &nrms = Normals();
+	const vector<vec2> &tex = Uvs();
+	const vector<int3> &tris = Triangles();
+	const vector<int4> &quas = Quads();
+	int nPoints = pts.size(), nTriangles = tris.size(), nQuads = quas.size();
+	bool hasNormals = (int) nrms.size() == nPoints, hasUvs = (int) tex.size() == nPoints;
+	packed = quantize;
+	indexType = packed && ShortIndices(nPoints)? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+	int indexBytes = indexType == GL_UNSIGNED_SHORT? 2 : 4;
+	if (meshAsset) {
+		// buffers shared with other meshes aren't written
+		storage = 0;
+		ReleaseMeshAsset();
+	}
+	if (!vao)
+		vao = AcquireVertexArray();
 	glBindVertexArray(vao);
-	SetVertexBuffer(pos, 0 + bindingOffset, tempPoints);
-	SetVertexBuffer(nrm, 1 + bindingOffset, tempNormals);
-	SetVertexBuffer(uv, 2 + bindingOffset, tempUvs);
-	eid.binding = 3 + bindingOffset;
-	glGenBuffers(1, &eid.buffer);
-	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, eid.binding, eid.buffer);
-	glBufferData(GL_SHADER_STORAGE_BUFFER, triangles.size() * sizeof(int3), triangles.data(), GL_DYNAMIC_DRAW);
+	// lay out the ranges, size storage once, then write each range in place
+	GLintptr size = 0;
+	SetRange(pos, 0 + bindingOffset, storage, size, nPoints*(packed? sizeof(PackedVertex) : sizeof(vec3)));
+	SetRange(nrm, 1 + bindingOffset, storage, size, !packed && hasNormals? nPoints*sizeof(vec3) : 0);
+	SetRange(uv, 2 + bindingOffset, storage, size, !packed && hasUvs? nPoints*sizeof(vec2) : 0);
+	SetRange(eid, 3 + bindingOffset, storage, size, 3*(nTriangles+2*nQuads)*indexBytes);
+	ReserveBuffer(storage, GL_SHADER_STORAGE_BUFFER, size);
+	pos.buffer = nrm.buffer = uv.buffer = eid.buffer = storage;
+	char *p = (char *) glMapBufferRange(GL_SHADER_STORAGE_BUFFER, 0, size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+	vector<char> staging;				// heap, as Mesh's index arrays
+	if (!p) {
+		// no mapping: write to memory and upload that
+		staging.resize(size);
+		p = staging.data();
+	}
+	if (packed)
+		packer.Pack(pts.data(), hasNormals? nrms.data() : NULL, hasUvs? tex.data() : NULL, NULL, nPoints, (PackedVertex *) (p+pos.offset));
+	else {
+		memcpy(p+pos.offset, pts.data(), pos.size);
+		if (nrm.size) memcpy(p+nrm.offset, nrms.data(), nrm.size);
+		if (uv.size) memcpy(p+uv.offset, tex.data(), uv.size);
+	}
+	// triangles, then quads as triangle pairs, so one draw covers both
+	edges.Clear();
+	nElementQuads = nQuads;
+	if (indexType == GL_UNSIGNED_SHORT) {
+		vector<int3> quadTriangles(2*nQuads);
+		TriangulateQuads(quas.data(), nQuads, quadTriangles.data());
+		ToShortIndices(tris.data(), nTriangles, (uint16_t *) (p+eid.offset));
+		ToShortIndices(quadTriangles.data(), 2*nQuads, (uint16_t *) (p+eid.offset)+3*nTriangles);
+	}
+	else {
+		if (nTriangles) memcpy(p+eid.offset, tris.data(), nTriangles*sizeof(int3));
+		TriangulateQuads(quas.data(), nQuads, (int3 *) (p+eid.offset)+nTriangles);
+	}
+	if (staging.size())
+		glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, size, staging.data());
+	else
+		glUnmapBuffer(GL_SHADER_STORAGE_BUFFER);
+	meshCounters.bytesUploaded += size;
+	for (ShaderStorage *ss : { &pos, &nrm, &uv, &eid })
+		if (ss->size)
+			glBindBufferRange(GL_SHADER_STORAGE_BUFFER, ss->binding, storage, ss->offset, ss->size);
+	BufferOcclusion();
+	AccountMemory();
+}
+
+void Meshadow::BufferOcclusion() {
+	if (occlusion.size() != Points().size())
+		return;
+	ReserveBuffer(occlusionBuffer, GL_ARRAY_BUFFER, occlusion.size() * sizeof(float));
+	glBufferSubData(GL_ARRAY_BUFFER, 0, occlusion.size() * sizeof(float), occlusion.data());
+	meshCounters.bytesUploaded += occlusion.size() * sizeof(float);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	AccountMemory();
+}
+
+void Meshadow::AccountMemory() {
+	Mesh::AccountMemory();
+	memory.Set(MemVertexBuffer, glPool.Capacity(occlusionBuffer));
+	memory.Set(MemStorageBuffer, meshAsset? 0 : glPool.Capacity(storage));	// else the asset's mesh reports it
+}
+
+void Meshadow::BindVertices(int shader) {
+	glBindVertexArray(vao);
+	glBindBuffer(GL_ARRAY_BUFFER, storage);
+	if (packed) {
+		EnablePackedVertex(Normals().size() == Points().size(), Uvs().size() == Points().size(), false, (int) pos.offset);
+		SetUniform(shader, "dequantize", packer.Dequantize());
+	}
+	else {
+		VertexAttribPointer(shader, "point", 3, 0, (void *) pos.offset);
+		if (nrm.size) VertexAttribPointer(shader, "normal", 3, 0, (void *) nrm.offset);
+		else glDisableVertexAttribArray(1);
+		if (uv.size) VertexAttribPointer(shader, "uv", 2, 0, (void *) uv.offset);
+		else glDisableVertexAttribArray(2);
+		SetUniform(shader, "dequantize", mat4());
+	}
+	SetUniform(shader, "packedNormals", packed);
 }
 
 void Meshadow::Display(CameraAB camera, bool lines) {
-	int nTris = triangles.size(), nQuads = quads.size();
-	bool useTexture = textureUnit > 0 && uvs.size() > 0;
+	int nTris = Triangles().size();
+	bool useTexture = textureUnit > 0 && Uvs().size() > 0;
 	// enable shader and vertex array object
 	int shader = UseMeshadowShader();
-	glBindBuffer(GL_ARRAY_BUFFER, pos.buffer);
-	VertexAttribPointer(shader, "point", 4, 0, 0);
-	glBindBuffer(GL_ARRAY_BUFFER, nrm.buffer);
-	VertexAttribPointer(shader, "normal", 4, 0, 0);
-	glBindBuffer(GL_ARRAY_BUFFER, uv.buffer);
-	VertexAttribPointer(shader, "uv", 4, 0, 0);
+	BindVertices(shader);
+	// ambient occlusion (attribute 8)
+	SetUniform(shader, "useOcclusion", occlusionBuffer != 0);
+	if (occlusionBuffer) {
+		glBindBuffer(GL_ARRAY_BUFFER, occlusionBuffer);
+		VertexAttribPointer(shader, "occlusion", 1, 0, 0);
+	}
+	else
+		glDisableVertexAttribArray(8);
+	// no lightmap: the uniform persists in the shared program, eg from a receiver drawn before
+	SetUniform(shader, "useLightmap", false);
 	// texture
 	SetUniform(shader, "useTexture", useTexture);
 	if (useTexture) {
@@ -234,26 +340,53 @@ void Meshadow::Display(CameraAB camera, bool lines) {
 		SetUniform(shader, "textureName", (int)textureName);
 	}
 	// set custom transform and draw (xform = mesh transforms X view transform)
-	SetUniform(shader, "modelview", camera.modelview * transform);
+	SetUniform(shader, "modelview", mat3x4(camera.modelview) * mat3x4(transform));
 	SetUniform(shader, "persp", camera.persp);
 	if (lines) {
-		for (int i = 0; i < nTris; i++)
-			glDrawElements(GL_LINE_LOOP, 3, GL_UNSIGNED_INT, &triangles[i]);
-		for (int i = 0; i < nQuads; i++)
-			glDrawElements(GL_LINE_LOOP, 4, GL_UNSIGNED_INT, &quads[i]);
+		UpdateEdges();
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, edges.buffer);
+		glDrawElements(GL_LINES, 2 * edges.nBuffered, edges.indexType, 0);
 	}
 	else {
+		// triangles and triangulated quads
 		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, eid.buffer);
-		glDrawElements(GL_TRIANGLES, 3 * nTris, GL_UNSIGNED_INT, 0); // triangles.data());
-#ifdef GL_QUADS
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
-		glDrawElements(GL_QUADS, 4 * nQuads, GL_UNSIGNED_INT, quads.data());
-#endif
+		glDrawElements(GL_TRIANGLES, 3 * (nTris + 2 * nElementQuads), indexType, (void *) eid.offset);
 	}
+	meshCounters.drawCalls++;
 	glBindVertexArray(0);
 }
 
 bool Meshadow::Read(std::string objFile, mat4* m, bool normalize, int bindingOffset) {
+	if (shareAssets) {
+		// read and buffer once per file, options and bindings
+		string options = "Meshadow "+std::to_string(bindingOffset)+(normalize? " normalize" : "")+(quantize? " quantize" : "");
+		MeshAsset *a = assetCache.GetMesh(AssetKey(objFile, options), [&]() -> Mesh * {
+			Meshadow *mesh = new Meshadow();
+			mesh->shareAssets = false;
+			mesh->quantize = quantize;
+			if (mesh->Read(objFile, NULL, normalize, bindingOffset))
+				return mesh;
+			delete mesh;
+			return NULL;
+		});
+		if (!a)
+			return false;
+		Meshadow &s = *(Meshadow *) a->mesh;
+		if (meshAsset)
+			storage = 0;
+		else
+			FreeBuffer(storage);
+		Share(a);
+		storage = s.storage;
+		pos = s.pos; nrm = s.nrm; uv = s.uv; eid = s.eid;
+		for (ShaderStorage *ss : { &pos, &nrm, &uv, &eid })
+			if (ss->size)
+				glBindBufferRange(GL_SHADER_STORAGE_BUFFER, ss->binding, storage, ss->offset, ss->size);
+		if (m)
+			transform = *m;
+		return true;
+	}
+	sharedGeometry.reset();
 	if (!ReadAsciiObj((char*)objFile.c_str(), points, triangles, &normals, &uvs, NULL, NULL, &quads)) {
 		printf("Meshadow.Read: can't read %s\n", objFile.c_str());
 		return false;
@@ -277,9 +410,11 @@ bool Meshadow::Read(std::string objFile, std::string texFile, int texUnit, mat4*
 	objFilename = objFile;
 	texFilename = texFile;
 	textureUnit = texUnit;
-	textureName = LoadTexture((char*)texFile.c_str(), textureUnit);
+	ReleaseTextures();
+	textureName = ReadTexture(texFile);
 	if (!textureName)
 		printf("Meshadow.Read: bad texture name\n");
+	AccountMemory();
 	return textureName > 0;
 }
 
@@ -294,13 +429,15 @@ bool Meshadow::Read(std::string objFile, vector<string>textList, int texUnit, ma
 	objFilename = objFile;
 	textureUnit = texUnit;
 	vector<GLuint>loadedTexture;
+	ReleaseTextures();
 	for (string item : textList) {
-		GLuint tmp = LoadTexture((char*)item.c_str(), textureUnit);
+		GLuint tmp = ReadTexture(item);
 		loadedTexture.push_back(tmp);
 		if (!loadedTexture.back())
 			printf("Meshadow.Read: bad texture name\n");
 	}
 	textureName = loadedTexture[0];
+	AccountMemory();
 
 	return loadedTexture[0] > 0;
 }
\ No newline at end of file
@@ -1,12 +1,20 @@
 
 #include <glad.h>
 #include <glfw3.h>
+#include "AmbientOcclusion.h"
+#include "Arena.h"
+#include "AssetCache.h"
 #include "CameraArcball.h"
 #include "Draw.h"
+#include "GLPool.h"
 #include "GLXtras.h"
+#include "Lightmap.h"
+#include "MemoryLedger.h"
 #include "Meshadow.h"
 #include "Mesh.h"
 #include "Misc.h"
+#include "Occluder.h"
+#include "ShadowVolume.h"
 #include "VecMat.h"
 #include "Slider.h"
 #include "float.h"	
@@ -15,8 +23,8 @@
 int winWidth = 500, winHeight = 500;
 CameraAB camera(0, 0, winWidth, winHeight, vec3(0, 0, 0), vec3(0, -1, -10), 30, .001f, 500);
 time_t mouseEvent = -1000;
-vec3 lightDefaultPos(-1.2f, 1.4f, 1.8f);
-vec3 objDefaultPos(0, 1.01f * 2, 0);
+constexpr vec3 lightDefaultPos(-1.2f, 1.4f, 1.8f);
+constexpr vec3 objDefaultPos(0, 1.01f * 2, 0);
 vec3 objectPos(objDefaultPos);
 vec3 light(lightDefaultPos);
 
@@ -29,6 +37,7 @@ bool faceted = true;
 unsigned int rot = 0;
 bool cpuShadow = false;
 bool flag = false;
+bool wireframe = false;		// wavy mesh or object drawn as edges
 float shift = 0, shift1 = 0.75;
 
 
@@ -47,11 +56,47 @@ Slider* sliders[] = { &lightx, &lighty, &lightz, &lightdim, &freqControl, &light
 
 // object and floor
 Meshadow object, square, wall, wall2;
+VECMAT_CONSTEXPR mat4 squareTransform = Scale(2, 2, 2) * Translate(0, -.1f, -.01f);
+VECMAT_CONSTEXPR mat4 wallTransform = Translate(0, 1, -2.5f) * Scale(2, 2, 2) * RotateX(90);
 vector<string> textureNames;
 const int objTextureStartIndex = 2;
 int currentTexture = objTextureStartIndex;
 const int objTextureEndIndex = 4;
 
+// packed vertex format for the object, floor and wall (see Quantize.h)
+bool packVertices = true;
+
+// baked shadows for static receivers (floor and wall)
+LightmapBaker baker;
+bool useLightmaps = true;
+
+int LightmapUnit() {
+	// the last texture unit: meshes bind their texture to unit textureName, so a fixed low unit would
+	// collide with any texture given that name
+	static GLint unit = 0;
+	if (!unit) {
+		glGetIntegerv(GL_MAX_COMBINED_TEXTURE_IMAGE_UNITS, &unit);
+		unit = unit > 1? unit-1 : 1;
+	}
+	return unit;
+}
+
+// per-vertex ambient occlusion for the object, baked at load (cached in <obj>.ao)
+OcclusionBaker occlusionBaker;
+bool useOcclusion = true;
+
+// occluder triangles transformed once per frame: eye space for the shader, world space for the cpu test
+Occluder eyeOccluder, worldOccluder;
+bool gpuPrepare = false;
+const int occluderBinding = 16;
+
+// stencil shadow volume from the object's silhouette, an alternative to per-fragment ray tests
+ShadowVolume shadowVolume;
+bool useShadowVolume = false;
+
+// cached cpu shadow samples, re-traced only where the shadow may have changed
+ShadowTracker gridTracker;
+ShadowGrid floorGrid, wallGrid;
 
 // wavy object
 Mesh wavyMesh;
@@ -59,6 +104,9 @@ float freq = 2, ampl = .3f;
 int res = 15;
 int selectedQuad = -1;
 bool diagnostics = false;
+MeshCounters frameCounters;		// GPU uploads and allocations during the last frame
+long long frameHeapAllocations = 0;	// heap allocations during the last frame (counted by HeapCount.cpp; transient arrays use frameArena)
+MemorySnapshot lastMemory;			// as of the last M key
 
 // set of item to be loaded
 string catFile = "./Assets/Cat.obj";
@@ -75,9 +123,15 @@ string cubeTexFile3 = "./thumbsup2.jpg";
 const char* usage = R"(
 	F: Toggle faceted
 	D: Toggle wavy points disagnostics
+	M: Write memory.json; print memory changes since the last M
 	L: Next cube texture fdlksqer
 	K: Previous cube texture
 	S: Toggle shadow disagnostics
+	B: Toggle baked shadows for floor and wall
+	G: Toggle preparing occluder triangles with a compute shader
+	O: Toggle baked ambient occlusion
+	W: Toggle wireframe (wavy mesh or object)
+	V: Toggle stencil shadow volumes (replaces ray-tested and baked shadows)
 	Q: Increase rotation speed
 	E: Decrease rotation speed
 	R: Reset some settings to default position
@@ -90,45 +144,6 @@ const char* usage = R"(
 )";
 
 
-// Intersection Test
-
-vec4 PlaneFromTriangle(vec3 p1, vec3 p2, vec3 p3) {
-	vec3 v1(p2 - p1), v2(p3 - p2), x = normalize(cross(v1, v2));
-	return vec4(x.x, x.y, x.z, -dot(p1, x));
-}
-
-bool LinePlaneIntersect(vec3 p1, vec3 p2, vec4 plane, vec3& intersection, float& alpha) {
-	vec3 normal(plane.x, plane.y, plane.z), axis(p2 - p1);
-	float pdDot = dot(axis, normal);
-	if (fabs(pdDot) < FLT_MIN) return false;
-	alpha = (-plane.w - dot(p1, normal)) / pdDot;
-	intersection = p1 + alpha * axis;
-	return true;
-}
-
-int GetMajorPlane(vec4 plane) {
-	float ax = fabs(plane.x), ay = fabs(plane.y), az = fabs(plane.z);
-	return ax > ay ? (ax > az ? 1 : 3) : (ay > az ? 2 : 3);
-}
-
-vec2 MajorPlane(vec3& p, int mp) { return mp == 1 ? vec2(p.y, p.z) : mp == 2 ? vec2(p.x, p.z) : vec2(p.x, p.y); }
-
-bool CrossPositive(vec2 a, vec2 b, vec2 c) { return cross(vec2(b - a), vec2(c - b)) > 0; }
-
-bool TestInclude(vec2 test, vec2 t1, vec2 t2, vec2 t3) {
-	bool c1 = CrossPositive(test, t1, t2), c2 = CrossPositive(test, t2, t3), c3 = CrossPositive(test, t3, t1);
-	return c1 == c2 && c2 == c3;
-}
-
-bool LineTriangleIntersect(vec3 a, vec3 b, vec3 p1, vec3 p2, vec3 p3, vec3& intersection) {
-	float alpha = 0;
-	vec4 plane = PlaneFromTriangle(p1, p2, p3);
-	if (!LinePlaneIntersect(a, b, plane, intersection, alpha)) return false;
-	if (alpha < 0 || alpha > 1) return false;
-	int mp = GetMajorPlane(plane);
-	return TestInclude(MajorPlane(intersection, mp), MajorPlane(p1, mp), MajorPlane(p2, mp), MajorPlane(p3, mp));
-}
-
 vec3 GetBase(Mesh& m) {
 	// return origin of mesh
 	mat4& f = m.transform;
@@ -136,21 +151,11 @@ vec3 GetBase(Mesh& m) {
 }
 // Display
 
-vec3 Xform(mat4 m, vec3 p) { vec4 v = m * vec4(p, 1); return vec3(v.x, v.y, v.z); }
+vec3 Xform(mat4 m, vec3 p) { return mat3x4(m).Point(p); }
 
 bool IntersectCube(vec3 a, vec3 b) {
-	vector<vec3>& pts = object.points;
-	mat4& m = object.transform;
-	vec3 intersection;
-	// Line(a, b, 1, blu, 0.1);
-	for (int i = 0; i < (int)object.triangles.size(); i++) {
-		int3 t = object.triangles[i];
-		vec3 p1 = Xform(m, pts[t.i1]), p2 = Xform(m, pts[t.i2]), p3 = Xform(m, pts[t.i3]);
-		if (LineTriangleIntersect(a, b, p1, p2, p3, intersection))
-			return true;
-	}
-
-	return false;
+	// worldOccluder prepared by DrawShadowTest
+	return worldOccluder.Intersect(a, b);
 }
 
 vec3 Lerp(vec3 p1, vec3 p2, float a) { return p1 + a * (p2 - p1); }
@@ -187,8 +192,9 @@ void MakeWavyPoints() {
 	}
 	shift += 0.05;
 	shift1 += 0.03;
-	SetWavyIndices();
-	wavyMesh.Buffer();
+	if ((int) wavyMesh.quads.size() != (res - 1) * 4 + 2)	// topology changes only with res
+		SetWavyIndices();
+	wavyMesh.UpdatePoints();								// stream points; no GPU allocation after the first frame
 }
 
 // Display
@@ -212,49 +218,43 @@ void DisplayWavyVertices() {
 void DrawShadowTest() {
 	glDisable(GL_DEPTH_TEST);
 	int res = 15;
-	mat4& m = square.transform;
-	vec3 p1 = Xform(m, square.points[0]), p2 = Xform(m, square.points[1]), p3 = Xform(m, square.points[2]), p4 = Xform(m, square.points[3]);
-	vec3 offsets[] = { vec3(0, 0, 0), vec3(-1, 0, 0), vec3(1, 0, 0), vec3(0, -1, 0), vec3(0, 1, 0), vec3(0, 0, -1), vec3(0, 0, 1) };
-	for (int i = 0; i < res; i++)
-		for (int j = 0; j < res; j++) {
-			float s = (float)i / (res - 1), t = (float)j / (res - 1);
-			vec3 p = Lerp(Lerp(p1, p2, s), Lerp(p4, p3, s), t);
-			float avg = 0;
-			int numLight = 5;
-			for (int i = 0; i < numLight; i++) {
-
-				vec3 l = light + 0.1 * normalize(vec3(rand(), rand(), rand()));
-				if (IntersectCube(p, l))
-					avg++;
-
-			}
-			float tmp = (numLight - avg);
-			Disk(p, 10, vec3(tmp / (float)numLight / 2 + 0.5, 0, 0));
-		}
-
-	mat4& m2 = wall.transform;
-	vec3 wp1 = Xform(m2, wall.points[0]), wp2 = Xform(m2, wall.points[1]), wp3 = Xform(m2, wall.points[2]), wp4 = Xform(m2, wall.points[3]);
-	for (int i = 0; i < res; i++)
-		for (int j = 0; j < res; j++) {
-			float s = (float)i / (res - 1), t = (float)j / (res - 1);
-			vec3 p = Lerp(Lerp(wp1, wp2, s), Lerp(wp4, wp3, s), t);
-			float avg = 0;
-			bool hit = IntersectCube(p, light);
-			Disk(p, 4, hit ? blu : yel);
+	static constexpr vec3 offsets[] = { vec3(0, 0, 0), vec3(-1, 0, 0), vec3(1, 0, 0), vec3(0, -1, 0), vec3(0, 1, 0), vec3(0, 0, -1), vec3(0, 0, 1) };
+	if (!floorGrid.res) {
+		mat4& m = square.transform, & m2 = wall.transform;
+		floorGrid.Init(Xform(m, square.points[0]), Xform(m, square.points[1]), Xform(m, square.points[2]), Xform(m, square.points[3]), res);
+		wallGrid.Init(Xform(m2, wall.points[0]), Xform(m2, wall.points[1]), Xform(m2, wall.points[2]), Xform(m2, wall.points[3]), res);
+		gridTracker.receivers = { &floorGrid, &wallGrid };
+	}
+	// invalidate all samples if light moved, else only those in old and new shadow of moved object
+	gridTracker.SetLight(light, 0.1f);
+	if (gridTracker.SetOccluder(&object))
+		worldOccluder.Prepare(object, object.transform);
+	floorGrid.Update([](vec3 p) {
+		float avg = 0;
+		int numLight = 5;
+		for (int i = 0; i < numLight; i++) {
+			vec3 l = light + 0.1 * normalize(vec3(rand(), rand(), rand()));
+			if (IntersectCube(p, l))
+				avg++;
 		}
+		return (numLight - avg) / (float)numLight;
+	});
+	wallGrid.Update([](vec3 p) { return IntersectCube(p, light) ? 1.f : 0.f; });
+	int nRecomputed = floorGrid.nRecomputed + wallGrid.nRecomputed, nReused = floorGrid.nReused + wallGrid.nReused;
+	if (nRecomputed)
+		printf("\rcpu shadow: %i samples reused, %i recomputed   ", nReused, nRecomputed);
+	for (int i = 0; i < res * res; i++)
+		Disk(floorGrid.points[i], 10, vec3(floorGrid.values[i] / 2 + 0.5, 0, 0));
+	for (int i = 0; i < res * res; i++)
+		Disk(wallGrid.points[i], 4, wallGrid.values[i] > 0 ? blu : yel);
 }
 
 void DisplayMesh(Meshadow& m) {
-	int nTris = m.triangles.size(), nQuads = m.quads.size();
-	bool useTexture = m.textureUnit > 0 && m.uvs.size() > 0;
+	int nTris = m.Triangles().size();
+	bool useTexture = m.textureUnit > 0 && m.Uvs().size() > 0;
 	// enable shader and vertex array object
 	int shader = UseMeshadowShader();
-	glBindBuffer(GL_ARRAY_BUFFER, m.pos.buffer);
-	VertexAttribPointer(shader, "point", 4, 0, 0);
-	glBindBuffer(GL_ARRAY_BUFFER, m.nrm.buffer);
-	VertexAttribPointer(shader, "normal", 4, 0, 0);
-	glBindBuffer(GL_ARRAY_BUFFER, m.uv.buffer);
-	VertexAttribPointer(shader, "uv", 4, 0, 0);
+	m.BindVertices(shader);
 	// texture
 	SetUniform(shader, "useTexture", useTexture);
 	if (useTexture) {
@@ -262,13 +262,29 @@ void DisplayMesh(Meshadow& m) {
 		glBindTexture(GL_TEXTURE_2D, m.textureName);    // bound texture and shader id correspond with textureName
 		SetUniform(shader, "textureName", (int)m.textureName);
 	}
+	// baked ambient occlusion
+	bool occ = useOcclusion && m.occlusionBuffer;
+	SetUniform(shader, "useOcclusion", occ);
+	if (occ) {
+		glBindBuffer(GL_ARRAY_BUFFER, m.occlusionBuffer);
+		VertexAttribPointer(shader, "occlusion", 1, 0, 0);
+	}
+	else
+		glDisableVertexAttribArray(8);
+	// baked shadow
+	Lightmap *lm = useLightmaps && !useShadowVolume ? baker.Find(&m) : NULL;
+	SetUniform(shader, "useLightmap", lm != NULL);
+	if (lm) {
+		glActiveTexture(GL_TEXTURE0 + LightmapUnit());
+		glBindTexture(GL_TEXTURE_2D, lm->textureName);
+		SetUniform(shader, "lightmap", LightmapUnit());
+	}
 	// set custom transform and draw (xform = mesh transforms X view transform)
-	SetUniform(shader, "modelview", camera.modelview * m.transform);
+	SetUniform(shader, "modelview", mat3x4(camera.modelview) * mat3x4(m.transform));
 	SetUniform(shader, "persp", camera.persp);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m.eid.buffer);
-	glDrawElements(GL_TRIANGLES, 3 * nTris, GL_UNSIGNED_INT, 0); // triangles.data());
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
-	glDrawElements(GL_QUADS, 4 * nQuads, GL_UNSIGNED_INT, m.quads.data());
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m.eid.buffer);	// triangles, then quads as triangle pairs
+	glDrawElements(GL_TRIANGLES, 3 * (nTris + 2 * m.nElementQuads), m.indexType, (void *) m.eid.offset);
+	meshCounters.drawCalls++;
 	glBindVertexArray(0);
 }
 
@@ -283,14 +299,29 @@ void Display(GLFWwindow* w) {
 	glEnable(GL_LINE_SMOOTH);
 	glHint(GL_LINE_SMOOTH_HINT, GL_NICEST);
 
+	// re-bake receiver texels whose shadow changed, within the per-frame budget
+	if (useLightmaps && !useShadowVolume) {
+		baker.SetLight(light, lightRadius);
+		baker.SetOccluder(&object);
+		baker.Update();
+	}
+
 	// display cube object with shadow 
 	GLuint s = UseMeshadowShader();				// object use meshadow shader
 	SetUniform(s, "facetedShading", !faceted);
 	SetUniform(s, "light", vec3(camera.modelview * vec4(light, 1)));
 	SetUniform(s, "dim", dim);
-	SetUniform(s, "shadowing", true);
-	SetUniform(s, "nObjTriangles", (int)object.triangles.size());
-	SetUniform(s, "objTransform", camera.modelview * object.transform);
+	SetUniform(s, "shadowing", !useShadowVolume);
+	SetUniform(s, "nObjTriangles", (int)object.Triangles().size());
+	mat4 objTransform = mat3x4(camera.modelview) * mat3x4(object.transform);	// both affine
+	if (gpuPrepare)
+		eyeOccluder.PrepareOnGPU(object, objTransform, occluderBinding);
+	else {
+		eyeOccluder.Prepare(object, objTransform);
+		eyeOccluder.Upload(occluderBinding);
+	}
+	if (useShadowVolume)
+		shadowVolume.Update(object, object.transform, light);
 	SetUniform(s, "numlight", numlight);
 	SetUniform(s, "lsize", lightRadius);
 
@@ -300,15 +331,19 @@ void Display(GLFWwindow* w) {
 
 	// toggle to display Wavy mesh or cube object
 	if (flag)
-		wavyMesh.Display(camera);
+		wavyMesh.Display(camera, wireframe);
+	else if (wireframe)
+		object.Display(camera, true);
 	else
 		DisplayMesh(object);
 
-	object.transform = object.transform * RotateX(rot * 0.5) * RotateY(rot * 0.5) * RotateZ(rot * 0.5);		// rotate object
+	object.transform = mat3x4(object.transform) * mat3x4(RotateX(rot * 0.5) * RotateY(rot * 0.5) * RotateZ(rot * 0.5));	// rotate object
 	wavyMesh.transform = Scale(1.0, 1.0, 1.0) * Translate(objectPos);										// position for wavy mesh
 
 	DisplayMesh(square);	// display floor mesh
 	DisplayMesh(wall);		// display wall mesh
+	if (useShadowVolume && !flag)
+		shadowVolume.Render(camera.fullview);
 
 	UseDrawShader(camera.fullview);
 	glEnable(GL_DEPTH_TEST);
@@ -356,7 +391,6 @@ void MouseButton(GLFWwindow* w, int butn, int action, int mods) {
 				else if (picked == &freqControl) {
 					freq = freqControl.Value();
 					MakeWavyPoints();
-					SetWavyIndices();
 				}
 
 				else if (picked == &lightSize)
@@ -410,7 +444,6 @@ void MouseMove(GLFWwindow* w, double x, double y) {
 					else if (picked == &freqControl) {
 						freq = freqControl.Value();
 						MakeWavyPoints();
-						SetWavyIndices();
 					}
 
 					else if (picked == &lightSize) 
@@ -435,6 +468,19 @@ void KeyBoard(GLFWwindow* window, int key, int scancode, int action, int mods) {
 
 		else if (key == GLFW_KEY_D) {
 			diagnostics = !diagnostics;
+			if (diagnostics)
+				printf("last frame: %i bytes uploaded, %i GPU allocations, %i objects created, %i mesh draw calls, %lld heap allocations (frame arena high water %.1f KB)\n",
+					(int) frameCounters.bytesUploaded, frameCounters.allocations, frameCounters.objectsCreated, frameCounters.drawCalls,
+					frameHeapAllocations, frameArena.highWater/1024.f);
+		}
+
+		else if (key == GLFW_KEY_M) {
+			MemorySnapshot s = memoryLedger.Snapshot();
+			if (WriteJson("memory.json", Json(s)))
+				printf("memory: %.2f MB CPU, %.2f MB GPU (high water %.2f, %.2f) in %i owners, written to memory.json\n",
+					s.cpu/(1024.f*1024.f), s.gpu/(1024.f*1024.f), s.cpuHighWater/(1024.f*1024.f), s.gpuHighWater/(1024.f*1024.f), (int) s.owners.size());
+			printf("since last: %s", JsonDiff(lastMemory, s).c_str());
+			lastMemory = s;
 		}
 
 		else if (key == GLFW_KEY_L && currentTexture <= objTextureEndIndex) {
@@ -450,6 +496,27 @@ void KeyBoard(GLFWwindow* window, int key, int scancode, int action, int mods) {
 		else if (key == GLFW_KEY_S)
 			cpuShadow = !cpuShadow;
 
+		else if (key == GLFW_KEY_B)
+			useLightmaps = !useLightmaps;
+
+		else if (key == GLFW_KEY_G) {
+			gpuPrepare = !gpuPrepare;
+			if (gpuPrepare) {
+				mat4 objTransform = mat3x4(camera.modelview) * mat3x4(object.transform);
+				printf("gpu prepare: largest difference from cpu %g (packed position error %g)\n",
+					eyeOccluder.CompareGPU(object, objTransform, occluderBinding), object.packed? object.packer.maxPositionError : 0.f);
+			}
+		}
+
+		else if (key == GLFW_KEY_O)
+			useOcclusion = !useOcclusion;
+
+		else if (key == GLFW_KEY_W)
+			wireframe = !wireframe;
+
+		else if (key == GLFW_KEY_V)
+			useShadowVolume = !useShadowVolume;
+
 		else if (key == GLFW_KEY_Q && rot > 0)
 			rot--;
 
@@ -519,11 +586,15 @@ int main(int ac, char** av) {
 	MakeWavyPoints();							// wavycube point
 
 
-	// set up for wall and ground
+	// set up for wall and ground (the wall shares the floor's geometry, buffers and texture; see AssetCache.h)
+	MeshCounters loadStart = meshCounters;
+	object.quantize = square.quantize = wall.quantize = packVertices;
 	square.Read(squareFile, squareTexFile, 1, NULL, true, 0);
-	square.transform = Scale(2, 2, 2) * Translate(0, -.1, -.01f);
+	square.transform = squareTransform;
 	wall.Read(squareFile, squareTexFile, 1, NULL, true, 0);
-	wall.transform = Translate(0, 1, -2.5) * Scale(2, 2, 2) * RotateX(90);
+	wall.transform = wallTransform;
+	baker.Add(&square);
+	baker.Add(&wall);
 
 	// set up a list of ready textures for the cube to use
 	textureNames.push_back(cubeTexFile);
@@ -538,9 +609,24 @@ int main(int ac, char** av) {
 	}
 	else {
 		object.Read(catFile, catTexFile, 1, NULL, true, 12);
-		printf("%i vertices, %i triangles\n", object.points.size(), object.triangles.size());
+		printf("%i vertices, %i triangles\n", object.Points().size(), object.Triangles().size());
 		object.transform = Translate(0, .7f, 0);
 	}
+	if (object.packed)
+		object.packer.Print((int) object.Points().size(), (int) object.Triangles().size(), object.Normals().size() > 0,
+							object.Uvs().size() > 0, false, object.indexType == GL_UNSIGNED_SHORT);
+	occlusionBaker.progress = [](float f) { printf("\rbaking ambient occlusion: %3.0f%%", 100*f); };
+	if (occlusionBaker.Bake(object))
+		printf("ambient occlusion read from %s.ao\n", object.objFilename.c_str());
+	else
+		printf("\nambient occlusion: %i vertices baked in %.0f ms\n", (int)object.Points().size(), occlusionBaker.bakeMs);
+	object.BufferOcclusion();
+	shadowVolume.Init(object);
+	printf("load: %.2f MB uploaded in %i buffer allocations, peak memory %.1f MB\n",
+		   (meshCounters.bytesUploaded-loadStart.bytesUploaded)/(1024.f*1024.f),
+		   meshCounters.allocations-loadStart.allocations, PeakMemory()/(1024.f*1024.f));
+	assetCache.Print();
+	glPool.Print();
 
 	// callbacks
 	glfwSetCursorPosCallback(w, MouseMove);
@@ -552,7 +638,13 @@ int main(int ac, char** av) {
 
 	// event loop
 	glfwSwapInterval(1);
+	long long heapStart = HeapAllocations();
 	while (!glfwWindowShouldClose(w)) {
+		frameCounters = meshCounters;
+		meshCounters = MeshCounters();
+		frameHeapAllocations = HeapAllocations()-heapStart;
+		heapStart = HeapAllocations();
+		frameArena.Reset();
 		MakeWavyPoints();
 		Display(w);
 		glfwPollEvents();
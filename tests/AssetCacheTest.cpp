@@ -0,0 +1,119 @@
+// AssetCacheTest.cpp - meshes read from one file share the asset's geometry and buffers, copying on first write
+//     cl /O2 /std:c++17 /IInclude /Itests tests\AssetCacheTest.cpp tests\GLStub.cpp Lib\*.cpp Lib\glad.c glfw3.lib opengl32.lib Lib\freetype.lib
+//     (linked as the apps in src are; no window or context is opened)
+// 100 meshes read a 40k-vertex grid: one read, one CPU copy of the geometry (reported once, by the asset) and
+// one vertex array; a mesh that changes its geometry copies it first and leaves the others' as read
+
+#include <memory>
+#include <stdio.h>
+#include <string.h>
+#include "AssetCache.h"
+#include "GLStub.h"
+#include "Meshadow.h"
+#include "Test.h"
+
+namespace {
+
+const char *objFile = "AssetCacheTest.obj";
+const int Side = 200, NMeshes = 100;
+
+bool WriteGrid(const char *filename) {
+	// Side by Side vertices with normals and uvs, two triangles per cell
+	FILE *f = fopen(filename, "w");
+	if (!f)
+		return false;
+	for (int j = 0; j < Side; j++)
+		for (int i = 0; i < Side; i++)
+			fprintf(f, "v %f %f %f\nvt %f %f\nvn 0 0 1\n", (float) i, (float) j, .1f*((i*j)%7), (float) i/Side, (float) j/Side);
+	for (int j = 0; j+1 < Side; j++)
+		for (int i = 0; i+1 < Side; i++) {
+			int k = j*Side+i+1;
+			fprintf(f, "f %i/%i/%i %i/%i/%i %i/%i/%i\n", k, k, k, k+1, k+1, k+1, k+Side+1, k+Side+1, k+Side+1);
+			fprintf(f, "f %i/%i/%i %i/%i/%i %i/%i/%i\n", k, k, k, k+Side+1, k+Side+1, k+Side+1, k+Side, k+Side, k+Side);
+		}
+	fclose(f);
+	return true;
+}
+
+size_t CpuGeometry() {
+	// points, normals, uvs, triangles and quads reported to the ledger
+	size_t n = 0;
+	for (MemoryCategory c : { MemPoints, MemNormals, MemUvs, MemTriangles, MemQuads })
+		n += memoryLedger.Total(c);
+	return n;
+}
+
+template <class T> bool Same(const vector<T> &a, const vector<T> &b) {
+	return a.size() == b.size() && !memcmp(a.data(), b.data(), a.size()*sizeof(T));
+}
+
+size_t OwnBytes(const Mesh &m) {
+	return m.points.capacity()*sizeof(vec3)+m.normals.capacity()*sizeof(vec3)+m.uvs.capacity()*sizeof(vec2)+
+		   m.triangles.capacity()*sizeof(int3)+m.quads.capacity()*sizeof(int4);
+}
+
+} // end namespace
+
+int main() {
+	if (!Check(LoadGLStub(), "GL stub loaded as 4.5") || !Check(WriteGrid(objFile), "wrote %s", objFile))
+		return Failures();
+	size_t cpuBefore = CpuGeometry();
+	std::weak_ptr<const MeshGeometry> geometry;
+	{
+		vector<Mesh> meshes(NMeshes);
+		for (Mesh &m : meshes)
+			m.Read(objFile);
+		MeshAsset *a = meshes[0].meshAsset;
+		const MeshGeometry *g = a? a->mesh->sharedGeometry.get() : NULL;
+		if (!Check(g != NULL, "%s read as an asset", objFile))
+			return Failures();
+		geometry = a->mesh->sharedGeometry;
+		int nShared = 0;
+		for (Mesh &m : meshes)
+			nShared += m.meshAsset == a && m.sharedGeometry.get() == g && m.vao == a->mesh->vao && !m.points.size() && !m.triangles.size();
+		Check(assetCache.misses == 1 && assetCache.hits == NMeshes-1 && nShared == NMeshes,
+			  "%i meshes, %i points, %i triangles: %i read, %i share the geometry and vertex array, holding no arrays of their own",
+			  NMeshes, (int) g->points.size(), (int) g->triangles.size(), assetCache.misses, nShared);
+		Check(!a->mesh->points.size() && a->mesh->Points().data() == g->points.data(),
+			  "the asset's mesh arrays moved to the shared geometry once buffered");
+		size_t cpu = CpuGeometry()-cpuBefore;
+		Check(cpu == g->Bytes() && a->bytes > g->Bytes(), "geometry reported once: %.2f MB for %i meshes (asset %.2f MB with buffers)",
+			  cpu/(1024.f*1024.f), NMeshes, a->bytes/(1024.f*1024.f));
+		// re-buffering (eg, with baked occlusion) gives a mesh buffers of its own, not geometry
+		Mesh &b = meshes[1];
+		b.occlusion.assign(g->points.size(), .5f);
+		b.Buffer();
+		Check(!b.meshAsset && b.vao && b.vao != a->mesh->vao && b.sharedGeometry.get() == g && CpuGeometry()-cpuBefore == g->Bytes(),
+			  "re-buffered: own vertex array, geometry still shared");
+		// changes copy first: SetNormals and BuildMeshlets write the mesh's own arrays, not the asset's
+		vector<vec3> normals = g->normals;
+		vector<int3> triangles = g->triangles;
+		Mesh &c = meshes[2], &d = meshes[3];
+		c.SetNormals(AreaWeight);
+		d.BuildMeshlets();
+		bool copied = !c.sharedGeometry && !d.sharedGeometry && c.Points().data() != g->points.data() &&
+					  c.normals.size() == normals.size() && d.triangles.size() == triangles.size() && !Same(d.triangles, triangles);
+		Check(copied && Same(g->normals, normals) && Same(g->triangles, triangles),
+			  "SetNormals and BuildMeshlets copy on first write; the shared normals and triangles are unchanged");
+		nShared = 0;
+		for (Mesh &m : meshes)
+			nShared += m.sharedGeometry.get() == g;
+		cpu = CpuGeometry()-cpuBefore;
+		Check(nShared == NMeshes-2 && cpu == g->Bytes()+OwnBytes(c)+OwnBytes(d),
+			  "%i meshes still share; %.2f MB reported: the asset's geometry and the two copies", nShared, cpu/(1024.f*1024.f));
+		// Meshadow reads share as well
+		Meshadow s1, s2;
+		s1.Read(objFile, (mat4 *) NULL);
+		s2.Read(objFile, (mat4 *) NULL);
+		Check(s1.sharedGeometry && s1.sharedGeometry == s2.sharedGeometry && s1.storage == s2.storage && !s1.points.size() &&
+			  s1.Triangles().size() == triangles.size(), "two Meshadows share geometry and storage");
+	}
+	// released: the idle asset is freed with its geometry
+	assetCache.Trim(0);
+	Check(geometry.expired() && CpuGeometry() == cpuBefore && assetCache.bytesResident == 0,
+		  "after the meshes and assetCache.Trim(0): geometry freed, %i bytes reported, %i resident",
+		  (int) (CpuGeometry()-cpuBefore), (int) assetCache.bytesResident);
+	remove(objFile);
+	printf("%s\n", Failures()? "FAILED" : "passed");
+	return Failures();
+}
@@ -0,0 +1,172 @@
+// BatchTest.cpp - batch quaternion and frame kernels against the Quaternion and Frame methods: accuracy and throughput
+//     g++ -O2 -std=c++17 -ffp-contract=off -IInclude tests/BatchTest.cpp Lib/Batch.cpp Lib/Arena.cpp Lib/Parallel.cpp Lib/Quaternion.cpp -lpthread -o BatchTest
+//     cl /O2 /std:c++17 /IInclude tests\BatchTest.cpp Lib\Batch.cpp Lib\Arena.cpp Lib\Parallel.cpp Lib\Quaternion.cpp
+// pairs are random, close (both sides of Slerp's linear threshold) and nearly opposite (both sides of its
+// perpendicular threshold); Slerp is measured against its formula in double, with the branches taken as in float
+
+#include <stdlib.h>
+#include <vector>
+#include "Batch.h"
+#include "Quaternion.h"
+#include "Test.h"
+
+TEST_SINK;
+
+namespace {
+
+const int N = 100000;
+
+float Random(float lo, float hi) { return lo+(hi-lo)*rand()/RAND_MAX; }
+
+Quaternion Unit(Quaternion q) { return q*(1/sqrt(q.Norm())); }
+
+Quaternion RandomQuaternion() {
+	return Unit(Quaternion(Random(-1, 1), Random(-1, 1), Random(-1, 1), Random(-1, 1)+.01f));
+}
+
+Quaternion Perturb(Quaternion q, float d) {
+	return Unit(q+Quaternion(Random(-d, d), Random(-d, d), Random(-d, d), Random(-d, d)));
+}
+
+Quaternion SlerpReference(const Quaternion &a, const Quaternion &b, float t) {
+	// Quaternion::Slerp in double, branching on the float dot product
+	float c = a.x*b.x+a.y*b.y+a.z*b.z+a.w*b.w, epsilon = .00001f;
+	double cd = (double) a.x*b.x+(double) a.y*b.y+(double) a.z*b.z+(double) a.w*b.w, p0, p1;
+	double q0[] = { a.x, a.y, a.z, a.w }, q1[] = { b.x, b.y, b.z, b.w }, r[4];
+	if (1+c <= epsilon) {
+		q1[0] = -a.y; q1[1] = a.x; q1[2] = -a.w; q1[3] = a.z;
+		p0 = sin((.5-t)*3.14159265358979);
+		p1 = sin(t*3.14159265358979);
+	}
+	else if (1-c <= epsilon) {
+		p0 = 1-(double) t;
+		p1 = t;
+	}
+	else {
+		double omega = acos(cd), sinOmega = sin(omega);
+		p0 = sin((1-(double) t)*omega)/sinOmega;
+		p1 = sin(t*omega)/sinOmega;
+	}
+	for (int k = 0; k < 4; k++)
+		r[k] = p0*q0[k]+p1*q1[k];
+	return Quaternion((float) r[0], (float) r[1], (float) r[2], (float) r[3]);
+}
+
+float Difference(const Quaternion &a, const Quaternion &b) {
+	return fmax(fmax(fabs(a.x-b.x), fabs(a.y-b.y)), fmax(fabs(a.z-b.z), fabs(a.w-b.w)));
+}
+
+float Difference(const mat4 &a, const mat4 &b) {
+	// relative to the larger magnitude, for scaled rotations and translations
+	float d = 0;
+	for (int i = 0; i < 4; i++)
+		for (int j = 0; j < 4; j++)
+			d = fmax(d, fabs(a[i][j]-b[i][j])/fmax(1.f, fmax(fabs(a[i][j]), fabs(b[i][j]))));
+	return d;
+}
+
+float Difference(const Frame &a, const Frame &b) {
+	float d = Difference(a.orientation, b.orientation);
+	for (int k = 0; k < 3; k++)
+		d = fmax(d, fabs(a.position[k]-b.position[k])/fmax(1.f, fabs(b.position[k])));
+	return fmax(d, fabs(a.scale-b.scale)/b.scale);
+}
+
+Frame RandomFrame() {
+	return Frame(RandomQuaternion(), vec3(Random(-10, 10), Random(-10, 10), Random(-10, 10)), Random(.1f, 4));
+}
+
+} // end namespace
+
+int main() {
+	srand(1);
+	// a third each random, close and nearly opposite; close and opposite offsets range 1e-7 to 1e-2
+	std::vector<Quaternion> a(N), b(N), r(N);
+	std::vector<Frame> fa(N), fb(N), fr(N);
+	std::vector<float> t(N);
+	std::vector<mat4> m(N), mRef(N);
+	for (int i = 0; i < N; i++) {
+		int kind = i%3;
+		float d = pow(10.f, Random(-7, -2));
+		a[i] = RandomQuaternion();
+		b[i] = kind == 0? RandomQuaternion() : kind == 1? Perturb(a[i], d) : Perturb(a[i]*-1, d);
+		t[i] = Random(0, 1);
+		fa[i] = RandomFrame();
+		fb[i] = RandomFrame();
+	}
+	quatSoA qa, qb, qr;
+	FrameSoA sa, sb, sr;
+	ToSoA(a.data(), N, qa);
+	ToSoA(b.data(), N, qb);
+	ToSoA(fa.data(), N, sa);
+	ToSoA(fb.data(), N, sb);
+	// accuracy
+	printf("accuracy, %i pairs:\n", N);
+	Slerp(qa, qb, t.data(), qr);
+	float dSlerp[3] = { 0, 0, 0 }, dScalar[3] = { 0, 0, 0 };
+	for (int i = 0; i < N; i++) {
+		Quaternion s, ref = SlerpReference(a[i], b[i], t[i]);
+		s.Slerp(a[i], b[i], t[i]);
+		dSlerp[i%3] = fmax(dSlerp[i%3], Difference(qr[i], ref));
+		dScalar[i%3] = fmax(dScalar[i%3], Difference(s, ref));
+	}
+	const char *kinds[] = { "random", "close", "nearly opposite" };
+	for (int k = 0; k < 3; k++)
+		Check(dSlerp[k] < 1e-6f, "Slerp, %s pairs, within %.1e (Quaternion::Slerp %.1e)", kinds[k], dSlerp[k], dScalar[k]);
+	Nlerp(qa, qb, t.data(), qr);
+	float dNlerp = 0;
+	for (int i = 0; i < N; i++) {
+		Quaternion s = a[i]*(1-t[i])+b[i]*t[i];
+		dNlerp = fmax(dNlerp, Difference(qr[i], s*(1/sqrt(s.Norm()))));
+	}
+	Check(dNlerp < 1e-6f, "Nlerp within %.1e of normalized (1-t)a+tb", dNlerp);
+	GetMatrices(qa, m.data());
+	float dRotations = 0;
+	for (int i = 0; i < N; i++)
+		dRotations = fmax(dRotations, Difference(m[i], a[i].GetMatrix()));
+	Check(dRotations < 1e-6f, "quaternion GetMatrices within %.1e of Quaternion::GetMatrix", dRotations);
+	Compose(sa, sb, sr);
+	float dCompose = 0, dParent = 0;
+	for (int i = 0; i < N; i++)
+		dCompose = fmax(dCompose, Difference(sr[i], fa[i]*fb[i]));
+	Compose(fa[0], sb, sr);
+	for (int i = 0; i < N; i++)
+		dParent = fmax(dParent, Difference(sr[i], fa[0]*fb[i]));
+	Check(dCompose < 1e-6f, "Compose within %.1e of Frame::operator*", dCompose);
+	Check(dParent < 1e-6f, "Compose with one parent within %.1e", dParent);
+	GetMatrices(sa, m.data());
+	float dFrames = 0;
+	for (int i = 0; i < N; i++)
+		dFrames = fmax(dFrames, Difference(m[i], fa[i].GetMatrix()));
+	Check(dFrames < 1e-6f, "frame GetMatrices within %.1e of Frame::GetMatrix", dFrames);
+	// throughput against the scalar methods, whole arrays (threads as in Parallel.h)
+	printf("ms per %i (best of 5): scalar, batch\n", N);
+	auto Report = [](const char *name, double scalar, double batch) {
+		printf("  %-22s %7.2f %7.2f  (%.1fx)\n", name, scalar, batch, scalar/batch);
+	};
+	Report("Slerp", BestMs(5, [&]() { for (int i = 0; i < N; i++) r[i].Slerp(a[i], b[i], t[i]); sink += r[N-1].w; }),
+				   BestMs(5, [&]() { Slerp(qa, qb, t.data(), qr); sink += qr.w[N-1]; }));
+	// as in animation, b negated where dot(a, b) < 0 for the shorter arc
+	for (int i = 0; i < N; i++)
+		if (a[i].x*b[i].x+a[i].y*b[i].y+a[i].z*b[i].z+a[i].w*b[i].w < 0)
+			b[i] = b[i]*-1;
+	ToSoA(b.data(), N, qb);
+	Report("Slerp, shorter arcs", BestMs(5, [&]() { for (int i = 0; i < N; i++) r[i].Slerp(a[i], b[i], t[i]); sink += r[N-1].w; }),
+								 BestMs(5, [&]() { Slerp(qa, qb, t.data(), qr); sink += qr.w[N-1]; }));
+	Report("Nlerp", BestMs(5, [&]() {
+						for (int i = 0; i < N; i++) {
+							Quaternion s = a[i]*(1-t[i])+b[i]*t[i];
+							r[i] = s*(1/sqrt(s.Norm()));
+						}
+						sink += r[N-1].w;
+					}),
+				   BestMs(5, [&]() { Nlerp(qa, qb, t.data(), qr); sink += qr.w[N-1]; }));
+	Report("quaternion matrices", BestMs(5, [&]() { for (int i = 0; i < N; i++) mRef[i] = a[i].GetMatrix(); sink += mRef[N-1][2][2]; }),
+								 BestMs(5, [&]() { GetMatrices(qa, m.data()); sink += m[N-1][2][2]; }));
+	Report("Compose", BestMs(5, [&]() { for (int i = 0; i < N; i++) fr[i] = fa[i]*fb[i]; sink += fr[N-1].scale; }),
+					 BestMs(5, [&]() { Compose(sa, sb, sr); sink += sr.scale[N-1]; }));
+	Report("frame matrices", BestMs(5, [&]() { for (int i = 0; i < N; i++) mRef[i] = fa[i].GetMatrix(); sink += mRef[N-1][2][3]; }),
+							BestMs(5, [&]() { GetMatrices(sa, m.data()); sink += m[N-1][2][3]; }));
+	printf("%s\n", Failures()? "FAILED" : "passed");
+	return Failures();
+}
@@ -0,0 +1,100 @@
+// DeformerBench.cpp - DeformerStack throughput in vertices per second, and the accuracy of its SSE sin and cos
+//     cl /O2 /std:c++17 /IInclude tests\DeformerBench.cpp Lib\*.cpp Lib\glad.c glfw3.lib opengl32.lib Lib\freetype.lib
+//     (linked as the apps in src are, for SetVertexNormals; no window or context is opened)
+// sin and cos are read back through the deformers: a unit wave gives sin(x), a unit twist of (x, 1, 0) gives
+// (x, cos(x), sin(x))
+
+#include <math.h>
+#include "Deformer.h"
+#include "Test.h"
+
+TEST_SINK;
+
+namespace {
+
+const int Side = 1500;                      // grid points per side, 2.25M in all
+
+void Grid(vector<vec3> &points, vector<int3> &triangles) {
+	// Side by Side points over [-1, 1] in xz, two triangles per cell
+	points.resize(Side*Side);
+	for (int j = 0; j < Side; j++)
+		for (int i = 0; i < Side; i++)
+			points[j*Side+i] = vec3(2.f*i/(Side-1)-1, 0, 2.f*j/(Side-1)-1);
+	triangles.resize(0);
+	for (int j = 0; j+1 < Side; j++)
+		for (int i = 0; i+1 < Side; i++) {
+			int k = j*Side+i;
+			triangles.push_back(int3(k, k+Side, k+Side+1));
+			triangles.push_back(int3(k, k+Side+1, k+1));
+		}
+}
+
+void Accuracy() {
+	// x over [-300, 300]; both against sinf and cosf, and against double
+	const int n = 600001;
+	vector<vec3> line(n);
+	for (int i = 0; i < n; i++)
+		line[i] = vec3(-300+600.f*i/(n-1), 1, 0);
+	DeformerStack wave, twist;
+	wave.deformers.push_back(Wave(0, vec3(0, 0, 1), 1, 1/6.28318531f));
+	twist.deformers.push_back(Twist(0, 1));
+	wave.SetRest(line);
+	twist.SetRest(line);
+	wave.Apply();
+	twist.Apply();
+	const vector<vec3> &w = wave.points[wave.front], &t = twist.points[twist.front];
+	float sinError = 0, cosError = 0, sinfError = 0;
+	double exactError = 0;
+	for (int i = 0; i < n; i++) {
+		float x = line[i].x;
+		// the wave's argument is 2*pi*frequency*x, within rounding of x
+		float xw = 6.28318531f*(1/6.28318531f)*x;
+		sinfError = fmaxf(sinfError, fabsf(w[i].z-sinf(xw)));
+		sinError = fmaxf(sinError, fabsf(t[i].z-sinf(x)));
+		cosError = fmaxf(cosError, fabsf(t[i].y-cosf(x)));
+		exactError = fmax(exactError, fmax(fabs(t[i].z-sin((double) x)), fabs(t[i].y-cos((double) x))));
+	}
+	Check(sinError < 5e-7f && cosError < 5e-7f && sinfError < 5e-7f,
+		  "SinCos on [-300, 300]: %.1e from sinf, %.1e from cosf (wave %.1e from sinf)", sinError, cosError, sinfError);
+	Check(exactError < 5e-7, "SinCos on [-300, 300]: %.1e from sin and cos in double", exactError);
+}
+
+void Time(const char *name, vector<Deformer> deformers, bool normals, vector<vec3> &points, vector<int3> &triangles) {
+	DeformerStack stack;
+	stack.deformers = deformers;
+	stack.setNormals = normals;
+	stack.SetRest(points, normals? &triangles : NULL);
+	stack.Apply();                          // size the outputs (and the adjacency)
+	double ms = BestMs(5, [&]() { stack.Apply(); sink += stack.points[stack.front].back().y; });
+	printf("  %-22s %8.2f ms %8.1f M vertices/s\n", name, ms, Side*Side/(1000*ms));
+}
+
+} // end namespace
+
+int main() {
+	Accuracy();
+	vector<vec3> points;
+	vector<int3> triangles;
+	Grid(points, triangles);
+	Deformer wave = Wave(0, vec3(0, 1, 0), .1f, 2, .3f), twist = Twist(2, 1.5f), bend = Bend(0, 1, .8f),
+			 noise = Noise(vec3(0, 1, 0), .05f, 3, .2f);
+	// bend keeps the axis on a circle of radius 1/curvature about (0, 1/curvature, 0)
+	DeformerStack bent;
+	bent.deformers.push_back(bend);
+	bent.SetRest(points);
+	bent.Apply();
+	float radiusError = 0;
+	for (const vec3 &p : bent.points[bent.front])
+		if (p.z == -1)
+			radiusError = fmaxf(radiusError, fabsf(length(p-vec3(0, 1/.8f, -1))-1/.8f));
+	Check(radiusError < 1e-5f, "bend: axis within %.1e of its circle", radiusError);
+	printf("%ix%i grid (%i vertices), best of 5, threads as in Parallel.h:\n", Side, Side, Side*Side);
+	Time("wave", { wave }, false, points, triangles);
+	Time("twist", { twist }, false, points, triangles);
+	Time("bend", { bend }, false, points, triangles);
+	Time("noise", { noise }, false, points, triangles);
+	Time("stack", { wave, twist, bend, noise }, false, points, triangles);
+	Time("stack + normals", { wave, twist, bend, noise }, true, points, triangles);
+	printf("%s\n", Failures()? "FAILED" : "passed");
+	return Failures();
+}
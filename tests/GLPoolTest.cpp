@@ -0,0 +1,104 @@
+// GLPoolTest.cpp - GL object reuse across frames against a counting GL stub
+//     cl /O2 /std:c++17 /IInclude /Itests tests\GLPoolTest.cpp tests\GLStub.cpp Lib\*.cpp Lib\glad.c glfw3.lib opengl32.lib Lib\freetype.lib
+//     (linked as the apps in src are; no window or context is opened)
+// each frame creates and destroys what a scene load does: two Meshadows (one textured), a Mesh with edges and
+// streamed points, and a texture from assetCache, evicted; from the second frame on, all of it comes from glPool
+
+#include <stdio.h>
+#include "AssetCache.h"
+#include "GLPool.h"
+#include "GLStub.h"
+#include "Meshadow.h"
+#include "Misc.h"
+#include "Test.h"
+
+namespace {
+
+const char *objFile = "GLPoolTest.obj", *texFile = "GLPoolTest.tga";
+
+bool WriteSquare(const char *filename) {
+	FILE *f = fopen(filename, "w");
+	if (!f)
+		return false;
+	fprintf(f, "v -1 -1 0\nv 1 -1 0\nv 1 1 0\nv -1 1 0\nvt 0 0\nvt 1 0\nvt 1 1\nvt 0 1\nvn 0 0 1\n");
+	fprintf(f, "f 1/1/1 2/2/1 3/3/1\nf 1/1/1 3/3/1 4/4/1\n");
+	fclose(f);
+	return true;
+}
+
+bool WriteChecker(const char *filename) {
+	// 64 by 64 (small enough to pool: a large photograph would exceed maxPooledBytes and be deleted on release)
+	unsigned char pixels[64*64*3];
+	for (int i = 0; i < 64*64*3; i++)
+		pixels[i] = ((i/3)%64/8+(i/3)/64/8)%2? 255 : 0;
+	return WriteTarga(filename, pixels, 64, 64);
+}
+
+void LoadAndFree(int frame) {
+	Meshadow a, b;
+	a.shareAssets = b.shareAssets = false;
+	a.Read(objFile, texFile, 1);
+	b.Read(objFile, (mat4 *) NULL);
+	Mesh m;
+	m.shareAssets = false;
+	m.points.resize(1000+frame%2);						// sizes differing by a point reuse the same buffers
+	m.normals.resize(m.points.size());
+	for (int i = 0; i < 300; i++)
+		m.triangles.push_back(int3(i, i+1, i+2));
+	m.Buffer();
+	m.UpdateEdges();
+	m.UpdatePoints();
+	TextureAsset *t = assetCache.GetTexture(texFile);
+	if (t)
+		t->Release();
+	assetCache.Trim(0);
+}
+
+} // end namespace
+
+int main() {
+	if (!Check(LoadGLStub(), "GL stub loaded as 4.5") || !Check(WriteSquare(objFile) && WriteChecker(texFile), "wrote %s, %s", objFile, texFile))
+		return Failures();
+	int nGenerated = 0, nStubGenerated = 0, nBufferData = 0, nLive = 0, nReused = 0;
+	for (int frame = 0; frame < 8; frame++) {
+		GLPoolCounts p0 = glPool.Counts();
+		GLStubCounts gl = glStub;
+		LoadAndFree(frame);
+		GLPoolCounts p = glPool.Counts();
+		int generated = p.generated-p0.generated, reused = p.reused-p0.reused, live = p.buffers+p.vertexArrays+p.textures;
+		if (frame == 0) {
+			Check(generated > 0 && generated == glStub.generated-gl.generated && live == 0,
+				  "frame 0: %i objects generated, %i glBufferData, %i live after", generated, glStub.bufferData-gl.bufferData, live);
+			continue;
+		}
+		nGenerated += generated;
+		nStubGenerated += glStub.generated-gl.generated;
+		nBufferData += glStub.bufferData-gl.bufferData;
+		nLive += live;
+		nReused += reused;
+	}
+	Check(nGenerated == 0 && nStubGenerated == 0, "frames 1-7: %i objects generated by glPool, %i GL names generated", nGenerated, nStubGenerated);
+	Check(nBufferData == 0, "frames 1-7: %i glBufferData", nBufferData);
+	Check(nReused > 0 && nLive == 0, "frames 1-7: %i objects reused (%i per frame), none live after", nReused, nReused/7);
+	// storage beyond maxPooledBytes is deleted on release, not kept
+	GLStubCounts gl = glStub;
+	GLuint big = glPool.AcquireTexture(8192, 8192, GL_RGBA, false);
+	glPool.ReleaseTexture(big);
+	Check(glStub.deleted-gl.deleted == 1, "a texture larger than maxPooledBytes is deleted on release");
+	// Trim deletes the largest first, whatever the kind: a 1 MB buffer before a 256 KB texture
+	glPool.Trim(0);
+	GLuint buffer = glPool.AcquireBuffer(GL_ARRAY_BUFFER, 1 << 20), texture = glPool.AcquireTexture(256, 256, GL_RGBA);
+	glPool.ReleaseBuffer(buffer);
+	glPool.ReleaseTexture(texture);
+	gl = glStub;
+	glPool.Trim(300 << 10);
+	Check(glStub.deleted-gl.deleted == 1 && glPool.Counts().pooled == 1 && glPool.Counts().pooledBytes == 256*256*4,
+		  "Trim(300 KB) deletes the buffer, keeps the texture");
+	glPool.Trim(0);
+	Check(GLStubLiveNames() == 0 && glStub.badDeletes == 0, "after glPool.Trim(0): %i live GL names, %i bad deletes",
+		  GLStubLiveNames(), glStub.badDeletes);
+	remove(objFile);
+	remove(texFile);
+	printf("%s\n", Failures()? "FAILED" : "passed");
+	return Failures();
+}
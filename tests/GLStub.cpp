@@ -0,0 +1,124 @@
+// GLStub.cpp - a GL without a context, for tests of buffer and object management
+
+#include <set>
+#include <string.h>
+#include <vector>
+#include "GLStub.h"
+
+GLStubCounts glStub;
+
+namespace {
+
+std::set<GLuint> liveNames;
+GLuint nextName = 1;
+std::vector<char> scratch;
+size_t mappedSize = 0;
+
+GLuint NewName() {
+	glStub.generated++;
+	liveNames.insert(nextName);
+	return nextName++;
+}
+
+void DeleteName(GLuint name) {
+	if (!name)
+		return;
+	glStub.deleted++;
+	if (!liveNames.erase(name))
+		glStub.badDeletes++;
+}
+
+// names
+
+void APIENTRY Gen(GLsizei n, GLuint *names) { for (int i = 0; i < n; i++) names[i] = NewName(); }
+void APIENTRY Create(GLenum, GLsizei n, GLuint *names) { Gen(n, names); }	// glCreateTextures, glCreateQueries
+void APIENTRY Delete(GLsizei n, const GLuint *names) { for (int i = 0; i < n; i++) DeleteName(names[i]); }
+GLuint APIENTRY CreateObject() { return NewName(); }
+GLuint APIENTRY CreateShader(GLenum) { return NewName(); }
+void APIENTRY DeleteObject(GLuint name) { DeleteName(name); }
+
+// buffers
+
+void APIENTRY BufferData(GLenum, GLsizeiptr size, const void *, GLenum) {
+	glStub.bufferData++;
+	glStub.bytesAllocated += (size_t) size;
+}
+
+void APIENTRY BufferSubData(GLenum, GLintptr, GLsizeiptr, const void *) { glStub.bufferSubData++; }
+
+void *APIENTRY MapBufferRange(GLenum, GLintptr, GLsizeiptr length, GLbitfield) {
+	glStub.maps++;
+	if (scratch.size() < (size_t) length)
+		scratch.resize((size_t) length);
+	mappedSize = (size_t) length;
+	return scratch.data();
+}
+
+GLboolean APIENTRY UnmapBuffer(GLenum) { return GL_TRUE; }
+
+// queries
+
+const GLubyte *APIENTRY GetString(GLenum name) {
+	return (const GLubyte *) (name == GL_VERSION? "4.5 stub" : name == GL_SHADING_LANGUAGE_VERSION? "4.50 stub" : "stub");
+}
+
+const GLubyte *APIENTRY GetStringi(GLenum, GLuint) { return (const GLubyte *) "GL_stub"; }
+
+void APIENTRY GetIntegerv(GLenum name, GLint *v) {
+	if (name == GL_VIEWPORT) { v[0] = v[1] = 0; v[2] = 640; v[3] = 480; }
+	else *v = name == GL_NUM_EXTENSIONS? 1 : name == GL_MAJOR_VERSION? 4 : name == GL_MINOR_VERSION? 5 :
+			  name == GL_MAX_VERTEX_ATTRIBS || name == GL_MAX_COMBINED_TEXTURE_IMAGE_UNITS? 16 : 0;
+}
+
+void APIENTRY GetFloatv(GLenum name, GLfloat *v) {
+	if (name == GL_VIEWPORT) { v[0] = v[1] = 0; v[2] = 640; v[3] = 480; }
+	else if (name == GL_DEPTH_RANGE) { v[0] = 0; v[1] = 1; }
+	else *v = 0;
+}
+
+void APIENTRY GetObjectiv(GLuint, GLenum name, GLint *v) { *v = name == GL_COMPILE_STATUS || name == GL_LINK_STATUS? GL_TRUE : 0; }
+GLint APIENTRY GetLocation(GLuint, const GLchar *) { return -1; }
+
+// everything else
+
+GLuint64 APIENTRY Zero() { return 0; }
+
+struct Entry { const char *name; void *function; };
+
+const Entry entries[] = {
+	{ "glGenBuffers", (void *) Gen }, { "glGenVertexArrays", (void *) Gen }, { "glGenTextures", (void *) Gen },
+	{ "glGenFramebuffers", (void *) Gen }, { "glGenRenderbuffers", (void *) Gen }, { "glGenQueries", (void *) Gen },
+	{ "glGenSamplers", (void *) Gen }, { "glCreateBuffers", (void *) Gen }, { "glCreateVertexArrays", (void *) Gen },
+	{ "glCreateFramebuffers", (void *) Gen }, { "glCreateRenderbuffers", (void *) Gen }, { "glCreateSamplers", (void *) Gen },
+	{ "glCreateTextures", (void *) Create }, { "glCreateQueries", (void *) Create },
+	{ "glDeleteBuffers", (void *) Delete }, { "glDeleteVertexArrays", (void *) Delete }, { "glDeleteTextures", (void *) Delete },
+	{ "glDeleteFramebuffers", (void *) Delete }, { "glDeleteRenderbuffers", (void *) Delete }, { "glDeleteQueries", (void *) Delete },
+	{ "glDeleteSamplers", (void *) Delete },
+	{ "glCreateProgram", (void *) CreateObject }, { "glCreateShader", (void *) CreateShader },
+	{ "glDeleteProgram", (void *) DeleteObject }, { "glDeleteShader", (void *) DeleteObject },
+	{ "glBufferData", (void *) BufferData }, { "glBufferSubData", (void *) BufferSubData },
+	{ "glMapBufferRange", (void *) MapBufferRange }, { "glUnmapBuffer", (void *) UnmapBuffer },
+	{ "glGetString", (void *) GetString }, { "glGetStringi", (void *) GetStringi },
+	{ "glGetIntegerv", (void *) GetIntegerv }, { "glGetFloatv", (void *) GetFloatv },
+	{ "glGetShaderiv", (void *) GetObjectiv }, { "glGetProgramiv", (void *) GetObjectiv },
+	{ "glGetUniformLocation", (void *) GetLocation }, { "glGetAttribLocation", (void *) GetLocation }
+};
+
+void *Load(const char *name) {
+	for (const Entry &e : entries)
+		if (!strcmp(e.name, name))
+			return e.function;
+	return (void *) Zero;
+}
+
+} // end namespace
+
+bool LoadGLStub() { return gladLoadGLLoader(Load) && GLVersion.major == 4 && GLVersion.minor == 5; }
+
+int GLStubLiveNames() { return (int) liveNames.size(); }
+
+const void *GLStubMapped(size_t *size) {
+	if (size)
+		*size = mappedSize;
+	return scratch.data();
+}
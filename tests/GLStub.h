@@ -0,0 +1,36 @@
+// GLStub.h - a GL without a context, for tests of buffer and object management
+
+#ifndef GL_STUB_HDR
+#define GL_STUB_HDR
+
+#include <glad.h>
+#include <stddef.h>
+
+// LoadGLStub points glad's function pointers at the stub, which draws nothing: glGen* and glCreate* hand out
+// fresh names, glMapBufferRange returns a scratch block, glGetString reports 4.5, compile and link succeed,
+// uniform and attribute locations are -1; every other call does nothing and returns 0
+// the catch-all has no parameters, which is fine on 64-bit and cdecl targets (not 32-bit Windows APIENTRY)
+
+struct GLStubCounts {
+	int generated = 0;                      // names handed out by glGen* and glCreate*
+	int deleted = 0;                        // names passed to glDelete* (other than 0)
+	int badDeletes = 0;                     // of those, names not live (deleted twice, or never generated)
+	int bufferData = 0;                     // glBufferData calls, each (re)allocating storage
+	int bufferSubData = 0;                  // glBufferSubData calls
+	int maps = 0;                           // glMapBufferRange calls
+	size_t bytesAllocated = 0;              // sum of glBufferData sizes
+};
+
+extern GLStubCounts glStub;
+	// totals since the last reset (glStub = GLStubCounts())
+
+bool LoadGLStub();
+	// return true if glad loaded all of GL 4.5 from the stub
+
+int GLStubLiveNames();
+	// names generated and not deleted
+
+const void *GLStubMapped(size_t *size = NULL);
+	// block returned by the last glMapBufferRange (and its size), to check what was written
+
+#endif
@@ -0,0 +1,101 @@
+// Mat3x4Bench.cpp - mat3x4 composition and inversion against mat4: agreement and throughput
+//     g++ -O2 -std=c++17 -ffp-contract=off -IInclude tests/Mat3x4Bench.cpp -o Mat3x4Bench
+//     g++ -O2 -std=c++17 -ffp-contract=off -DVECMAT_SCALAR -IInclude tests/Mat3x4Bench.cpp -o Mat3x4BenchScalar
+//     cl /O2 /std:c++17 /IInclude tests\Mat3x4Bench.cpp     (add /DVECMAT_SCALAR for the scalar build)
+
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include "VecMat.h"
+#include "Test.h"
+
+TEST_SINK;
+
+namespace {
+
+const int N = 1024;
+
+float Random(float lo, float hi) { return lo+(hi-lo)*rand()/RAND_MAX; }
+
+mat4 RandomTRS() {
+	return Translate(Random(-10, 10), Random(-10, 10), Random(-10, 10))*RotateZ(Random(-180, 180))*
+		   RotateX(Random(-180, 180))*RotateY(Random(-180, 180))*Scale(Random(.1f, 4), Random(.1f, 4), Random(.1f, 4));
+}
+
+float SignedUnit() {
+	static const float values[] = { 0.f, -0.f, 1.f, -1.f };
+	return values[rand()%4];
+}
+
+float MaxDifference(const mat4 &a, const mat4 &b) {
+	// relative to the larger magnitude, for entries of either size
+	float d = 0;
+	for (int i = 0; i < 4; i++)
+		for (int j = 0; j < 4; j++)
+			d = fmax(d, fabs(a[i][j]-b[i][j])/fmax(1.f, fmax(fabs(a[i][j]), fabs(b[i][j]))));
+	return d;
+}
+
+} // end namespace
+
+int main() {
+#if defined(VECMAT_SSE)
+	printf("VecMat: SSE\n");
+#elif defined(VECMAT_NEON)
+	printf("VecMat: NEON\n");
+#else
+	printf("VecMat: scalar\n");
+#endif
+	srand(1);
+	std::vector<mat4> a4(N), b4(N), c4(N);
+	std::vector<mat3x4> a(N), b(N), c(N);
+	for (int i = 0; i < N; i++) {
+		a4[i] = RandomTRS();
+		b4[i] = RandomTRS();
+		a[i] = mat3x4(a4[i]);
+		b[i] = mat3x4(b4[i]);
+	}
+	// agreement with mat4
+	printf("agreement with mat4, %i random translate*rotate*scale matrices:\n", N);
+	int nSame = 0;
+	float dInvert = 0, dTRS = 0;
+	for (int i = 0; i < N; i++) {
+		mat4 p = mat4(a[i]*b[i]), q = a4[i]*b4[i];
+		nSame += memcmp(&p, &q, sizeof(mat4)) == 0;
+		mat4 inv4 = Invert(a4[i]);
+		dInvert = fmax(dInvert, MaxDifference(mat4(Invert(a[i])), inv4));
+		dTRS = fmax(dTRS, MaxDifference(mat4(InvertTRS(a[i])), inv4));
+	}
+	Check(nSame == N, "composition bit-identical to mat4 product: %i of %i", nSame, N);
+	// entries of 0, -0, 1 and -1, where the order of sums decides the sign of zeros
+	nSame = 0;
+	for (int n = 0; n < N; n++) {
+		mat3x4 s, t;
+		for (int i = 0; i < 3; i++)
+			for (int j = 0; j < 4; j++) {
+				s[i][j] = SignedUnit();
+				t[i][j] = SignedUnit();
+			}
+		mat4 p = mat4(s*t), q = mat4(s)*mat4(t);
+		nSame += memcmp(&p, &q, sizeof(mat4)) == 0;
+	}
+	Check(nSame == N, "composition bit-identical with signed zeros: %i of %i", nSame, N);
+	// different arithmetic, so a few ulps apart (relative to entries, or absolute below 1)
+	Check(dInvert < 1e-5f, "Invert within %.1e of mat4 Invert", dInvert);
+	Check(dTRS < 1e-5f, "InvertTRS within %.1e of mat4 Invert", dTRS);
+	// throughput: millions of operations per second, best of 15 runs, inputs in cache
+	printf("Mops/s (best of 15, %i inputs in cache):\n", N);
+	auto Report = [](const char *name, double ms) { printf("  %-20s %6.0f\n", name, N/(1000*ms)); };
+	Report("mat3x4 compose", BestMs(15, [&]() { for (int i = 0; i < N; i++) c[i] = a[i]*b[i]; sink += c[N-1][2][3]; }));
+	Report("mat4 compose", BestMs(15, [&]() { for (int i = 0; i < N; i++) c4[i] = a4[i]*b4[i]; sink += c4[N-1][2][3]; }));
+	Report("mat3x4 Invert", BestMs(15, [&]() { for (int i = 0; i < N; i++) c[i] = Invert(a[i]); sink += c[N-1][2][3]; }));
+	Report("mat3x4 InvertTRS", BestMs(15, [&]() { for (int i = 0; i < N; i++) c[i] = InvertTRS(a[i]); sink += c[N-1][2][3]; }));
+	Report("mat4 Invert", BestMs(15, [&]() { for (int i = 0; i < N; i++) c4[i] = Invert(a4[i]); sink += c4[N-1][2][3]; }));
+	Report("InverseMatrix4x4", BestMs(15, [&]() {
+		for (int i = 0; i < N; i++)
+			InverseMatrix4x4((const float *) a4[i], &c4[i][0].x);
+		sink += c4[N-1][2][3];
+	}));
+	printf("%s\n", Failures()? "FAILED" : "passed");
+	return Failures();
+}
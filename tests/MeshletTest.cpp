@@ -0,0 +1,159 @@
+// MeshletTest.cpp - BuildMeshlets and CullMeshlets: partition and bounds, no visible triangle culled, and timing
+//     g++ -O2 -std=c++17 -IInclude tests/MeshletTest.cpp Lib/Meshlet.cpp Lib/CornerTable.cpp Lib/Parallel.cpp -lpthread -o MeshletTest
+//     cl /O2 /std:c++17 /IInclude tests\MeshletTest.cpp Lib\Meshlet.cpp Lib\CornerTable.cpp Lib\Parallel.cpp
+// a torus of about 1M triangles, shuffled as a scanned mesh might be, seen from outside and from close up;
+// the brute-force check is that every culled triangle lies wholly outside one frustum plane or faces away
+
+#include <algorithm>
+#include <math.h>
+#include "Meshlet.h"
+#include "Parallel.h"
+#include "Test.h"
+
+namespace {
+
+void Torus(int nu, int nv, vector<vec3> &points, vector<int3> &triangles) {
+	// radii 1 and .35; counter-clockwise seen from outside
+	points.resize(0);
+	triangles.resize(0);
+	for (int j = 0; j < nv; j++)
+		for (int i = 0; i < nu; i++) {
+			float u = 6.28318531f*i/nu, v = 6.28318531f*j/nv, r = 1+.35f*cosf(v);
+			points.push_back(vec3(r*cosf(u), r*sinf(u), .35f*sinf(v)));
+		}
+	for (int j = 0; j < nv; j++)
+		for (int i = 0; i < nu; i++) {
+			int a = j*nu+i, b = j*nu+(i+1)%nu, c = (j+1)%nv*nu+i, d = (j+1)%nv*nu+(i+1)%nu;
+			triangles.push_back(int3(a, b, d));
+			triangles.push_back(int3(a, d, c));
+		}
+	unsigned int r = 1;                     // rand() may give only 15 bits
+	for (int i = (int) triangles.size()-1; i > 0; i--) {
+		r = r*1664525u+1013904223u;
+		std::swap(triangles[i], triangles[r%(i+1)]);
+	}
+}
+
+bool Partition(vector<vec3> &points, vector<int3> &before, vector<int3> &after, vector<int> &order, vector<Meshlet> &meshlets) {
+	// after is a permutation of before, given by order; meshlets tile it within the limits, with correct
+	// vertex counts and spheres that hold their vertices
+	int n = (int) before.size();
+	vector<char> seen(n, 0);
+	bool ok = (int) after.size() == n && (int) order.size() == n;
+	for (int i = 0; ok && i < n; i++) {
+		ok = order[i] >= 0 && order[i] < n && !seen[order[i]] && after[i] == before[order[i]];
+		seen[order[i]] = 1;
+	}
+	int next = 0;
+	vector<int> ids;
+	for (Meshlet &m : meshlets) {
+		ok = ok && m.first == next && m.count > 0 && m.count <= 124 && m.nVertices <= 64;
+		ids.resize(0);
+		for (int t = m.first; ok && t < m.first+m.count; t++)
+			for (int k = 0; k < 3; k++) {
+				int v = after[t][k];
+				ids.push_back(v);
+				ok = length(points[v]-m.center) <= m.radius*(1+1e-5f);
+			}
+		std::sort(ids.begin(), ids.end());
+		ok = ok && std::unique(ids.begin(), ids.end())-ids.begin() == m.nVertices;
+		next += m.count;
+	}
+	return ok && next == n;
+}
+
+int WronglyCulled(vector<vec3> &points, vector<int3> &triangles, vector<Meshlet> &meshlets, mat4 modelview, mat4 persp,
+				  MeshletCull &cull) {
+	// culled triangles that have a vertex inside every clip plane and face the eye
+	mat4 clip = persp*modelview, inv = Invert(modelview);
+	vec3 eye(inv[0].w, inv[1].w, inv[2].w);
+	int n = 0;
+	for (size_t i = 0; i < meshlets.size(); i++) {
+		if (cull.visible[i] == 1)
+			continue;
+		for (int t = meshlets[i].first; t < meshlets[i].first+meshlets[i].count; t++) {
+			vec3 p[] = { points[triangles[t].i1], points[triangles[t].i2], points[triangles[t].i3] };
+			bool outside = false;
+			for (int k = 0; k < 6 && !outside; k++) {
+				int axis = k/2;
+				float sign = k%2? -1.f : 1.f;
+				outside = true;
+				for (vec3 &v : p) {
+					vec4 c = clip*vec4(v, 1);
+					outside = outside && c.w+sign*c[axis] < 0;
+				}
+			}
+			bool facing = dot(cross(p[1]-p[0], p[2]-p[1]), p[0]-eye) < 0;
+			n += !outside && facing;
+		}
+	}
+	return n;
+}
+
+bool Ranges(MeshletCull &cull, vector<Meshlet> &meshlets) {
+	// ranges cover exactly the visible triangles, in order, none adjacent to the next
+	int nElements = 0;
+	size_t last = 0;
+	for (size_t r = 0; r < cull.counts.size(); r++) {
+		size_t offset = (size_t) cull.offsets[r];
+		if (r && offset <= last)
+			return false;
+		last = offset+cull.counts[r]*cull.indexBytes;
+		nElements += cull.counts[r];
+	}
+	int nVisible = 0;
+	for (size_t i = 0; i < meshlets.size(); i++)
+		nVisible += cull.visible[i] == 1? meshlets[i].count : 0;
+	return nElements == 3*nVisible && cull.nTrianglesCulled == cull.nTriangles-nVisible;
+}
+
+} // end namespace
+
+int main() {
+	vector<vec3> points;
+	vector<int3> triangles, original;
+	Torus(1000, 500, points, triangles);
+	original = triangles;
+	vector<Meshlet> meshlets;
+	vector<int> order;
+	double start = TimeMs();
+	BuildMeshlets(points, triangles, meshlets, 64, 124, &order);
+	double buildMs = TimeMs()-start;
+	int nTriangles = (int) triangles.size();
+	printf("%i points, %i triangles: %i meshlets (%.1f triangles each) built in %.0f ms\n",
+		   (int) points.size(), nTriangles, (int) meshlets.size(), (float) nTriangles/meshlets.size(), buildMs);
+	Check(Partition(points, original, triangles, order, meshlets),
+		  "triangles reordered, not lost; meshlets contiguous, within 64 vertices and 124 triangles, spheres hold their vertices");
+	struct View { const char *name; vec3 eye, at; } views[] = {
+		{ "outside", vec3(0, -4, 2), vec3(0, 0, 0) },
+		{ "close", vec3(1.6f, 0, .3f), vec3(.8f, .6f, 0) },
+		{ "in the hole", vec3(0, 0, .1f), vec3(1, 0, 0) }
+	};
+	mat4 persp = Perspective(60, 1.5f, .01f, 100);
+	for (View &v : views) {
+		mat4 modelview = LookAt(v.eye, v.at, vec3(0, 0, 1));
+		MeshletCull cull;
+		CullMeshlets(meshlets, modelview, persp, cull);
+		double ms = BestMs(10, [&]() { CullMeshlets(meshlets, modelview, persp, cull); });
+		int wrong = WronglyCulled(points, triangles, meshlets, modelview, persp, cull);
+		Check(wrong == 0 && Ranges(cull, meshlets),
+			  "%s: %i of %i triangles culled (%.0f%%; %i meshlets by frustum, %i by cone) in %.3f ms, %i draw ranges; %i visible culled",
+			  v.name, cull.nTrianglesCulled, cull.nTriangles, 100.f*cull.nTrianglesCulled/cull.nTriangles,
+			  cull.nFrustumCulled, cull.nBackfaceCulled, ms, (int) cull.counts.size(), wrong);
+	}
+	// the check catches wrong culling: with every cone reversed, front-facing meshlets are culled
+	vector<Meshlet> reversed = meshlets;
+	for (Meshlet &m : reversed)
+		m.coneAxis = -m.coneAxis;
+	MeshletCull cull;
+	mat4 close = LookAt(views[1].eye, views[1].at, vec3(0, 0, 1));
+	CullMeshlets(reversed, close, persp, cull);
+	Check(WronglyCulled(points, triangles, reversed, close, persp, cull) > 0, "with cones reversed, visible triangles are culled");
+	// with back-face culling off, nothing is culled by cone
+	cull = MeshletCull();
+	cull.backface = false;
+	CullMeshlets(meshlets, close, persp, cull);
+	Check(cull.nBackfaceCulled == 0 && cull.nFrustumCulled > 0, "backface off: %i by cone, %i by frustum", cull.nBackfaceCulled, cull.nFrustumCulled);
+	printf("%s\n", Failures()? "FAILED" : "passed");
+	return Failures();
+}
@@ -0,0 +1,182 @@
+// SceneGraphBench.cpp - SceneGraph against recursive updates: agreement, dirty propagation, and time for 100k nodes
+//     cl /O2 /std:c++17 /IInclude /Itests tests\SceneGraphBench.cpp tests\GLStub.cpp Lib\*.cpp Lib\glad.c glfw3.lib opengl32.lib Lib\freetype.lib
+//     (linked as the apps in src are; no window or context is opened)
+// the reference for a drag is MeshFramer's former recursive rotation (children rotated about the root's
+// origin); the reference for Update is a recursive pointer tree of mat4
+
+#include <math.h>
+#include <memory>
+#include <stdlib.h>
+#include "GLStub.h"
+#include "Mesh.h"
+#include "Quaternion.h"
+#include "SceneGraph.h"
+#include "Test.h"
+#include "Widgets.h"
+
+TEST_SINK;
+
+namespace {
+
+float Random() { return 2.f*rand()/RAND_MAX-1; }
+
+// MeshFramer before SceneGraph
+
+void SetFramedown(Mesh *m) {
+	m->frameDown = Frame(Quaternion(m->transform), MatrixOrigin(m->transform), MatrixScale(m->transform));
+	for (Mesh *c : m->children)
+		SetFramedown(c);
+}
+
+void RotateTransform(Mesh *m, Quaternion qrot, vec3 *center) {
+	Quaternion qq = m->frameDown.orientation*qrot;
+	qq.SetMatrix(m->transform, m->frameDown.scale);
+	if (center) {
+		mat3x4 x = mat3x4(Translate(*center))*mat3x4(qrot.GetMatrix())*mat3x4(Translate(-*center));
+		SetMatrixOrigin(m->transform, x.Point(m->frameDown.position));
+	}
+	for (Mesh *c : m->children)
+		RotateTransform(c, qrot, center? center : &m->frameDown.position);
+}
+
+struct Node { mat4 local, world; vector<Node *> children; };
+
+void Update(Node *n, const mat4 &parentWorld) {
+	n->world = parentWorld*n->local;
+	for (Node *c : n->children)
+		Update(c, n->world);
+}
+
+float Difference(const mat4 &a, const mat4 &b) {
+	// relative to the larger magnitude, as translations grow with depth
+	float d = 0;
+	for (int i = 0; i < 3; i++)
+		for (int j = 0; j < 4; j++)
+			d = fmaxf(d, fabsf(a[i][j]-b[i][j])/fmaxf(1, fmaxf(fabsf(a[i][j]), fabsf(b[i][j]))));
+	return d;
+}
+
+void Drag() {
+	// root, two children, three grandchildren, one great-grandchild, each with a uniform scale
+	vector<std::unique_ptr<Mesh>> meshes;
+	for (int i = 0; i < 7; i++) {
+		meshes.emplace_back(new Mesh());
+		meshes[i]->transform = Translate(Random(), Random(), Random())*RotateX(180*Random())*RotateY(180*Random())*Scale(1+.5f*Random());
+	}
+	Mesh *root = meshes[0].get();
+	root->children = { meshes[1].get(), meshes[2].get() };
+	meshes[1]->children = { meshes[3].get(), meshes[4].get() };
+	meshes[2]->children = { meshes[5].get() };
+	meshes[5]->children = { meshes[6].get() };
+	vector<mat4> start, old;
+	for (auto &m : meshes)
+		start.push_back(m->transform);
+	Quaternion qrot(normalize(vec3(Random(), Random(), Random())), 1.3f);
+	SetFramedown(root);
+	RotateTransform(root, qrot, NULL);
+	for (int i = 0; i < 7; i++) {
+		old.push_back(meshes[i]->transform);
+		meshes[i]->transform = start[i];
+	}
+	// as MeshFramer: capture on mouse down, set only the root on drag
+	SceneGraph graph;
+	graph.Add(root);
+	root->frameDown = Frame(Quaternion(root->transform), MatrixOrigin(root->transform), MatrixScale(root->transform));
+	graph.Capture();
+	mat4 m = root->transform;
+	(root->frameDown.orientation*qrot).SetMatrix(m, root->frameDown.scale);
+	graph.SetLocal(0, mat3x4(m));
+	graph.Update();
+	float d = 0;
+	for (int i = 0; i < 7; i++)
+		d = fmaxf(d, Difference(old[i], meshes[i]->transform));
+	Check(d < 1e-5f && graph.nUpdated == 7, "7-mesh drag: %.1e from the recursive rotation, %i nodes updated", d, graph.nUpdated);
+}
+
+int Descendants(const SceneGraph &g, const vector<int> &dirty) {
+	// nodes that are dirty or have a dirty ancestor
+	vector<char> reached(g.Size(), 0);
+	for (int i : dirty)
+		reached[i] = 1;
+	int n = 0;
+	for (int i = 0; i < g.Size(); i++) {
+		reached[i] = reached[i] || (g.parents[i] >= 0 && reached[g.parents[i]]);
+		n += reached[i];
+	}
+	return n;
+}
+
+void Tree(bool bushy) {
+	// 100k nodes; bushy: parent any earlier node (depth about log n); deep: one of the 64 before (depth about n/32,
+	// shallow enough for the recursive reference on a 1 MB stack)
+	const int n = 100000;
+	SceneGraph graph;
+	vector<Node> nodes(n);
+	for (int i = 0; i < n; i++) {
+		int p = i == 0? -1 : bushy? rand()%i : i-1-rand()%(i < 64? i : 64);
+		mat3x4 local(Translate(Random(), Random(), Random())*RotateZ(10*Random()));
+		graph.Add(p, local);
+		nodes[i].local = local;
+		if (p >= 0)
+			nodes[p].children.push_back(&nodes[i]);
+	}
+	const char *name = bushy? "bushy" : "deep";
+	graph.Update();
+	Update(&nodes[0], mat4());
+	float d = 0;
+	for (int i = 0; i < n; i++)
+		d = fmaxf(d, Difference(nodes[i].world, graph.world[i]));
+	Check(graph.nUpdated == n && d < 1e-3f, "%s tree: first Update recomputes all %i nodes, %.1e from recursive", name, graph.nUpdated, d);
+	graph.Update();
+	Check(graph.nUpdated == 0, "%s tree: an Update with nothing set recomputes %i", name, graph.nUpdated);
+	// dirty subtrees only: move 100 nodes in the latter half, compare with a full recursive update
+	vector<int> moved;
+	for (int k = 0; k < 100; k++) {
+		int i = n/2+rand()%(n/2);
+		moved.push_back(i);
+		mat3x4 local(Translate(Random(), Random(), Random())*RotateZ(10*Random()));
+		graph.SetLocal(i, local);
+		nodes[i].local = local;
+	}
+	graph.Update();
+	Update(&nodes[0], mat4());
+	d = 0;
+	for (int i = 0; i < n; i++)
+		d = fmaxf(d, Difference(nodes[i].world, graph.world[i]));
+	int expected = Descendants(graph, moved);
+	Check(graph.nUpdated == expected && d < 1e-3f, "%s tree: 100 set, %i recomputed (%i expected), %.1e from recursive",
+		  name, graph.nUpdated, expected, d);
+	// level-parallel gives the same
+	vector<mat3x4> serial = graph.world;
+	graph.parallel = true;
+	graph.SetLocal(0, graph.local[0]);
+	graph.Update();
+	d = 0;
+	for (int i = 0; i < n; i++)
+		d = fmaxf(d, Difference(mat4(serial[i]), mat4(graph.world[i])));
+	Check(graph.nUpdated == n && d == 0, "%s tree: level-parallel Update recomputes %i, %.1e from serial", name, graph.nUpdated, d);
+	graph.parallel = false;
+	// timing
+	double recursive = BestMs(10, [&]() { Update(&nodes[0], mat4()); sink += nodes[n-1].world[0][3]; });
+	double all = BestMs(10, [&]() { graph.SetLocal(0, graph.local[0]); graph.Update(); sink += graph.world[n-1][0][3]; });
+	double some = BestMs(10, [&]() { for (int i : moved) graph.SetLocal(i, graph.local[i]); graph.Update(); });
+	int nSome = graph.nUpdated;
+	graph.parallel = true;
+	double parallel = BestMs(10, [&]() { graph.SetLocal(0, graph.local[0]); graph.Update(); });
+	printf("  %s, %i nodes: recursive mat4 %.2f ms; graph all dirty %.2f ms, 100 dirty %.3f ms (%i recomputed), all dirty level-parallel %.2f ms\n",
+		   name, n, recursive, all, some, nSome, parallel);
+}
+
+} // end namespace
+
+int main() {
+	if (!Check(LoadGLStub(), "GL stub loaded as 4.5"))
+		return Failures();
+	srand(1);
+	Drag();
+	printf("best of 10, threads as in Parallel.h:\n");
+	Tree(true);
+	Tree(false);
+	printf("%s\n", Failures()? "FAILED" : "passed");
+	return Failures();
+}
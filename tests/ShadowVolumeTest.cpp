@@ -0,0 +1,113 @@
+// ShadowVolumeTest.cpp - shadow volume construction on the CPU (no GL context): closure and Update timings
+//     cl /O2 /std:c++17 /IInclude tests\ShadowVolumeTest.cpp Lib\*.cpp Lib\glad.c glfw3.lib opengl32.lib Lib\freetype.lib
+//     (linked as the apps in src are; Init and Update make no GL calls, so no window or context is opened)
+// a shadow volume is closed and consistently wound if every directed edge of its triangles has its reverse
+
+#include <algorithm>
+#include <array>
+#include <vector>
+#include "ShadowVolume.h"
+#include "Test.h"
+
+TEST_SINK;
+
+namespace {
+
+typedef std::array<float, 6> Edge;         // directed, two positions
+
+void Sphere(int slices, Mesh &m, bool perTriangle) {
+	// latitude-longitude sphere, one point at each pole, slices*(slices/2-1)*2 triangles;
+	// if perTriangle, three points per triangle (as with per-face normals)
+	int stacks = slices/2;
+	vector<vec3> p;
+	p.push_back(vec3(0, 1, 0));
+	for (int j = 1; j < stacks; j++)
+		for (int i = 0; i < slices; i++) {
+			float phi = 3.14159265f*j/stacks, theta = 6.28318531f*i/slices;
+			p.push_back(vec3(sin(phi)*cos(theta), cos(phi), sin(phi)*sin(theta)));
+		}
+	p.push_back(vec3(0, -1, 0));
+	int south = (int) p.size()-1;
+	auto Id = [&](int j, int i) { return 1+(j-1)*slices+i%slices; };
+	vector<int3> t;
+	for (int i = 0; i < slices; i++) {
+		t.push_back(int3(0, Id(1, i+1), Id(1, i)));
+		t.push_back(int3(south, Id(stacks-1, i), Id(stacks-1, i+1)));
+		for (int j = 1; j < stacks-1; j++) {
+			t.push_back(int3(Id(j, i), Id(j, i+1), Id(j+1, i+1)));
+			t.push_back(int3(Id(j, i), Id(j+1, i+1), Id(j+1, i)));
+		}
+	}
+	m.points.resize(0);
+	m.triangles.resize(0);
+	if (!perTriangle) {
+		m.points = p;
+		m.triangles = t;
+		return;
+	}
+	for (int3 &tri : t) {
+		int n = (int) m.points.size();
+		for (int k = 0; k < 3; k++)
+			m.points.push_back(p[tri[k]]);
+		m.triangles.push_back(int3(n, n+1, n+2));
+	}
+}
+
+Edge MakeEdge(vec3 a, vec3 b) { return { a.x, a.y, a.z, b.x, b.y, b.z }; }
+
+int Unmatched(const vector<vec3> &v) {
+	// number of directed edges whose reverse is missing (or appears fewer times)
+	vector<Edge> edges;
+	for (size_t i = 0; i+2 < v.size(); i += 3)
+		for (int k = 0; k < 3; k++)
+			edges.push_back(MakeEdge(v[i+k], v[i+(k+1)%3]));
+	std::sort(edges.begin(), edges.end());
+	int n = 0;
+	for (Edge &e : edges) {
+		Edge r = { e[3], e[4], e[5], e[0], e[1], e[2] };
+		auto same = std::equal_range(edges.begin(), edges.end(), e), reverse = std::equal_range(edges.begin(), edges.end(), r);
+		n += (same.second-same.first) != (reverse.second-reverse.first);
+	}
+	return n;
+}
+
+} // end namespace
+
+int main() {
+	mat4 transform = Translate(.5f, -.2f, .3f)*RotateY(30)*RotateX(20)*Scale(1.5f);
+	vec3 light(3, 4, 5);
+	// closure
+	printf("closure:\n");
+	for (int perTriangle = 0; perTriangle < 2; perTriangle++)
+		for (int slices : { 32, 128 }) {
+			Mesh m;
+			ShadowVolume volume;
+			Sphere(slices, m, perTriangle != 0);
+			volume.Init(m);
+			volume.Update(m, transform, light);
+			int nFacing = 0;
+			for (char f : volume.facing)
+				nFacing += f;
+			bool counts = volume.nCapTriangles == nFacing && volume.nSilhouette > 0 &&
+						  (int) volume.vertices.size() == 6*(volume.nSilhouette+volume.nCapTriangles);
+			int nUnmatched = Unmatched(volume.vertices);
+			Check(counts && nUnmatched == 0, "%s sphere, %i tris: %i silhouette edges, %i caps, %i unmatched volume edges",
+				  perTriangle? "per-triangle" : "shared-vertex", (int) m.triangles.size(), volume.nSilhouette, volume.nCapTriangles, nUnmatched);
+			if (slices == 32 && !perTriangle) {
+				vector<vec3> open(volume.vertices.begin(), volume.vertices.end()-3);
+				Check(Unmatched(open) > 0, "the same volume less one triangle is open");
+			}
+		}
+	// timing
+	printf("Update ms (best of 3, threads as in Parallel.h):\n");
+	for (int slices : { 32, 128, 512, 2048 }) {
+		Mesh m;
+		ShadowVolume volume;
+		Sphere(slices, m, false);
+		volume.Init(m);
+		double ms = BestMs(3, [&]() { volume.Update(m, transform, light); sink += volume.vertices.back().x; });
+		printf("  %8i tris: %8.2f (%i silhouette edges)\n", (int) m.triangles.size(), ms, volume.nSilhouette);
+	}
+	printf("%s\n", Failures()? "FAILED" : "passed");
+	return Failures();
+}
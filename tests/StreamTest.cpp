@@ -0,0 +1,98 @@
+// StreamTest.cpp - Mesh::UpdatePoints against a counting GL stub: no GL allocation after the first frame
+//     cl /O2 /std:c++17 /IInclude /Itests tests\StreamTest.cpp tests\GLStub.cpp Lib\*.cpp Lib\glad.c glfw3.lib opengl32.lib Lib\freetype.lib
+//     (linked as the apps in src are; no window or context is opened)
+
+#include <string.h>
+#include "GLPool.h"
+#include "GLStub.h"
+#include "Mesh.h"
+#include "Test.h"
+
+namespace {
+
+const int Rows = 6, Columns = 10;
+
+void Grid(Mesh &m, int rows) {
+	// rows by Columns points in the xz plane, two triangles per cell
+	m.points.resize(rows*Columns);
+	m.normals.resize(rows*Columns);
+	m.triangles.resize(0);
+	for (int j = 0; j+1 < rows; j++)
+		for (int i = 0; i+1 < Columns; i++) {
+			int k = j*Columns+i;
+			m.triangles.push_back(int3(k, k+Columns, k+Columns+1));
+			m.triangles.push_back(int3(k, k+Columns+1, k+1));
+		}
+}
+
+void Wave(Mesh &m, int frame) {
+	// deform in place, as RandRay's wavy mesh
+	for (int k = 0; k < (int) m.points.size(); k++) {
+		float x = (float) (k%Columns), z = (float) (k/Columns), a = .3f*x+.2f*frame;
+		m.points[k] = vec3(x, .5f*sin(a), z);
+		m.normals[k] = normalize(vec3(-.15f*cos(a), 1, 0));
+	}
+}
+
+bool Written(const Mesh &m) {
+	// the last mapped block holds points then normals
+	size_t size, sizePoints = m.points.size()*sizeof(vec3);
+	const char *p = (const char *) GLStubMapped(&size);
+	return size == 2*sizePoints && !memcmp(p, m.points.data(), sizePoints) && !memcmp(p+sizePoints, m.normals.data(), sizePoints);
+}
+
+} // end namespace
+
+int main() {
+	if (!Check(LoadGLStub(), "GL stub loaded as 4.5"))
+		return Failures();
+	{
+		Mesh m;
+		Grid(m, Rows);
+		int slotSize = 2*Rows*Columns*sizeof(vec3);
+		int nGenerated = 0, nBufferData = 0, nAllocations = 0, nCreated = 0, nMaps = 0, nWritten = 0, nSlots = 0;
+		size_t nBytes = 0;
+		for (int frame = 0; frame < 8; frame++) {
+			GLStubCounts gl = glStub;
+			meshCounters = MeshCounters();
+			Wave(m, frame);
+			m.UpdatePoints();
+			int generated = glStub.generated-gl.generated, bufferData = glStub.bufferData-gl.bufferData;
+			if (frame == 0) {
+				Check(generated > 0 && bufferData > 0 && m.ringSlot == 0 && Written(m),
+					  "frame 0: %i names generated, %i glBufferData, slot %i written", generated, bufferData, m.ringSlot);
+				continue;
+			}
+			nGenerated += generated;
+			nBufferData += bufferData;
+			nAllocations += meshCounters.allocations;
+			nCreated += meshCounters.objectsCreated;
+			nMaps += glStub.maps-gl.maps;
+			nBytes += meshCounters.bytesUploaded;
+			nWritten += Written(m);
+			nSlots += m.ringSlot == frame%m.ringSlots;
+		}
+		Check(nGenerated == 0 && nBufferData == 0, "frames 1-7: %i names generated, %i glBufferData", nGenerated, nBufferData);
+		Check(nAllocations == 0 && nCreated == 0, "frames 1-7: meshCounters %i allocations, %i objects created", nAllocations, nCreated);
+		Check(nMaps == 7 && nWritten == 7 && nBytes == 7*(size_t) slotSize,
+			  "frames 1-7: %i maps, %i with this frame's points and normals, %zu bytes uploaded (%i per frame)", nMaps, nWritten, nBytes, slotSize);
+		Check(nSlots == 7, "frames 1-7: slots cycle 1, 2, 0, ... (%i of 7)", nSlots);
+		// a new point count re-lays out the ring once
+		Grid(m, Rows+1);
+		GLStubCounts gl = glStub;
+		Wave(m, 0);
+		m.UpdatePoints();
+		int relayout = glStub.bufferData-gl.bufferData;
+		gl = glStub;
+		Wave(m, 1);
+		m.UpdatePoints();
+		Check(relayout > 0 && glStub.bufferData == gl.bufferData && glStub.generated == gl.generated && Written(m),
+			  "after a change in point count: %i glBufferData, then none", relayout);
+	}
+	// ~Mesh returns its objects to glPool, which deletes them when trimmed
+	glPool.Trim(0);
+	Check(GLStubLiveNames() == 0 && glStub.badDeletes == 0, "after ~Mesh and glPool.Trim(0): %i live GL names, %i bad deletes",
+		  GLStubLiveNames(), glStub.badDeletes);
+	printf("%s\n", Failures()? "FAILED" : "passed");
+	return Failures();
+}
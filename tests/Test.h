@@ -0,0 +1,45 @@
+// Test.h - checks and timing shared by the programs in tests/
+
+#ifndef TEST_HDR
+#define TEST_HDR
+
+#include <chrono>
+#include <stdarg.h>
+#include <stdio.h>
+
+// each test is a console program: it prints a line per check and per timing, and returns the number
+// of failed checks (0 if all pass); build lines are at the top of each file, run from the repository root
+
+inline int &Failures() { static int n = 0; return n; }
+
+inline bool Check(bool ok, const char *format, ...) {
+	// print format (printf style) after ok or FAIL; count failures
+	va_list args;
+	va_start(args, format);
+	printf(ok? "  ok    " : "  FAIL  ");
+	vprintf(format, args);
+	printf("\n");
+	va_end(args);
+	if (!ok)
+		Failures()++;
+	return ok;
+}
+
+template <class F> double BestMs(int runs, F f) {
+	// least wall-clock time of runs calls to f, in milliseconds
+	double best = 1e30;
+	for (int r = 0; r < runs; r++) {
+		auto start = std::chrono::steady_clock::now();
+		f();
+		double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now()-start).count();
+		best = ms < best? ms : best;
+	}
+	return best;
+}
+
+extern volatile float sink;
+	// results are added here so timed loops aren't optimized away (define once per program: TEST_SINK)
+
+#define TEST_SINK volatile float sink = 0
+
+#endif
@@ -0,0 +1,140 @@
+// VecMatTest.cpp - mat4 SIMD paths against the scalar arithmetic, and a microbenchmark per operation
+//     g++ -O2 -std=c++17 -ffp-contract=off -IInclude tests/VecMatTest.cpp -o VecMatTest
+//     g++ -O2 -std=c++17 -ffp-contract=off -DVECMAT_SCALAR -IInclude tests/VecMatTest.cpp -o VecMatTestScalar
+//     cl /O2 /std:c++17 /IInclude tests\VecMatTest.cpp     (add /DVECMAT_SCALAR for the scalar build)
+// products and Transpose must be bit-identical to the reference (scalar sums, in order, starting from zero);
+// no fused multiply-add: gcc and clang contract a*b+c unless -ffp-contract=off (msvc doesn't by default)
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include "VecMat.h"
+#include "Test.h"
+
+TEST_SINK;
+
+namespace {
+
+const int N = 4096;
+
+// Reference (the scalar code of VecMat.h, copied so that one build compares both)
+
+mat4 RefMul(const mat4 &a, const mat4 &b) {
+	mat4 r(0);
+	for (int i = 0; i < 4; i++)
+		for (int j = 0; j < 4; j++)
+			for (int k = 0; k < 4; k++)
+				r[i][j] += a[i][k]*b[k][j];
+	return r;
+}
+
+vec4 RefMul(const mat4 &m, const vec4 &v) {
+	vec4 r;
+	for (int i = 0; i < 4; i++)
+		r[i] = m[i].x*v.x+m[i].y*v.y+m[i].z*v.z+m[i].w*v.w;
+	return r;
+}
+
+mat4 RefTranspose(const mat4 &m) {
+	mat4 r;
+	for (int i = 0; i < 4; i++)
+		for (int j = 0; j < 4; j++)
+			r[i][j] = m[j][i];
+	return r;
+}
+
+mat4 RefInvert(const mat4 &m) {
+	mat4 inv;
+	InverseMatrix4x4((const float *) m, &inv[0].x);
+	return inv;
+}
+
+// Inputs
+
+float Random(float lo, float hi) { return lo+(hi-lo)*rand()/RAND_MAX; }
+
+mat4 RandomMatrix() {
+	// entries in [-1, 1], some exactly zero of either sign
+	mat4 m;
+	for (int i = 0; i < 4; i++)
+		for (int j = 0; j < 4; j++) {
+			int r = rand()%16;
+			m[i][j] = r == 0? 0.f : r == 1? -0.f : Random(-1, 1);
+		}
+	return m;
+}
+
+mat4 RandomAffine() {
+	return Translate(Random(-10, 10), Random(-10, 10), Random(-10, 10))*RotateX(Random(-180, 180))*
+		   RotateY(Random(-180, 180))*Scale(Random(.1f, 4), Random(.1f, 4), Random(.1f, 4));
+}
+
+bool Same(const void *a, const void *b, size_t n) { return memcmp(a, b, n) == 0; }
+
+float Residual(const mat4 &m, const mat4 &inv) {
+	// max |m*inv-I|, in double
+	float e = 0;
+	for (int i = 0; i < 4; i++)
+		for (int j = 0; j < 4; j++) {
+			double s = 0;
+			for (int k = 0; k < 4; k++)
+				s += (double) m[i][k]*inv[k][j];
+			e = fmax(e, (float) fabs(s-(i == j? 1 : 0)));
+		}
+	return e;
+}
+
+} // end namespace
+
+int main() {
+#if defined(VECMAT_SSE)
+	printf("VecMat: SSE\n");
+#elif defined(VECMAT_NEON)
+	printf("VecMat: NEON\n");
+#else
+	printf("VecMat: scalar\n");
+#endif
+	srand(1);
+	std::vector<mat4> a(N), b(N), affine(N), c(N);
+	std::vector<vec4> v(N), w(N);
+	for (int i = 0; i < N; i++) {
+		a[i] = RandomMatrix();
+		b[i] = i%2? RandomMatrix() : RandomAffine();
+		affine[i] = RandomAffine();
+		v[i] = vec4(Random(-10, 10), Random(-10, 10), i%3? Random(-10, 10) : -0.f, 1);
+	}
+	// equivalence
+	printf("equivalence, %i random and affine matrices:\n", N);
+	int nProduct = 0, nVector = 0, nTranspose = 0;
+	for (int i = 0; i < N; i++) {
+		mat4 p = a[i]*b[i], q = RefMul(a[i], b[i]);
+		vec4 x = a[i]*v[i], y = RefMul(a[i], v[i]);
+		mat4 t = Transpose(a[i]), u = RefTranspose(a[i]);
+		nProduct += Same(&p, &q, sizeof(mat4));
+		nVector += Same(&x, &y, sizeof(vec4));
+		nTranspose += Same(&t, &u, sizeof(mat4));
+	}
+	Check(nProduct == N, "mat4*mat4 bit-identical: %i of %i", nProduct, N);
+	Check(nVector == N, "mat4*vec4 bit-identical: %i of %i", nVector, N);
+	Check(nTranspose == N, "Transpose bit-identical: %i of %i", nTranspose, N);
+	float e = 0, eRef = 0;
+	for (int i = 0; i < N; i++) {
+		e = fmax(e, Residual(affine[i], Invert(affine[i])));
+		eRef = fmax(eRef, Residual(affine[i], RefInvert(affine[i])));
+	}
+	// affine inputs are well conditioned (scales .1 to 4, translations to 10): the residual is rounding only
+	Check(e < 1e-3f && e < 4*eRef+1e-5f, "Invert max |m*inv-I| %.1e (InverseMatrix4x4 %.1e)", e, eRef);
+	mat4 ident, inv = Invert(mat4(vec4(1, 2, 3, 4), vec4(2, 4, 6, 8), vec4(0, 1, 0, 0), vec4(0, 0, 1, 0)));
+	Check(Same(&inv, &ident, sizeof(mat4)), "Invert of singular matrix is identity");
+	// microbenchmark: compare with the VECMAT_SCALAR build
+	printf("ns per operation (best of 5, %i inputs in cache):\n", N);
+	auto Report = [](const char *name, double ms) { printf("  %-18s %6.2f\n", name, 1e6*ms/N); };
+	Report("mat4*mat4", BestMs(5, [&]() { for (int i = 0; i < N; i++) c[i] = a[i]*b[i]; sink += c[N-1][3][3]; }));
+	Report("chained mat4*mat4", BestMs(5, [&]() { mat4 m; for (int i = 0; i < N; i++) m = m*affine[i]; sink += m[3][3]; }));
+	Report("mat4*vec4", BestMs(5, [&]() { for (int i = 0; i < N; i++) w[i] = a[i]*v[i]; sink += w[N-1].w; }));
+	Report("Transpose", BestMs(5, [&]() { for (int i = 0; i < N; i++) c[i] = Transpose(a[i]); sink += c[N-1][3][3]; }));
+	Report("Invert", BestMs(5, [&]() { for (int i = 0; i < N; i++) c[i] = Invert(affine[i]); sink += c[N-1][3][3]; }));
+	printf("%s\n", Failures()? "FAILED" : "passed");
+	return Failures();
+}
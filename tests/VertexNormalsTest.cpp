@@ -0,0 +1,127 @@
+// VertexNormalsTest.cpp - SetVertexNormals (CSR gather) against the former scatter and scalar references; scaling
+//     cl /O2 /std:c++17 /IInclude /Itests tests\VertexNormalsTest.cpp tests\GLStub.cpp Lib\*.cpp Lib\glad.c glfw3.lib opengl32.lib Lib\freetype.lib
+//     (linked as the apps in src are; no window or context is opened)
+// uniform weighting is the former scatter's result; area and angle weights are checked against a scalar
+// accumulation of cross products (area) and of corner angles times unit normals (angle); all agree to 1e-6
+// (uniform and area exactly, as built here, if the compiler doesn't contract to fused multiply-adds)
+
+#include <math.h>
+#include "CornerTable.h"
+#include "GLStub.h"
+#include "Mesh.h"
+#include "Parallel.h"
+#include "Test.h"
+
+TEST_SINK;
+
+namespace {
+
+const char *weightNames[] = { "uniform", "area", "angle" };
+
+void Grid(int res, vector<vec3> &points, vector<int3> &triangles) {
+	// (res+1)^2 points over the unit square, displaced in z, two triangles per cell
+	points.resize(0);
+	triangles.resize(0);
+	for (int j = 0; j <= res; j++)
+		for (int i = 0; i <= res; i++) {
+			float u = (float) i/res, v = (float) j/res;
+			points.push_back(vec3(u, v, .1f*sinf(13*u)*cosf(7*v)+.01f*sinf(97*u*v)));
+		}
+	for (int j = 0; j < res; j++)
+		for (int i = 0; i < res; i++) {
+			int a = j*(res+1)+i, b = a+1, c = a+res+1, d = c+1;
+			triangles.push_back(int3(a, b, d));
+			triangles.push_back(int3(a, d, c));
+		}
+}
+
+void Scatter(vector<vec3> &points, vector<int3> &triangles, vector<vec3> &normals) {
+	// SetVertexNormals before the gather: each triangle's unit normal added to its three vertices
+	normals.assign(points.size(), vec3(0, 0, 0));
+	for (int3 &t : triangles) {
+		vec3 &p1 = points[t.i1], &p2 = points[t.i2], &p3 = points[t.i3];
+		vec3 n = normalize(cross(p2-p1, p3-p2));
+		normals[t.i1] += n;
+		normals[t.i2] += n;
+		normals[t.i3] += n;
+	}
+	for (vec3 &n : normals)
+		n = normalize(n);
+}
+
+void Reference(vector<vec3> &points, vector<int3> &triangles, vector<vec3> &normals, NormalWeight w) {
+	normals.assign(points.size(), vec3(0, 0, 0));
+	for (int3 &t : triangles) {
+		int id[] = { t.i1, t.i2, t.i3 };
+		vec3 c = cross(points[t.i2]-points[t.i1], points[t.i3]-points[t.i2]);
+		for (int k = 0; k < 3; k++) {
+			vec3 u = points[id[(k+1)%3]]-points[id[k]], v = points[id[(k+2)%3]]-points[id[k]];
+			float angle = (float) acos(dot(normalize(u), normalize(v)));
+			normals[id[k]] += w == AreaWeight? c : w == AngleWeight? angle*normalize(c) : normalize(c);
+		}
+	}
+	for (vec3 &n : normals)
+		n = normalize(n);
+}
+
+float MaxDifference(const vector<vec3> &a, const vector<vec3> &b) {
+	float d = a.size() == b.size()? 0 : 1e30f;
+	for (size_t i = 0; i < a.size() && i < b.size(); i++)
+		d = fmaxf(d, length(a[i]-b[i]));
+	return d;
+}
+
+} // end namespace
+
+int main() {
+	if (!Check(LoadGLStub(), "GL stub loaded as 4.5"))
+		return Failures();
+	vector<vec3> points, expected, normals;
+	vector<int3> triangles;
+	Grid(200, points, triangles);
+	// equivalence
+	Scatter(points, triangles, expected);
+	SetVertexNormals(points, triangles, normals);
+	float d = MaxDifference(expected, normals);
+	Check(d <= 1e-6f, "uniform: %.1e from the former scatter", d);
+	for (int w = 0; w < 3; w++) {
+		Reference(points, triangles, expected, (NormalWeight) w);
+		SetVertexNormals(points, triangles, normals, (NormalWeight) w);
+		d = MaxDifference(expected, normals);
+		Check(d <= 1e-6f, "%s: %.1e from the scalar reference", weightNames[w], d);
+	}
+	// sized normals are overwritten, not accumulated into
+	normals.assign(points.size(), vec3(1, 2, 3));
+	SetVertexNormals(points, triangles, normals, AngleWeight);
+	d = MaxDifference(expected, normals);
+	Check(d <= 1e-6f, "angle, into stale normals: %.1e from the scalar reference", d);
+	// Mesh keeps the adjacency: a second SetNormals, after moving points, reuses it and is current
+	{
+		Mesh m;
+		m.points = points;
+		m.triangles = triangles;
+		m.SetNormals(AngleWeight);
+		for (vec3 &p : m.points)
+			p.z *= 2;
+		m.SetNormals(AngleWeight);
+		Reference(m.points, m.triangles, expected, AngleWeight);
+		d = MaxDifference(expected, m.normals);
+		Check(d <= 1e-6f, "Mesh::SetNormals after deforming, cached adjacency: %.1e from the scalar reference", d);
+	}
+	// scaling
+	printf("ms, best of 5, %i threads (the gather reuses the adjacency, built once per mesh):\n", NumThreads());
+	printf("  %10s %10s %8s %9s %8s %8s %8s %14s\n", "vertices", "triangles", "scatter", "adjacency", "uniform", "area", "angle", "M vertices/s");
+	for (int res : { 500, 1000, 1500, 2000 }) {
+		Grid(res, points, triangles);
+		VertexTriangles adjacency;
+		double scatter = BestMs(5, [&]() { Scatter(points, triangles, normals); sink += normals[0].z; });
+		double build = BestMs(5, [&]() { adjacency.Build(triangles, (int) points.size()); });
+		double gather[3];
+		for (int w = 0; w < 3; w++)
+			gather[w] = BestMs(5, [&]() { SetVertexNormals(points, triangles, adjacency, normals, (NormalWeight) w); sink += normals[0].z; });
+		printf("  %10i %10i %8.1f %9.1f %8.1f %8.1f %8.1f %14.1f\n", (int) points.size(), (int) triangles.size(),
+			   scatter, build, gather[0], gather[1], gather[2], points.size()/(1000*gather[0]));
+	}
+	printf("%s\n", Failures()? "FAILED" : "passed");
+	return Failures();
+}